@@ -0,0 +1,968 @@
+//
+// Created by agent on 17-10-2026.
+//
+
+#include <cmath>
+#include <cstdlib>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <stb_image.h>
+
+#include "system/asset_manager.hpp"
+#include "system/instance_compression.hpp"
+#include "system/mesh_bvh.hpp"
+#include "system/occlusion_culler.hpp"
+#include "system/scene_graph.hpp"
+#include "system/vertex_compression.hpp"
+#include "util/dynamic_bvh.hpp"
+#include "util/frustum.hpp"
+#include "util/ls_log.hpp"
+#include "util/normal_matrix.hpp"
+#include "util/thread_pool.hpp"
+#include "util/util.hpp"
+
+/**
+ * CPU benchmarks of the asset import, instance and culling code, run with "light_show_bench [name...]". Every
+ * benchmark compares against a straightforward reference and checks that the results match. The GPU draw overhead is
+ * measured by the application itself, see --benchmark in main.cpp.
+ */
+
+double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Writes a grid of {size} by {size} quads, as two triangles each, with one material. Returns false on failure.
+ */
+bool write_grid_obj(const std::string &dir, const std::string &file, uint32_t size)
+{
+    FILE *mtl = fopen((dir + "/bench_grid.mtl").c_str(), "w");
+    if (!mtl) {
+        return false;
+    }
+    fprintf(mtl, "newmtl grid\nKd 0.8 0.8 0.8\n");
+    fclose(mtl);
+
+    FILE *obj = fopen((dir + "/" + file).c_str(), "w");
+    if (!obj) {
+        return false;
+    }
+
+    fprintf(obj, "mtllib bench_grid.mtl\nvn 0 1 0\n");
+    for (uint32_t z = 0; z <= size; z++) {
+        for (uint32_t x = 0; x <= size; x++) {
+            fprintf(obj, "v %u 0 %u\nvt %f %f\n", x, z, (float) x / (float) size, (float) z / (float) size);
+        }
+    }
+
+    fprintf(obj, "usemtl grid\n");
+    for (uint32_t z = 0; z < size; z++) {
+        for (uint32_t x = 0; x < size; x++) {
+            uint32_t a = z * (size + 1) + x + 1;
+            uint32_t b = a + 1;
+            uint32_t c = a + size + 1;
+            uint32_t d = c + 1;
+            fprintf(obj, "f %u/%u/1 %u/%u/1 %u/%u/1\nf %u/%u/1 %u/%u/1 %u/%u/1\n", a, a, c, c, b, b, b, b, c, c, d, d);
+        }
+    }
+
+    return fclose(obj) == 0;
+}
+
+/**
+ * Whether the vertices of {a} and {b} match within float precision, and their submeshes have the same indices.
+ */
+bool same_mesh(const Model &a, const Model &b)
+{
+    auto near = [](glm::vec3 x, glm::vec3 y) {
+        return glm::length(x - y) <= 1e-5f * std::max(1.f, std::max(glm::length(x), glm::length(y)));
+    };
+
+    if (a.vertices.size() != b.vertices.size() ||
+        a.mesh.materialSubMeshes.size() != b.mesh.materialSubMeshes.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.vertices.size(); i++) {
+        const Vertex &x = a.vertices[i];
+        const Vertex &y = b.vertices[i];
+        if (!near(x.position, y.position) || !near(x.normal, y.normal) ||
+            !near(glm::vec3(x.uv.x, x.uv.y, 0.f), glm::vec3(y.uv.x, y.uv.y, 0.f)) ||
+            !near(x.tangent, y.tangent) || !near(x.biTangent, y.biTangent)) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < a.mesh.materialSubMeshes.size(); i++) {
+        if (a.mesh.materialSubMeshes[i].indices != b.mesh.materialSubMeshes[i].indices) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Import time of grids of increasing size with both OBJ front-ends, the time per face should stay about constant.
+ * The models imported with the parallel parser are checked against those imported with tinyobjloader.
+ */
+void bench_import()
+{
+    printf("OBJ import, time per face should not grow with the face count\n");
+
+    AssetManager asset_manager;
+    for (uint32_t size : {50u, 100u, 200u, 400u}) {
+        std::string file = "bench_grid_" + std::to_string(size) + ".obj";
+        if (!write_grid_obj(".", file, size)) {
+            ls_log::log(LOG_ERROR, "cannot write %s\n", file.c_str());
+            return;
+        }
+
+        uint32_t faces = size * size * 2;
+        printf("  %7u faces:", faces);
+        Model tinyobj_model(0);
+        Model parallel_model(0);
+        for (ObjParserType parser : {TINYOBJ_PARSER, PARALLEL_PARSER}) {
+            Model *model = parser == TINYOBJ_PARSER ? &tinyobj_model : &parallel_model;
+            asset_manager.setObjParserType(parser);
+
+            auto start = std::chrono::steady_clock::now();
+            if (!asset_manager.importObj(".", file, model)) {
+                printf("\n");
+                return;
+            }
+            double ms = elapsed_ms(start);
+
+            printf("  %s %8.1f ms (%5.0f ns/face)", parser == TINYOBJ_PARSER ? "tinyobj" : "parallel", ms,
+                   ms * 1e6 / faces);
+        }
+        printf("%s\n", same_mesh(tinyobj_model, parallel_model) ? "" : "  MISMATCH");
+
+        std::remove(file.c_str());
+    }
+    std::remove("bench_grid.mtl");
+}
+
+/**
+ * Random transforms in a box around the origin, rotated about random axes. Seen from the origin looking down -z,
+ * about a quarter of them is visible.
+ */
+std::vector<glm::mat4> random_transforms(uint32_t count, std::mt19937 *random, bool uniform_scale)
+{
+    std::uniform_real_distribution<float> position(-400.f, 400.f);
+    std::uniform_real_distribution<float> angle(-3.14f, 3.14f);
+    std::uniform_real_distribution<float> scale(.5f, 3.f);
+
+    std::vector<glm::mat4> transforms(count);
+    for (auto &transform : transforms) {
+        glm::vec3 axis = glm::normalize(glm::vec3(position(*random), position(*random), position(*random) + .1f));
+        float uniform = scale(*random);
+        glm::vec3 axis_scale = uniform_scale ? glm::vec3(uniform) : glm::vec3(uniform, scale(*random), scale(*random));
+
+        transform = glm::translate(glm::mat4(1.f), glm::vec3(position(*random), position(*random) * .2f,
+                                                             position(*random)));
+        transform = glm::rotate(transform, angle(*random), axis);
+        transform = glm::scale(transform, axis_scale);
+    }
+
+    return transforms;
+}
+
+/**
+ * Per-instance frustum culling and compaction with the {InstanceCuller} of {Renderer::compactVisibleInstances},
+ * against a scalar sphere test per instance.
+ */
+void bench_instance_culling()
+{
+    printf("instance culling and compaction, %u threads\n", ThreadPool::get_instance()->get_thread_count());
+
+    glm::mat4 perspective = glm::perspective(glm::radians(60.f), 16.f / 9.f, .1f, 500.f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, 1.f, 0.f));
+    Frustum frustum = Frustum::from_matrix(perspective * view);
+    glm::vec3 center(.3f, .1f, -.2f);
+    float radius = 1.5f;
+
+    std::mt19937 random(1);
+    for (uint32_t count : {1000u, 10000u, 100000u, 1000000u}) {
+        std::vector<glm::mat4> transforms = random_transforms(count, &random, false);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<glm::mat4> expected;
+        for (const auto &transform : transforms) {
+            float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(
+                    glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+            if (frustum.intersects_sphere(glm::vec3(transform * glm::vec4(center, 1.f)), radius * scale)) {
+                expected.emplace_back(transform);
+            }
+        }
+        double scalar_ms = elapsed_ms(start);
+
+        InstanceCuller culler;
+        std::vector<glm::mat4> compacted(count);
+        uint32_t visible_count = 0;
+
+        // best of a few runs, the first one also faults in the memory
+        double parallel_ms = INFINITY;
+        for (uint32_t run = 0; run < 5; run++) {
+            start = std::chrono::steady_clock::now();
+            visible_count = culler.cull(frustum, transforms.data(), count, center, radius);
+            culler.compact([&](uint32_t first, const uint32_t *sources, uint32_t source_count) {
+                for (uint32_t i = 0; i < source_count; i++) {
+                    compacted[first + i] = transforms[sources[i]];
+                }
+            });
+            parallel_ms = std::min(parallel_ms, elapsed_ms(start));
+        }
+
+        bool match = visible_count == expected.size() &&
+                     memcmp(compacted.data(), expected.data(), expected.size() * sizeof(glm::mat4)) == 0;
+        printf("  %7u instances, %6u visible: scalar %8.3f ms, parallel SIMD %8.3f ms%s\n", count,
+               visible_count, scalar_ms, parallel_ms, match ? "" : "  MISMATCH");
+    }
+}
+
+/**
+ * Size, encode time and precision of the instance formats on translate, rotate and uniform scale transforms.
+ */
+void bench_instance_formats()
+{
+    const uint32_t count = 1000000;
+    const char *const names[INSTANCE_FORMAT_COUNT] = {"mat4", "affine", "quantized"};
+
+    printf("instance formats, %u transforms, single-threaded encode\n", count);
+
+    std::mt19937 random(3);
+    std::vector<glm::mat4> transforms = random_transforms(count, &random, true);
+
+    for (uint32_t format = 0; format < INSTANCE_FORMAT_COUNT; format++) {
+        uint32_t size = InstanceCompression::getSize((InstanceFormat) format);
+        std::vector<uint8_t> encoded((size_t) count * size);
+
+        auto start = std::chrono::steady_clock::now();
+        InstanceCompression::encode((InstanceFormat) format, transforms.data(), count, encoded.data());
+        double ms = elapsed_ms(start);
+
+        // largest error of an axis relative to its length, and of the translation
+        float axis_error = 0;
+        float translation_error = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            glm::mat4 decoded = InstanceCompression::decode((InstanceFormat) format, &encoded[(size_t) i * size]);
+            for (int axis = 0; axis < 3; axis++) {
+                glm::vec3 expected = glm::vec3(transforms[i][axis]);
+                axis_error = std::max(axis_error,
+                                      glm::length(glm::vec3(decoded[axis]) - expected) / glm::length(expected));
+            }
+            translation_error = std::max(translation_error,
+                                         glm::length(glm::vec3(decoded[3]) - glm::vec3(transforms[i][3])));
+        }
+
+        printf("  %-9s %2u bytes, %6.1f MB, encode %6.1f ms, axis error %.1e, translation error %.1e\n",
+               names[format], size, (double) count * size / 1e6, ms, axis_error, translation_error);
+    }
+}
+
+/**
+ * Batched SSE normal matrices against {PackedNormalMatrix::from_transform} one at a time.
+ */
+void bench_normal_matrices()
+{
+    const uint32_t count = 1000000;
+
+    printf("normal matrices, %u affine transforms, single-threaded\n", count);
+
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> element(-4.f, 4.f);
+    std::vector<glm::mat4> transforms(count, glm::mat4(1.f));
+    for (auto &transform : transforms) {
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 3; row++) {
+                transform[column][row] = element(random);
+            }
+        }
+    }
+
+    std::vector<PackedNormalMatrix> expected(count);
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < count; i++) {
+        expected[i] = PackedNormalMatrix::from_transform(transforms[i]);
+    }
+    double scalar_ms = elapsed_ms(start);
+
+    std::vector<PackedNormalMatrix> batched(count);
+    start = std::chrono::steady_clock::now();
+    PackedNormalMatrix::from_transforms(transforms.data(), count, batched.data());
+    double batched_ms = elapsed_ms(start);
+
+    float difference = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        for (int column = 0; column < 3; column++) {
+            difference = std::max(difference, glm::length(batched[i].columns[column] - expected[i].columns[column]) /
+                                              std::max(1e-3f, glm::length(expected[i].columns[column])));
+        }
+    }
+
+    printf("  scalar %.1f ms, SSE %.1f ms, largest relative difference %.1e\n", scalar_ms, batched_ms, difference);
+}
+
+/**
+ * Build, query and update costs of {DynamicBVH} against testing every object, for boxes of 1 to 3 units spread
+ * at a density of one per 64 cubic units.
+ */
+void bench_dynamic_bvh()
+{
+    printf("dynamic BVH, brute force in parentheses, single-threaded queries\n");
+
+    for (uint32_t count : {10000u, 100000u, 1000000u}) {
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        float world = std::cbrt((float) count) * 4.f;
+
+        std::vector<AABB> boxes(count);
+        std::vector<uint32_t> user_data(count);
+        std::vector<uint32_t> proxies(count);
+        for (uint32_t i = 0; i < count; i++) {
+            glm::vec3 center(unit(random) * world, unit(random) * world, unit(random) * world);
+            float half_size = .5f + unit(random);
+            boxes[i] = AABB(center - glm::vec3(half_size), center + glm::vec3(half_size));
+            user_data[i] = i;
+        }
+
+        DynamicBVH bvh;
+        auto start = std::chrono::steady_clock::now();
+        bvh.build(boxes.data(), user_data.data(), count, proxies.data());
+        double build_ms = elapsed_ms(start);
+
+        // a frustum around a box of about 3% of the world
+        Frustum frustum;
+        float low = world * .35f;
+        float high = world * .65f;
+        frustum.planes[0] = glm::vec4(1.f, 0.f, 0.f, -low);
+        frustum.planes[1] = glm::vec4(-1.f, 0.f, 0.f, high);
+        frustum.planes[2] = glm::vec4(0.f, 1.f, 0.f, -low);
+        frustum.planes[3] = glm::vec4(0.f, -1.f, 0.f, high);
+        frustum.planes[4] = glm::vec4(0.f, 0.f, 1.f, -low);
+        frustum.planes[5] = glm::vec4(0.f, 0.f, -1.f, high);
+
+        std::vector<uint32_t> visible;
+        start = std::chrono::steady_clock::now();
+        for (uint32_t run = 0; run < 10; run++) {
+            visible.clear();
+            bvh.cull(frustum, &visible);
+        }
+        double cull_ms = elapsed_ms(start) / 10;
+
+        // NB: the hierarchy culls the fattened boxes it stores, so does the reference
+        std::vector<uint32_t> expected;
+        start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t mask = ALL_FRUSTUM_PLANES;
+            const AABB &box = bvh.get_box(proxies[i]);
+            if (frustum.test_box(box.min, box.max, &mask) != OUTSIDE_FRUSTUM) {
+                expected.emplace_back(i);
+            }
+        }
+        double flat_cull_ms = elapsed_ms(start);
+        std::sort(visible.begin(), visible.end());
+        bool match = visible == expected;
+
+        // rays into the world, against the boxes themselves
+        const uint32_t ray_count = 200;
+        double ray_ms = 0;
+        double flat_ray_ms = 0;
+        for (uint32_t ray = 0; ray < ray_count; ray++) {
+            glm::vec3 origin(unit(random) * world, unit(random) * world, -1.f);
+            glm::vec3 direction = glm::normalize(glm::vec3(unit(random) - .5f, unit(random) - .5f, 1.f));
+            glm::vec3 inverse_direction = glm::vec3(1.f) / direction;
+            auto intersect = [&](uint32_t object, float max_distance) {
+                return boxes[object].intersect_ray(origin, inverse_direction, max_distance);
+            };
+
+            BVHRayHit hit = {UINT32_MAX, INFINITY};
+            start = std::chrono::steady_clock::now();
+            bvh.ray_cast(origin, direction, INFINITY, intersect, &hit);
+            ray_ms += elapsed_ms(start);
+
+            start = std::chrono::steady_clock::now();
+            float nearest = INFINITY;
+            for (uint32_t i = 0; i < count; i++) {
+                nearest = std::min(nearest, intersect(i, nearest));
+            }
+            flat_ray_ms += elapsed_ms(start);
+            match = match && nearest == hit.distance;
+        }
+
+        std::vector<uint32_t> overlapping;
+        start = std::chrono::steady_clock::now();
+        for (uint32_t query = 0; query < 1000; query++) {
+            overlapping.clear();
+            bvh.query_sphere(glm::vec3(unit(random) * world, unit(random) * world, unit(random) * world), 3.f,
+                             &overlapping);
+        }
+        double sphere_ms = elapsed_ms(start) / 1000;
+
+        // a frame moves 10% of the objects, most a little and every tenth across the world
+        start = std::chrono::steady_clock::now();
+        for (uint32_t frame = 0; frame < 10; frame++) {
+            for (uint32_t i = 0; i < count / 10; i++) {
+                uint32_t object = random() % count;
+                glm::vec3 offset = glm::vec3(unit(random) - .5f, unit(random) - .5f, unit(random) - .5f) *
+                                   (i % 10 == 0 ? world : .3f);
+                boxes[object] = AABB(boxes[object].min + offset, boxes[object].max + offset);
+                bvh.move(proxies[object], boxes[object]);
+            }
+        }
+        double move_ms = elapsed_ms(start) / 10;
+
+        DynamicBVH rebuilt;
+        rebuilt.build(boxes.data(), user_data.data(), count, proxies.data());
+
+        printf("  %7u objects: build %7.1f ms, cull %6.3f (%7.3f) ms, ray %7.1f (%8.1f) us, sphere %5.1f us, "
+               "10%% moved %6.1f ms, SAH cost %.2fx of a rebuild%s\n", count, build_ms, cull_ms, flat_cull_ms,
+               ray_ms * 1000 / ray_count, flat_ray_ms * 1000 / ray_count, sphere_ms * 1000, move_ms,
+               bvh.get_sah_cost() / rebuilt.get_sah_cost(), match ? "" : "  MISMATCH");
+    }
+}
+
+/**
+ * A wall facing the camera at the origin, which looks down -z: the rectangle ({min.x}, {min.y}) to ({max.x},
+ * {max.y}) at z = -{depth}.
+ */
+struct BenchWall {
+    glm::vec2 min;
+    glm::vec2 max;
+    float depth;
+
+    /**
+     * Whether the wall hides all of the box ({box_min}, {box_max}): every corner lies behind the wall, and within the
+     * wall as seen from the origin. As the projection of the box is the hull of its corners, that is exact.
+     */
+    bool hides(glm::vec3 box_min, glm::vec3 box_max) const
+    {
+        for (uint32_t corner = 0; corner < 8; corner++) {
+            glm::vec3 point((corner & 1) ? box_max.x : box_min.x, (corner & 2) ? box_max.y : box_min.y,
+                            (corner & 4) ? box_max.z : box_min.z);
+            if (-point.z <= depth) {
+                return false;
+            }
+
+            glm::vec2 projected = glm::vec2(point.x, point.y) * (depth / -point.z);
+            if (projected.x < min.x || projected.y < min.y || projected.x > max.x || projected.y > max.y) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+};
+
+/**
+ * {OcclusionCuller} rasterizing four walls at different depths, which do not overlap on screen, against testing
+ * every box against every wall exactly. As the walls do not overlap, a box is hidden only if a single wall hides it.
+ * The culler is conservative, so it must not report a box that is not hidden, but may miss some that are.
+ */
+void bench_occlusion_culling()
+{
+    const uint32_t count = 100000;
+    const float tan_half_fov = std::tan(glm::radians(30.f));
+    const float aspect = 16.f / 9.f;
+
+    printf("occlusion culling, 4 walls, %u boxes in view, %u threads\n", count,
+           ThreadPool::get_instance()->get_thread_count());
+
+    const BenchWall walls[] = {
+            {{-9.f,  -4.f},  {-.5f,  4.f},  10.f},
+            {{.5f,   -5.f},  {9.f,   -.5f}, 12.f},
+            {{1.f,   .5f},   {9.f,   5.f},  8.f},
+            {{-1.8f, -1.1f}, {-1.1f, -.9f}, 2.f}
+    };
+
+    OcclusionCuller culler;
+    for (const auto &wall : walls) {
+        Model model(0);
+        for (uint32_t corner = 0; corner < 4; corner++) {
+            Vertex vertex = {};
+            vertex.position = glm::vec3((corner & 1) ? wall.max.x : wall.min.x, (corner & 2) ? wall.max.y : wall.min.y,
+                                        -wall.depth);
+            model.vertices.emplace_back(vertex);
+        }
+
+        MaterialSubMesh sub_mesh;
+        sub_mesh.indices = {0, 1, 3, 0, 3, 2};
+        model.mesh.materialSubMeshes.emplace_back(sub_mesh);
+        culler.addOccluder(model, glm::mat4(1.f));
+    }
+
+    // boxes of which all corners are in view, between the near plane and 40 units away
+    std::mt19937 random(9);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::vector<Bounds> boxes;
+    while (boxes.size() < count) {
+        float distance = .5f + unit(random) * 39.5f;
+        glm::vec3 center((unit(random) * 2.f - 1.f) * distance * tan_half_fov * aspect,
+                         (unit(random) * 2.f - 1.f) * distance * tan_half_fov, -distance);
+        glm::vec3 half_size = glm::vec3(unit(random), unit(random), unit(random)) * (.05f + .05f * distance);
+
+        Bounds box;
+        box.min = center - half_size;
+        box.max = center + half_size;
+
+        bool in_view = box.min.z < -.2f;
+        for (float z : {box.min.z, box.max.z}) {
+            float half_width = -z * tan_half_fov * aspect;
+            float half_height = -z * tan_half_fov;
+            in_view = in_view && box.min.x > -half_width && box.max.x < half_width && box.min.y > -half_height &&
+                      box.max.y < half_height;
+        }
+
+        if (in_view) {
+            boxes.emplace_back(box);
+        }
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(60.f), aspect, .1f, 100.f);
+
+    // best of a few runs, the first one also allocates the bins and the pyramid
+    double rasterize_ms = INFINITY;
+    for (uint32_t run = 0; run < 10; run++) {
+        auto start = std::chrono::steady_clock::now();
+        culler.rasterize(projection);
+        rasterize_ms = std::min(rasterize_ms, elapsed_ms(start));
+    }
+
+    std::vector<uint8_t> occluded(count);
+    glm::mat4 identity(1.f);
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < count; i++) {
+        occluded[i] = culler.isOccluded(boxes[i], identity) ? 1 : 0;
+    }
+    double query_ms = elapsed_ms(start);
+
+    std::vector<uint8_t> hidden(count);
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < count; i++) {
+        for (const auto &wall : walls) {
+            hidden[i] = hidden[i] || wall.hides(boxes[i].min, boxes[i].max);
+        }
+    }
+    double exact_ms = elapsed_ms(start);
+
+    uint32_t hidden_count = 0;
+    uint32_t culled_count = 0;
+    uint32_t wrongly_culled = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        hidden_count += hidden[i];
+        culled_count += occluded[i];
+        wrongly_culled += occluded[i] && !hidden[i];
+    }
+
+    printf("  %ux%u depth buffer, %u triangles: rasterize %.3f ms, query %.1f ns/box (exact %.1f ns/box), "
+           "culled %u of %u hidden boxes (%.0f%%)%s\n", culler.getWidth(), culler.getHeight(),
+           culler.getTriangleCount(), rasterize_ms, query_ms * 1e6 / count, exact_ms * 1e6 / count, culled_count,
+           hidden_count, 100.0 * culled_count / std::max(hidden_count, 1u), wrongly_culled == 0 ? "" : "  MISMATCH");
+    if (wrongly_culled > 0) {
+        printf("  %u visible boxes were culled\n", wrongly_culled);
+    }
+}
+
+/**
+ * A node of the recursive reference of {bench_scene_graph}, with its children.
+ */
+struct RecursiveNode {
+    glm::vec3 translation;
+    glm::quat rotation;
+    glm::vec3 scale;
+    std::vector<uint32_t> children;
+};
+
+/**
+ * Computes the world matrices of {node} and its descendants depth first, as a scene graph without dirty tracking
+ * would every frame.
+ */
+void update_recursive(const std::vector<RecursiveNode> &nodes, uint32_t node, const glm::mat4 &parent_world,
+                      std::vector<glm::mat4> *world_matrices)
+{
+    const RecursiveNode &current = nodes[node];
+    glm::mat4 local = glm::translate(glm::mat4(1.f), current.translation) * glm::mat4_cast(current.rotation) *
+                      glm::scale(glm::mat4(1.f), current.scale);
+    (*world_matrices)[node] = parent_world * local;
+
+    for (uint32_t child : current.children) {
+        update_recursive(nodes, child, (*world_matrices)[node], world_matrices);
+    }
+}
+
+/**
+ * Largest difference between an element of the world matrices of {graph} and of {expected}, relative to the largest
+ * element of the matrix and at least 1.
+ */
+float scene_graph_error(const SceneGraph &graph, const std::vector<glm::mat4> &expected)
+{
+    float error = 0;
+    for (uint32_t node = 0; node < expected.size(); node++) {
+        const glm::mat4 &actual = graph.getWorldMatrix(node);
+        float difference = 0;
+        float magnitude = 1;
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                difference = std::max(difference, std::abs(actual[column][row] - expected[node][column][row]));
+                magnitude = std::max(magnitude, std::abs(expected[node][column][row]));
+            }
+        }
+        error = std::max(error, difference / magnitude);
+    }
+
+    return error;
+}
+
+/**
+ * {SceneGraph::update} after changing every node and after moving 0.1% of the nodes, on forests in which each node
+ * has a random earlier node as parent, or is a root. Both are checked against recomputing all world matrices
+ * recursively, which is also timed, and the sparse update must recompute exactly the moved subtrees.
+ */
+void bench_scene_graph()
+{
+    printf("scene graph updates, %u threads, recursive reference in parentheses\n",
+           ThreadPool::get_instance()->get_thread_count());
+
+    for (uint32_t count : {10000u, 100000u, 1000000u}) {
+        std::mt19937 random(11);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        std::normal_distribution<float> normal;
+        auto random_translation = [&]() {
+            return glm::vec3(unit(random) - .5f, unit(random) - .5f, unit(random) - .5f) * 20.f;
+        };
+
+        SceneGraph graph;
+        std::vector<RecursiveNode> nodes(count);
+        std::vector<uint32_t> parents(count);
+        std::vector<uint32_t> roots;
+        for (uint32_t i = 0; i < count; i++) {
+            parents[i] = (i < 16 || unit(random) < .01f) ? UINT32_MAX : (uint32_t) (random() % i);
+            if (parents[i] == UINT32_MAX) {
+                roots.emplace_back(i);
+            } else {
+                nodes[parents[i]].children.emplace_back(i);
+            }
+
+            RecursiveNode &node = nodes[i];
+            node.translation = random_translation();
+            node.rotation = glm::normalize(glm::quat(normal(random), normal(random), normal(random), normal(random)));
+            node.scale = glm::vec3(.8f) + glm::vec3(unit(random), unit(random), unit(random)) * .45f;
+
+            NodeID handle = graph.createNode(parents[i] == UINT32_MAX ? INVALID_NODE : parents[i]);
+            graph.setLocalTransform(handle, node.translation, node.rotation, node.scale);
+        }
+
+        // the first update also sorts the nodes by depth
+        graph.update();
+
+        std::vector<glm::mat4> expected(count);
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t root : roots) {
+            update_recursive(nodes, root, glm::mat4(1.f), &expected);
+        }
+        double recursive_ms = elapsed_ms(start);
+
+        for (uint32_t i = 0; i < count; i++) {
+            graph.setTranslation(i, nodes[i].translation);
+        }
+        start = std::chrono::steady_clock::now();
+        graph.update();
+        double full_ms = elapsed_ms(start);
+        uint32_t full_updated = graph.getUpdatedCount();
+        float full_error = scene_graph_error(graph, expected);
+
+        // nodes are created after their parent, so a single pass finds the moved subtrees
+        std::vector<uint8_t> moved(count, 0);
+        for (uint32_t i = 0; i < count / 1000; i++) {
+            uint32_t node = random() % count;
+            moved[node] = 1;
+            nodes[node].translation = random_translation();
+            graph.setTranslation(node, nodes[node].translation);
+        }
+        uint32_t expected_updated = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            moved[i] = moved[i] || (parents[i] != UINT32_MAX && moved[parents[i]]);
+            expected_updated += moved[i];
+        }
+
+        start = std::chrono::steady_clock::now();
+        graph.update();
+        double sparse_ms = elapsed_ms(start);
+        uint32_t sparse_updated = graph.getUpdatedCount();
+
+        for (uint32_t root : roots) {
+            update_recursive(nodes, root, glm::mat4(1.f), &expected);
+        }
+        float sparse_error = scene_graph_error(graph, expected);
+
+        bool match = full_updated == count && sparse_updated == expected_updated && full_error < 1e-5f &&
+                     sparse_error < 1e-5f;
+        printf("  %7u nodes: full %7.2f (%7.2f) ms, 0.1%% moved %7u nodes in %6.3f ms, largest relative error "
+               "%.1e%s\n", count, full_ms, recursive_ms, sparse_updated, sparse_ms,
+               std::max(full_error, sparse_error), match ? "" : "  MISMATCH");
+    }
+}
+
+/**
+ * Nearest triangle of {model} hit by the ray, testing every triangle with the Moller-Trumbore test of {MeshBVH} one
+ * at a time. {hit->triangle} is numbered through all submeshes. Returns false if no triangle is hit.
+ */
+bool intersect_triangles(const Model &model, glm::vec3 origin, glm::vec3 direction, MeshHit *hit)
+{
+    const Vertex *vertices = model.getVertexData();
+    hit->distance = INFINITY;
+    hit->triangle = UINT32_MAX;
+
+    uint32_t triangle = 0;
+    for (const auto &sub_mesh : model.mesh.materialSubMeshes) {
+        const uint32_t *indices = sub_mesh.getIndexData();
+        for (uint32_t i = 0; i + 2 < sub_mesh.getIndexCount(); i += 3, triangle++) {
+            glm::vec3 v0 = vertices[indices[i]].position;
+            glm::vec3 e1 = vertices[indices[i + 1]].position - v0;
+            glm::vec3 e2 = vertices[indices[i + 2]].position - v0;
+
+            glm::vec3 p = glm::cross(direction, e2);
+            float det = glm::dot(e1, p);
+            if (det == 0.f) {
+                continue;
+            }
+
+            float inverse_det = 1.f / det;
+            glm::vec3 to_origin = origin - v0;
+            float u = glm::dot(to_origin, p) * inverse_det;
+            glm::vec3 q = glm::cross(to_origin, e1);
+            float v = glm::dot(direction, q) * inverse_det;
+            float t = glm::dot(e2, q) * inverse_det;
+            if (u >= 0.f && v >= 0.f && u + v <= 1.f && t >= 0.f && t < hit->distance) {
+                hit->distance = t;
+                hit->triangle = triangle;
+            }
+        }
+    }
+
+    return hit->triangle != UINT32_MAX;
+}
+
+/**
+ * Build time of the {MeshBVH} of the chandelier, and rays cast at it from around its bounds, against testing every
+ * triangle.
+ */
+void bench_mesh_bvh()
+{
+    const uint32_t ray_count = 1000;
+
+    AssetManager asset_manager;
+    Model model(0);
+    if (!asset_manager.importObj(std::string(LIGHT_SHOW_RES_DIR) + "/obj/Chandelier_03", "Chandelier_03.obj",
+                                 &model)) {
+        return;
+    }
+
+    uint32_t triangle_count = 0;
+    AABB bounds;
+    for (const auto &sub_mesh : model.mesh.materialSubMeshes) {
+        triangle_count += sub_mesh.getIndexCount() / 3;
+    }
+    for (uint32_t i = 0; i < model.getVertexCount(); i++) {
+        bounds.grow(model.getVertexData()[i].position);
+    }
+
+    printf("mesh BVH, Chandelier_03 with %u triangles, single-threaded\n", triangle_count);
+
+    MeshBVH bvh;
+    auto start = std::chrono::steady_clock::now();
+    bvh.build(model);
+    double build_ms = elapsed_ms(start);
+
+    // from a sphere around the model, at random points within its bounds
+    std::mt19937 random(13);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::normal_distribution<float> normal;
+    glm::vec3 center = bounds.center();
+    float radius = glm::length(bounds.max - bounds.min);
+
+    uint32_t hits = 0;
+    uint32_t mismatches = 0;
+    double ray_ms = 0;
+    double flat_ray_ms = 0;
+    for (uint32_t ray = 0; ray < ray_count; ray++) {
+        glm::vec3 origin = center + glm::normalize(glm::vec3(normal(random), normal(random), normal(random))) * radius;
+        glm::vec3 target = bounds.min + (bounds.max - bounds.min) * glm::vec3(unit(random), unit(random), unit(random));
+        glm::vec3 direction = glm::normalize(target - origin);
+
+        MeshHit hit = {};
+        start = std::chrono::steady_clock::now();
+        bool found = bvh.intersect(origin, direction, INFINITY, &hit);
+        ray_ms += elapsed_ms(start);
+
+        MeshHit expected = {};
+        start = std::chrono::steady_clock::now();
+        bool expected_found = intersect_triangles(model, origin, direction, &expected);
+        flat_ray_ms += elapsed_ms(start);
+
+        hits += expected_found;
+        if (found != expected_found) {
+            mismatches++;
+        } else if (found) {
+            // NB: rays through a shared edge may hit either triangle, at the same distance
+            uint32_t triangle = bvh.subMeshFirstTriangles[hit.subMesh] + hit.triangle;
+            if (triangle != expected.triangle && hit.distance != expected.distance) {
+                mismatches++;
+            }
+        }
+    }
+
+    printf("  build %.1f ms, %u nodes, %u packets; %u rays, %u hit: BVH %.2f us/ray, brute force %.0f us/ray%s\n",
+           build_ms, bvh.getNodeCount(), bvh.getPacketCount(), ray_count, hits, ray_ms * 1000 / ray_count,
+           flat_ray_ms * 1000 / ray_count, mismatches == 0 ? "" : "  MISMATCH");
+    if (mismatches > 0) {
+        printf("  %u rays hit a different triangle\n", mismatches);
+    }
+}
+
+/**
+ * Same as {octDecode} in the vertex shaders.
+ */
+glm::vec3 decode_octahedral(const int16_t *encoded)
+{
+    glm::vec3 v(std::max(encoded[0] / 32767.f, -1.f), std::max(encoded[1] / 32767.f, -1.f), 0.f);
+    v.z = 1.f - std::fabs(v.x) - std::fabs(v.y);
+    if (v.z < 0.f) {
+        float x = (1.f - std::fabs(v.y)) * (v.x >= 0.f ? 1.f : -1.f);
+        float y = (1.f - std::fabs(v.x)) * (v.y >= 0.f ? 1.f : -1.f);
+        v.x = x;
+        v.y = y;
+    }
+    return glm::normalize(v);
+}
+
+/**
+ * Angle in degrees between {a} and {b}, also precise for small angles unlike the arc cosine of the dot product.
+ */
+float angle_degrees(glm::vec3 a, glm::vec3 b)
+{
+    return std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b)) * 180.f / (float) M_PI;
+}
+
+/**
+ * Size and encode time of {CompactVertex} against {Vertex} for the bundled models, and their decoding errors with the
+ * decoding of the vertex shaders, which must stay within the precision of the formats: half a quantization step of
+ * the position, half a unit in the last place of the half float uv and the octahedral error bound of the normal and
+ * tangent.
+ */
+void bench_vertex_formats()
+{
+    // NB: 16 bit octahedral vectors are within about 0.004 degrees, with room for the float math of the decoding
+    const float max_octahedral_degrees = .006f;
+    const char *const models[][2] = {{"Chandelier_03", "Chandelier_03.obj"}, {"nol", "nol.obj"}};
+
+    printf("vertex formats, single-threaded encode, errors of the shader decoding\n");
+
+    AssetManager asset_manager;
+    for (const auto &file : models) {
+        Model model(0);
+        if (!asset_manager.importObj(std::string(LIGHT_SHOW_RES_DIR) + "/obj/" + file[0], file[1], &model)) {
+            return;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        VertexCompression::compress(&model);
+        double encode_ms = elapsed_ms(start);
+
+        float position_error = 0;
+        float normal_error = 0;
+        float tangent_error = 0;
+        float uv_error = 0;
+        bool within_bounds = true;
+        for (uint32_t i = 0; i < model.getVertexCount(); i++) {
+            const Vertex &vertex = model.vertices[i];
+            const CompactVertex &compact = model.compactVertices[i];
+
+            for (int axis = 0; axis < 3; axis++) {
+                float extent = model.positionScale[axis];
+                float decoded = model.positionOffset[axis] + (float) compact.position[axis] / 65535.f * extent;
+                float error = std::fabs(decoded - vertex.position[axis]);
+                position_error = std::max(position_error, error);
+                within_bounds &= error <= extent * (.5f / 65535.f + 1e-6f);
+            }
+
+            // vertices without a valid normal or tangent get an arbitrary one
+            glm::vec3 normal = glm::normalize(vertex.normal);
+            glm::vec3 tangent = vertex.tangent - normal * glm::dot(normal, vertex.tangent);
+            if (std::isfinite(glm::dot(normal, normal))) {
+                float error = angle_degrees(decode_octahedral(&compact.normalTangent[0]), normal);
+                normal_error = std::max(normal_error, error);
+                within_bounds &= error <= max_octahedral_degrees;
+
+                if (std::isfinite(glm::dot(tangent, tangent)) && glm::length(tangent) > 1e-3f) {
+                    error = angle_degrees(decode_octahedral(&compact.normalTangent[2]), glm::normalize(tangent));
+                    tangent_error = std::max(tangent_error, error);
+                    within_bounds &= error <= max_octahedral_degrees;
+                }
+            }
+
+            for (int axis = 0; axis < 2; axis++) {
+                float uv = vertex.uv[axis];
+                float error = std::fabs(Util::half_to_float(compact.uv[axis]) - uv);
+                if (std::fabs(uv) <= 65504.f) {
+                    uv_error = std::max(uv_error, error);
+                    within_bounds &= error <= std::max(std::fabs(uv) * std::ldexp(1.f, -11), std::ldexp(1.f, -25));
+                }
+            }
+        }
+
+        uint32_t count = model.getVertexCount();
+        printf("  %-13s %6u vertices: %7u -> %7u bytes, encode %6.2f ms, max errors: position %g, normal %.4f, "
+               "tangent %.4f degrees, uv %g%s\n", file[0], count, count * (uint32_t) sizeof(Vertex),
+               count * (uint32_t) sizeof(CompactVertex), encode_ms, position_error, normal_error, tangent_error,
+               uv_error, within_bounds ? "" : "  MISMATCH");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct Benchmark {
+        const char *name;
+        void (*run)();
+    };
+
+    const Benchmark benchmarks[] = {
+            {"import",    bench_import},
+            {"instances", bench_instance_culling},
+            {"formats",   bench_instance_formats},
+            {"normals",   bench_normal_matrices},
+            {"bvh",       bench_dynamic_bvh},
+            {"occlusion", bench_occlusion_culling},
+            {"graph",     bench_scene_graph},
+            {"mesh",      bench_mesh_bvh},
+            {"vertices",  bench_vertex_formats}
+    };
+
+    // all benchmarks without arguments, otherwise those named
+    for (const auto &benchmark : benchmarks) {
+        bool selected = argc == 1;
+        for (int i = 1; i < argc; i++) {
+            selected = selected || strcmp(argv[i], benchmark.name) == 0;
+        }
+
+        if (selected) {
+            benchmark.run();
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
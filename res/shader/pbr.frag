@@ -9,14 +9,14 @@ in vec3 worldBiTangent;
 
 in mat3 TBN;
 
+flat in vec3 albedoValue;
+flat in float roughnessValue;
+flat in float metallicValue;
+
 uniform vec3 cameraPosition;
 
 const float PI = 3.14159265359;
 
-uniform vec3 albedoConstant;
-uniform float roughnessConstant;
-uniform float metallicConstant;
-
 uniform int useAlbedoTexture;
 uniform int useRoughnessTexture;
 uniform int useMetallicTexture;
@@ -80,19 +80,19 @@ void main()
     if(useAlbedoTexture != 0) {
         albedo = texture(albedoTexture, uvCoord).rgb;
     } else {
-        albedo = albedoConstant;
+        albedo = albedoValue;
     }
 
     if(useRoughnessTexture != 0) {
         roughness = texture(roughnessTexture, uvCoord).r;
     } else {
-        roughness = roughnessConstant;
+        roughness = roughnessValue;
     }
 
     if(useMetallicTexture != 0) {
         metallic = texture(metallicTexture, uvCoord).r;
     } else {
-        metallic = metallicConstant;
+        metallic = metallicValue;
     }
 
     vec3 N;
@@ -1,13 +1,26 @@
 #version 420
 
 uniform mat4 ModelM;
+// inverse transpose of the upper 3x3 of ModelM, computed on the CPU
+uniform mat3 NormalM;
 uniform mat4 ViewM;
 uniform mat4 ProjectionM;
 
 uniform vec3 cameraPosition;
 
-layout(location = 0) in vec3 vPos;
-layout(location = 1) in vec3 vNorm;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+uniform vec3 albedoConstant;
+uniform float roughnessConstant;
+uniform float metallicConstant;
+
+// with compactVertices set, vPos holds the quantized position and the bitangent sign in w and vNorm holds the
+// octahedral normal and tangent, see CompactVertex
+uniform int compactVertices;
+
+layout(location = 0) in vec4 vPos;
+layout(location = 1) in vec4 vNorm;
 layout(location = 2) in vec2 vTex;
 
 layout(location = 3) in vec3 tangent;
@@ -22,22 +35,48 @@ out vec3 worldBiTangent;
 
 out mat3 TBN;
 
+// material constants are passed on per draw, so pbr.frag can be shared with pbr_indirect.vert
+flat out vec3 albedoValue;
+flat out float roughnessValue;
+flat out float metallicValue;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0) {
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(v);
+}
+
 void main()
 {
-    gl_Position = ProjectionM * ViewM * ModelM * vec4(vPos, 1.0);
-    uvCoord = vTex;
+    vec3 position = vPos.xyz;
+    vec3 normal = vNorm.xyz;
+    vec3 vertexTangent = tangent;
+    vec3 vertexBiTangent = biTangent;
+    if (compactVertices != 0) {
+        position = positionOffset + vPos.xyz * positionScale;
+        normal = octDecode(vNorm.xy);
+        vertexTangent = octDecode(vNorm.zw);
+        vertexBiTangent = cross(normal, vertexTangent) * (vPos.w * 2.0 - 1.0);
+    }
 
-    //TODO: it is very slow to compute this as a 4x4 rather than 3x3 and to do it in a vertex shader
-    mat4 normalMatrix = transpose(inverse(ModelM));
+    gl_Position = ProjectionM * ViewM * ModelM * vec4(position, 1.0);
+    uvCoord = vTex;
 
-    worldPos = (ModelM * vec4(vPos, 1.0)).xyz;
-    worldNorm = normalize((normalMatrix * vec4(vNorm, 0.0)).xyz);
-    worldTangent = normalize((normalMatrix * vec4(tangent, 0.0)).xyz);
-    worldBiTangent = normalize((normalMatrix * vec4(biTangent, 0.0)).xyz);
+    worldPos = (ModelM * vec4(position, 1.0)).xyz;
+    worldNorm = normalize(NormalM * normal);
+    worldTangent = normalize(NormalM * vertexTangent);
+    worldBiTangent = normalize(NormalM * vertexBiTangent);
 
     TBN = mat3(
         worldTangent,
         worldBiTangent,
         worldNorm
     );
+
+    albedoValue = albedoConstant;
+    roughnessValue = roughnessConstant;
+    metallicValue = metallicConstant;
 }
\ No newline at end of file
@@ -0,0 +1,92 @@
+#version 430
+
+uniform mat4 ViewM;
+uniform mat4 ProjectionM;
+
+uniform vec3 cameraPosition;
+
+// per-draw data of a multi-draw, see GPUDrawData
+struct DrawData {
+    mat4 model;
+    // inverse transpose of the upper 3x3 of model
+    mat3 normal;
+    vec4 albedoRoughness;
+    vec4 metallic;
+    vec4 positionOffset;
+    vec4 positionScale;
+};
+
+layout(std430, binding = 0) readonly buffer DrawDataBuffer {
+    DrawData drawData[];
+};
+
+// with compactVertices set, vPos holds the quantized position and the bitangent sign in w and vNorm holds the
+// octahedral normal and tangent, see CompactVertex
+uniform int compactVertices;
+
+layout(location = 0) in vec4 vPos;
+layout(location = 1) in vec4 vNorm;
+layout(location = 2) in vec2 vTex;
+
+layout(location = 3) in vec3 tangent;
+layout(location = 4) in vec3 biTangent;
+
+// index of the draw within the multi-draw, read at the base instance of the draw
+layout(location = 9) in uint drawID;
+
+out vec3 worldPos;
+out vec3 worldNorm;
+out vec2 uvCoord;
+
+out vec3 worldTangent;
+out vec3 worldBiTangent;
+
+out mat3 TBN;
+
+flat out vec3 albedoValue;
+flat out float roughnessValue;
+flat out float metallicValue;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0) {
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(v);
+}
+
+void main()
+{
+    mat4 ModelM = drawData[drawID].model;
+    mat3 NormalM = drawData[drawID].normal;
+
+    vec3 position = vPos.xyz;
+    vec3 normal = vNorm.xyz;
+    vec3 vertexTangent = tangent;
+    vec3 vertexBiTangent = biTangent;
+    if (compactVertices != 0) {
+        position = drawData[drawID].positionOffset.xyz + vPos.xyz * drawData[drawID].positionScale.xyz;
+        normal = octDecode(vNorm.xy);
+        vertexTangent = octDecode(vNorm.zw);
+        vertexBiTangent = cross(normal, vertexTangent) * (vPos.w * 2.0 - 1.0);
+    }
+
+    gl_Position = ProjectionM * ViewM * ModelM * vec4(position, 1.0);
+    uvCoord = vTex;
+
+    worldPos = (ModelM * vec4(position, 1.0)).xyz;
+    worldNorm = normalize(NormalM * normal);
+    worldTangent = normalize(NormalM * vertexTangent);
+    worldBiTangent = normalize(NormalM * vertexBiTangent);
+
+    TBN = mat3(
+        worldTangent,
+        worldBiTangent,
+        worldNorm
+    );
+
+    albedoValue = drawData[drawID].albedoRoughness.rgb;
+    roughnessValue = drawData[drawID].albedoRoughness.a;
+    metallicValue = drawData[drawID].metallic.r;
+}
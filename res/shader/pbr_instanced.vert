@@ -0,0 +1,125 @@
+#version 420
+
+uniform mat4 ViewM;
+uniform mat4 ProjectionM;
+
+uniform vec3 cameraPosition;
+
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+uniform vec3 albedoConstant;
+uniform float roughnessConstant;
+uniform float metallicConstant;
+
+// with compactVertices set, vPos holds the quantized position and the bitangent sign in w and vNorm holds the
+// octahedral normal and tangent, see CompactVertex
+uniform int compactVertices;
+
+layout(location = 0) in vec4 vPos;
+layout(location = 1) in vec4 vNorm;
+layout(location = 2) in vec2 vTex;
+
+layout(location = 3) in vec3 tangent;
+layout(location = 4) in vec3 biTangent;
+
+// per-instance transform, laid out as selected by instanceFormat, see InstanceFormat:
+// 0: the columns of the model matrix
+// 1: the first three rows of the model matrix
+// 2: translation and uniform scale in instance0, unit quaternion in instance1
+uniform int instanceFormat;
+
+layout(location = 5) in vec4 instance0;
+layout(location = 6) in vec4 instance1;
+layout(location = 7) in vec4 instance2;
+layout(location = 8) in vec4 instance3;
+
+// per-instance inverse transpose of the upper 3x3 of the transform, unless instanceUniformScale is set, in which case
+// the upper 3x3 itself transforms normals up to their length
+uniform int instanceUniformScale;
+
+layout(location = 10) in vec3 instanceNormal0;
+layout(location = 11) in vec3 instanceNormal1;
+layout(location = 12) in vec3 instanceNormal2;
+
+out vec3 worldPos;
+out vec3 worldNorm;
+out vec2 uvCoord;
+
+out vec3 worldTangent;
+out vec3 worldBiTangent;
+
+out mat3 TBN;
+
+// material constants are passed on per draw, so pbr.frag can be shared with pbr_indirect.vert
+flat out vec3 albedoValue;
+flat out float roughnessValue;
+flat out float metallicValue;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0) {
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(v);
+}
+
+// same as quaternionToRotation in instance_compression.cpp
+mat3 quaternionToRotation(vec4 q)
+{
+    vec3 q2 = q.xyz + q.xyz;
+    return mat3(
+        1.0 - q.y * q2.y - q.z * q2.z, q.x * q2.y + q.w * q2.z, q.x * q2.z - q.w * q2.y,
+        q.x * q2.y - q.w * q2.z, 1.0 - q.x * q2.x - q.z * q2.z, q.y * q2.z + q.w * q2.x,
+        q.x * q2.z + q.w * q2.y, q.y * q2.z - q.w * q2.x, 1.0 - q.x * q2.x - q.y * q2.y
+    );
+}
+
+mat4 instanceTransform()
+{
+    if (instanceFormat == 1) {
+        return transpose(mat4(instance0, instance1, instance2, vec4(0.0, 0.0, 0.0, 1.0)));
+    }
+    if (instanceFormat == 2) {
+        mat4 model = mat4(quaternionToRotation(normalize(instance1)) * instance0.w);
+        model[3] = vec4(instance0.xyz, 1.0);
+        return model;
+    }
+    return mat4(instance0, instance1, instance2, instance3);
+}
+
+void main()
+{
+    mat4 ModelM = instanceTransform();
+    mat3 NormalM = (instanceUniformScale != 0) ? mat3(ModelM) : mat3(instanceNormal0, instanceNormal1, instanceNormal2);
+
+    vec3 position = vPos.xyz;
+    vec3 normal = vNorm.xyz;
+    vec3 vertexTangent = tangent;
+    vec3 vertexBiTangent = biTangent;
+    if (compactVertices != 0) {
+        position = positionOffset + vPos.xyz * positionScale;
+        normal = octDecode(vNorm.xy);
+        vertexTangent = octDecode(vNorm.zw);
+        vertexBiTangent = cross(normal, vertexTangent) * (vPos.w * 2.0 - 1.0);
+    }
+
+    gl_Position = ProjectionM * ViewM * ModelM * vec4(position, 1.0);
+    uvCoord = vTex;
+
+    worldPos = (ModelM * vec4(position, 1.0)).xyz;
+    worldNorm = normalize(NormalM * normal);
+    worldTangent = normalize(NormalM * vertexTangent);
+    worldBiTangent = normalize(NormalM * vertexBiTangent);
+
+    TBN = mat3(
+        worldTangent,
+        worldBiTangent,
+        worldNorm
+    );
+
+    albedoValue = albedoConstant;
+    roughnessValue = roughnessConstant;
+    metallicValue = metallicConstant;
+}
\ No newline at end of file
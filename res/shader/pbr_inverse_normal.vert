@@ -0,0 +1,85 @@
+#version 420
+
+// pbr.vert as it was before normal matrices were computed on the CPU, with the inverse transpose of ModelM computed
+// for every vertex. Only drawn by --benchmark, to time the difference.
+
+uniform mat4 ModelM;
+uniform mat4 ViewM;
+uniform mat4 ProjectionM;
+
+uniform vec3 cameraPosition;
+
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+uniform vec3 albedoConstant;
+uniform float roughnessConstant;
+uniform float metallicConstant;
+
+// with compactVertices set, vPos holds the quantized position and the bitangent sign in w and vNorm holds the
+// octahedral normal and tangent, see CompactVertex
+uniform int compactVertices;
+
+layout(location = 0) in vec4 vPos;
+layout(location = 1) in vec4 vNorm;
+layout(location = 2) in vec2 vTex;
+
+layout(location = 3) in vec3 tangent;
+layout(location = 4) in vec3 biTangent;
+
+out vec3 worldPos;
+out vec3 worldNorm;
+out vec2 uvCoord;
+
+out vec3 worldTangent;
+out vec3 worldBiTangent;
+
+out mat3 TBN;
+
+// material constants are passed on per draw, so pbr.frag can be shared with pbr_indirect.vert
+flat out vec3 albedoValue;
+flat out float roughnessValue;
+flat out float metallicValue;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0) {
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(v);
+}
+
+void main()
+{
+    vec3 position = vPos.xyz;
+    vec3 normal = vNorm.xyz;
+    vec3 vertexTangent = tangent;
+    vec3 vertexBiTangent = biTangent;
+    if (compactVertices != 0) {
+        position = positionOffset + vPos.xyz * positionScale;
+        normal = octDecode(vNorm.xy);
+        vertexTangent = octDecode(vNorm.zw);
+        vertexBiTangent = cross(normal, vertexTangent) * (vPos.w * 2.0 - 1.0);
+    }
+
+    gl_Position = ProjectionM * ViewM * ModelM * vec4(position, 1.0);
+    uvCoord = vTex;
+
+    mat4 normalMatrix = transpose(inverse(ModelM));
+
+    worldPos = (ModelM * vec4(position, 1.0)).xyz;
+    worldNorm = normalize((normalMatrix * vec4(normal, 0.0)).xyz);
+    worldTangent = normalize((normalMatrix * vec4(vertexTangent, 0.0)).xyz);
+    worldBiTangent = normalize((normalMatrix * vec4(vertexBiTangent, 0.0)).xyz);
+
+    TBN = mat3(
+        worldTangent,
+        worldBiTangent,
+        worldNorm
+    );
+
+    albedoValue = albedoConstant;
+    roughnessValue = roughnessConstant;
+    metallicValue = metallicConstant;
+}
\ No newline at end of file
@@ -1,11 +1,14 @@
 #include <iostream>
+#include <chrono>
+#include <cstring>
+#include <cmath>
 
 #include <glm/mat4x4.hpp>
 
+// NB: hud.hpp holds the configuration of Nuklear and must be its first include
 #define NK_IMPLEMENTATION
-#define NK_INCLUDE_FIXED_TYPES // additionally required for mingw-w64 https://github.com/vurtun/nuklear/issues/770
 
-#include "nuklear.h"
+#include "system/hud.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 
@@ -19,54 +22,632 @@
 #include "util/ls_log.hpp"
 #include "system/camera.hpp"
 #include "system/window.hpp"
+#include "system/scene_graph.hpp"
+#include "system/occlusion_culler.hpp"
+#include "system/software_renderer.hpp"
+#include "system/gpu_profiler.hpp"
+#include "util/dynamic_bvh.hpp"
+#include "util/profiler.hpp"
 
-void update(Window *window, Camera *camera);
+/**
+ * A model placed at a node of the scene graph.
+ */
+struct SceneObject {
+    NodeID node;
+    AssetID model;
 
-void render(Window *window, Camera *camera, AssetID shader_id, AssetID model_id);
+    /**
+     * Object space bounds and triangles of the model and the proxy of the object in {Scene::bvh}, set once the model
+     * is loaded.
+     */
+    Bounds bounds;
+    const MeshBVH *triangles = nullptr;
+    uint32_t proxy = BVH_NULL;
 
-int main()
+    /**
+     * Levels of detail the model was last drawn with.
+     */
+    LodState lods;
+
+    /**
+     * Whether the model also hides the objects behind it, see {Scene::occlusion_culler}. It is added there as
+     * occluder {occluder_index} once loaded.
+     */
+    bool occluder = false;
+    uint32_t occluder_index = 0;
+
+    SceneObject(NodeID p_node, AssetID p_model) : node(p_node), model(p_model)
+    {}
+};
+
+/**
+ * Objects of the scene, with a bounding volume hierarchy over them for culling and picking. Objects are identified
+ * by their index in {objects}. Large opaque objects, such as walls and terrain, can be added to {occlusion_culler}
+ * to hide the objects behind them.
+ */
+struct Scene {
+    SceneGraph graph;
+    std::vector<SceneObject> objects;
+    DynamicBVH bvh;
+    std::vector<uint32_t> visible_objects;
+    OcclusionCuller occlusion_culler;
+};
+
+/**
+ * Command line options, see {parse_options}.
+ */
+struct Options {
+    bool headless = false;
+
+    /**
+     * Render with {SoftwareRenderer} instead of OpenGL, which implies headless.
+     */
+    bool software = false;
+
+    /**
+     * Number of frames to render once all assets are loaded before exiting, 0 to run until the window is closed.
+     */
+    uint32_t frame_count = 0;
+
+    /**
+     * Directory to write the counted frames to, not written if empty.
+     */
+    std::string output_dir;
+
+    /**
+     * File to write a Chrome trace of the CPU and GPU zones of the whole run to, not profiled if empty.
+     */
+    std::string profile_file;
+
+    /**
+     * Show the performance overlay from the start, it is toggled with F1.
+     */
+    bool show_hud = false;
+
+    /**
+     * Number of copies of the model to draw with every draw path before exiting, 0 to not benchmark, see
+     * {run_draw_benchmark}.
+     */
+    uint32_t benchmark_objects = 0;
+
+    /**
+     * Layout the models are uploaded with, set with --vertex-format float or compact, to compare both with
+     * --benchmark.
+     */
+    VertexFormat vertex_format = COMPACT_VERTEX_FORMAT;
+};
+
+const uint32_t WINDOW_WIDTH = 800;
+const uint32_t WINDOW_HEIGHT = 600;
+
+/**
+ * Maximum time a headless run waits for its assets, as it cannot be closed otherwise if loading fails.
+ */
+const double HEADLESS_LOAD_TIMEOUT_SECONDS = 300.0;
+
+/**
+ * Frames {run_draw_benchmark} draws with every draw path, after the warm-up frames which are not measured.
+ */
+const uint32_t BENCHMARK_WARMUP_FRAMES = 10;
+const uint32_t BENCHMARK_FRAMES = 100;
+
+/**
+ * Width of the square the copies of the model are spread over by --benchmark.
+ */
+const float BENCHMARK_GRID_SIZE = 2.f;
+
+/**
+ * Placement of the low-poly sphere in front of the model, which is drawn and hides the objects behind it.
+ */
+const glm::vec3 DEMO_OCCLUDER_POSITION(0.f, 0.f, 1.2f);
+const float DEMO_OCCLUDER_SCALE = .2f;
+
+bool parse_options(int argc, char **argv, Options *options);
+
+bool is_scene_loaded(GraphicsManager *graphics_manager, const Scene &scene, AssetID shader_id);
+
+void add_demo_occluder(Scene *scene, AssetID model_id);
+
+int render_software(const Options &options);
+
+int run_draw_benchmark(Window *window, Camera *camera, Scene *scene, GpuProfiler *gpu_profiler,
+                       AssetID per_draw_shader_id, AssetID inverse_normal_shader_id, AssetID multi_draw_shader_id);
+
+void start_profiling(const Options &options);
+
+bool finish_profiling(const Options &options);
+
+void update(Window *window, Camera *camera, const Scene &scene, Hud *hud);
+
+void update_scene(Scene *scene, AssetManager *asset_manager);
+
+void render(Window *window, Camera *camera, Scene *scene, AssetID shader_id);
+
+int main(int argc, char **argv)
 {
-    Window window(800, 600, "");
+    Options options;
+    if (!parse_options(argc, argv, &options)) {
+        ls_log::log(LOG_ERROR, "usage: %s [--headless | --software] [--frames count] [--output directory] "
+                               "[--profile file] [--hud] [--benchmark count] [--vertex-format float | compact]\n",
+                    argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    start_profiling(options);
+
+    if (options.software) {
+        return render_software(options);
+    }
+
+    Window window(WINDOW_WIDTH, WINDOW_HEIGHT, "", options.headless);
 
     GraphicsManager graphics_manager;
     window.getRenderer()->setGraphicsManager(&graphics_manager);
 
     AssetManager asset_manager;
+    asset_manager.setVertexFormat(options.vertex_format);
 
-    AssetID model_id = asset_manager.loadObj(
+    // assets are loaded in the background and uploaded a few at a time from the render loop, see below
+    AssetID model_id = asset_manager.loadObjAsync(
             std::string("../res/obj/Chandelier_03"),
             std::string("Chandelier_03.obj"));
-    Model *chandelier = asset_manager.getModel(model_id);
-    graphics_manager.loadModel(chandelier);
 
-    ls_log::log(LOG_INFO, "done loading model!\n");
+    AssetID shader_id = asset_manager.loadShaderAsync(
+            std::string("../res/shader/pbr_indirect.vert"),
+            std::string("../res/shader/pbr.frag"));
+
+    Scene scene;
+    window.getRenderer()->setOcclusionCuller(&scene.occlusion_culler);
 
-    AssetID shader_id = asset_manager.loadShader(
+    // the benchmark draws a grid of scaled down copies of the model, also with the per-draw shader, and with the
+    // per-draw shader that computed the normal matrix for every vertex
+    AssetID per_draw_shader_id = (options.benchmark_objects > 0) ? asset_manager.loadShaderAsync(
             std::string("../res/shader/pbr.vert"),
-            std::string("../res/shader/pbr.frag"));
-    Shader *shader = asset_manager.getShader(shader_id);
-    graphics_manager.loadShader(shader);
+            std::string("../res/shader/pbr.frag")) : AssetID(INVALID, 0);
+    AssetID inverse_normal_shader_id = (options.benchmark_objects > 0) ? asset_manager.loadShaderAsync(
+            std::string("../res/shader/pbr_inverse_normal.vert"),
+            std::string("../res/shader/pbr.frag")) : AssetID(INVALID, 0);
+    if (options.benchmark_objects > 0) {
+        auto side = (uint32_t) std::ceil(std::sqrt((float) options.benchmark_objects));
+        for (uint32_t i = 0; i < options.benchmark_objects; i++) {
+            glm::vec3 position(((float) (i % side) + .5f) / (float) side - .5f, 0.f,
+                               ((float) (i / side) + .5f) / (float) side - .5f);
+            NodeID node = scene.graph.createNode();
+            scene.graph.setLocalTransform(node, position * BENCHMARK_GRID_SIZE, glm::quat(1.f, 0.f, 0.f, 0.f),
+                                          glm::vec3(1.f / (float) side));
+            scene.objects.emplace_back(node, model_id);
+        }
+    } else {
+        scene.objects.emplace_back(scene.graph.createNode(), model_id);
+    }
+
+    add_demo_occluder(&scene, asset_manager.loadObjAsync(std::string("../res/obj/nol"), std::string("nol.obj")));
+
+    GpuProfiler gpu_profiler;
+    gpu_profiler.setEnabled(Profiler::get_instance()->is_enabled());
+    gpu_profiler.setDrawZones(Profiler::get_instance()->is_capturing());
+    window.getRenderer()->setGpuProfiler(&gpu_profiler);
+
+    Hud hud(&gpu_profiler);
+    hud.setVisible(options.show_hud);
 
     Camera camera(
             (float) window.get_input_handler()->get_size_x() / (float) window.get_input_handler()->get_size_y(),
             glm::radians(70.f), .1f, 100.f);
 
+    window.getRenderer()->setViewportHeight(window.get_input_handler()->get_size_y());
+
+    auto start_time = std::chrono::steady_clock::now();
+    auto first_frame_time = start_time;
+    uint32_t frame = 0;
+
     while (!window.shouldClose()) {
+        // collects the zones of the previous frame, which have all ended here
+        Profiler::get_instance()->end_frame();
+        gpu_profiler.beginFrame();
+        hud.beginFrame();
+        PROFILE_ZONE("frame");
+
         window.get_input_handler()->pull_input();
-        update(&window, &camera);
-        render(&window, &camera, shader_id, model_id);
+        update(&window, &camera, scene, &hud);
+        graphics_manager.uploadLoadedAssets(&asset_manager);
+        update_scene(&scene, &asset_manager);
+
+        if (options.benchmark_objects > 0 && is_scene_loaded(&graphics_manager, scene, shader_id) &&
+            graphics_manager.getShaderProgram(per_draw_shader_id) &&
+            graphics_manager.getShaderProgram(inverse_normal_shader_id)) {
+            int result = run_draw_benchmark(&window, &camera, &scene, &gpu_profiler, per_draw_shader_id,
+                                            inverse_normal_shader_id, shader_id);
+            return finish_profiling(options) ? result : EXIT_FAILURE;
+        }
+
+        render(&window, &camera, &scene, shader_id);
+        hud.render(window.getRenderer(), graphics_manager, window.get_input_handler()->get_size_x(),
+                   window.get_input_handler()->get_size_y());
+
+        // frames are only counted once everything is loaded, so every run renders the same frames
+        if (options.frame_count > 0 && is_scene_loaded(&graphics_manager, scene, shader_id)) {
+            if (frame == 0) {
+                first_frame_time = std::chrono::steady_clock::now();
+            }
+
+            if (!options.output_dir.empty()) {
+                char file_name[32];
+                snprintf(file_name, sizeof(file_name), "/frame_%04u.ppm", frame);
+                if (!window.saveFrame(options.output_dir + file_name)) {
+                    return EXIT_FAILURE;
+                }
+            }
+
+            if (++frame == options.frame_count) {
+                window.close();
+            }
+        } else if (window.isHeadless() && frame == 0 &&
+                   std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count() >
+                   HEADLESS_LOAD_TIMEOUT_SECONDS) {
+            ls_log::log(LOG_ERROR, "assets did not load within %.0f seconds\n", HEADLESS_LOAD_TIMEOUT_SECONDS);
+            return EXIT_FAILURE;
+        }
+
+        PROFILE_ZONE("swapBuffers");
+        window.swapBuffers();
+    }
+
+    if (frame > 0) {
+        glFinish();
+        double frames_ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - first_frame_time).count();
+        ls_log::log(LOG_INFO, "rendered %u frames in %.1f ms, %.2f ms per frame\n", frame, frames_ms,
+                    frames_ms / frame);
+    }
+
+    return finish_profiling(options) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Parses --headless, --software, --frames {count}, --output {directory}, --profile {file}, --hud, --benchmark
+ * {count} and --vertex-format {float | compact} into {options}. Returns false on unknown or incomplete arguments.
+ * A headless run without --frames renders a single frame.
+ */
+bool parse_options(int argc, char **argv, Options *options)
+{
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            options->headless = true;
+        } else if (strcmp(argv[i], "--software") == 0) {
+            options->headless = true;
+            options->software = true;
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            options->frame_count = (uint32_t) strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            options->output_dir = argv[++i];
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            options->profile_file = argv[++i];
+        } else if (strcmp(argv[i], "--hud") == 0) {
+            options->show_hud = true;
+        } else if (strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc) {
+            options->benchmark_objects = (uint32_t) strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--vertex-format") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "float") == 0) {
+                options->vertex_format = FLOAT_VERTEX_FORMAT;
+            } else if (strcmp(argv[i], "compact") == 0) {
+                options->vertex_format = COMPACT_VERTEX_FORMAT;
+            } else {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+
+    if (options->headless && options->frame_count == 0) {
+        options->frame_count = 1;
+    }
+
+    return true;
+}
+
+/**
+ * Whether the shader and the models of all objects are uploaded.
+ */
+bool is_scene_loaded(GraphicsManager *graphics_manager, const Scene &scene, AssetID shader_id)
+{
+    if (!graphics_manager->getShaderProgram(shader_id)) {
+        return false;
+    }
+
+    for (const auto &object : scene.objects) {
+        if (!graphics_manager->getVAO(object.model)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Adds {model_id} as an occluder at {DEMO_OCCLUDER_POSITION}, to show occlusion culling. Both renderers draw it, so
+ * their frames stay comparable.
+ */
+void add_demo_occluder(Scene *scene, AssetID model_id)
+{
+    NodeID node = scene->graph.createNode();
+    scene->graph.setLocalTransform(node, DEMO_OCCLUDER_POSITION, glm::quat(1.f, 0.f, 0.f, 0.f),
+                                   glm::vec3(DEMO_OCCLUDER_SCALE));
+    scene->objects.emplace_back(node, model_id);
+    scene->objects.back().occluder = true;
+}
+
+/**
+ * Renders the scene with {SoftwareRenderer}, without a window or a GL context, for machines without a GPU. The
+ * frames are rendered like those of a headless run and can be compared with them.
+ */
+int render_software(const Options &options)
+{
+    AssetManager asset_manager;
+    AssetID model_id = asset_manager.loadObj(
+            std::string("../res/obj/Chandelier_03"),
+            std::string("Chandelier_03.obj"));
+
+    Scene scene;
+    scene.objects.emplace_back(scene.graph.createNode(), model_id);
+    add_demo_occluder(&scene, asset_manager.loadObj(std::string("../res/obj/nol"), std::string("nol.obj")));
+    update_scene(&scene, &asset_manager);
+
+    SoftwareRenderer renderer(WINDOW_WIDTH, WINDOW_HEIGHT);
+    renderer.setAssetManager(&asset_manager);
+
+    Camera camera((float) WINDOW_WIDTH / (float) WINDOW_HEIGHT, glm::radians(70.f), .1f, 100.f);
+
+    auto start_time = std::chrono::steady_clock::now();
+    SoftwareRenderStats stats = {};
+    for (uint32_t frame = 0; frame < options.frame_count; frame++) {
+        Profiler::get_instance()->end_frame();
+        PROFILE_ZONE("frame");
+
+        renderer.clearScreen();
+
+        renderer.setCameraPosition(camera.get_camera_position());
+        renderer.setView(camera.get_view_matrix());
+        renderer.setPerspective(camera.get_proj_matrix());
+
+        renderer.cullScene(scene.bvh, &scene.visible_objects);
+        for (uint32_t object : scene.visible_objects) {
+            const SceneObject &visible = scene.objects[object];
+            renderer.renderModel(visible.model, scene.graph.getWorldMatrix(visible.node));
+        }
+        stats = renderer.getStats();
+
+        if (!options.output_dir.empty()) {
+            char file_name[32];
+            snprintf(file_name, sizeof(file_name), "/frame_%04u.ppm", frame);
+            if (!renderer.saveFrame(options.output_dir + file_name)) {
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    double frames_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+    ls_log::log(LOG_INFO, "rendered %u frames in software in %.1f ms, %.2f ms per frame (%u triangles, %llu pixels "
+                          "shaded per frame)\n", options.frame_count, frames_ms, frames_ms / options.frame_count,
+                stats.triangles, (unsigned long long) stats.pixelsShaded);
+
+    return finish_profiling(options) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Draws {scene} with every draw path of the renderer, and logs per frame the CPU time of culling, submitting and
+ * drawing, the GPU time of the frame measured by {gpu_profiler}, and the time until the GPU finished. The frames are
+ * not swapped, so vsync does not limit them. The per-draw paths draw with {per_draw_shader_id}, the multi-draw path
+ * with {multi_draw_shader_id}, see {Renderer::flush}. {renderModel} is measured three more times: specifying the
+ * vertex layout for every draw, as it did before the layouts were baked into vertex arrays (see
+ * {Renderer::setRespecifyVertexLayout}), and with {inverse_normal_shader_id}, which computes the normal matrix for
+ * every vertex rather than reading the one computed on the CPU.
+ */
+int run_draw_benchmark(Window *window, Camera *camera, Scene *scene, GpuProfiler *gpu_profiler,
+                       AssetID per_draw_shader_id, AssetID inverse_normal_shader_id, AssetID multi_draw_shader_id)
+{
+    enum DrawPath {
+        RESPECIFIED_LAYOUT_DRAWS, INVERSE_NORMAL_DRAWS, IMMEDIATE_DRAWS, QUEUED_DRAWS, QUEUED_MULTI_DRAWS,
+        DRAW_PATH_COUNT
+    };
+    const char *const draw_path_names[DRAW_PATH_COUNT] = {"renderModel, layout per draw",
+                                                          "renderModel, inverse per vertex", "renderModel",
+                                                          "queued per-draw", "queued multi-draw"};
+    const char *const frame_zone = "benchmark frame";
+
+    bool gpu_profiler_enabled = gpu_profiler->isEnabled();
+    gpu_profiler->setEnabled(true);
+
+    Renderer *renderer = window->getRenderer();
+    for (uint32_t path = 0; path < DRAW_PATH_COUNT; path++) {
+        AssetID shader_id = (path == QUEUED_MULTI_DRAWS) ? multi_draw_shader_id :
+                            (path == INVERSE_NORMAL_DRAWS) ? inverse_normal_shader_id : per_draw_shader_id;
+        bool immediate = path == RESPECIFIED_LAYOUT_DRAWS || path == INVERSE_NORMAL_DRAWS || path == IMMEDIATE_DRAWS;
+        renderer->setRespecifyVertexLayout(path == RESPECIFIED_LAYOUT_DRAWS);
+        double cpu_ms = 0;
+        double gpu_ms = 0;
+        double frame_ms = 0;
+        uint32_t gpu_frames = 0;
+
+        for (uint32_t frame = 0; frame < BENCHMARK_WARMUP_FRAMES + BENCHMARK_FRAMES; frame++) {
+            glFinish();
+
+            // NB: this reads the zones of the frame drawn GpuProfiler::FRAME_COUNT frames ago, which used the same
+            //     draw path once past the warm-up. They are always available, as the GPU finished it.
+            uint32_t dropped_frames = gpu_profiler->getDroppedFrames();
+            gpu_profiler->beginFrame();
+            if (frame >= BENCHMARK_WARMUP_FRAMES && gpu_profiler->getDroppedFrames() == dropped_frames) {
+                for (const GpuZoneResult &zone : gpu_profiler->getFrameZones()) {
+                    if (strcmp(zone.name, frame_zone) == 0) {
+                        gpu_ms += zone.milliseconds;
+                        gpu_frames++;
+                    }
+                }
+            }
+
+            auto start_time = std::chrono::steady_clock::now();
+            gpu_profiler->beginZone(frame_zone);
+
+            renderer->clearScreen();
+            renderer->setCameraPosition(camera->get_camera_position());
+            renderer->setView(camera->get_view_matrix());
+            renderer->setPerspective(camera->get_proj_matrix());
+            scene->occlusion_culler.rasterize(camera->get_proj_matrix() * camera->get_view_matrix());
+            renderer->cullScene(scene->bvh, &scene->visible_objects);
+
+            if (immediate) {
+                renderer->useShader(shader_id);
+            }
+            for (uint32_t object : scene->visible_objects) {
+                SceneObject &visible = scene->objects[object];
+                if (immediate) {
+                    renderer->renderModel(visible.model, scene->graph.getWorldMatrix(visible.node), &visible.lods);
+                } else {
+                    renderer->submit(shader_id, visible.model, scene->graph.getWorldMatrix(visible.node),
+                                     &visible.lods);
+                }
+            }
+            renderer->flush();
+
+            gpu_profiler->endZone();
+            auto cpu_end_time = std::chrono::steady_clock::now();
+            glFinish();
+            auto end_time = std::chrono::steady_clock::now();
+
+            if (frame >= BENCHMARK_WARMUP_FRAMES) {
+                cpu_ms += std::chrono::duration<double, std::milli>(cpu_end_time - start_time).count();
+                frame_ms += std::chrono::duration<double, std::milli>(end_time - start_time).count();
+            }
+        }
+
+        RenderQueueStats stats = renderer->getQueueStats();
+        ls_log::log(LOG_INFO, "%-31s %u objects: %.3f ms CPU, %.3f ms GPU (%u frames timed), %.3f ms until the GPU "
+                              "finished, per frame (queued: %u draws in %u multi-draws)\n", draw_path_names[path],
+                    (uint32_t) scene->visible_objects.size(), cpu_ms / BENCHMARK_FRAMES,
+                    gpu_ms / std::max(gpu_frames, 1u), gpu_frames, frame_ms / BENCHMARK_FRAMES, stats.draws,
+                    stats.multiDraws);
     }
+    renderer->setRespecifyVertexLayout(false);
+    gpu_profiler->setEnabled(gpu_profiler_enabled);
 
     return EXIT_SUCCESS;
 }
 
-void update(Window *window, Camera *camera)
+/**
+ * Enables the profiler and captures the whole run if a profile file is set. GPU zones are captured down to single
+ * draw calls.
+ */
+void start_profiling(const Options &options)
 {
+    if (options.profile_file.empty()) {
+        return;
+    }
+
+    Profiler *profiler = Profiler::get_instance();
+    profiler->set_enabled(true);
+    profiler->set_thread_name("main");
+    profiler->start_capture();
+}
+
+/**
+ * Writes the capture of {start_profiling}, if any. Returns false on failure.
+ */
+bool finish_profiling(const Options &options)
+{
+    if (options.profile_file.empty()) {
+        return true;
+    }
+
+    Profiler *profiler = Profiler::get_instance();
+    profiler->end_frame();
+    profiler->stop_capture();
+    return profiler->write_chrome_trace(options.profile_file.c_str());
+}
+
+/**
+ * Distance along the ray to the nearest triangle of {object} within {max_distance}, which is written to {hit}.
+ * INFINITY if the ray misses it.
+ */
+float intersect_object(const Scene &scene, const SceneObject &object, glm::vec3 origin, glm::vec3 direction,
+                       float max_distance, MeshHit *hit)
+{
+    const glm::mat4 &transform = scene.graph.getWorldMatrix(object.node);
+    glm::vec3 center = glm::vec3(transform * glm::vec4(object.bounds.center, 1.f));
+    float scale = std::max(glm::length(glm::vec3(transform[0])),
+                           std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+    float radius = object.bounds.radius * scale;
+
+    // solve |origin + t * direction - center| = radius for the nearest t >= 0, {direction} is normalized
+    glm::vec3 offset = origin - center;
+    float b = glm::dot(offset, direction);
+    float c = glm::dot(offset, offset) - radius * radius;
+    float discriminant = b * b - c;
+    if (discriminant < 0.f) {
+        return INFINITY;
+    }
+
+    float t = -b - std::sqrt(discriminant);
+    if (t < 0.f && c > 0.f) {
+        return INFINITY;
+    }
+
+    // the bounding sphere is hit, test the triangles in object space, where the distances stay the same
+    glm::mat4 inverse_transform = glm::inverse(transform);
+    glm::vec3 object_origin = glm::vec3(inverse_transform * glm::vec4(origin, 1.f));
+    glm::vec3 object_direction = glm::vec3(inverse_transform * glm::vec4(direction, 0.f));
+    if (!object.triangles->intersect(object_origin, object_direction, max_distance, hit)) {
+        return INFINITY;
+    }
+
+    return hit->distance;
+}
+
+/**
+ * Logs the object and triangle under the cursor.
+ */
+void pick(Window *window, Camera *camera, const Scene &scene)
+{
+    glm::vec3 origin;
+    glm::vec3 direction;
+    camera->get_ray(window->get_input_handler()->get_mouse_xpos(), window->get_input_handler()->get_mouse_ypos(),
+                    window->get_input_handler()->get_size_x(), window->get_input_handler()->get_size_y(),
+                    &origin, &direction);
+
+    BVHRayHit hit = {};
+    MeshHit triangle_hit = {};
+    bool found = scene.bvh.ray_cast(origin, direction, INFINITY, [&](uint32_t object, float distance) {
+        MeshHit object_hit;
+        float object_distance = intersect_object(scene, scene.objects[object], origin, direction, distance,
+                                                 &object_hit);
+        if (object_distance < distance) {
+            triangle_hit = object_hit;
+        }
+        return object_distance;
+    }, &hit);
+
+    if (found) {
+        ls_log::log(LOG_INFO, "picked object %u, submesh %u, triangle %u (%.2f, %.2f) at distance %.2f\n",
+                    hit.user_data, triangle_hit.subMesh, triangle_hit.triangle, triangle_hit.u, triangle_hit.v,
+                    hit.distance);
+    }
+}
+
+void update(Window *window, Camera *camera, const Scene &scene, Hud *hud)
+{
+    PROFILE_ZONE("update");
+
     // if ESC is pressed, close the window
     if (window->get_input_handler()->get_key_state(InputHandler::ESCAPE, InputHandler::PRESSED)) {
         window->close();
     }
 
+    // toggle the performance overlay
+    if (window->get_input_handler()->get_key_state(InputHandler::F1, InputHandler::PRESSED)) {
+        hud->setVisible(!hud->isVisible());
+    }
+
     // update camera zoom
     camera->add_zoom((float) window->get_input_handler()->get_yoffset());
 
@@ -77,6 +658,11 @@ void update(Window *window, Camera *camera)
                 window->get_input_handler()->get_mouse_yoffset());
     }
 
+    // pick the object under the cursor
+    if (window->get_input_handler()->get_mouse_button_state(InputHandler::LMB, InputHandler::PRESSED)) {
+        pick(window, camera, scene);
+    }
+
     // update camera rotation
     if (window->get_input_handler()->get_mouse_button_state(InputHandler::MMB, InputHandler::DOWN)) {
         camera->rotate(
@@ -94,19 +680,62 @@ void update(Window *window, Camera *camera)
 
         // update gl viewport
         glViewport(0, 0, size_x, size_y);
+        window->getRenderer()->setViewportHeight(size_y);
     }
 }
 
-void render(Window *window, Camera *camera, AssetID shader_id, AssetID model_id)
+void update_scene(Scene *scene, AssetManager *asset_manager)
 {
+    PROFILE_ZONE("update_scene");
+
+    scene->graph.update();
+
+    for (uint32_t i = 0; i < scene->objects.size(); i++) {
+        SceneObject &object = scene->objects[i];
+        if (object.proxy == BVH_NULL) {
+            Model *model = asset_manager->getModel(object.model);
+            if (model == nullptr) {
+                continue;
+            }
+            object.bounds = model->bounds;
+            object.triangles = &model->bvh;
+        } else if (!scene->graph.hasChanged(object.node)) {
+            continue;
+        }
+
+        const glm::mat4 &transform = scene->graph.getWorldMatrix(object.node);
+        AABB box = AABB::transformed(AABB(object.bounds.min, object.bounds.max), transform);
+        if (object.proxy == BVH_NULL) {
+            object.proxy = scene->bvh.insert(box, i);
+            if (object.occluder) {
+                object.occluder_index = scene->occlusion_culler.addOccluder(*asset_manager->getModel(object.model),
+                                                                           transform);
+            }
+        } else {
+            scene->bvh.move(object.proxy, box);
+            if (object.occluder) {
+                scene->occlusion_culler.setOccluderTransform(object.occluder_index, transform);
+            }
+        }
+    }
+}
+
+void render(Window *window, Camera *camera, Scene *scene, AssetID shader_id)
+{
+    PROFILE_ZONE("render");
+
     window->getRenderer()->clearScreen();
 
     window->getRenderer()->setCameraPosition(camera->get_camera_position());
     window->getRenderer()->setView(camera->get_view_matrix());
     window->getRenderer()->setPerspective(camera->get_proj_matrix());
+    scene->occlusion_culler.rasterize(camera->get_proj_matrix() * camera->get_view_matrix());
 
-    window->getRenderer()->useShader(shader_id);
-    window->getRenderer()->renderModel(model_id, glm::identity<glm::mat4>());
-
-    window->swapBuffers();
+    window->getRenderer()->cullScene(scene->bvh, &scene->visible_objects);
+    for (uint32_t object : scene->visible_objects) {
+        SceneObject &visible = scene->objects[object];
+        window->getRenderer()->submit(shader_id, visible.model, scene->graph.getWorldMatrix(visible.node),
+                                      &visible.lods);
+    }
+    window->getRenderer()->flush();
 }
\ No newline at end of file
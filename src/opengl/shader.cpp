@@ -70,6 +70,8 @@ int32_t ShaderProgram::create_shader_program(
         return EXIT_FAILURE;
     }
 
+    shader_program->reflection = ShaderReflection::reflect(shader_program->shader_program);
+
     // detach shaders and delete shaders
     glDetachShader(shader_program->shader_program, frag_shader.shader);
     glDetachShader(shader_program->shader_program, vert_shader.shader);
@@ -96,34 +98,59 @@ void ShaderProgram::unuse_shader_program()
     glUseProgram(0);
 }
 
+GLint ShaderProgram::get_uniform_location(ShaderProgram *p_shader_program, const char *name)
+{
+    return p_shader_program->reflection.get_uniform_location(name);
+}
+
 void ShaderProgram::set_vec3(ShaderProgram *p_shader_program, const char *name, glm::vec3 val)
 {
-    GLint location = glGetUniformLocation(p_shader_program->shader_program, name);
-    glUniform3fv(location, 1, glm::value_ptr(val));
+    set_vec3(get_uniform_location(p_shader_program, name), val);
 }
 
 void ShaderProgram::set_mat4(ShaderProgram *p_shader_program, const char *name, glm::mat4 val)
 {
-    GLint location = glGetUniformLocation(p_shader_program->shader_program, name);
+    set_mat4(get_uniform_location(p_shader_program, name), val);
+}
+
+void ShaderProgram::set_float(ShaderProgram *p_shader_program, const char *name, float val)
+{
+    set_float(get_uniform_location(p_shader_program, name), val);
+}
+
+void ShaderProgram::set_int(ShaderProgram *p_shader_program, const char *name, int val)
+{
+    set_int(get_uniform_location(p_shader_program, name), val);
+}
+
+void ShaderProgram::set_vec3_array(ShaderProgram *p_shader_program, const char *name, std::vector<glm::vec3> vals)
+{
+    set_vec3_array(get_uniform_location(p_shader_program, name), vals);
+}
+
+void ShaderProgram::set_vec3(GLint location, glm::vec3 val)
+{
+    glUniform3fv(location, 1, glm::value_ptr(val));
+}
+
+void ShaderProgram::set_mat4(GLint location, glm::mat4 val)
+{
     // GL_FALSE is passed since glm matrices are column major
     glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(val));
 }
 
-void ShaderProgram::set_float(ShaderProgram *p_shader_program, const char *name, float val)
+void ShaderProgram::set_float(GLint location, float val)
 {
-    GLint location = glGetUniformLocation(p_shader_program->shader_program, name);
     glUniform1f(location, val);
 }
 
-void ShaderProgram::set_int(ShaderProgram *p_shader_program, const char *name, int val)
+void ShaderProgram::set_int(GLint location, int val)
 {
-    GLint location = glGetUniformLocation(p_shader_program->shader_program, name);
     glUniform1i(location, val);
 }
 
-void ShaderProgram::set_vec3_array(ShaderProgram *p_shader_program, const char *name, std::vector<glm::vec3> vals)
+void ShaderProgram::set_vec3_array(GLint location, const std::vector<glm::vec3> &vals)
 {
-    GLint location = glGetUniformLocation(p_shader_program->shader_program, name);
     glUniform3fv(location, vals.size(), glm::value_ptr(vals.front()));
 }
 
@@ -7,9 +7,16 @@
 #include <glm/vec3.hpp>
 #include <glm/glm.hpp>
 
+#include "shader_reflection.hpp"
+
 class ShaderProgram {
 private:
     GLuint shader_program;
+
+    /**
+     * Uniform and attribute locations, reflected when the program is linked.
+     */
+    ShaderReflection reflection;
 public:
     /**
      * Returns {EXIT_SUCCESS} on success, {EXIT_FAILURE} otherwise.
@@ -26,6 +33,12 @@ public:
 
     static void unuse_shader_program();
 
+    /**
+     * Returns -1 if the program has no active uniform called {name}. The returned location can be passed to the
+     * setters below, which avoids looking up the name on every call.
+     */
+    static GLint get_uniform_location(ShaderProgram *p_shader_program, const char *name);
+
     static void set_vec3(ShaderProgram *p_shader_program, const char *name, glm::vec3 val);
 
     static void set_mat4(ShaderProgram *p_shader_program, const char *name, glm::mat4 val);
@@ -35,6 +48,17 @@ public:
     static void set_int(ShaderProgram *p_shader_program, const char *name, int val);
 
     static void set_vec3_array(ShaderProgram *p_shader_program, const char *name, std::vector<glm::vec3> vals);
+
+    /** The program to set the uniform of must be in use. */
+    static void set_vec3(GLint location, glm::vec3 val);
+
+    static void set_mat4(GLint location, glm::mat4 val);
+
+    static void set_float(GLint location, float val);
+
+    static void set_int(GLint location, int val);
+
+    static void set_vec3_array(GLint location, const std::vector<glm::vec3> &vals);
 };
 
 struct Shader {
@@ -0,0 +1,74 @@
+#include "shader_reflection.hpp"
+
+#include <vector>
+
+/**
+ * Adds {name}, and for arrays also the name without the "[0]" suffix reported by the driver, to {locations}.
+ */
+static void add_location(std::unordered_map<std::string, GLint> *locations, std::string name, GLint location)
+{
+    locations->emplace(name, location);
+
+    const std::string array_suffix = "[0]";
+    if (name.size() > array_suffix.size() &&
+        name.compare(name.size() - array_suffix.size(), array_suffix.size(), array_suffix) == 0) {
+        locations->emplace(name.substr(0, name.size() - array_suffix.size()), location);
+    } else {
+        locations->emplace(name + array_suffix, location);
+    }
+}
+
+ShaderReflection ShaderReflection::reflect(GLuint program)
+{
+    ShaderReflection result;
+
+    GLint uniform_count = 0, uniform_name_length = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniform_count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &uniform_name_length);
+
+    std::vector<GLchar> name(uniform_name_length + 1);
+    for (GLint i = 0; i < uniform_count; i++) {
+        GLint size;
+        GLenum type;
+        GLsizei length = 0;
+        glGetActiveUniform(program, i, (GLsizei) name.size(), &length, &size, &type, name.data());
+
+        // uniforms inside uniform blocks have no location
+        GLint location = glGetUniformLocation(program, name.data());
+        if (location != -1) {
+            add_location(&result.uniform_locations, std::string(name.data(), length), location);
+        }
+    }
+
+    GLint attribute_count = 0, attribute_name_length = 0;
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &attribute_count);
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &attribute_name_length);
+
+    name.resize(attribute_name_length + 1);
+    for (GLint i = 0; i < attribute_count; i++) {
+        GLint size;
+        GLenum type;
+        GLsizei length = 0;
+        glGetActiveAttrib(program, i, (GLsizei) name.size(), &length, &size, &type, name.data());
+
+        // built-in attributes (gl_VertexID, ...) have no location
+        GLint location = glGetAttribLocation(program, name.data());
+        if (location != -1) {
+            add_location(&result.attribute_locations, std::string(name.data(), length), location);
+        }
+    }
+
+    return result;
+}
+
+GLint ShaderReflection::get_uniform_location(const char *name) const
+{
+    auto found = uniform_locations.find(name);
+    return (found == uniform_locations.end()) ? -1 : found->second;
+}
+
+GLint ShaderReflection::get_attribute_location(const char *name) const
+{
+    auto found = attribute_locations.find(name);
+    return (found == attribute_locations.end()) ? -1 : found->second;
+}
@@ -0,0 +1,34 @@
+#ifndef OPENGL_SHADER_REFLECTION_HPP
+#define OPENGL_SHADER_REFLECTION_HPP
+
+#include <string>
+#include <unordered_map>
+
+#include <glad/glad.h>
+
+/**
+ * Locations of all active uniforms and attributes of a linked shader program, queried once after linking so that
+ * setting uniforms does not require a string-based lookup in the driver.
+ */
+struct ShaderReflection {
+    std::unordered_map<std::string, GLint> uniform_locations;
+    std::unordered_map<std::string, GLint> attribute_locations;
+
+    /**
+     * Reflects the active uniforms and attributes of {program}, which must be linked successfully.
+     * Uniform arrays are listed both as "name" and as "name[0]", like {glGetUniformLocation} accepts them.
+     */
+    static ShaderReflection reflect(GLuint program);
+
+    /**
+     * Returns -1 if the program has no active uniform called {name}, like {glGetUniformLocation}.
+     */
+    GLint get_uniform_location(const char *name) const;
+
+    /**
+     * Returns -1 if the program has no active attribute called {name}, like {glGetAttribLocation}.
+     */
+    GLint get_attribute_location(const char *name) const;
+};
+
+#endif //OPENGL_SHADER_REFLECTION_HPP
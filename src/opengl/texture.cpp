@@ -47,23 +47,25 @@ int Texture::create_tex_from_mem(
 
     // load and generate the texture
     int found_width, found_height, found_channel_count;
-    // NB: first pixel is top-left corner, flip it with this call
-    stbi_set_flip_vertically_on_load(1);
     void *data;
+    uint32_t bytes_per_channel;
     // todo could combine channel type and bit depth into a single enum variable
     if (bit_depth == 8 && channel_type == INTEGER) {
         // unsigned char *
         default_depth:
+        bytes_per_channel = 1;
         data = stbi_load_from_memory(
                 (const unsigned char *) tex_data, tex_len, &found_width, &found_height, &found_channel_count,
                 channel_count);
     } else if (bit_depth == 16 && channel_type == INTEGER) {
         // unsigned short *
+        bytes_per_channel = 2;
         data = stbi_load_16_from_memory(
                 (const unsigned char *) tex_data, tex_len, &found_width, &found_height, &found_channel_count,
                 channel_count);
     } else if (bit_depth == 32 && channel_type == FLOATING_POINT) {
         // float *
+        bytes_per_channel = 4;
         data = stbi_loadf_from_memory(
                 (const unsigned char *) tex_data, tex_len, &found_width, &found_height, &found_channel_count,
                 channel_count);
@@ -82,6 +84,9 @@ int Texture::create_tex_from_mem(
     // keep on moving forward with assumed channel count since this is the size of the buffer
     // since stbi may complain but will always allocate the number of channels the user specifies
     if (data) {
+        // NB: first pixel is top-left corner, flip it (not through stbi, whose flip setting is global state)
+        Util::flip_image_vertically(data, found_width, found_height, channel_count * bytes_per_channel);
+
         GLenum format;
         GLenum internal_format;
         if (channel_count == 2) {
@@ -3,13 +3,54 @@
 //
 
 #include "asset_manager.hpp"
+#include "obj_parser.hpp"
+#include "mesh_cache.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_simplifier.hpp"
+#include "vertex_compression.hpp"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 
 #include "tiny_obj_loader.h"
 #include "../util/ls_log.hpp"
+#include "../util/util.hpp"
+#include "../util/profiler.hpp"
+#include "../util/thread_pool.hpp"
 
 #include <stb_image.h> // NB: required define is in main.cpp
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+/**
+ * Key of the vertex welding table: the (position, normal, texcoord) index tuple of a face corner.
+ */
+struct VertexIndexKey {
+    int32_t vertexIndex;
+    int32_t normalIndex;
+    int32_t texcoordIndex;
+
+    bool operator==(const VertexIndexKey &other) const
+    {
+        return vertexIndex == other.vertexIndex &&
+               normalIndex == other.normalIndex &&
+               texcoordIndex == other.texcoordIndex;
+    }
+};
+
+struct VertexIndexKeyHash {
+    size_t operator()(const VertexIndexKey &key) const
+    {
+        // pack the three indices and scramble them with the splitmix64 finalizer
+        uint64_t h = ((uint64_t) (uint32_t) key.vertexIndex << 32u) ^ (uint32_t) key.normalIndex;
+        h ^= (uint64_t) (uint32_t) key.texcoordIndex * 0x9E3779B97F4A7C15ull;
+        h = (h ^ (h >> 30u)) * 0xBF58476D1CE4E5B9ull;
+        h = (h ^ (h >> 27u)) * 0x94D049BB133111EBull;
+        return (size_t) (h ^ (h >> 31u));
+    }
+};
 
 AssetID::AssetID(AssetType type, uint64_t id) : type(type), ID(id)
 {}
@@ -17,12 +58,44 @@ AssetID::AssetID(AssetType type, uint64_t id) : type(type), ID(id)
 Model::Model(uint64_t ID) : assetID(MODEL, ID)
 {}
 
+const Vertex *Model::getVertexData() const
+{
+    return mappedVertices ? mappedVertices : vertices.data();
+}
+
+uint32_t Model::getVertexCount() const
+{
+    return mappedVertices ? mappedVertexCount : (uint32_t) vertices.size();
+}
+
+const uint32_t *MaterialSubMesh::getIndexData() const
+{
+    return mappedIndices ? mappedIndices : indices.data();
+}
+
+uint32_t MaterialSubMesh::getIndexCount() const
+{
+    return mappedIndices ? mappedIndexCount : (uint32_t) indices.size();
+}
+
+const uint32_t *MeshLod::getIndexData() const
+{
+    return mappedIndices ? mappedIndices : indices.data();
+}
+
+uint32_t MeshLod::getIndexCount() const
+{
+    return mappedIndices ? mappedIndexCount : (uint32_t) indices.size();
+}
+
 Shader::Shader(uint64_t ID) : assetID(SHADER, ID)
 {}
 
 Texture AssetManager::loadTexture(const std::string &file)
 {
+    PROFILE_ZONE("AssetManager::loadTexture");
     Texture tex = {};
+    tex.file = file;
 
     bool is16bit = stbi_is_16_bit(file.c_str());
 
@@ -31,7 +104,6 @@ Texture AssetManager::loadTexture(const std::string &file)
 
         int width, height, numChannels;
 
-        stbi_set_flip_vertically_on_load(true);
         uint8_t *data = (uint8_t *) stbi_load_16(file.c_str(), &width, &height, &numChannels, 0);
 
         // check if the texture could be loaded
@@ -43,6 +115,7 @@ Texture AssetManager::loadTexture(const std::string &file)
         //TODO: handle all formats
         assert(numChannels == 1 || numChannels == 2 || numChannels == 4);
         tex.format = (numChannels == 1) ? GRAYSCALE_16 : (numChannels == 3) ? RGB_16 : RGBA_16;
+        Util::flip_image_vertically(data, width, height, numChannels * 2);
         tex.width = width;
         tex.height = height;
         tex.data = (char *) data;
@@ -51,7 +124,6 @@ Texture AssetManager::loadTexture(const std::string &file)
 
         int width, height, numChannels;
 
-        stbi_set_flip_vertically_on_load(true);
         uint8_t *data = stbi_load(file.c_str(), &width, &height, &numChannels, 0);
 
         // check if the texture could be loaded
@@ -65,6 +137,7 @@ Texture AssetManager::loadTexture(const std::string &file)
         //TODO: handle all formats
         assert(numChannels == 1 || numChannels == 3 || numChannels == 4);
         tex.format = (numChannels == 1) ? GRAYSCALE_8 : (numChannels == 3) ? RGB_8 : RGBA_8;
+        Util::flip_image_vertically(data, width, height, numChannels);
         tex.width = width;
         tex.height = height;
         tex.data = (char *) data;
@@ -73,8 +146,59 @@ Texture AssetManager::loadTexture(const std::string &file)
     return tex;
 }
 
-AssetID AssetManager::loadObj(const std::string &dir, const std::string &file)
+void AssetManager::loadModelTextures(Model *model)
+{
+    // all texture slots that reference an image, and the canonical path of that image
+    std::vector<Texture *> slots;
+    for (auto &material : model->materials) {
+        for (Texture *texture : {&material.albedoTexture, &material.roughnessTexture,
+                                 &material.metallicTexture, &material.normalMap}) {
+            if (!texture->file.empty()) {
+                slots.emplace_back(texture);
+            }
+        }
+    }
+
+    std::vector<std::string> paths;
+    for (Texture *slot : slots) {
+        paths.emplace_back(Util::canonical_path(slot->file));
+    }
+
+    // images that have not been decoded before, each listed once
+    std::vector<std::string> pending;
+    {
+        std::lock_guard<std::mutex> lock(textureCacheMutex);
+        for (const auto &path : paths) {
+            if (textureCache.find(path) == textureCache.end() &&
+                std::find(pending.begin(), pending.end(), path) == pending.end()) {
+                pending.emplace_back(path);
+            }
+        }
+    }
+
+    std::vector<Texture> decoded(pending.size());
+    ThreadPool::get_instance()->parallel_for(pending.size(), [&pending, &decoded](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            decoded[i] = loadTexture(pending[i]);
+        }
+    });
+
+    std::lock_guard<std::mutex> lock(textureCacheMutex);
+    for (size_t i = 0; i < pending.size(); i++) {
+        // another model may have decoded the same image concurrently, in which case that copy is kept
+        if (!textureCache.emplace(pending[i], decoded[i]).second) {
+            stbi_image_free(decoded[i].data);
+        }
+    }
+
+    for (size_t i = 0; i < slots.size(); i++) {
+        *slots[i] = textureCache.at(paths[i]);
+    }
+}
+
+bool AssetManager::importObj(const std::string &dir, const std::string &file, Model *result)
 {
+    PROFILE_ZONE("AssetManager::importObj");
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
@@ -83,32 +207,49 @@ AssetID AssetManager::loadObj(const std::string &dir, const std::string &file)
 
     // todo: nol: removed warn due to deprecation of parameter
     // todo: nol: moved {mtl_basedir} to parameters
-    std::string new_dir = dir + "\\"; // dir requires a concatenated /
-    std::string file_name = dir + "\\" + file;
-    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, file_name.c_str(), new_dir.c_str());
+    std::string new_dir = dir + "/"; // dir requires a concatenated /
+    std::string file_name = dir + "/" + file;
+    bool ret;
+    if (objParserType == PARALLEL_PARSER) {
+        ret = ObjParser::loadObj(&attrib, &shapes, &materials, &err, file_name, new_dir);
+    } else {
+        ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, file_name.c_str(), new_dir.c_str());
+    }
 
     if (!ret) {
         ls_log::log(LOG_ERROR, err.c_str());
-        return {INVALID, 0};
+        return false;
     }
 
-    Model result(generateNewID());
-
     //NOTE: the structure of the OBJ file has to altered in order to fit the desired indexing format. Instead
     //      of indexing position/normal/uv individually, we need a single index to a vertex. To this end, all
     //      unique combinations of pos/norm/uv are condensed into individual vertices, and indices are saved as
-    //      indices into this set of unique vertices.
+    //      indices into this set of unique vertices. The set is a hash table from index tuple to vertex index,
+    //      so every face corner is welded in constant time.
+
+    uint32_t totalIndexCount = 0;
+    for (const auto &shape: shapes) {
+        totalIndexCount += shape.mesh.indices.size();
+    }
 
-    std::vector<std::tuple<int32_t, int32_t, int32_t>> uniqueVertices;
+    // NB: every attribute is normally referenced by some vertex, so there are at least as many unique vertices as
+    //     the most numerous attribute, and usually not many more. Face corners overestimate it several times.
+    size_t vertexEstimate = std::max(attrib.vertices.size() / 3,
+                                     std::max(attrib.normals.size() / 3, attrib.texcoords.size() / 2));
+    vertexEstimate = std::min(vertexEstimate, (size_t) totalIndexCount);
+
+    std::unordered_map<VertexIndexKey, uint32_t, VertexIndexKeyHash> uniqueVertices;
+    uniqueVertices.reserve(totalIndexCount);
+    result->vertices.reserve(vertexEstimate);
 
     //TODO: what about the names of the individual submeshes as described by the obj file?
-    result.mesh.name = file;
+    result->mesh.name = file;
 
     //TODO: probably need an extra mesh for material index -1
     for (int i = 0; i < materials.size(); i++) {
         MaterialSubMesh subMesh = {};
         subMesh.materialIndex = i;
-        result.mesh.materialSubMeshes.emplace_back(subMesh);
+        result->mesh.materialSubMeshes.emplace_back(subMesh);
     }
 
     for (auto &shape: shapes) {
@@ -119,17 +260,12 @@ AssetID AssetManager::loadObj(const std::string &dir, const std::string &file)
         for (uint32_t i = 0; i < shape.mesh.indices.size(); i++) {
             auto &index = shape.mesh.indices[i];
 
-            std::tuple<int32_t, int32_t, int32_t> vertexIndices = std::make_tuple(index.vertex_index,
-                                                                                  index.normal_index,
-                                                                                  index.texcoord_index);
+            VertexIndexKey vertexIndices = {index.vertex_index, index.normal_index, index.texcoord_index};
 
-            // NOTE: this could be optimized quite easily, by using a better data structure
             int32_t vertexIndex = -1;
-            for (uint32_t j = 0; j < uniqueVertices.size(); j++) {
-                if (uniqueVertices[j] == vertexIndices) {
-                    vertexIndex = j;
-                    break;
-                }
+            auto found = uniqueVertices.find(vertexIndices);
+            if (found != uniqueVertices.end()) {
+                vertexIndex = (int32_t) found->second;
             }
 
             // compute the tangent and bi-tangent for every triangle
@@ -156,8 +292,7 @@ AssetID AssetManager::loadObj(const std::string &dir, const std::string &file)
 
             int32_t faceMaterialIndex = shape.mesh.material_ids[i / 3];
             if (vertexIndex == -1) {
-                uniqueVertices.emplace_back(
-                        std::make_tuple(index.vertex_index, index.normal_index, index.texcoord_index));
+                uniqueVertices.emplace(vertexIndices, (uint32_t) result->vertices.size());
 
                 Vertex v = {};
                 v.position = {attrib.vertices[index.vertex_index * 3],
@@ -171,15 +306,15 @@ AssetID AssetManager::loadObj(const std::string &dir, const std::string &file)
                 v.tangent = tangent;
                 v.biTangent = biTangent;
 
-                result.vertices.emplace_back(v);
+                result->vertices.emplace_back(v);
 
                 //TODO: robustness when materialIndex = -1
-                result.mesh.materialSubMeshes[faceMaterialIndex].indices.emplace_back(uniqueVertices.size() - 1);
+                result->mesh.materialSubMeshes[faceMaterialIndex].indices.emplace_back(result->vertices.size() - 1);
             } else {
-                result.vertices[vertexIndex].tangent = result.vertices[vertexIndex].tangent + tangent;
-                result.vertices[vertexIndex].biTangent = result.vertices[vertexIndex].tangent + biTangent;
+                result->vertices[vertexIndex].tangent = result->vertices[vertexIndex].tangent + tangent;
+                result->vertices[vertexIndex].biTangent = result->vertices[vertexIndex].tangent + biTangent;
 
-                result.mesh.materialSubMeshes[faceMaterialIndex].indices.emplace_back(vertexIndex);
+                result->mesh.materialSubMeshes[faceMaterialIndex].indices.emplace_back(vertexIndex);
             }
         }
     }
@@ -195,7 +330,7 @@ AssetID AssetManager::loadObj(const std::string &dir, const std::string &file)
         bool usesNormalTexture = mat.bump_texname != "";
 
         if (usesAlbedoTexture) {
-            newMaterial.albedoTexture = loadTexture(new_dir + mat.diffuse_texname);
+            newMaterial.albedoTexture.file = new_dir + mat.diffuse_texname;
         } else {
             newMaterial.albedo.x = mat.diffuse[0];
             newMaterial.albedo.y = mat.diffuse[1];
@@ -203,7 +338,7 @@ AssetID AssetManager::loadObj(const std::string &dir, const std::string &file)
         }
 
         if (usesRoughnessTexture) {
-            newMaterial.roughnessTexture = loadTexture(new_dir + mat.specular_highlight_texname);
+            newMaterial.roughnessTexture.file = new_dir + mat.specular_highlight_texname;
         } else {
             //TODO: gruesome hack for blender, instead should use PBR extension but blender doesn't support that
             //https://developer.blender.org/diffusion/BA/browse/master/io_scene_obj/export_obj.py
@@ -212,7 +347,7 @@ AssetID AssetManager::loadObj(const std::string &dir, const std::string &file)
 
         if (usesMetallicTexture) {
             // todo: nol: {reflection_texname} is deprecated see above, this branch is never taken
-//            newMaterial.metallicTexture = loadTexture(new_dir + mat.reflection_texname);
+//            newMaterial.metallicTexture.file = new_dir + mat.reflection_texname;
         } else {
             //TODO: gruesome hack for blender, instead should use PBR extension but blender doesn't support that
             if (mat.ambient[0] == 1.0 && mat.ambient[1] == 1.0 && mat.ambient[2] == 1.0) {
@@ -223,14 +358,192 @@ AssetID AssetManager::loadObj(const std::string &dir, const std::string &file)
         }
 
         if (usesNormalTexture) {
-            newMaterial.normalMap = loadTexture(new_dir + mat.bump_texname);
+            newMaterial.normalMap.file = new_dir + mat.bump_texname;
         }
 
-        result.materials.emplace_back(newMaterial);
+        result->materials.emplace_back(newMaterial);
     }
 
-    this->models.emplace(result.assetID.ID, result);
-    return result.assetID;
+    return true;
+}
+
+/**
+ * Fills the bounds of {model} and of its submeshes.
+ */
+static void computeBounds(Model *model)
+{
+    const Vertex *vertices = model->getVertexData();
+    std::vector<glm::vec3> points;
+
+    auto fitBounds = [&points](Bounds *bounds) {
+        if (points.empty()) {
+            *bounds = Bounds();
+            return;
+        }
+
+        bounds->min = points[0];
+        bounds->max = points[0];
+        for (const auto &point : points) {
+            bounds->min = glm::min(bounds->min, point);
+            bounds->max = glm::max(bounds->max, point);
+        }
+
+        bounds->center = (bounds->min + bounds->max) * 0.5f;
+        float radiusSquared = 0;
+        for (const auto &point : points) {
+            glm::vec3 offset = point - bounds->center;
+            radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+        }
+        bounds->radius = std::sqrt(radiusSquared);
+    };
+
+    for (auto &subMesh : model->mesh.materialSubMeshes) {
+        points.clear();
+        const uint32_t *indices = subMesh.getIndexData();
+        for (uint32_t i = 0; i < subMesh.getIndexCount(); i++) {
+            points.emplace_back(vertices[indices[i]].position);
+        }
+        fitBounds(&subMesh.bounds);
+    }
+
+    points.clear();
+    for (uint32_t i = 0; i < model->getVertexCount(); i++) {
+        points.emplace_back(vertices[i].position);
+    }
+    fitBounds(&model->bounds);
+}
+
+bool AssetManager::readObj(const std::string &dir, const std::string &file, Model *result)
+{
+    PROFILE_ZONE("AssetManager::readObj");
+    auto startTime = std::chrono::steady_clock::now();
+
+    std::string file_name = dir + "/" + file;
+    std::string cache_name = dir + "/" + file.substr(0, file.find_last_of('.')) + ".lsmesh";
+
+    bool cached = MeshCache::load(cache_name, result);
+    if (!cached) {
+        if (!importObj(dir, file, result)) {
+            return false;
+        }
+
+        MeshSimplifier::generateLods(result);
+        MeshOptimizer::optimize(result);
+        result->bvh.build(*result);
+
+        // the cooked mesh depends on the OBJ file and the material libraries it references
+        std::vector<std::string> sourceFiles = {file_name};
+        for (const auto &library : ObjParser::findMaterialLibraries(file_name)) {
+            int64_t mtime;
+            uint64_t size;
+            std::string library_name = dir + "/" + library;
+            if (Util::get_file_info(library_name.c_str(), &mtime, &size) == EXIT_SUCCESS) {
+                sourceFiles.emplace_back(library_name);
+            }
+        }
+
+        MeshCache::write(cache_name, sourceFiles, *result);
+    }
+
+    computeBounds(result);
+    loadModelTextures(result);
+
+    if (vertexFormat == COMPACT_VERTEX_FORMAT) {
+        VertexCompression::compress(result);
+    }
+
+    uint32_t indexCount = 0;
+    for (const auto &subMesh : result->mesh.materialSubMeshes) {
+        indexCount += subMesh.getIndexCount();
+    }
+
+    // load timing, allows checking that import time scales linearly with the face count
+    double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    ls_log::log(LOG_INFO, "%s %s: %u faces, %u unique vertices in %.1f ms\n",
+                cached ? "loaded cooked" : "imported", file.c_str(), indexCount / 3, result->getVertexCount(), loadMs);
+
+    return true;
+}
+
+AssetID AssetManager::loadObj(const std::string &dir, const std::string &file)
+{
+    Model result(generateNewID());
+    if (!readObj(dir, file, &result)) {
+        return {INVALID, 0};
+    }
+
+    AssetID id = result.assetID;
+    std::lock_guard<std::mutex> lock(assetsMutex);
+    this->models.emplace(id.ID, std::move(result));
+    return id;
+}
+
+/**
+ * Number of bytes {GraphicsManager::loadModel} uploads for {model}.
+ */
+static uint64_t modelUploadSize(const Model &model)
+{
+    size_t vertexSize = (model.vertexFormat == COMPACT_VERTEX_FORMAT) ? sizeof(CompactVertex) : sizeof(Vertex);
+    uint64_t size = (uint64_t) model.getVertexCount() * vertexSize;
+    for (const auto &subMesh : model.mesh.materialSubMeshes) {
+        size += (uint64_t) subMesh.getIndexCount() * sizeof(uint32_t);
+        for (const auto &lod : subMesh.lods) {
+            size += (uint64_t) lod.getIndexCount() * sizeof(uint32_t);
+        }
+    }
+
+    for (const auto &material : model.materials) {
+        for (const Texture *texture : {&material.albedoTexture, &material.roughnessTexture,
+                                       &material.metallicTexture, &material.normalMap}) {
+            if (texture->data) {
+                uint32_t bytesPerPixel;
+                switch (texture->format) {
+                    case GRAYSCALE_8: bytesPerPixel = 1; break;
+                    case GRAYSCALE_16: bytesPerPixel = 2; break;
+                    case RGB_8: bytesPerPixel = 3; break;
+                    case RGBA_8: bytesPerPixel = 4; break;
+                    case RGB_16: bytesPerPixel = 6; break;
+                    default: bytesPerPixel = 8; break;
+                }
+                size += (uint64_t) texture->width * texture->height * bytesPerPixel;
+            }
+        }
+    }
+
+    return size;
+}
+
+AssetID AssetManager::loadObjAsync(const std::string &dir, const std::string &file)
+{
+    AssetID id(MODEL, generateNewID());
+
+    submitLoad([this, id, dir, file]() {
+        Model result(id.ID);
+        if (!readObj(dir, file, &result)) {
+            return;
+        }
+
+        LoadedAsset asset = {id, modelUploadSize(result)};
+        {
+            std::lock_guard<std::mutex> lock(assetsMutex);
+            this->models.emplace(id.ID, std::move(result));
+        }
+
+        std::lock_guard<std::mutex> lock(loadedAssetsMutex);
+        loadedAssets.emplace_back(asset);
+    });
+
+    return id;
+}
+
+void AssetManager::setObjParserType(ObjParserType type)
+{
+    this->objParserType = type;
+}
+
+void AssetManager::setVertexFormat(VertexFormat format)
+{
+    this->vertexFormat = format;
 }
 
 uint64_t AssetManager::generateNewID()
@@ -238,7 +551,7 @@ uint64_t AssetManager::generateNewID()
     return indexGeneratorCounter++;
 }
 
-AssetID AssetManager::loadShader(const std::string &vertexShader, const std::string &fragmentShader)
+void AssetManager::readShader(const std::string &vertexShader, const std::string &fragmentShader, Shader *result)
 {
     std::ifstream vertexFileStream(vertexShader);
     std::string vertexFileContent((std::istreambuf_iterator<char>(vertexFileStream)),
@@ -248,24 +561,98 @@ AssetID AssetManager::loadShader(const std::string &vertexShader, const std::str
     std::string fragmentFileContent((std::istreambuf_iterator<char>(fragmentFileStream)),
                                     (std::istreambuf_iterator<char>()));
 
+    result->vertexShaderText = vertexFileContent;
+    result->fragmentShaderText = fragmentFileContent;
+}
+
+AssetID AssetManager::loadShader(const std::string &vertexShader, const std::string &fragmentShader)
+{
     Shader result(generateNewID());
-    result.vertexShaderText = vertexFileContent;
-    result.fragmentShaderText = fragmentFileContent;
+    readShader(vertexShader, fragmentShader, &result);
 
+    std::lock_guard<std::mutex> lock(assetsMutex);
     shaders.emplace(result.assetID.ID, result);
     return result.assetID;
 }
 
+AssetID AssetManager::loadShaderAsync(const std::string &vertexShader, const std::string &fragmentShader)
+{
+    AssetID id(SHADER, generateNewID());
+
+    submitLoad([this, id, vertexShader, fragmentShader]() {
+        Shader result(id.ID);
+        readShader(vertexShader, fragmentShader, &result);
+
+        LoadedAsset asset = {id, result.vertexShaderText.size() + result.fragmentShaderText.size()};
+        {
+            std::lock_guard<std::mutex> lock(assetsMutex);
+            shaders.emplace(id.ID, std::move(result));
+        }
+
+        std::lock_guard<std::mutex> lock(loadedAssetsMutex);
+        loadedAssets.emplace_back(asset);
+    });
+
+    return id;
+}
+
+void AssetManager::submitLoad(std::function<void()> load)
+{
+    {
+        std::lock_guard<std::mutex> lock(pendingLoadMutex);
+        pendingLoadCount++;
+    }
+
+    ThreadPool::get_instance()->submit([this, load]() {
+        load();
+
+        std::lock_guard<std::mutex> lock(pendingLoadMutex);
+        pendingLoadCount--;
+        pendingLoadFinished.notify_all();
+    });
+}
+
+void AssetManager::drainLoadedAssets(const std::function<bool(const LoadedAsset &asset)> &upload)
+{
+    while (true) {
+        std::unique_lock<std::mutex> lock(loadedAssetsMutex);
+        if (loadedAssets.empty()) {
+            return;
+        }
+
+        LoadedAsset asset = loadedAssets.front();
+        loadedAssets.pop_front();
+
+        // NB: the lock is not held while uploading, so background loads can keep queueing assets
+        lock.unlock();
+        if (!upload(asset)) {
+            lock.lock();
+            loadedAssets.push_front(asset);
+            return;
+        }
+    }
+}
+
+AssetManager::~AssetManager()
+{
+    std::unique_lock<std::mutex> lock(pendingLoadMutex);
+    pendingLoadFinished.wait(lock, [this]() { return pendingLoadCount == 0; });
+}
+
 Model *AssetManager::getModel(AssetID id)
 {
     assert(id.type == MODEL);
-    //TODO: containment check
-    return &models.at(id.ID);
+
+    std::lock_guard<std::mutex> lock(assetsMutex);
+    auto found = models.find(id.ID);
+    return (found == models.end()) ? nullptr : &found->second;
 }
 
 Shader *AssetManager::getShader(AssetID id)
 {
     assert(id.type == SHADER);
-    //TODO: containment check
-    return &shaders.at(id.ID);
+
+    std::lock_guard<std::mutex> lock(assetsMutex);
+    auto found = shaders.find(id.ID);
+    return (found == shaders.end()) ? nullptr : &found->second;
 }
@@ -5,14 +5,23 @@
 #ifndef GAME_ASSET_MANAGER_HPP
 #define GAME_ASSET_MANAGER_HPP
 
+#include <deque>
 #include <vector>
 #include <tuple>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <condition_variable>
 #include <string>
 #include <unordered_map>
 
 #include <glm/vec3.hpp>
 #include <glm/vec2.hpp>
 #include "tiny_obj_loader.h"
+#include "mesh_bvh.hpp"
+
+class MappedFile;
 
 enum AssetType {
     INVALID, MODEL, SHADER
@@ -32,6 +41,16 @@ struct AssetID {
     AssetID(AssetType type, uint64_t id);
 };
 
+/**
+ * Which front-end {AssetManager::loadObj} uses to parse OBJ files.
+ */
+enum ObjParserType {
+    /** Single-threaded {tinyobj::LoadObj}. */
+    TINYOBJ_PARSER,
+    /** Chunked, multithreaded {ObjParser::loadObj}. */
+    PARALLEL_PARSER
+};
+
 enum TextureFormat {
     GRAYSCALE_8, GRAYSCALE_16, RGB_8, RGBA_8, RGB_16, RGBA_16
 };
@@ -46,6 +65,11 @@ struct Texture {
      * A texture is 'invalid' if the data pointer is 0.
      */
     char *data = nullptr;
+
+    /**
+     * Path of the image file the texture is decoded from, empty if the texture is not used.
+     */
+    std::string file;
 };
 
 struct Material {
@@ -61,6 +85,42 @@ struct Material {
     Texture normalMap;
 };
 
+/**
+ * Object space bounding volumes of a mesh, computed at load.
+ */
+struct Bounds {
+    glm::vec3 min = {0, 0, 0};
+    glm::vec3 max = {0, 0, 0};
+
+    /**
+     * Bounding sphere around the center of the box, with the radius fitted to the vertices.
+     */
+    glm::vec3 center = {0, 0, 0};
+    float radius = 0;
+};
+
+/**
+ * A simplified version of a {MaterialSubMesh}, indexing the same vertices.
+ */
+struct MeshLod {
+    std::vector<uint32_t> indices;
+
+    /**
+     * Estimated largest distance between this level and the full detail mesh, in object space units.
+     */
+    float error = 0;
+
+    /**
+     * Indices inside the memory-mapped cooked mesh of the parent Model, used instead of {indices} if set.
+     */
+    const uint32_t *mappedIndices = nullptr;
+    uint32_t mappedIndexCount = 0;
+
+    const uint32_t *getIndexData() const;
+
+    uint32_t getIndexCount() const;
+};
+
 /**
  * An index buffer that is to be rendered with a specific material
  */
@@ -70,6 +130,27 @@ struct MaterialSubMesh {
      */
     int32_t materialIndex = -1;
     std::vector<uint32_t> indices;
+
+    /**
+     * Indices inside the memory-mapped cooked mesh of the parent Model, used instead of {indices} if set.
+     */
+    const uint32_t *mappedIndices = nullptr;
+    uint32_t mappedIndexCount = 0;
+
+    /**
+     * Levels of detail of increasing coarseness, {lods[0]} being the first level below full detail. Generated at
+     * import, see {MeshSimplifier::generateLods}.
+     */
+    std::vector<MeshLod> lods;
+
+    /**
+     * Bounds of the vertices referenced by the submesh.
+     */
+    Bounds bounds;
+
+    const uint32_t *getIndexData() const;
+
+    uint32_t getIndexCount() const;
 };
 
 struct Mesh {
@@ -90,6 +171,38 @@ struct Vertex {
     glm::vec3 biTangent;
 };
 
+/**
+ * Layout of the vertices a model is uploaded to the GPU with, chosen at import with {AssetManager::setVertexFormat}.
+ */
+enum VertexFormat {
+    /** {Vertex}, full precision. */
+    FLOAT_VERTEX_FORMAT,
+    /** {CompactVertex}, quantized. */
+    COMPACT_VERTEX_FORMAT,
+    VERTEX_FORMAT_COUNT
+};
+
+/**
+ * Compressed {Vertex} of 20 instead of 56 bytes, decoded by the vertex shaders.
+ */
+struct CompactVertex {
+    /**
+     * Position quantized to 16 bits per axis within the bounding box of the model, see {Model::positionOffset}.
+     * The fourth component is the sign of the bitangent relative to cross(normal, tangent), 0 for -1 and 65535 for 1.
+     */
+    uint16_t position[4];
+
+    /**
+     * Octahedral encoded unit normal (first two) and tangent (last two), as signed normalized 16 bit integers.
+     */
+    int16_t normalTangent[4];
+
+    /**
+     * Texture coordinates as half precision floats.
+     */
+    uint16_t uv[2];
+};
+
 struct Model {
     const AssetID assetID;
 
@@ -98,7 +211,42 @@ struct Model {
 
     Mesh mesh;
 
+    /**
+     * Bounds of all submeshes.
+     */
+    Bounds bounds;
+
+    /**
+     * Hierarchy over the triangles of all submeshes, for ray picking.
+     */
+    MeshBVH bvh;
+
+    /**
+     * Memory-mapped cooked mesh (see mesh_cache.hpp) the model was loaded from, if any. In that case {vertices} and
+     * the submesh {indices} are empty, and the data is read directly from the mapping instead.
+     */
+    std::shared_ptr<MappedFile> cookedData;
+    const Vertex *mappedVertices = nullptr;
+    uint32_t mappedVertexCount = 0;
+
+    /**
+     * If {COMPACT_VERTEX_FORMAT}, {compactVertices} holds the same vertices as {vertices}, and is uploaded instead.
+     * The full precision vertices are kept for processing on the CPU.
+     */
+    VertexFormat vertexFormat = FLOAT_VERTEX_FORMAT;
+    std::vector<CompactVertex> compactVertices;
+
+    /**
+     * Decoding of {CompactVertex::position}: positionOffset + position / 65535 * positionScale.
+     */
+    glm::vec3 positionOffset = {0, 0, 0};
+    glm::vec3 positionScale = {1, 1, 1};
+
     explicit Model(uint64_t ID);
+
+    const Vertex *getVertexData() const;
+
+    uint32_t getVertexCount() const;
 };
 
 struct Shader {
@@ -110,22 +258,111 @@ struct Shader {
     explicit Shader(uint64_t ID);
 };
 
+/**
+ * An asset of which the CPU-side data has been loaded in the background, and that still has to be uploaded to the GPU.
+ */
+struct LoadedAsset {
+    AssetID id;
+
+    /**
+     * Approximate number of bytes uploading the asset to the GPU takes.
+     */
+    uint64_t uploadSize;
+};
+
 class AssetManager {
 private:
     /**
      * Used to generate unique IDs for assets.
      */
-    uint64_t indexGeneratorCounter = 0;
+    std::atomic<uint64_t> indexGeneratorCounter{0};
 
+    ObjParserType objParserType = PARALLEL_PARSER;
+
+    std::atomic<VertexFormat> vertexFormat{FLOAT_VERTEX_FORMAT};
+
+    /**
+     * Guards {models} and {shaders}, which background loads insert into. Elements are never moved once inserted,
+     * so pointers returned by {getModel} and {getShader} stay valid without holding the lock.
+     */
+    std::mutex assetsMutex;
     std::unordered_map<uint64_t, Model> models;
     std::unordered_map<uint64_t, Shader> shaders;
 
+    /**
+     * Assets loaded by {loadObjAsync} and {loadShaderAsync} that are ready to be uploaded, in order of completion.
+     */
+    std::deque<LoadedAsset> loadedAssets;
+    std::mutex loadedAssetsMutex;
+
+    /**
+     * Number of background loads that have not finished yet, waited for on destruction.
+     */
+    uint32_t pendingLoadCount = 0;
+    std::mutex pendingLoadMutex;
+    std::condition_variable pendingLoadFinished;
+
+    /**
+     * Decoded images by canonical path. Every image is decoded once and shared by all materials referencing it.
+     */
+    std::unordered_map<std::string, Texture> textureCache;
+    std::mutex textureCacheMutex;
+
     uint64_t generateNewID();
 
-    Texture loadTexture(const std::string &file);
+    /**
+     * Decodes an image file. Safe to call from multiple threads at once.
+     */
+    static Texture loadTexture(const std::string &file);
+
+    /**
+     * Resolves the textures of all materials of {model} through the texture cache. Images that are not in the
+     * cache yet are decoded in parallel on the thread pool.
+     */
+    void loadModelTextures(Model *model);
+
+    /**
+     * Loads the model {loadObj} describes into {result}, without registering it.
+     */
+    bool readObj(const std::string &dir, const std::string &file, Model *result);
+
+    /**
+     * Reads the sources of a shader into {result}, without registering it.
+     */
+    static void readShader(const std::string &vertexShader, const std::string &fragmentShader, Shader *result);
+
+    /**
+     * Runs {load} on the thread pool, tracking it in {pendingLoadCount}.
+     */
+    void submitLoad(std::function<void()> load);
 
 public:
+    AssetManager() = default;
+
+    /**
+     * Waits for all background loads to finish.
+     */
+    virtual ~AssetManager();
+
+    /**
+     * Select the OBJ front-end used by subsequent {loadObj} calls. Both produce identical models.
+     */
+    void setObjParserType(ObjParserType type);
+
+    /**
+     * Parses an OBJ file into {result} with the selected front-end, bypassing the mesh cache. Material textures are
+     * only resolved to file names, not loaded, and no LODs or BVH are built.
+     */
+    bool importObj(const std::string &dir, const std::string &file, Model *result);
+
     /**
+     * Select the vertex format models loaded after this call are uploaded with.
+     */
+    void setVertexFormat(VertexFormat format);
+
+    /**
+     * Loads a model from its cooked mesh cache ({file} with extension .lsmesh) if that is up-to-date, and otherwise
+     * imports the OBJ file and writes the cache.
      * @param dir: name of the directory containing .obj and .mtl files.
      * @param file: name of the .obj file within {dir}.
      */
@@ -133,8 +370,31 @@ public:
 
     AssetID loadShader(const std::string &vertexShader, const std::string &fragmentShader);
 
+    /**
+     * Same as {loadObj}, but returns immediately and loads the model on the thread pool. The model becomes
+     * available through {getModel} once it is loaded, and is then queued for {drainLoadedAssets}.
+     */
+    AssetID loadObjAsync(const std::string &dir, const std::string &file);
+
+    /**
+     * Same as {loadShader}, but returns immediately and reads the files on the thread pool. See {loadObjAsync}.
+     */
+    AssetID loadShaderAsync(const std::string &vertexShader, const std::string &fragmentShader);
+
+    /**
+     * Hands the assets that finished loading in the background to {upload}, oldest first, until {upload} returns
+     * false or none are left. An asset for which {upload} returns false stays queued for the next call.
+     */
+    void drainLoadedAssets(const std::function<bool(const LoadedAsset &asset)> &upload);
+
+    /**
+     * Returns nullptr if the model is still being loaded or failed to load.
+     */
     Model *getModel(AssetID id);
 
+    /**
+     * Returns nullptr if the shader is still being loaded.
+     */
     Shader *getShader(AssetID id);
 };
 
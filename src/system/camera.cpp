@@ -26,6 +26,26 @@ glm::mat4 Camera::get_proj_matrix() const
     return glm::perspective(fov, aspect_ratio, near_clipping_dist, far_clipping_dist);
 }
 
+Frustum Camera::get_frustum()
+{
+    return Frustum::from_matrix(get_proj_matrix() * get_view_matrix());
+}
+
+void Camera::get_ray(double xpos, double ypos, uint32_t size_x, uint32_t size_y, glm::vec3 *origin,
+                     glm::vec3 *direction)
+{
+    // cursor position in normalized device coordinates, with y pointing up
+    float x = 2.f * (float) xpos / (float) size_x - 1.f;
+    float y = 1.f - 2.f * (float) ypos / (float) size_y;
+
+    glm::mat4 inverse_view_projection = glm::inverse(get_proj_matrix() * get_view_matrix());
+    glm::vec4 near_point = inverse_view_projection * glm::vec4(x, y, -1.f, 1.f);
+    glm::vec4 far_point = inverse_view_projection * glm::vec4(x, y, 1.f, 1.f);
+
+    *origin = glm::vec3(near_point) / near_point.w;
+    *direction = glm::normalize(glm::vec3(far_point) / far_point.w - *origin);
+}
+
 glm::vec3 Camera::get_camera_position()
 {
     // distance to focus point is computed as (1.2^zoomConstant)
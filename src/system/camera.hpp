@@ -6,6 +6,8 @@
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
 
+#include "../util/frustum.hpp"
+
 class Camera {
 private:
     constexpr static const float MIN_PITCH = -.49f * M_PI;
@@ -42,6 +44,16 @@ public:
     /** Constructs and returns the projection matrix for this camera. */
     glm::mat4 get_proj_matrix() const;
 
+    /** Extracts the six planes of the view frustum, in world space. */
+    Frustum get_frustum();
+
+    /**
+     * Ray through the cursor position ({xpos}, {ypos}) in a window of {size_x} by {size_y} pixels, in world space.
+     * The ray starts at the near plane, {direction} is normalized.
+     */
+    void get_ray(double xpos, double ypos, uint32_t size_x, uint32_t size_y, glm::vec3 *origin,
+                 glm::vec3 *direction);
+
     /** Reverse-engineers the camera position from the target, angles and zoom level. */
     glm::vec3 get_camera_position();
 
@@ -0,0 +1,164 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#include "gpu_profiler.hpp"
+
+#include <algorithm>
+
+GpuProfiler::GpuProfiler()
+{
+    track = Profiler::get_instance()->create_track("GPU");
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    for (auto &frame : frames) {
+        if (!frame.queries.empty()) {
+            glDeleteQueries((GLsizei) frame.queries.size(), frame.queries.data());
+        }
+    }
+}
+
+uint32_t GpuProfiler::issueQuery(FrameQueries *frame)
+{
+    if (frame->usedQueries == frame->queries.size()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        frame->queries.emplace_back(query);
+    }
+
+    glQueryCounter(frame->queries[frame->usedQueries], GL_TIMESTAMP);
+    return frame->usedQueries++;
+}
+
+void GpuProfiler::resolve(FrameQueries *frame)
+{
+    if (frame->zones.empty()) {
+        return;
+    }
+
+    // NB: timestamps complete in order, so the other results are available if the last one is
+    GLint available = 0;
+    glGetQueryObjectiv(frame->queries[frame->usedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        droppedFrames++;
+        return;
+    }
+
+    Profiler *profiler = Profiler::get_instance();
+    bool recording = profiler->is_enabled();
+    frameZones.clear();
+    for (const auto &zone : frame->zones) {
+        if (zone.endQuery == UINT32_MAX) {
+            continue;
+        }
+
+        GLuint64 start;
+        GLuint64 end;
+        glGetQueryObjectui64v(frame->queries[zone.startQuery], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(frame->queries[zone.endQuery], GL_QUERY_RESULT, &end);
+        frameZones.push_back({zone.name, zone.depth, (double) (end - start) / 1e6});
+
+        if (recording) {
+            // the GPU runs behind the CPU, so a zone cannot start before its frame began on the CPU
+            uint64_t cpuStart = frame->cpuStart + (uint64_t) std::max((GLint64) start - frame->gpuStart, (GLint64) 0);
+            profiler->record(track, zone.name, cpuStart, cpuStart + (end - start), zone.depth);
+        }
+    }
+}
+
+void GpuProfiler::beginFrame()
+{
+    if (!enabled) {
+        return;
+    }
+
+    openZones.clear();
+    frameIndex = (frameIndex + 1) % FRAME_COUNT;
+
+    FrameQueries *frame = &frames[frameIndex];
+    if (frame->started) {
+        resolve(frame);
+    }
+
+    frame->usedQueries = 0;
+    frame->zones.clear();
+    frame->started = true;
+
+    glGetInteger64v(GL_TIMESTAMP, &frame->gpuStart);
+    frame->cpuStart = Profiler::get_instance()->now();
+}
+
+void GpuProfiler::beginZone(const char *name)
+{
+    FrameQueries *frame = &frames[frameIndex];
+    if (!enabled || !frame->started) {
+        return;
+    }
+
+    openZones.emplace_back((uint32_t) frame->zones.size());
+    frame->zones.push_back({name, (uint32_t) openZones.size() - 1, issueQuery(frame), UINT32_MAX});
+}
+
+void GpuProfiler::endZone()
+{
+    if (!enabled || openZones.empty()) {
+        return;
+    }
+
+    FrameQueries *frame = &frames[frameIndex];
+    frame->zones[openZones.back()].endQuery = issueQuery(frame);
+    openZones.pop_back();
+}
+
+void GpuProfiler::setEnabled(bool enabled)
+{
+    if (!enabled) {
+        for (auto &frame : frames) {
+            frame.started = false;
+        }
+        openZones.clear();
+    }
+
+    this->enabled = enabled;
+}
+
+bool GpuProfiler::isEnabled() const
+{
+    return enabled;
+}
+
+void GpuProfiler::setDrawZones(bool drawZones)
+{
+    this->drawZones = drawZones;
+}
+
+bool GpuProfiler::getDrawZones() const
+{
+    return drawZones;
+}
+
+const std::vector<GpuZoneResult> &GpuProfiler::getFrameZones() const
+{
+    return frameZones;
+}
+
+uint32_t GpuProfiler::getDroppedFrames() const
+{
+    return droppedFrames;
+}
+
+GpuZone::GpuZone(GpuProfiler *profiler, const char *name) : profiler(profiler)
+{
+    if (profiler) {
+        profiler->beginZone(name);
+    }
+}
+
+GpuZone::~GpuZone()
+{
+    if (profiler) {
+        profiler->endZone();
+    }
+}
@@ -0,0 +1,147 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#ifndef GAME_GPU_PROFILER_HPP
+#define GAME_GPU_PROFILER_HPP
+
+#include <vector>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include "../util/profiler.hpp"
+
+/**
+ * A GPU zone of a completed frame, see {GpuProfiler::getFrameZones}.
+ */
+struct GpuZoneResult {
+    const char *name;
+    uint32_t depth;
+    double milliseconds;
+};
+
+/**
+ * Times zones of GL commands with timestamp queries, and adds them to the "GPU" track of {Profiler}, mapped to the
+ * CPU timeline. Queries are read {FRAME_COUNT} - 1 frames after they were issued, and only if their results are
+ * available, so the CPU never waits for the GPU. A frame of which the results are not available in time is dropped.
+ */
+struct GpuProfiler {
+    /**
+     * Frames of queries in flight, drivers commonly queue up to two frames ahead of the GPU.
+     */
+    static const uint32_t FRAME_COUNT = 3;
+
+private:
+    struct PendingZone {
+        const char *name;
+        uint32_t depth;
+        uint32_t startQuery;
+        uint32_t endQuery;
+    };
+
+    struct FrameQueries {
+        std::vector<GLuint> queries;
+        uint32_t usedQueries = 0;
+        std::vector<PendingZone> zones;
+
+        /**
+         * GPU and CPU ({Profiler::now}) time at the start of the frame, in nanoseconds.
+         */
+        GLint64 gpuStart = 0;
+        uint64_t cpuStart = 0;
+
+        bool started = false;
+    };
+
+    FrameQueries frames[FRAME_COUNT];
+    uint32_t frameIndex = 0;
+
+    /**
+     * Zones of the current frame that are not ended yet, as indices in its {FrameQueries::zones}.
+     */
+    std::vector<uint32_t> openZones;
+
+    bool enabled = false;
+    bool drawZones = false;
+
+    ProfileTrack *track = nullptr;
+
+    std::vector<GpuZoneResult> frameZones;
+    uint32_t droppedFrames = 0;
+
+    /**
+     * Issues a timestamp query in {frame}, returns its index in {FrameQueries::queries}.
+     */
+    uint32_t issueQuery(FrameQueries *frame);
+
+    /**
+     * Reads the results of the queries of {frame}, if they are available.
+     */
+    void resolve(FrameQueries *frame);
+
+public:
+    GpuProfiler();
+
+    ~GpuProfiler();
+
+    /**
+     * Starts recording a frame, and reads the results of the oldest frame in flight.
+     */
+    void beginFrame();
+
+    /**
+     * Starts a zone, {name} must be a string literal. Zones nest, and must be ended in reverse order.
+     */
+    void beginZone(const char *name);
+
+    void endZone();
+
+    /**
+     * Disabling discards the frames in flight.
+     */
+    void setEnabled(bool enabled);
+
+    bool isEnabled() const;
+
+    /**
+     * Whether {Renderer} times every draw call in addition to its passes, which costs two queries per draw.
+     */
+    void setDrawZones(bool drawZones);
+
+    bool getDrawZones() const;
+
+    /**
+     * Zones of the most recent frame with available results, in the order they began.
+     */
+    const std::vector<GpuZoneResult> &getFrameZones() const;
+
+    /**
+     * Frames of which the results were not available when their queries were reused.
+     */
+    uint32_t getDroppedFrames() const;
+};
+
+/**
+ * Times its lifetime as a zone of {profiler}, which may be nullptr, see {PROFILE_GPU_ZONE}.
+ */
+struct GpuZone {
+private:
+    GpuProfiler *profiler;
+
+public:
+    GpuZone(GpuProfiler *profiler, const char *name);
+
+    ~GpuZone();
+
+    GpuZone(const GpuZone &) = delete;
+
+    GpuZone &operator=(const GpuZone &) = delete;
+};
+
+/**
+ * Times the GL commands of the rest of the enclosing scope as zone {name} of {profiler}, if it is not nullptr.
+ */
+#define PROFILE_GPU_ZONE(profiler, name) GpuZone PROFILE_CONCAT(gpu_zone_, __LINE__)(profiler, name)
+
+#endif //GAME_GPU_PROFILER_HPP
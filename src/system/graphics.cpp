@@ -3,43 +3,372 @@
 //
 
 #include "graphics.hpp"
+#include "scene_graph.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
-InstanceTransformBuffer InstanceTransformBuffer::create(std::vector<glm::mat4> *transforms)
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <cstring>
+
+#include "../util/profiler.hpp"
+#include "../util/thread_pool.hpp"
+
+uint64_t InstanceTransformBuffer::uploadedBytes = 0;
+
+/**
+ * Grows the instance bounds of {buffer} to include {count} {transforms}.
+ */
+static void expandInstanceBounds(InstanceTransformBuffer *buffer, const glm::mat4 *transforms, uint32_t count)
 {
-    InstanceTransformBuffer result = {};
+    for (uint32_t i = 0; i < count; i++) {
+        const glm::mat4 &transform = transforms[i];
+        glm::vec3 origin(transform[3]);
+        buffer->originMin = glm::min(buffer->originMin, origin);
+        buffer->originMax = glm::max(buffer->originMax, origin);
+
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            buffer->maxScale = std::max(buffer->maxScale, glm::length(glm::vec3(transform[axis])));
+        }
+    }
+}
 
-    GLuint buffer;
-    glGenBuffers(1, &buffer);
+/**
+ * Fills the instance bounds of {buffer} from {transforms}.
+ */
+static void computeInstanceBounds(InstanceTransformBuffer *buffer, const std::vector<glm::mat4> &transforms)
+{
+    buffer->originMin = glm::vec3(std::numeric_limits<float>::max());
+    buffer->originMax = glm::vec3(-std::numeric_limits<float>::max());
+    buffer->maxScale = 0;
+    expandInstanceBounds(buffer, transforms.data(), (uint32_t) transforms.size());
+}
 
-    assert(buffer);
+/**
+ * Whether buffers can be persistently mapped, which needs OpenGL 4.4 or ARB_buffer_storage.
+ */
+static bool supportsBufferStorage()
+{
+#ifdef GL_VERSION_4_4
+    return GLAD_GL_VERSION_4_4 != 0;
+#else
+    return false;
+#endif
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, buffer);
-    glBufferData(GL_ARRAY_BUFFER, transforms->size() * sizeof(glm::mat4), &(*transforms)[0], GL_STATIC_DRAW);
+/**
+ * {InstanceCompression::encode} on the thread pool, the conversion to {QUANTIZED_INSTANCE_FORMAT} takes about
+ * 0.1 microseconds per transform.
+ */
+static void encodeInstances(InstanceFormat format, const glm::mat4 *transforms, uint32_t count, uint8_t *destination)
+{
+    uint32_t stride = InstanceCompression::getSize(format);
+    ThreadPool::get_instance()->parallel_for(count, [&](uint32_t begin, uint32_t end) {
+        InstanceCompression::encode(format, transforms + begin, end - begin, destination + begin * stride);
+    }, INSTANCE_CULLING_CHUNK);
+}
 
-    result.buffer = buffer;
-    result.elementCount = transforms->size();
+/**
+ * {PackedNormalMatrix::from_transforms} on the thread pool.
+ */
+static void computeNormalMatrices(const glm::mat4 *transforms, uint32_t count, PackedNormalMatrix *destination)
+{
+    ThreadPool::get_instance()->parallel_for(count, [&](uint32_t begin, uint32_t end) {
+        PackedNormalMatrix::from_transforms(transforms + begin, end - begin, destination + begin);
+    }, INSTANCE_CULLING_CHUNK);
+}
+
+/**
+ * Whether all {count} {transforms} pass {PackedNormalMatrix::has_uniform_scale}, checked on the thread pool.
+ */
+static bool haveUniformScale(const glm::mat4 *transforms, uint32_t count)
+{
+    std::atomic<bool> result(true);
+    ThreadPool::get_instance()->parallel_for(count, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end && result.load(std::memory_order_relaxed); i++) {
+            if (!PackedNormalMatrix::has_uniform_scale(transforms[i])) {
+                result = false;
+            }
+        }
+    }, INSTANCE_CULLING_CHUNK);
+
+    return result;
+}
+
+/**
+ * Blocks until the GPU has passed {fence}, and deletes it.
+ */
+static void waitForFence(GLsync fence)
+{
+    // NB: the first wait flushes the command stream, so the fence is guaranteed to be signaled eventually
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    const GLuint64 timeout = 1000000000;
+    while (true) {
+        GLenum result = glClientWaitSync(fence, flags, timeout);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED) {
+            break;
+        }
+        flags = 0;
+    }
+
+    glDeleteSync(fence);
+}
+
+InstanceTransformBuffer InstanceTransformBuffer::create(std::vector<glm::mat4> *transforms, InstanceFormat format)
+{
+    InstanceTransformBuffer result = {};
+    result.format = format;
+    result.persistent = supportsBufferStorage();
+    result.updateData(transforms);
 
     return result;
 }
 
 void InstanceTransformBuffer::destroy()
 {
-    glDeleteBuffers(1, &buffer);
+    for (uint32_t region = 0; region < REGION_COUNT; region++) {
+        if (fences[region]) {
+            glDeleteSync(fences[region]);
+            fences[region] = nullptr;
+        }
+        if (regions[region]) {
+            if (mappedRegions[region]) {
+                glBindBuffer(GL_ARRAY_BUFFER, regions[region]);
+                glUnmapBuffer(GL_ARRAY_BUFFER);
+                mappedRegions[region] = nullptr;
+            }
+            glDeleteBuffers(1, &regions[region]);
+            regions[region] = 0;
+        }
+    }
+
+    buffer = 0;
+    capacity = 0;
+}
+
+void InstanceTransformBuffer::reserve(uint32_t count)
+{
+    if (count <= capacity) {
+        return;
+    }
+
+    uint32_t newCapacity = std::max(count, capacity + capacity / 2);
+
+    // NB: buffers are only deleted once the GPU has finished using them, so draws in flight are unaffected
+    destroy();
+    capacity = newCapacity;
+    GLsizeiptr size = getBufferSize();
+
+    for (uint32_t region = 0; region < getRegionCount(); region++) {
+        glGenBuffers(1, &regions[region]);
+        glBindBuffer(GL_ARRAY_BUFFER, regions[region]);
+
+#ifdef GL_VERSION_4_4
+        if (persistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+            mappedRegions[region] = (uint8_t *) glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+            assert(mappedRegions[region]);
+            continue;
+        }
+#endif
+        glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+    }
+
+    // the new regions have none of the transforms
+    for (uint32_t region = 0; region < getRegionCount(); region++) {
+        dirtyRanges[region].clear();
+        dirtyRanges[region].push_back({0, elementCount});
+    }
+    currentRegion = 0;
+    buffer = regions[0];
+    pendingUpdate = true;
 }
 
 void InstanceTransformBuffer::updateData(std::vector<glm::mat4> *transforms)
 {
-    if (transforms->size() != this->elementCount) {
-        printf("Instance transform buffer updated with wrong element count. Got %u while expecting %u. \n",
-               transforms->size(), this->elementCount
-        );
+    this->transforms = *transforms;
+    elementCount = (uint32_t) transforms->size();
+    computeInstanceBounds(this, *transforms);
+    uniformScale = (format == QUANTIZED_INSTANCE_FORMAT) || haveUniformScale(transforms->data(), elementCount);
+
+    reserve(std::max(elementCount, 1u));
+    for (uint32_t region = 0; region < getRegionCount(); region++) {
+        dirtyRanges[region].clear();
+        dirtyRanges[region].push_back({0, elementCount});
+    }
+    pendingUpdate = true;
+
+    commit();
+}
+
+void InstanceTransformBuffer::updateRange(uint32_t first, const glm::mat4 *newTransforms, uint32_t count)
+{
+    assert(first + count <= elementCount);
+
+    std::copy(newTransforms, newTransforms + count, transforms.begin() + first);
+    expandInstanceBounds(this, newTransforms, count);
+
+    if (uniformScale && format != QUANTIZED_INSTANCE_FORMAT && !haveUniformScale(newTransforms, count)) {
+        // none of the regions hold normal matrices yet
+        uniformScale = false;
+        for (uint32_t region = 0; region < getRegionCount(); region++) {
+            dirtyRanges[region].clear();
+            dirtyRanges[region].push_back({0, elementCount});
+        }
+        pendingUpdate = true;
+        return;
+    }
+
+    for (uint32_t region = 0; region < getRegionCount(); region++) {
+        std::vector<InstanceRange> &ranges = dirtyRanges[region];
+
+        // extend the last range instead of adding one, for the common case of consecutive updates
+        if (!ranges.empty() && ranges.back().first <= first &&
+            first <= ranges.back().first + ranges.back().count) {
+            InstanceRange &last = ranges.back();
+            last.count = std::max(last.count, first + count - last.first);
+        } else {
+            ranges.push_back({first, count});
+        }
+    }
+    pendingUpdate = true;
+}
+
+void InstanceTransformBuffer::commit()
+{
+    if (!pendingUpdate) {
         return;
     }
+    pendingUpdate = false;
+
+    if (persistent) {
+        // the draws of the current region were issued before this fence, and the next region was last drawn from
+        // REGION_COUNT - 1 commits ago
+        fences[currentRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        currentRegion = (currentRegion + 1) % REGION_COUNT;
+        if (fences[currentRegion]) {
+            waitForFence(fences[currentRegion]);
+            fences[currentRegion] = nullptr;
+        }
+    }
+
+    std::vector<InstanceRange> &ranges = dirtyRanges[currentRegion];
+    std::sort(ranges.begin(), ranges.end(), [](const InstanceRange &a, const InstanceRange &b) {
+        return a.first < b.first;
+    });
 
+    buffer = regions[currentRegion];
     glBindBuffer(GL_ARRAY_BUFFER, buffer);
-    glBufferData(GL_ARRAY_BUFFER, transforms->size() * sizeof(glm::mat4), &(*transforms)[0], GL_STATIC_DRAW);
+
+    // write the merged ranges, which may extend beyond elementCount if the buffer shrunk since they were added
+    uint32_t stride = InstanceCompression::getSize(format);
+    GLintptr normalOffset = getNormalOffset();
+    uint32_t rangeFirst = 0;
+    uint32_t rangeEnd = 0;
+    for (uint32_t i = 0; i <= ranges.size(); i++) {
+        if (i < ranges.size() && ranges[i].first <= rangeEnd && rangeEnd > rangeFirst) {
+            rangeEnd = std::max(rangeEnd, ranges[i].first + ranges[i].count);
+            continue;
+        }
+
+        rangeEnd = std::min(rangeEnd, elementCount);
+        if (rangeEnd > rangeFirst) {
+            uint32_t count = rangeEnd - rangeFirst;
+            if (persistent) {
+                uint8_t *destination = mappedRegions[currentRegion] + rangeFirst * stride;
+                encodeInstances(format, &transforms[rangeFirst], count, destination);
+            } else {
+                encodedTransforms.resize(count * stride);
+                encodeInstances(format, &transforms[rangeFirst], count, encodedTransforms.data());
+                if (count == elementCount) {
+                    // orphan the storage instead of waiting for the draws that still read it
+                    glBufferData(GL_ARRAY_BUFFER, getBufferSize(), nullptr, GL_DYNAMIC_DRAW);
+                }
+                glBufferSubData(GL_ARRAY_BUFFER, rangeFirst * stride, count * stride, encodedTransforms.data());
+            }
+            uploadedBytes += count * stride;
+
+            if (normalOffset) {
+                if (persistent) {
+                    auto *normals = (PackedNormalMatrix *) (mappedRegions[currentRegion] + normalOffset);
+                    computeNormalMatrices(&transforms[rangeFirst], count, normals + rangeFirst);
+                } else {
+                    encodedNormals.resize(count);
+                    computeNormalMatrices(&transforms[rangeFirst], count, encodedNormals.data());
+                    glBufferSubData(GL_ARRAY_BUFFER, normalOffset + rangeFirst * sizeof(PackedNormalMatrix),
+                                    count * sizeof(PackedNormalMatrix), encodedNormals.data());
+                }
+                uploadedBytes += count * sizeof(PackedNormalMatrix);
+            }
+        }
+
+        if (i < ranges.size()) {
+            rangeFirst = ranges[i].first;
+            rangeEnd = ranges[i].first + ranges[i].count;
+        }
+    }
+
+    ranges.clear();
+}
+
+// NB: defined here rather than in scene_graph.cpp, so that the scene graph builds without GL
+uint32_t SceneGraph::updateInstances(const std::vector<NodeID> &nodes, InstanceTransformBuffer *buffer)
+{
+    assert(nodes.size() == buffer->elementCount);
+
+    uint32_t changedCount = 0;
+    if (anyChanged) {
+        for (uint32_t first = 0; first < nodes.size();) {
+            if (!changed[indices[nodes[first]]]) {
+                first++;
+                continue;
+            }
+
+            gathered.clear();
+            uint32_t end = first;
+            while (end < nodes.size() && changed[indices[nodes[end]]]) {
+                gathered.emplace_back(worldMatrices[indices[nodes[end]]]);
+                end++;
+            }
+
+            buffer->updateRange(first, gathered.data(), end - first);
+            changedCount += end - first;
+            first = end;
+        }
+    }
+
+    buffer->commit();
+    return changedCount;
+}
+
+uint32_t InstanceTransformBuffer::getRegionCount() const
+{
+    return persistent ? REGION_COUNT : 1;
+}
+
+GLsizeiptr InstanceTransformBuffer::getBufferSize() const
+{
+    // room for normal matrices is kept even while the scale is uniform, as a later update may make it non-uniform
+    GLsizeiptr elementSize = InstanceCompression::getSize(format);
+    if (format != QUANTIZED_INSTANCE_FORMAT) {
+        elementSize += sizeof(PackedNormalMatrix);
+    }
+
+    return (GLsizeiptr) capacity * elementSize;
+}
+
+GLintptr InstanceTransformBuffer::getNormalOffset() const
+{
+    return uniformScale ? 0 : (GLintptr) capacity * InstanceCompression::getSize(format);
+}
+
+uint64_t InstanceTransformBuffer::takeUploadedBytes()
+{
+    uint64_t result = uploadedBytes;
+    uploadedBytes = 0;
+    return result;
 }
 
 GLint createTexture(const Texture *tex)
@@ -92,35 +421,350 @@ GLint createTexture(const Texture *tex)
     return texture;
 }
 
-VertexArrayObject VertexArrayObject::create(Model *model)
+bool BufferRangeAllocator::allocate(uint32_t count, uint32_t *first)
 {
-    //TODO: robustness
-    VertexArrayObject result = {};
+    for (size_t i = 0; i < freeRanges.size(); i++) {
+        if (freeRanges[i].second >= count) {
+            *first = freeRanges[i].first;
+
+            freeRanges[i].first += count;
+            freeRanges[i].second -= count;
+            if (freeRanges[i].second == 0) {
+                freeRanges.erase(freeRanges.begin() + i);
+            }
+
+            return true;
+        }
+    }
 
-    GLuint vertexBuffer;
-    glGenBuffers(1, &vertexBuffer);
+    return false;
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, model->vertices.size() * sizeof(Vertex), model->vertices.data(), GL_STATIC_DRAW);
+void BufferRangeAllocator::free(uint32_t first, uint32_t count)
+{
+    if (count == 0) {
+        return;
+    }
 
-    result.numVertices = model->vertices.size();
-    result.vertexBuffer = vertexBuffer;
+    auto next = std::lower_bound(freeRanges.begin(), freeRanges.end(), std::make_pair(first, count));
+    next = freeRanges.insert(next, std::make_pair(first, count));
 
-    for (const auto &materialSubMesh: model->mesh.materialSubMeshes) {
-        GLuint indexBuffer;
-        glGenBuffers(1, &indexBuffer);
+    // merge with the following and the preceding range
+    if (next + 1 != freeRanges.end() && next->first + next->second == (next + 1)->first) {
+        next->second += (next + 1)->second;
+        freeRanges.erase(next + 1);
+    }
+    if (next != freeRanges.begin() && (next - 1)->first + (next - 1)->second == next->first) {
+        (next - 1)->second += next->second;
+        freeRanges.erase(next);
+    }
+}
+
+void BufferRangeAllocator::grow(uint32_t newCapacity)
+{
+    uint32_t oldCapacity = capacity;
+    capacity = newCapacity;
+    free(oldCapacity, newCapacity - oldCapacity);
+}
+
+/**
+ * Replaces {buffer} by a buffer of {newSize} bytes, which starts with the first {oldSize} bytes of {buffer}.
+ */
+static void resizeBuffer(GLuint *buffer, GLsizeiptr oldSize, GLsizeiptr newSize)
+{
+    GLuint newBuffer;
+    glGenBuffers(1, &newBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, newSize, nullptr, GL_STATIC_DRAW);
+
+    if (*buffer) {
+        glBindBuffer(GL_COPY_READ_BUFFER, *buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+        glDeleteBuffers(1, buffer);
+    }
+
+    *buffer = newBuffer;
+}
+
+/**
+ * Enables attribute {location} of the bound vertex array, reading {size} components of {type} at {offset} within
+ * the elements of the buffer attached to {binding}. The shader reads the attribute as floats.
+ */
+static void setVertexAttribute(GLuint location, GLint size, GLuint offset, GLuint binding, GLenum type = GL_FLOAT,
+                               GLboolean normalized = GL_FALSE)
+{
+    glEnableVertexAttribArray(location);
+    glVertexAttribFormat(location, size, type, normalized, offset);
+    glVertexAttribBinding(location, binding);
+}
+
+/**
+ * Specifies attribute {location} of the bound vertex array with glVertexAttribPointer, reading from the bound array
+ * buffer. The per-draw counterpart of {setVertexAttribute}.
+ */
+static void setVertexPointer(GLuint location, GLint size, size_t offset, GLsizei stride, GLenum type = GL_FLOAT,
+                             GLboolean normalized = GL_FALSE)
+{
+    glEnableVertexAttribArray(location);
+    glVertexAttribPointer(location, size, type, normalized, stride, (void *) offset);
+}
+
+/**
+ * Specifies the vertex layout and buffers of {pool} on the bound vertex array, see
+ * {Renderer::setRespecifyVertexLayout}.
+ */
+static void specifyVertexLayout(const GeometryPool *pool)
+{
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool->indexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, pool->vertexBuffer);
+
+    auto stride = (GLsizei) pool->vertexSize;
+    if (pool->vertexFormat == COMPACT_VERTEX_FORMAT) {
+        setVertexPointer(POSITION_ATTRIBUTE, 4, offsetof(CompactVertex, position), stride, GL_UNSIGNED_SHORT, GL_TRUE);
+        setVertexPointer(NORMAL_ATTRIBUTE, 4, offsetof(CompactVertex, normalTangent), stride, GL_SHORT, GL_TRUE);
+        setVertexPointer(TEXCOORD_ATTRIBUTE, 2, offsetof(CompactVertex, uv), stride, GL_HALF_FLOAT);
+    } else {
+        setVertexPointer(POSITION_ATTRIBUTE, 3, offsetof(Vertex, position), stride);
+        setVertexPointer(NORMAL_ATTRIBUTE, 3, offsetof(Vertex, normal), stride);
+        setVertexPointer(TEXCOORD_ATTRIBUTE, 2, offsetof(Vertex, uv), stride);
+        setVertexPointer(TANGENT_ATTRIBUTE, 3, offsetof(Vertex, tangent), stride);
+        setVertexPointer(BITANGENT_ATTRIBUTE, 3, offsetof(Vertex, biTangent), stride);
+    }
+}
+
+GeometryPool GeometryPool::create(VertexFormat vertexFormat, uint32_t vertexCapacity, uint32_t indexCapacity)
+{
+    GeometryPool result = {};
+    result.vertexFormat = vertexFormat;
+    result.vertexSize = (vertexFormat == COMPACT_VERTEX_FORMAT) ? sizeof(CompactVertex) : sizeof(Vertex);
+
+    resizeBuffer(&result.vertexBuffer, 0, vertexCapacity * result.vertexSize);
+    resizeBuffer(&result.indexBuffer, 0, indexCapacity * sizeof(uint32_t));
+    result.vertexAllocator.grow(vertexCapacity);
+    result.indexAllocator.grow(indexCapacity);
+
+    // bake the vertex layout into the vertex arrays, the instanced ones additionally read a transform per instance
+    GLuint vertexArrays[1 + INSTANCE_FORMAT_COUNT];
+    glGenVertexArrays(1 + INSTANCE_FORMAT_COUNT, vertexArrays);
+    for (int i = 0; i < 1 + INSTANCE_FORMAT_COUNT; i++) {
+        glBindVertexArray(vertexArrays[i]);
+
+        if (vertexFormat == COMPACT_VERTEX_FORMAT) {
+            // decoded in the vertex shader, the tangent and bitangent attributes are packed into position and normal
+            setVertexAttribute(POSITION_ATTRIBUTE, 4, offsetof(CompactVertex, position), VERTEX_BINDING,
+                               GL_UNSIGNED_SHORT, GL_TRUE);
+            setVertexAttribute(NORMAL_ATTRIBUTE, 4, offsetof(CompactVertex, normalTangent), VERTEX_BINDING,
+                               GL_SHORT, GL_TRUE);
+            setVertexAttribute(TEXCOORD_ATTRIBUTE, 2, offsetof(CompactVertex, uv), VERTEX_BINDING, GL_HALF_FLOAT);
+        } else {
+            setVertexAttribute(POSITION_ATTRIBUTE, 3, offsetof(Vertex, position), VERTEX_BINDING);
+            setVertexAttribute(NORMAL_ATTRIBUTE, 3, offsetof(Vertex, normal), VERTEX_BINDING);
+            setVertexAttribute(TEXCOORD_ATTRIBUTE, 2, offsetof(Vertex, uv), VERTEX_BINDING);
+            setVertexAttribute(TANGENT_ATTRIBUTE, 3, offsetof(Vertex, tangent), VERTEX_BINDING);
+            setVertexAttribute(BITANGENT_ATTRIBUTE, 3, offsetof(Vertex, biTangent), VERTEX_BINDING);
+        }
+
+        if (i == 0) {
+            glEnableVertexAttribArray(DRAW_ID_ATTRIBUTE);
+            glVertexAttribIFormat(DRAW_ID_ATTRIBUTE, 1, GL_UNSIGNED_INT, 0);
+            glVertexAttribBinding(DRAW_ID_ATTRIBUTE, DRAW_ID_BINDING);
+            glVertexBindingDivisor(DRAW_ID_BINDING, 1);
+        } else if (i - 1 == QUANTIZED_INSTANCE_FORMAT) {
+            setVertexAttribute(INSTANCE_TRANSFORM_ATTRIBUTE, 4, offsetof(QuantizedInstance, translation),
+                               INSTANCE_BINDING);
+            setVertexAttribute(INSTANCE_TRANSFORM_ATTRIBUTE + 1, 4, offsetof(QuantizedInstance, rotation),
+                               INSTANCE_BINDING, GL_SHORT, GL_TRUE);
+            glVertexBindingDivisor(INSTANCE_BINDING, 1);
+        } else {
+            // columns of a matrix, or rows of an affine matrix
+            uint32_t vectors = (i - 1 == AFFINE_INSTANCE_FORMAT) ? 3 : 4;
+            for (uint32_t vector = 0; vector < vectors; vector++) {
+                setVertexAttribute(INSTANCE_TRANSFORM_ATTRIBUTE + vector, 4, vector * sizeof(glm::vec4),
+                                   INSTANCE_BINDING);
+            }
+            glVertexBindingDivisor(INSTANCE_BINDING, 1);
+
+            for (uint32_t column = 0; column < 3; column++) {
+                setVertexAttribute(INSTANCE_NORMAL_ATTRIBUTE + column, 3, column * sizeof(glm::vec3),
+                                   INSTANCE_NORMAL_BINDING);
+            }
+            glVertexBindingDivisor(INSTANCE_NORMAL_BINDING, 1);
+        }
+    }
+    glBindVertexArray(0);
+
+    result.vertexArray = vertexArrays[0];
+    for (uint32_t format = 0; format < INSTANCE_FORMAT_COUNT; format++) {
+        result.instancedVertexArrays[format] = vertexArrays[1 + format];
+    }
+
+    result.reserveDrawIds(1024);
+    result.attachBuffers();
+
+    return result;
+}
+
+void GeometryPool::destroy()
+{
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteVertexArrays(INSTANCE_FORMAT_COUNT, instancedVertexArrays);
+
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+    glDeleteBuffers(1, &drawIdBuffer);
+}
+
+void GeometryPool::attachBuffers()
+{
+    for (int i = 0; i < 1 + INSTANCE_FORMAT_COUNT; i++) {
+        glBindVertexArray((i == 0) ? vertexArray : instancedVertexArrays[i - 1]);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, materialSubMesh.indices.size() * sizeof(uint32_t),
-                     &materialSubMesh.indices[0],
-                     GL_STATIC_DRAW);
+        glBindVertexBuffer(VERTEX_BINDING, vertexBuffer, 0, vertexSize);
+    }
+    glBindVertexArray(vertexArray);
+    glBindVertexBuffer(DRAW_ID_BINDING, drawIdBuffer, 0, sizeof(uint32_t));
+    glBindVertexArray(0);
+}
+
+uint32_t GeometryPool::allocateVertices(uint32_t count)
+{
+    uint32_t first;
+    if (!vertexAllocator.allocate(count, &first)) {
+        uint32_t newCapacity = std::max(vertexAllocator.capacity * 2, vertexAllocator.capacity + count);
+        ls_log::log(LOG_INFO, "growing geometry pool of format %d to %u vertices\n", vertexFormat, newCapacity);
+
+        resizeBuffer(&vertexBuffer, vertexAllocator.capacity * vertexSize, newCapacity * vertexSize);
+        vertexAllocator.grow(newCapacity);
+        attachBuffers();
+
+        bool allocated = vertexAllocator.allocate(count, &first);
+        assert(allocated);
+    }
+
+    return first;
+}
+
+uint32_t GeometryPool::allocateIndices(uint32_t count)
+{
+    uint32_t first;
+    if (!indexAllocator.allocate(count, &first)) {
+        uint32_t newCapacity = std::max(indexAllocator.capacity * 2, indexAllocator.capacity + count);
+        ls_log::log(LOG_INFO, "growing geometry pool to %u indices\n", newCapacity);
+
+        resizeBuffer(&indexBuffer, indexAllocator.capacity * sizeof(uint32_t), newCapacity * sizeof(uint32_t));
+        indexAllocator.grow(newCapacity);
+        attachBuffers();
+
+        bool allocated = indexAllocator.allocate(count, &first);
+        assert(allocated);
+    }
+
+    return first;
+}
+
+void GeometryPool::freeVertices(uint32_t first, uint32_t count)
+{
+    vertexAllocator.free(first, count);
+}
+
+void GeometryPool::freeIndices(uint32_t first, uint32_t count)
+{
+    indexAllocator.free(first, count);
+}
+
+void GeometryPool::reserveDrawIds(uint32_t count)
+{
+    if (count <= drawIdCapacity) {
+        return;
+    }
+
+    uint32_t newCapacity = std::max(drawIdCapacity * 2, count);
+    std::vector<uint32_t> drawIds(newCapacity);
+    for (uint32_t i = 0; i < newCapacity; i++) {
+        drawIds[i] = i;
+    }
+
+    if (!drawIdBuffer) {
+        glGenBuffers(1, &drawIdBuffer);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, drawIdBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, newCapacity * sizeof(uint32_t), drawIds.data(), GL_STATIC_DRAW);
+    drawIdCapacity = newCapacity;
+}
+
+VertexArrayObject VertexArrayObject::create(Model *model, GeometryPool *pool)
+{
+    //TODO: robustness
+    VertexArrayObject result = {};
+    assert(pool->vertexFormat == model->vertexFormat);
+    result.vertexArray = pool->vertexArray;
+    std::copy(pool->instancedVertexArrays, pool->instancedVertexArrays + INSTANCE_FORMAT_COUNT,
+              result.instancedVertexArrays);
+    result.vertexFormat = model->vertexFormat;
+    result.positionOffset = model->positionOffset;
+    result.positionScale = model->positionScale;
+    result.bounds = model->bounds;
+
+    result.numVertices = model->getVertexCount();
+    result.baseVertex = (int32_t) pool->allocateVertices(result.numVertices);
+
+    // NB: for cooked meshes the full precision data is uploaded straight from the memory mapping
+    const void *vertexData = (model->vertexFormat == COMPACT_VERTEX_FORMAT) ?
+                             (const void *) model->compactVertices.data() : (const void *) model->getVertexData();
+    glBindBuffer(GL_COPY_WRITE_BUFFER, pool->vertexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, result.baseVertex * pool->vertexSize, result.numVertices * pool->vertexSize,
+                    vertexData);
+
+    // the indices of all submeshes and their levels of detail are stored consecutively, relative to the base vertex
+    for (const auto &materialSubMesh: model->mesh.materialSubMeshes) {
+        result.numIndices += materialSubMesh.getIndexCount();
+        for (const auto &lod : materialSubMesh.lods) {
+            result.numIndices += lod.getIndexCount();
+        }
+    }
+    result.firstIndex = pool->allocateIndices(result.numIndices);
 
+    glBindBuffer(GL_COPY_WRITE_BUFFER, pool->indexBuffer);
+    uint32_t firstIndex = result.firstIndex;
+    for (const auto &materialSubMesh: model->mesh.materialSubMeshes) {
         IndexBuffer buffer = {};
         buffer.materialIndex = materialSubMesh.materialIndex;
-        buffer.numIndices = materialSubMesh.indices.size();
-        buffer.indexBuffer = indexBuffer;
+        buffer.numIndices = materialSubMesh.getIndexCount();
+        buffer.firstIndex = firstIndex;
+        buffer.bounds = materialSubMesh.bounds;
+
+        glBufferSubData(GL_COPY_WRITE_BUFFER, firstIndex * sizeof(uint32_t), buffer.numIndices * sizeof(uint32_t),
+                        materialSubMesh.getIndexData());
+        firstIndex += buffer.numIndices;
+
+        for (const auto &lod : materialSubMesh.lods) {
+            LodRange range = {};
+            range.numIndices = lod.getIndexCount();
+            range.firstIndex = firstIndex;
+            range.error = lod.error;
+            buffer.lods.emplace_back(range);
+
+            glBufferSubData(GL_COPY_WRITE_BUFFER, firstIndex * sizeof(uint32_t), range.numIndices * sizeof(uint32_t),
+                            lod.getIndexData());
+            firstIndex += range.numIndices;
+        }
+
         result.materialIndexBuffers.emplace_back(buffer);
     }
 
+    // materials share decoded images (see AssetManager::loadModelTextures), upload each of them only once
+    std::unordered_map<const char *, GLint> uploadedTextures;
+    auto getTexture = [&uploadedTextures](const Texture *tex) {
+        auto found = uploadedTextures.find(tex->data);
+        if (found != uploadedTextures.end()) {
+            return found->second;
+        }
+
+        GLint texture = createTexture(tex);
+        uploadedTextures.emplace(tex->data, texture);
+        return texture;
+    };
+
     for (const auto &material: model->materials) {
         GPUMaterial newMaterial = {};
         newMaterial.albedo = material.albedo;
@@ -128,35 +772,126 @@ VertexArrayObject VertexArrayObject::create(Model *model)
         newMaterial.metallic = material.metallic;
 
         if (material.albedoTexture.data) {
-            newMaterial.albedoTexture = createTexture(&material.albedoTexture);
+            newMaterial.albedoTexture = getTexture(&material.albedoTexture);
         }
         if (material.roughnessTexture.data) {
-            newMaterial.roughnessTexture = createTexture(&material.roughnessTexture);
+            newMaterial.roughnessTexture = getTexture(&material.roughnessTexture);
         }
         if (material.metallicTexture.data) {
-            newMaterial.metallicTexture = createTexture(&material.metallicTexture);
+            newMaterial.metallicTexture = getTexture(&material.metallicTexture);
         }
         if (material.normalMap.data) {
-            newMaterial.normalTexture = createTexture(&material.normalMap);
+            newMaterial.normalTexture = getTexture(&material.normalMap);
         }
 
         result.materials.emplace_back(newMaterial);
     }
 
+    // submeshes without a material have index -1, they are drawn with a default material appended to the others
+    int32_t defaultMaterial = -1;
+    for (auto &indexBuffer : result.materialIndexBuffers) {
+        if (indexBuffer.materialIndex >= 0) {
+            continue;
+        }
+
+        if (defaultMaterial < 0) {
+            Material material;
+            GPUMaterial newMaterial = {};
+            newMaterial.albedo = material.albedo;
+            newMaterial.roughness = material.roughness;
+            newMaterial.metallic = material.metallic;
+
+            defaultMaterial = (int32_t) result.materials.size();
+            result.materials.emplace_back(newMaterial);
+        }
+        indexBuffer.materialIndex = defaultMaterial;
+    }
+
     return result;
 }
 
-void VertexArrayObject::unload()
+LodRange IndexBuffer::getLod(uint32_t lod) const
 {
-    glDeleteBuffers(1, &vertexBuffer);
+    if (lod == 0) {
+        return {numIndices, firstIndex, 0.0f};
+    }
+
+    return lods[lod - 1];
+}
 
-    for (auto &indexBuffer: materialIndexBuffers) {
-        glDeleteBuffers(1, &indexBuffer.indexBuffer);
+uint32_t LodState::get(uint32_t subMesh) const
+{
+    return (subMesh < levels.size()) ? levels[subMesh] : NONE;
+}
+
+void LodState::set(uint32_t subMesh, uint32_t level)
+{
+    if (subMesh >= levels.size()) {
+        // NB: copied, as binding the static member to a reference would need a definition of it
+        uint32_t none = NONE;
+        levels.resize(subMesh + 1, none);
     }
 
+    levels[subMesh] = level;
+}
+
+void VertexArrayObject::unload(GeometryPool *pool)
+{
+    pool->freeVertices(baseVertex, numVertices);
+    pool->freeIndices(firstIndex, numIndices);
+
     //TODO: unload textures
 }
 
+/**
+ * Sets the uniforms with which the vertex shader decodes the vertices of {vao}.
+ */
+static void setVertexDecoding(const ShaderLocations &locations, const VertexArrayObject *vao)
+{
+    glUniform1i(locations.compactVertices, (vao->vertexFormat == COMPACT_VERTEX_FORMAT) ? 1 : 0);
+    glUniform3fv(locations.positionOffset, 1, glm::value_ptr(vao->positionOffset));
+    glUniform3fv(locations.positionScale, 1, glm::value_ptr(vao->positionScale));
+}
+
+/**
+ * Attaches the per-instance normal matrices at {normalOffset} in {instanceBuffer} to the bound vertex array, or
+ * selects deriving them from the instance transforms if {normalOffset} is 0.
+ */
+static void bindInstanceNormals(const ShaderLocations &locations, GLuint instanceBuffer, GLintptr normalOffset)
+{
+    glUniform1i(locations.instanceUniformScale, normalOffset ? 0 : 1);
+
+    // NB: unused with uniform scale, but the attribute is enabled and still reads the start of the buffer
+    GLsizei stride = normalOffset ? (GLsizei) sizeof(PackedNormalMatrix) : 0;
+    glBindVertexBuffer(INSTANCE_NORMAL_BINDING, instanceBuffer, normalOffset, stride);
+}
+
+/**
+ * Largest factor by which {transform} scales an axis.
+ */
+static float transformScale(const glm::mat4 &transform)
+{
+    return std::max(glm::length(glm::vec3(transform[0])),
+                    std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+}
+
+/**
+ * Smallest view depth of the instance origins of {transforms}. View depth is linear in the position, so it is
+ * found at one of the corners of the bounds of the origins.
+ */
+static float nearestInstanceDepth(const glm::mat4 &view, const InstanceTransformBuffer &transforms)
+{
+    float depth = std::numeric_limits<float>::max();
+    for (uint32_t corner = 0; corner < 8; corner++) {
+        glm::vec4 origin((corner & 1u) ? transforms.originMax.x : transforms.originMin.x,
+                         (corner & 2u) ? transforms.originMax.y : transforms.originMin.y,
+                         (corner & 4u) ? transforms.originMax.z : transforms.originMin.z, 1.0f);
+        depth = std::min(depth, -(view * origin).z);
+    }
+
+    return depth;
+}
+
 Renderer::Renderer()
 {
 
@@ -164,75 +899,218 @@ Renderer::Renderer()
 
 void Renderer::clearScreen()
 {
+    PROFILE_GPU_ZONE(gpuProfiler, "clear");
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    cullingStats = {};
+    instanceUploadBytes = InstanceTransformBuffer::takeUploadedBytes();
 }
 
-void Renderer::renderModel(AssetID id, glm::mat4 transform)
+void SphereBatch::clear()
 {
-    assert(graphicsManager);
+    x.clear();
+    y.clear();
+    z.clear();
+    radius.clear();
+}
 
-    VertexArrayObject *vao = graphicsManager->getVAO(id);
+void SphereBatch::add(glm::vec3 center, float sphereRadius)
+{
+    x.emplace_back(center.x);
+    y.emplace_back(center.y);
+    z.emplace_back(center.z);
+    radius.emplace_back(sphereRadius);
+}
+
+uint32_t SphereBatch::test(const Frustum &frustum)
+{
+    visible.resize(x.size());
+    return frustum.test_spheres(x.data(), y.data(), z.data(), radius.data(), (uint32_t) x.size(), visible.data());
+}
+
+uint32_t Renderer::cullSubMeshes(const VertexArrayObject *vao, const glm::mat4 &transform)
+{
+    auto subMeshCount = (uint32_t) vao->materialIndexBuffers.size();
+    float scale = transformScale(transform);
+    subMeshSpheres.clear();
+
+    glm::vec3 modelCenter(transform * glm::vec4(vao->bounds.center, 1.0f));
+    if (!frustum.intersects_sphere(modelCenter, vao->bounds.radius * scale)) {
+        subMeshSpheres.visible.assign(subMeshCount, 0);
+        cullingStats.culled += subMeshCount;
+        return 0;
+    }
+
+    if (occlusionCuller && occlusionCuller->isOccluded(vao->bounds, transform)) {
+        subMeshSpheres.visible.assign(subMeshCount, 0);
+        cullingStats.culled += subMeshCount;
+        cullingStats.occluded++;
+        return 0;
+    }
+
+    for (const auto &indexBuffer : vao->materialIndexBuffers) {
+        glm::vec3 center(transform * glm::vec4(indexBuffer.bounds.center, 1.0f));
+        subMeshSpheres.add(center, indexBuffer.bounds.radius * scale);
+    }
+
+    uint32_t visible = subMeshSpheres.test(frustum);
+    cullingStats.visible += visible;
+    cullingStats.culled += subMeshCount - visible;
+    return visible;
+}
+
+uint32_t Renderer::cullScene(const DynamicBVH &bvh, std::vector<uint32_t> *visible)
+{
+    PROFILE_ZONE("Renderer::cullScene");
+    visible->clear();
+    uint32_t visibleCount = bvh.cull(frustum, visible);
+
+    cullingStats.objectsVisible += visibleCount;
+    cullingStats.objectsCulled += bvh.get_proxy_count() - visibleCount;
+    return visibleCount;
+}
+
+uint32_t Renderer::cullInstances(const VertexArrayObject *vao, const InstanceTransformBuffer &transforms, bool compact,
+                                 GLuint *instanceBuffer, GLintptr *normalOffset)
+{
+    auto subMeshCount = (uint32_t) vao->materialIndexBuffers.size();
+
+    // a sphere around the instance origins, grown by the furthest any instance can reach from its origin
+    glm::vec3 center = (transforms.originMin + transforms.originMax) * 0.5f;
+    float radius = glm::length(transforms.originMax - transforms.originMin) * 0.5f +
+                   (glm::length(vao->bounds.center) + vao->bounds.radius) * transforms.maxScale;
+
+    uint32_t visible = 0;
+    *instanceBuffer = transforms.buffer;
+    *normalOffset = transforms.getNormalOffset();
+    if (transforms.elementCount > 0 && frustum.intersects_sphere(center, radius)) {
+        visible = transforms.elementCount;
+        if (compact && !frustum.contains_sphere(center, radius)) {
+            visible = compactVisibleInstances(vao, transforms, normalOffset);
+            *instanceBuffer = culledInstanceBuffer;
+        }
+    }
 
-    GLint vPosPosition = glGetAttribLocation(activeShader.program, "vPos");
-    GLint vNormPosition = glGetAttribLocation(activeShader.program, "vNorm");
-    GLint vTexcoordPosition = glGetAttribLocation(activeShader.program, "vTex");
-    GLint tangentPosition = glGetAttribLocation(activeShader.program, "tangent");
-    GLint biTangentPosition = glGetAttribLocation(activeShader.program, "biTangent");
+    cullingStats.instancesVisible += visible;
+    cullingStats.instancesCulled += transforms.elementCount - visible;
 
-    GLint modelPosition = glGetUniformLocation(activeShader.program, "ModelM");
-    GLint viewPosition = glGetUniformLocation(activeShader.program, "ViewM");
-    GLint projPosition = glGetUniformLocation(activeShader.program, "ProjectionM");
-    GLint camPosPosition = glGetUniformLocation(activeShader.program, "cameraPosition");
+    subMeshSpheres.visible.assign(subMeshCount, visible ? 1 : 0);
+    if (visible) {
+        cullingStats.visible += subMeshCount;
+    } else {
+        cullingStats.culled += subMeshCount;
+    }
 
-    GLint albedoConstantPosition = glGetUniformLocation(activeShader.program, "albedoConstant");
-    GLint roughnessConstantPosition = glGetUniformLocation(activeShader.program, "roughnessConstant");
-    GLint metallicConstantPosition = glGetUniformLocation(activeShader.program, "metallicConstant");
+    return visible;
+}
 
-    GLint useAlbedoTexturePosition = glGetUniformLocation(activeShader.program, "useAlbedoTexture");
-    GLint useRoughnessTexturePosition = glGetUniformLocation(activeShader.program, "useRoughnessTexture");
-    GLint useMetallicTexturePosition = glGetUniformLocation(activeShader.program, "useMetallicTexture");
-    GLint useNormalTexturePosition = glGetUniformLocation(activeShader.program, "useNormalTexture");
+uint32_t Renderer::compactVisibleInstances(const VertexArrayObject *vao, const InstanceTransformBuffer &transforms,
+                                           GLintptr *normalOffset)
+{
+    const std::vector<glm::mat4> &source = transforms.transforms;
+    uint32_t visibleCount = instanceCuller.cull(frustum, source.data(), (uint32_t) source.size(),
+                                                vao->bounds.center, vao->bounds.radius);
+    if (visibleCount == 0) {
+        return 0;
+    }
 
-    GLint albedoTexPosition = glGetUniformLocation(activeShader.program, "albedoTexture");
-    GLint roughnessTexPosition = glGetUniformLocation(activeShader.program, "roughnessTexture");
-    GLint metallicTexPosition = glGetUniformLocation(activeShader.program, "metallicTexture");
-    GLint normalTexPosition = glGetUniformLocation(activeShader.program, "normalTexture");
+    if (!culledInstanceBuffer) {
+        glGenBuffers(1, &culledInstanceBuffer);
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, vao->vertexBuffer);
+    // the compacted transforms are in the format of {transforms}, so they are drawn with the same vertex array
+    uint32_t stride = InstanceCompression::getSize(transforms.format);
+    auto size = (GLsizeiptr) visibleCount * stride;
+    *normalOffset = 0;
+    if (!transforms.uniformScale) {
+        *normalOffset = size;
+        size += (GLsizeiptr) visibleCount * sizeof(PackedNormalMatrix);
+    }
 
-    glEnableVertexAttribArray(vPosPosition);
-    glVertexAttribPointer(vPosPosition, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, position));
+    glBindBuffer(GL_ARRAY_BUFFER, culledInstanceBuffer);
+    if (size > culledInstanceBufferSize) {
+        culledInstanceBufferSize = std::max(size, culledInstanceBufferSize + culledInstanceBufferSize / 2);
+        glBufferData(GL_ARRAY_BUFFER, culledInstanceBufferSize, nullptr, GL_STREAM_DRAW);
+    }
 
-    glEnableVertexAttribArray(vNormPosition);
-    glVertexAttribPointer(vNormPosition, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, normal));
+    auto *mapped = (uint8_t *) glMapBufferRange(GL_ARRAY_BUFFER, 0, size,
+                                                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!mapped) {
+        ls_log::log(LOG_ERROR, "could not map the culled instance buffer\n");
+        return 0;
+    }
 
-    glEnableVertexAttribArray(vTexcoordPosition);
-    glVertexAttribPointer(vTexcoordPosition, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, uv));
+    // the visible transforms of every chunk go to the offset of the chunk in the compacted buffer
+    instanceCuller.compact([&](uint32_t first, const uint32_t *sources, uint32_t count) {
+        uint8_t *destination = mapped + first * stride;
+        auto *normals = (PackedNormalMatrix *) (mapped + *normalOffset) + first;
+        for (uint32_t i = 0; i < count; i++) {
+            const glm::mat4 &transform = source[sources[i]];
+            InstanceCompression::encode(transforms.format, &transform, 1, destination + i * stride);
+            if (*normalOffset) {
+                normals[i] = PackedNormalMatrix::from_transform(transform);
+            }
+        }
+    });
 
-    glEnableVertexAttribArray(tangentPosition);
-    glVertexAttribPointer(tangentPosition, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, tangent));
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    InstanceTransformBuffer::uploadedBytes += size;
+    return visibleCount;
+}
 
-    glEnableVertexAttribArray(biTangentPosition);
-    glVertexAttribPointer(biTangentPosition, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (void *) offsetof(Vertex, biTangent));
+void Renderer::renderModel(AssetID id, glm::mat4 transform, LodState *lodState)
+{
+    assert(graphicsManager);
+
+    VertexArrayObject *vao = graphicsManager->getVAO(id);
+
+    // skip models that are still streaming in, and drawing before any shader is ready
+    if (!vao || !activeShader) {
+        return;
+    }
+
+    if (cullSubMeshes(vao, transform) == 0) {
+        return;
+    }
+
+    // NB: locations are reflected once when the program is linked, see ShaderProgram::createShaderProgram
+    const ShaderLocations &locations = activeShader->locations;
+
+    // NB: the vertex layout and index buffer are part of the vertex array
+    if (respecifyVertexLayout) {
+        glBindVertexArray(respecifiedVertexArray);
+        specifyVertexLayout(graphicsManager->getGeometryPool(vao->vertexFormat));
+    } else {
+        glBindVertexArray(vao->vertexArray);
+    }
 
     glm::mat4 model = transform;
     glm::mat4 view = activeViewMatrix;
     glm::mat4 projection = activePerspectiveMatrix;
+    PackedNormalMatrix normalMatrix = PackedNormalMatrix::from_transform(transform);
 
-    glUniformMatrix4fv(modelPosition, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewPosition, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projPosition, 1, GL_FALSE, glm::value_ptr(projection));
+    glUniformMatrix4fv(locations.model, 1, GL_FALSE, glm::value_ptr(model));
+    glUniformMatrix3fv(locations.normalMatrix, 1, GL_FALSE, glm::value_ptr(normalMatrix.columns[0]));
+    glUniformMatrix4fv(locations.view, 1, GL_FALSE, glm::value_ptr(view));
 
-    glUniform3fv(camPosPosition, 1, glm::value_ptr(cameraPosition));
+    float pixelsPerUnit = lodPixelsPerUnit(-(view * transform[3]).z, transformScale(transform));
+    glUniformMatrix4fv(locations.projection, 1, GL_FALSE, glm::value_ptr(projection));
 
-    glUniform1i(albedoTexPosition, 0);
-    glUniform1i(roughnessTexPosition, 1);
-    glUniform1i(metallicTexPosition, 2);
-    glUniform1i(normalTexPosition, 3);
+    glUniform3fv(locations.cameraPosition, 1, glm::value_ptr(cameraPosition));
+    setVertexDecoding(locations, vao);
 
-    for (const auto &indexBuffer: vao->materialIndexBuffers) {
+    glUniform1i(locations.albedoTexture, 0);
+    glUniform1i(locations.roughnessTexture, 1);
+    glUniform1i(locations.metallicTexture, 2);
+    glUniform1i(locations.normalTexture, 3);
+
+    for (uint32_t i = 0; i < vao->materialIndexBuffers.size(); i++) {
+        if (!subMeshSpheres.visible[i]) {
+            continue;
+        }
+
+        const IndexBuffer &indexBuffer = vao->materialIndexBuffers[i];
         GPUMaterial &material = vao->materials[indexBuffer.materialIndex];
+        LodRange lod = indexBuffer.getLod(selectLod(indexBuffer, i, pixelsPerUnit, lodState));
 
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, material.albedoTexture);
@@ -243,29 +1121,90 @@ void Renderer::renderModel(AssetID id, glm::mat4 transform)
         glActiveTexture(GL_TEXTURE3);
         glBindTexture(GL_TEXTURE_2D, material.normalTexture);
 
-        glUniform3fv(albedoConstantPosition, 1, glm::value_ptr(material.albedo));
-        glUniform1f(roughnessConstantPosition, material.roughness);
-        glUniform1f(metallicConstantPosition, material.metallic);
-
-        glUniform1i(useAlbedoTexturePosition, (material.albedoTexture == 0) ? 0 : 1);
-        glUniform1i(useRoughnessTexturePosition, (material.roughnessTexture == 0) ? 0 : 1);
-        glUniform1i(useMetallicTexturePosition, (material.metallicTexture == 0) ? 0 : 1);
-        glUniform1i(useNormalTexturePosition, (material.normalTexture == 0) ? 0 : 1);
+        glUniform3fv(locations.albedoConstant, 1, glm::value_ptr(material.albedo));
+        glUniform1f(locations.roughnessConstant, material.roughness);
+        glUniform1f(locations.metallicConstant, material.metallic);
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.indexBuffer);
+        glUniform1i(locations.useAlbedoTexture, (material.albedoTexture == 0) ? 0 : 1);
+        glUniform1i(locations.useRoughnessTexture, (material.roughnessTexture == 0) ? 0 : 1);
+        glUniform1i(locations.useMetallicTexture, (material.metallicTexture == 0) ? 0 : 1);
+        glUniform1i(locations.useNormalTexture, (material.normalTexture == 0) ? 0 : 1);
 
-        glDrawElements(GL_TRIANGLES, indexBuffer.numIndices, GL_UNSIGNED_INT, nullptr);
+        PROFILE_GPU_ZONE(getDrawProfiler(), "draw");
+        glDrawElementsBaseVertex(GL_TRIANGLES, lod.numIndices, GL_UNSIGNED_INT,
+                                 (void *) (lod.firstIndex * sizeof(uint32_t)), vao->baseVertex);
     }
 }
 
 void Renderer::setView(glm::mat4 viewMatrix)
 {
     this->activeViewMatrix = viewMatrix;
+    this->frustum = Frustum::from_matrix(activePerspectiveMatrix * activeViewMatrix);
 }
 
 void Renderer::setPerspective(glm::mat4 perspectiveMatrix)
 {
     this->activePerspectiveMatrix = perspectiveMatrix;
+    this->frustum = Frustum::from_matrix(activePerspectiveMatrix * activeViewMatrix);
+}
+
+void Renderer::setViewportHeight(uint32_t height)
+{
+    this->viewportHeight = std::max(height, 1u);
+}
+
+void Renderer::setLodSelection(float errorThreshold, float hysteresis)
+{
+    this->lodErrorThreshold = errorThreshold;
+    this->lodHysteresis = hysteresis;
+}
+
+void Renderer::setRespecifyVertexLayout(bool respecify)
+{
+    if (respecify && !respecifiedVertexArray) {
+        glGenVertexArrays(1, &respecifiedVertexArray);
+    }
+
+    this->respecifyVertexLayout = respecify;
+}
+
+float Renderer::lodPixelsPerUnit(float depth, float scale) const
+{
+    // models at or behind the camera plane are drawn at full detail
+    const float MIN_DEPTH = 1e-4f;
+    if (depth < MIN_DEPTH) {
+        return std::numeric_limits<float>::max();
+    }
+
+    // NB: the second diagonal element of a perspective matrix is the cotangent of half the vertical field of view
+    return activePerspectiveMatrix[1][1] * 0.5f * (float) viewportHeight * scale / depth;
+}
+
+uint32_t Renderer::selectLod(const IndexBuffer &indexBuffer, uint32_t subMesh, float pixelsPerUnit,
+                             LodState *lodState) const
+{
+    uint32_t previous = lodState ? lodState->get(subMesh) : LodState::NONE;
+    uint32_t selected = 0;
+
+    for (auto lod = (uint32_t) indexBuffer.lods.size(); lod > 0; lod--) {
+        float threshold = lodErrorThreshold;
+        if (lod > previous) {
+            threshold *= 1.0f - lodHysteresis;
+        } else if (lod == previous) {
+            threshold *= 1.0f + lodHysteresis;
+        }
+
+        if (indexBuffer.lods[lod - 1].error * pixelsPerUnit <= threshold) {
+            selected = lod;
+            break;
+        }
+    }
+
+    if (lodState) {
+        lodState->set(subMesh, selected);
+    }
+
+    return selected;
 }
 
 void Renderer::useShader(AssetID shaderID)
@@ -275,140 +1214,589 @@ void Renderer::useShader(AssetID shaderID)
 
     ShaderProgram *shaderProgram = this->graphicsManager->getShaderProgram(shaderID);
 
-    if (shaderProgram) {
-        this->activeShader = *shaderProgram;
-        glUseProgram(shaderProgram->program);
+    if (shaderProgram && shaderProgram->program) {
+        useShaderProgram(shaderProgram);
     }
 }
 
+void Renderer::useShaderProgram(ShaderProgram *shaderProgram)
+{
+    this->activeShader = shaderProgram;
+    glUseProgram(shaderProgram->program);
+}
+
 void Renderer::setGraphicsManager(GraphicsManager *graphicsManager)
 {
     this->graphicsManager = graphicsManager;
 }
 
+void Renderer::setOcclusionCuller(const OcclusionCuller *occlusionCuller)
+{
+    this->occlusionCuller = occlusionCuller;
+}
+
+GpuProfiler *Renderer::getDrawProfiler() const
+{
+    return (gpuProfiler && gpuProfiler->getDrawZones()) ? gpuProfiler : nullptr;
+}
+
+void Renderer::setGpuProfiler(GpuProfiler *gpuProfiler)
+{
+    this->gpuProfiler = gpuProfiler;
+}
+
 void Renderer::setCameraPosition(glm::vec3 pos)
 {
     this->cameraPosition = pos;
 }
 
-void Renderer::renderModelInstanced(AssetID id, InstanceTransformBuffer transforms)
+void Renderer::renderModelInstanced(AssetID id, const InstanceTransformBuffer &transforms, LodState *lodState)
 {
     assert(graphicsManager);
 
     VertexArrayObject *vao = graphicsManager->getVAO(id);
 
-    GLint vPosPosition = glGetAttribLocation(activeShader.program, "vPos");
-    GLint vNormPosition = glGetAttribLocation(activeShader.program, "vNorm");
-    GLint vTexcoordPosition = glGetAttribLocation(activeShader.program, "vTex");
-    GLint tangentPosition = glGetAttribLocation(activeShader.program, "tangent");
-    GLint biTangentPosition = glGetAttribLocation(activeShader.program, "biTangent");
-    GLint modelPosition = glGetAttribLocation(activeShader.program, "ModelM");
+    // skip models that are still streaming in, and drawing before any shader is ready
+    if (!vao || !activeShader) {
+        return;
+    }
 
-    GLint viewPosition = glGetUniformLocation(activeShader.program, "ViewM");
-    GLint projPosition = glGetUniformLocation(activeShader.program, "ProjectionM");
-    GLint camPosPosition = glGetUniformLocation(activeShader.program, "cameraPosition");
+    GLuint instanceBuffer;
+    GLintptr normalOffset;
+    uint32_t instanceCount = cullInstances(vao, transforms, true, &instanceBuffer, &normalOffset);
+    if (instanceCount == 0) {
+        return;
+    }
 
-    GLint albedoConstantPosition = glGetUniformLocation(activeShader.program, "albedoConstant");
-    GLint roughnessConstantPosition = glGetUniformLocation(activeShader.program, "roughnessConstant");
-    GLint metallicConstantPosition = glGetUniformLocation(activeShader.program, "metallicConstant");
+    // NB: locations are reflected once when the program is linked, see ShaderProgram::createShaderProgram
+    const ShaderLocations &locations = activeShader->locations;
 
-    GLint useAlbedoTexturePosition = glGetUniformLocation(activeShader.program, "useAlbedoTexture");
-    GLint useRoughnessTexturePosition = glGetUniformLocation(activeShader.program, "useRoughnessTexture");
-    GLint useMetallicTexturePosition = glGetUniformLocation(activeShader.program, "useMetallicTexture");
-    GLint useNormalTexturePosition = glGetUniformLocation(activeShader.program, "useNormalTexture");
+    // Bind the vertex array, and attach the instance transform buffer to its instance slot
 
-    GLint albedoTexPosition = glGetUniformLocation(activeShader.program, "albedoTexture");
-    GLint roughnessTexPosition = glGetUniformLocation(activeShader.program, "roughnessTexture");
-    GLint metallicTexPosition = glGetUniformLocation(activeShader.program, "metallicTexture");
-    GLint normalTexPosition = glGetUniformLocation(activeShader.program, "normalTexture");
+    glBindVertexArray(vao->instancedVertexArrays[transforms.format]);
+    glBindVertexBuffer(INSTANCE_BINDING, instanceBuffer, 0, InstanceCompression::getSize(transforms.format));
+    bindInstanceNormals(locations, instanceBuffer, normalOffset);
 
-    // Bind vertex attribute data
+    // Bind uniforms
 
-    glBindBuffer(GL_ARRAY_BUFFER, vao->vertexBuffer);
+    glm::mat4 view = activeViewMatrix;
+    glm::mat4 projection = activePerspectiveMatrix;
 
-    glEnableVertexAttribArray(vPosPosition);
-    glVertexAttribPointer(vPosPosition, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, position));
+    glUniformMatrix4fv(locations.view, 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(locations.projection, 1, GL_FALSE, glm::value_ptr(projection));
 
-    glEnableVertexAttribArray(vNormPosition);
-    glVertexAttribPointer(vNormPosition, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, normal));
+    float pixelsPerUnit = lodPixelsPerUnit(nearestInstanceDepth(view, transforms), transforms.maxScale);
 
-    glEnableVertexAttribArray(vTexcoordPosition);
-    glVertexAttribPointer(vTexcoordPosition, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, uv));
+    glUniform3fv(locations.cameraPosition, 1, glm::value_ptr(cameraPosition));
+    setVertexDecoding(locations, vao);
+    glUniform1i(locations.instanceFormat, transforms.format);
 
-    glEnableVertexAttribArray(tangentPosition);
-    glVertexAttribPointer(tangentPosition, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, tangent));
+    glUniform1i(locations.albedoTexture, 0);
+    glUniform1i(locations.roughnessTexture, 1);
+    glUniform1i(locations.metallicTexture, 2);
+    glUniform1i(locations.normalTexture, 3);
 
-    glEnableVertexAttribArray(biTangentPosition);
-    glVertexAttribPointer(biTangentPosition, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (void *) offsetof(Vertex, biTangent));
+    for (uint32_t i = 0; i < vao->materialIndexBuffers.size(); i++) {
+        if (!subMeshSpheres.visible[i]) {
+            continue;
+        }
 
-    // Bind instance transform buffer to the 4 vectors making up the model matrix
+        const IndexBuffer &indexBuffer = vao->materialIndexBuffers[i];
+        GPUMaterial &material = vao->materials[indexBuffer.materialIndex];
+        LodRange lod = indexBuffer.getLod(selectLod(indexBuffer, i, pixelsPerUnit, lodState));
 
-    glBindBuffer(GL_ARRAY_BUFFER, transforms.buffer);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, material.albedoTexture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, material.roughnessTexture);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, material.metallicTexture);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, material.normalTexture);
 
-    glEnableVertexAttribArray(modelPosition);
-    glVertexAttribPointer(modelPosition, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(glm::vec4), (void *) 0);
+        glUniform3fv(locations.albedoConstant, 1, glm::value_ptr(material.albedo));
+        glUniform1f(locations.roughnessConstant, material.roughness);
+        glUniform1f(locations.metallicConstant, material.metallic);
 
-    glEnableVertexAttribArray(modelPosition + 1);
-    glVertexAttribPointer(modelPosition + 1, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(glm::vec4),
-                          (void *) (1 * sizeof(glm::vec4)));
+        glUniform1i(locations.useAlbedoTexture, (material.albedoTexture == 0) ? 0 : 1);
+        glUniform1i(locations.useRoughnessTexture, (material.roughnessTexture == 0) ? 0 : 1);
+        glUniform1i(locations.useMetallicTexture, (material.metallicTexture == 0) ? 0 : 1);
+        glUniform1i(locations.useNormalTexture, (material.normalTexture == 0) ? 0 : 1);
 
-    glEnableVertexAttribArray(modelPosition + 2);
-    glVertexAttribPointer(modelPosition + 2, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(glm::vec4),
-                          (void *) (2 * sizeof(glm::vec4)));
+        PROFILE_GPU_ZONE(getDrawProfiler(), "instanced draw");
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lod.numIndices, GL_UNSIGNED_INT,
+                                          (void *) (lod.firstIndex * sizeof(uint32_t)),
+                                          instanceCount, vao->baseVertex);
+    }
+}
 
-    glEnableVertexAttribArray(modelPosition + 3);
-    glVertexAttribPointer(modelPosition + 3, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(glm::vec4),
-                          (void *) (3 * sizeof(glm::vec4)));
 
-    glVertexAttribDivisor(modelPosition + 0, 1);
-    glVertexAttribDivisor(modelPosition + 1, 1);
-    glVertexAttribDivisor(modelPosition + 2, 1);
-    glVertexAttribDivisor(modelPosition + 3, 1);
+/**
+ * Hash of the textures a material binds, used to group draws by texture set.
+ */
+static uint32_t hashTextureSet(const GPUMaterial &material)
+{
+    uint64_t h = ((uint64_t) (uint32_t) material.albedoTexture << 32u) ^ (uint32_t) material.roughnessTexture;
+    h ^= (((uint64_t) (uint32_t) material.metallicTexture << 32u) ^ (uint32_t) material.normalTexture) *
+         0x9E3779B97F4A7C15ull;
+    h = (h ^ (h >> 30u)) * 0xBF58476D1CE4E5B9ull;
+    h = (h ^ (h >> 27u)) * 0x94D049BB133111EBull;
+    return (uint32_t) (h ^ (h >> 31u));
+}
 
-    // Bind uniforms
+/**
+ * Whether drawing {a} sets the same material uniforms as drawing {b}.
+ */
+static bool sameMaterialUniforms(const GPUMaterial &a, const GPUMaterial &b)
+{
+    return a.albedo == b.albedo && a.roughness == b.roughness && a.metallic == b.metallic &&
+           (a.albedoTexture == 0) == (b.albedoTexture == 0) &&
+           (a.roughnessTexture == 0) == (b.roughnessTexture == 0) &&
+           (a.metallicTexture == 0) == (b.metallicTexture == 0) &&
+           (a.normalTexture == 0) == (b.normalTexture == 0);
+}
 
-    glm::mat4 view = activeViewMatrix;
-    glm::mat4 projection = activePerspectiveMatrix;
+uint64_t RenderQueue::makeKey(RenderPass pass, GLuint program, const GPUMaterial &material, float depth)
+{
+    // the bit pattern of a non-negative float increases monotonically with its value
+    float clampedDepth = std::max(depth, 0.0f);
+    uint32_t depthBits;
+    memcpy(&depthBits, &clampedDepth, sizeof(depthBits));
 
-    glUniformMatrix4fv(viewPosition, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projPosition, 1, GL_FALSE, glm::value_ptr(projection));
+    uint64_t shaderBits = program & 0x3FFu;
+    uint64_t textureSetBits = hashTextureSet(material) & 0xFFFFFu;
 
-    glUniform3fv(camPosPosition, 1, glm::value_ptr(cameraPosition));
+    if (pass == TRANSPARENT_PASS) {
+        return ((uint64_t) pass << 62u) | ((uint64_t) (~depthBits) << 30u) | (shaderBits << 20u) | textureSetBits;
+    }
 
-    glUniform1i(albedoTexPosition, 0);
-    glUniform1i(roughnessTexPosition, 1);
-    glUniform1i(metallicTexPosition, 2);
-    glUniform1i(normalTexPosition, 3);
+    return ((uint64_t) pass << 62u) | (shaderBits << 52u) | (textureSetBits << 32u) | depthBits;
+}
 
-    for (const auto &indexBuffer: vao->materialIndexBuffers) {
-        GPUMaterial &material = vao->materials[indexBuffer.materialIndex];
+void RenderQueue::sort()
+{
+    if (packets.size() < 2) {
+        return;
+    }
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, material.albedoTexture);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, material.roughnessTexture);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, material.metallicTexture);
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, material.normalTexture);
+    sortBuffer.resize(packets.size());
+    DrawPacket *source = packets.data();
+    DrawPacket *destination = sortBuffer.data();
 
-        glUniform3fv(albedoConstantPosition, 1, glm::value_ptr(material.albedo));
-        glUniform1f(roughnessConstantPosition, material.roughness);
-        glUniform1f(metallicConstantPosition, material.metallic);
+    for (uint32_t shift = 0; shift < 64; shift += 8) {
+        uint32_t offsets[256] = {};
+        for (size_t i = 0; i < packets.size(); i++) {
+            offsets[(source[i].key >> shift) & 0xFFu]++;
+        }
+
+        // all keys have the same digit, the pass would not change the order
+        if (offsets[(source[0].key >> shift) & 0xFFu] == packets.size()) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (uint32_t &bucket : offsets) {
+            uint32_t count = bucket;
+            bucket = offset;
+            offset += count;
+        }
 
-        glUniform1i(useAlbedoTexturePosition, (material.albedoTexture == 0) ? 0 : 1);
-        glUniform1i(useRoughnessTexturePosition, (material.roughnessTexture == 0) ? 0 : 1);
-        glUniform1i(useMetallicTexturePosition, (material.metallicTexture == 0) ? 0 : 1);
-        glUniform1i(useNormalTexturePosition, (material.normalTexture == 0) ? 0 : 1);
+        for (size_t i = 0; i < packets.size(); i++) {
+            destination[offsets[(source[i].key >> shift) & 0xFFu]++] = source[i];
+        }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.indexBuffer);
+        std::swap(source, destination);
+    }
 
-        glDrawElementsInstanced(GL_TRIANGLES, indexBuffer.numIndices, GL_UNSIGNED_INT, nullptr,
-                                transforms.elementCount);
+    if (source != packets.data()) {
+        packets.swap(sortBuffer);
     }
 }
 
+void RenderQueue::clear()
+{
+    packets.clear();
+    transforms.clear();
+    normalMatrices.clear();
+}
+
+void Renderer::submitPackets(AssetID shader, VertexArrayObject *vao, float depth, float pixelsPerUnit,
+                             LodState *lodState, uint32_t transformIndex, GLuint instanceBuffer, uint32_t instanceCount,
+                             InstanceFormat instanceFormat, GLintptr instanceNormalOffset, RenderPass pass)
+{
+    assert(graphicsManager);
+
+    ShaderProgram *shaderProgram = graphicsManager->getShaderProgram(shader);
+
+    // skip shaders that are still streaming in
+    if (!shaderProgram || !shaderProgram->program) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < vao->materialIndexBuffers.size(); i++) {
+        if (!subMeshSpheres.visible[i]) {
+            continue;
+        }
+
+        const GPUMaterial &material = vao->materials[vao->materialIndexBuffers[i].materialIndex];
+
+        DrawPacket packet = {};
+        packet.key = RenderQueue::makeKey(pass, shaderProgram->program, material, depth);
+        packet.shader = shaderProgram;
+        packet.vao = vao;
+        packet.subMesh = i;
+        packet.lod = selectLod(vao->materialIndexBuffers[i], i, pixelsPerUnit, lodState);
+        packet.transformIndex = transformIndex;
+        packet.instanceBuffer = instanceBuffer;
+        packet.instanceCount = instanceCount;
+        packet.instanceFormat = instanceFormat;
+        packet.instanceNormalOffset = instanceNormalOffset;
+        queue.packets.emplace_back(packet);
+    }
+}
+
+void Renderer::submit(AssetID shader, AssetID id, glm::mat4 transform, LodState *lodState, RenderPass pass)
+{
+    assert(graphicsManager);
+
+    // skip models that are still streaming in
+    VertexArrayObject *vao = graphicsManager->getVAO(id);
+    if (!vao || cullSubMeshes(vao, transform) == 0) {
+        return;
+    }
+
+    // distance in front of the camera, which looks down the negative z axis in view space
+    float depth = -(activeViewMatrix * transform[3]).z;
+
+    submitPackets(shader, vao, depth, lodPixelsPerUnit(depth, transformScale(transform)), lodState,
+                  (uint32_t) queue.transforms.size(), 0, 0, MAT4_INSTANCE_FORMAT, 0, pass);
+    queue.transforms.emplace_back(transform);
+    queue.normalMatrices.emplace_back(PackedNormalMatrix::from_transform(transform));
+}
+
+void Renderer::submitInstanced(AssetID shader, AssetID id, const InstanceTransformBuffer &transforms,
+                               LodState *lodState, RenderPass pass)
+{
+    assert(graphicsManager);
+
+    // skip models that are still streaming in
+    VertexArrayObject *vao = graphicsManager->getVAO(id);
+    if (!vao) {
+        return;
+    }
+
+    // NB: queued draws execute at the end of the frame, after the culled instance buffer may have been rewritten
+    GLuint instanceBuffer;
+    GLintptr normalOffset;
+    uint32_t instanceCount = cullInstances(vao, transforms, false, &instanceBuffer, &normalOffset);
+    if (instanceCount == 0) {
+        return;
+    }
+
+    float pixelsPerUnit = lodPixelsPerUnit(nearestInstanceDepth(activeViewMatrix, transforms), transforms.maxScale);
+    submitPackets(shader, vao, 0.0f, pixelsPerUnit, lodState, 0, instanceBuffer, instanceCount, transforms.format,
+                  normalOffset, pass);
+}
+
+/**
+ * Whether {packet} is drawn as part of a multi-draw.
+ */
+static bool drawsIndirect(const DrawPacket &packet)
+{
+    return packet.shader->locations.indirect && !packet.instanceBuffer;
+}
+
+static const GPUMaterial &packetMaterial(const DrawPacket &packet)
+{
+    return packet.vao->materials[packet.vao->materialIndexBuffers[packet.subMesh].materialIndex];
+}
+
+static bool sameTextures(const GPUMaterial &a, const GPUMaterial &b)
+{
+    return a.albedoTexture == b.albedoTexture && a.roughnessTexture == b.roughnessTexture &&
+           a.metallicTexture == b.metallicTexture && a.normalTexture == b.normalTexture;
+}
+
+void Renderer::flush()
+{
+    PROFILE_ZONE("Renderer::flush");
+    PROFILE_GPU_ZONE(gpuProfiler, "flush");
+
+    queue.sort();
+    queueStats = {};
+
+    // draws that are part of a multi-draw get their command and per-draw data up front, in execution order
+    indirectCommands.clear();
+    drawData.clear();
+    for (const auto &packet: queue.packets) {
+        if (!drawsIndirect(packet)) {
+            continue;
+        }
+
+        LodRange lod = packet.vao->materialIndexBuffers[packet.subMesh].getLod(packet.lod);
+        const GPUMaterial &material = packetMaterial(packet);
+
+        DrawElementsIndirectCommand command = {};
+        command.count = lod.numIndices;
+        command.instanceCount = 1;
+        command.firstIndex = lod.firstIndex;
+        command.baseVertex = packet.vao->baseVertex;
+        // NB: the base instance selects the draw ID, see GeometryPool::drawIdBuffer
+        command.baseInstance = (uint32_t) drawData.size();
+        indirectCommands.emplace_back(command);
+
+        GPUDrawData data = {};
+        data.model = queue.transforms[packet.transformIndex];
+        for (uint32_t column = 0; column < 3; column++) {
+            data.normalMatrix[column] = glm::vec4(queue.normalMatrices[packet.transformIndex].columns[column], 0);
+        }
+        data.albedoRoughness = glm::vec4(material.albedo, material.roughness);
+        data.metallic = glm::vec4(material.metallic, 0, 0, 0);
+        data.positionOffset = glm::vec4(packet.vao->positionOffset, 0);
+        data.positionScale = glm::vec4(packet.vao->positionScale, 0);
+        drawData.emplace_back(data);
+    }
+
+    if (!indirectCommands.empty()) {
+        if (!indirectCommandBuffer) {
+            glGenBuffers(1, &indirectCommandBuffer);
+            glGenBuffers(1, &drawDataBuffer);
+        }
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectCommandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, indirectCommands.size() * sizeof(DrawElementsIndirectCommand),
+                     indirectCommands.data(), GL_STREAM_DRAW);
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, drawData.size() * sizeof(GPUDrawData), drawData.data(),
+                     GL_STREAM_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, drawDataBuffer);
+
+        graphicsManager->reserveDrawIds(drawData.size());
+    }
+
+    // state set by the previous draw, the texture units and vertex array are unknown at the start of the frame
+    ShaderProgram *boundShader = nullptr;
+    GLuint boundVertexArray = 0;
+    bool vertexArrayKnown = false;
+    GLint boundTextures[4] = {-1, -1, -1, -1};
+    const GPUMaterial *uploadedMaterial = nullptr;
+    uint32_t uploadedTransform = UINT32_MAX;
+    const VertexArrayObject *decodedVertexArray = nullptr;
+    uint32_t commandIndex = 0;
+
+    // packets are sorted by pass first, so every pass is a single zone
+    static const char *const PASS_ZONES[] = {"opaque pass", "transparent pass"};
+    GpuProfiler *drawProfiler = getDrawProfiler();
+    uint64_t activePass = UINT64_MAX;
+
+    for (size_t i = 0; i < queue.packets.size();) {
+        const DrawPacket &packet = queue.packets[i];
+        const ShaderLocations &locations = packet.shader->locations;
+
+        if (gpuProfiler && packet.key >> 62u != activePass) {
+            if (activePass != UINT64_MAX) {
+                gpuProfiler->endZone();
+            }
+            activePass = packet.key >> 62u;
+            gpuProfiler->beginZone(PASS_ZONES[activePass]);
+        }
+
+        if (packet.shader != boundShader) {
+            glUseProgram(packet.shader->program);
+
+            // uniforms are state of the program, so everything has to be set again
+            glUniformMatrix4fv(locations.view, 1, GL_FALSE, glm::value_ptr(activeViewMatrix));
+            glUniformMatrix4fv(locations.projection, 1, GL_FALSE, glm::value_ptr(activePerspectiveMatrix));
+            glUniform3fv(locations.cameraPosition, 1, glm::value_ptr(cameraPosition));
+
+            glUniform1i(locations.albedoTexture, 0);
+            glUniform1i(locations.roughnessTexture, 1);
+            glUniform1i(locations.metallicTexture, 2);
+            glUniform1i(locations.normalTexture, 3);
+
+            boundShader = packet.shader;
+            uploadedMaterial = nullptr;
+            uploadedTransform = UINT32_MAX;
+            decodedVertexArray = nullptr;
+            queueStats.shaderBinds++;
+        } else {
+            queueStats.shaderBindsAvoided++;
+        }
+
+        GLuint vertexArray = packet.instanceBuffer ? packet.vao->instancedVertexArrays[packet.instanceFormat]
+                                                   : packet.vao->vertexArray;
+        if (!vertexArrayKnown || vertexArray != boundVertexArray) {
+            glBindVertexArray(vertexArray);
+
+            boundVertexArray = vertexArray;
+            vertexArrayKnown = true;
+            queueStats.vertexArrayBinds++;
+        } else {
+            queueStats.vertexArrayBindsAvoided++;
+        }
+
+        LodRange lod = packet.vao->materialIndexBuffers[packet.subMesh].getLod(packet.lod);
+        const GPUMaterial &material = packetMaterial(packet);
+
+        const GLint textures[4] = {material.albedoTexture, material.roughnessTexture,
+                                   material.metallicTexture, material.normalTexture};
+        for (uint32_t unit = 0; unit < 4; unit++) {
+            if (textures[unit] != boundTextures[unit]) {
+                glActiveTexture(GL_TEXTURE0 + unit);
+                glBindTexture(GL_TEXTURE_2D, textures[unit]);
+
+                boundTextures[unit] = textures[unit];
+                queueStats.textureBinds++;
+            } else {
+                queueStats.textureBindsAvoided++;
+            }
+        }
+
+        // NB: indirect shaders read the material constants from the per-draw data, only the texture flags are set
+        if (!uploadedMaterial || !sameMaterialUniforms(material, *uploadedMaterial)) {
+            glUniform3fv(locations.albedoConstant, 1, glm::value_ptr(material.albedo));
+            glUniform1f(locations.roughnessConstant, material.roughness);
+            glUniform1f(locations.metallicConstant, material.metallic);
+
+            glUniform1i(locations.useAlbedoTexture, (material.albedoTexture == 0) ? 0 : 1);
+            glUniform1i(locations.useRoughnessTexture, (material.roughnessTexture == 0) ? 0 : 1);
+            glUniform1i(locations.useMetallicTexture, (material.metallicTexture == 0) ? 0 : 1);
+            glUniform1i(locations.useNormalTexture, (material.normalTexture == 0) ? 0 : 1);
+
+            uploadedMaterial = &material;
+            queueStats.materialUploads++;
+        } else {
+            queueStats.materialUploadsAvoided++;
+        }
+
+        // the position decoding of indirect draws is part of the per-draw data, only the vertex format is used
+        if (packet.vao != decodedVertexArray) {
+            setVertexDecoding(locations, packet.vao);
+            decodedVertexArray = packet.vao;
+        }
+
+        if (drawsIndirect(packet)) {
+            // all following draws with the same shader, vertex format and textures are part of the same multi-draw
+            size_t end = i + 1;
+            while (end < queue.packets.size() && drawsIndirect(queue.packets[end]) &&
+                   queue.packets[end].shader == packet.shader &&
+                   queue.packets[end].vao->vertexFormat == packet.vao->vertexFormat &&
+                   sameTextures(packetMaterial(queue.packets[end]), material)) {
+                end++;
+            }
+
+            uint32_t drawCount = (uint32_t) (end - i);
+            for (uint32_t command = commandIndex; command < commandIndex + drawCount; command++) {
+                queueStats.triangles += indirectCommands[command].count / 3;
+            }
+            {
+                PROFILE_GPU_ZONE(drawProfiler, "multi-draw");
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                            (void *) (commandIndex * sizeof(DrawElementsIndirectCommand)), drawCount,
+                                            0);
+            }
+
+            commandIndex += drawCount;
+            queueStats.draws += drawCount;
+            queueStats.multiDraws++;
+            i = end;
+            continue;
+        }
+
+        void *firstIndex = (void *) (lod.firstIndex * sizeof(uint32_t));
+        if (packet.instanceBuffer) {
+            glBindVertexBuffer(INSTANCE_BINDING, packet.instanceBuffer, 0,
+                               InstanceCompression::getSize(packet.instanceFormat));
+            glUniform1i(locations.instanceFormat, packet.instanceFormat);
+            bindInstanceNormals(locations, packet.instanceBuffer, packet.instanceNormalOffset);
+            {
+                PROFILE_GPU_ZONE(drawProfiler, "instanced draw");
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lod.numIndices, GL_UNSIGNED_INT, firstIndex,
+                                                  packet.instanceCount, packet.vao->baseVertex);
+            }
+            queueStats.triangles += lod.numIndices / 3 * packet.instanceCount;
+        } else {
+            if (packet.transformIndex != uploadedTransform) {
+                const glm::mat4 &transform = queue.transforms[packet.transformIndex];
+                const PackedNormalMatrix &normalMatrix = queue.normalMatrices[packet.transformIndex];
+                glUniformMatrix4fv(locations.model, 1, GL_FALSE, glm::value_ptr(transform));
+                glUniformMatrix3fv(locations.normalMatrix, 1, GL_FALSE, glm::value_ptr(normalMatrix.columns[0]));
+                uploadedTransform = packet.transformIndex;
+            }
+            {
+                PROFILE_GPU_ZONE(drawProfiler, "draw");
+                glDrawElementsBaseVertex(GL_TRIANGLES, lod.numIndices, GL_UNSIGNED_INT, firstIndex,
+                                         packet.vao->baseVertex);
+            }
+            queueStats.triangles += lod.numIndices / 3;
+        }
+
+        queueStats.draws++;
+        i++;
+    }
+
+    if (activePass != UINT64_MAX) {
+        gpuProfiler->endZone();
+    }
+
+    // subsequent immediate draws use the program that is bound now
+    if (boundShader) {
+        activeShader = boundShader;
+    }
+
+    queue.clear();
+}
+
+RenderQueueStats Renderer::getQueueStats() const
+{
+    return queueStats;
+}
+
+CullingStats Renderer::getCullingStats() const
+{
+    return cullingStats;
+}
+
+uint64_t Renderer::getInstanceUploadBytes() const
+{
+    return instanceUploadBytes;
+}
+
+ShaderLocations ShaderLocations::resolve(const ShaderReflection &reflection)
+{
+    ShaderLocations result = {};
+
+    result.indirect = reflection.get_attribute_location("drawID") != -1;
+
+    result.model = reflection.get_uniform_location("ModelM");
+    result.view = reflection.get_uniform_location("ViewM");
+    result.projection = reflection.get_uniform_location("ProjectionM");
+    result.cameraPosition = reflection.get_uniform_location("cameraPosition");
+
+    result.compactVertices = reflection.get_uniform_location("compactVertices");
+    result.positionOffset = reflection.get_uniform_location("positionOffset");
+    result.positionScale = reflection.get_uniform_location("positionScale");
+    result.instanceFormat = reflection.get_uniform_location("instanceFormat");
+    result.instanceUniformScale = reflection.get_uniform_location("instanceUniformScale");
+    result.normalMatrix = reflection.get_uniform_location("NormalM");
+
+    result.albedoConstant = reflection.get_uniform_location("albedoConstant");
+    result.roughnessConstant = reflection.get_uniform_location("roughnessConstant");
+    result.metallicConstant = reflection.get_uniform_location("metallicConstant");
+
+    result.useAlbedoTexture = reflection.get_uniform_location("useAlbedoTexture");
+    result.useRoughnessTexture = reflection.get_uniform_location("useRoughnessTexture");
+    result.useMetallicTexture = reflection.get_uniform_location("useMetallicTexture");
+    result.useNormalTexture = reflection.get_uniform_location("useNormalTexture");
+
+    result.albedoTexture = reflection.get_uniform_location("albedoTexture");
+    result.roughnessTexture = reflection.get_uniform_location("roughnessTexture");
+    result.metallicTexture = reflection.get_uniform_location("metallicTexture");
+    result.normalTexture = reflection.get_uniform_location("normalTexture");
+
+    return result;
+}
 
 bool ShaderProgram::checkShaderCompilation(GLuint shader)
 {
@@ -485,6 +1873,16 @@ ShaderProgram ShaderProgram::createShaderProgram(const char *vertexText, const c
     GLuint program = glCreateProgram();
     glAttachShader(program, vertexShader);
     glAttachShader(program, fragmentShader);
+
+    // match the vertex layout of VertexArrayObject, explicit layout qualifiers in the shader take precedence
+    glBindAttribLocation(program, POSITION_ATTRIBUTE, "vPos");
+    glBindAttribLocation(program, NORMAL_ATTRIBUTE, "vNorm");
+    glBindAttribLocation(program, TEXCOORD_ATTRIBUTE, "vTex");
+    glBindAttribLocation(program, TANGENT_ATTRIBUTE, "tangent");
+    glBindAttribLocation(program, BITANGENT_ATTRIBUTE, "biTangent");
+    glBindAttribLocation(program, INSTANCE_TRANSFORM_ATTRIBUTE, "ModelM");
+    glBindAttribLocation(program, DRAW_ID_ATTRIBUTE, "drawID");
+
     glLinkProgram(program);
 
     if (!checkProgramLinking(program)) {
@@ -499,6 +1897,8 @@ ShaderProgram ShaderProgram::createShaderProgram(const char *vertexText, const c
     result.vertexShader = vertexShader;
     result.fragmentShader = fragmentShader;
     result.program = program;
+    result.reflection = ShaderReflection::reflect(program);
+    result.locations = ShaderLocations::resolve(result.reflection);
 
     return result;
 }
@@ -506,19 +1906,40 @@ ShaderProgram ShaderProgram::createShaderProgram(const char *vertexText, const c
 VertexArrayObject *GraphicsManager::getVAO(AssetID assetId)
 {
     assert(assetId.type == MODEL);
-    return &loadedModels.at(assetId.ID);
+    auto found = loadedModels.find(assetId.ID);
+    return (found == loadedModels.end()) ? nullptr : &found->second;
 }
 
 ShaderProgram *GraphicsManager::getShaderProgram(AssetID assetId)
 {
     assert(assetId.type == SHADER);
-    return &loadedShaders.at(assetId.ID);
+    auto found = loadedShaders.find(assetId.ID);
+    return (found == loadedShaders.end()) ? nullptr : &found->second;
+}
+
+GeometryPool *GraphicsManager::getGeometryPool(VertexFormat format)
+{
+    return &geometryPools[format];
+}
+
+void GraphicsManager::reserveDrawIds(uint32_t count)
+{
+    for (auto &pool : geometryPools) {
+        if (pool.vertexArray) {
+            pool.reserveDrawIds(count);
+        }
+    }
 }
 
 void GraphicsManager::loadModel(Model *model)
 {
+    GeometryPool *pool = &geometryPools[model->vertexFormat];
+    if (!pool->vertexArray) {
+        *pool = GeometryPool::create(model->vertexFormat, 256 * 1024, 1024 * 1024);
+    }
+
     //TODO: robustness
-    VertexArrayObject vao = VertexArrayObject::create(model);
+    VertexArrayObject vao = VertexArrayObject::create(model, pool);
     loadedModels.emplace(model->assetID.ID, vao);
 }
 
@@ -530,3 +1951,57 @@ void GraphicsManager::loadShader(Shader *shader)
     loadedShaders.emplace(shader->assetID.ID, s);
 }
 
+
+void GraphicsManager::setUploadBudget(double milliseconds, uint64_t bytes)
+{
+    this->uploadBudgetMs = milliseconds;
+    this->uploadBudgetBytes = bytes;
+}
+
+uint32_t GraphicsManager::uploadLoadedAssets(AssetManager *assetManager)
+{
+    PROFILE_ZONE("GraphicsManager::uploadLoadedAssets");
+    auto startTime = std::chrono::steady_clock::now();
+
+    uint32_t uploadedCount = 0;
+    uint64_t uploadedBytes = 0;
+    assetManager->drainLoadedAssets([&](const LoadedAsset &asset) {
+        if (uploadedCount > 0) {
+            double elapsedMs = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - startTime).count();
+            if (elapsedMs >= uploadBudgetMs || uploadedBytes + asset.uploadSize > uploadBudgetBytes) {
+                return false;
+            }
+        }
+
+        if (asset.id.type == MODEL) {
+            loadModel(assetManager->getModel(asset.id));
+        } else if (asset.id.type == SHADER) {
+            loadShader(assetManager->getShader(asset.id));
+        }
+
+        uploadedCount++;
+        uploadedBytes += asset.uploadSize;
+        return true;
+    });
+
+    lastUploadedBytes = uploadedBytes;
+    uploadedAssetBytes += uploadedBytes;
+    return uploadedCount;
+}
+
+GraphicsMemoryStats GraphicsManager::getMemoryStats() const
+{
+    GraphicsMemoryStats stats = {};
+    stats.uploadedBytes = lastUploadedBytes;
+    stats.assetBytes = uploadedAssetBytes;
+
+    for (const auto &pool : geometryPools) {
+        if (pool.vertexArray) {
+            stats.geometryPoolBytes += (uint64_t) pool.vertexAllocator.capacity * pool.vertexSize +
+                                       (uint64_t) pool.indexAllocator.capacity * sizeof(uint32_t);
+        }
+    }
+
+    return stats;
+}
@@ -10,6 +10,7 @@
 #include <algorithm>
 #include <cassert>
 #include <unordered_map>
+#include <utility>
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
 
@@ -17,24 +18,332 @@
 #include "GLFW/glfw3.h"
 
 #include "../util/ls_log.hpp"
+#include "../util/frustum.hpp"
+#include "../util/dynamic_bvh.hpp"
+#include "../util/normal_matrix.hpp"
+#include "../opengl/shader_reflection.hpp"
 #include "asset_manager.hpp"
+#include "instance_compression.hpp"
+#include "occlusion_culler.hpp"
+#include "gpu_profiler.hpp"
 
+/**
+ * Attribute locations of the vertex layout baked into every {VertexArrayObject}. Shader attributes are bound to these
+ * locations by name before linking, see {ShaderProgram::createShaderProgram}.
+ */
+enum VertexAttribute {
+    POSITION_ATTRIBUTE = 0,
+    NORMAL_ATTRIBUTE = 1,
+    TEXCOORD_ATTRIBUTE = 2,
+    TANGENT_ATTRIBUTE = 3,
+    BITANGENT_ATTRIBUTE = 4,
+    /** First of the four consecutive locations holding the per-instance transform, see {InstanceFormat}. */
+    INSTANCE_TRANSFORM_ATTRIBUTE = 5,
+    /** Index of the draw within a multi-draw, see {GeometryPool::drawIdBuffer}. */
+    DRAW_ID_ATTRIBUTE = 9,
+    /** First of the three consecutive locations holding the per-instance normal matrix, see {PackedNormalMatrix}. */
+    INSTANCE_NORMAL_ATTRIBUTE = 10
+};
+
+/**
+ * Vertex buffer binding points of a {VertexArrayObject}.
+ */
+enum VertexBufferBinding {
+    VERTEX_BINDING = 0,
+    /** Per-instance transforms, only used by {GeometryPool::instancedVertexArrays}. */
+    INSTANCE_BINDING = 1,
+    DRAW_ID_BINDING = 2,
+    /** Per-instance normal matrices, see {InstanceTransformBuffer::uniformScale}. */
+    INSTANCE_NORMAL_BINDING = 3
+};
+
+/**
+ * Shader storage buffer binding of the per-draw data of indirect draws, see {GPUDrawData}.
+ */
+const GLuint DRAW_DATA_BINDING = 0;
+
+/**
+ * Range of the index buffer of the {GeometryPool} holding one level of detail of a submesh.
+ */
+struct LodRange {
+    uint32_t numIndices;
+    uint32_t firstIndex;
+
+    /**
+     * Object space error of the level, see {MeshLod::error}.
+     */
+    float error;
+};
+
+/**
+ * Range of the index buffer of the {GeometryPool} that is rendered with a single material.
+ */
 struct IndexBuffer {
     int32_t materialIndex;
 
     uint32_t numIndices;
+    uint32_t firstIndex;
+
+    /**
+     * Coarser levels of detail, see {MaterialSubMesh::lods}.
+     */
+    std::vector<LodRange> lods;
+
+    /**
+     * See {MaterialSubMesh::bounds}.
+     */
+    Bounds bounds;
+
+    /**
+     * Range of level {lod}, 0 being full detail.
+     */
+    LodRange getLod(uint32_t lod) const;
+};
+
+/**
+ * Levels of detail last drawn for each submesh of a model by one object or instance batch, from which the hysteresis
+ * of {Renderer::selectLod} is applied. Owned by the caller, as objects sharing a model are at different distances.
+ */
+struct LodState {
+    /**
+     * Level of a submesh that has not been drawn yet, which is selected without hysteresis.
+     */
+    static const uint32_t NONE = UINT32_MAX;
+
+    std::vector<uint32_t> levels;
+
+    uint32_t get(uint32_t subMesh) const;
+
+    void set(uint32_t subMesh, uint32_t level);
+};
+
+/**
+ * Command layout read by {glMultiDrawElementsIndirect}.
+ */
+struct DrawElementsIndirectCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+};
+
+/**
+ * Per-draw data of indirect draws, an array of which is bound to {DRAW_DATA_BINDING} and indexed by draw ID.
+ * Matches the std430 layout of {DrawData} in pbr_indirect.vert.
+ */
+struct GPUDrawData {
+    glm::mat4 model;
+
+    /**
+     * Columns of the {PackedNormalMatrix} of {model}, padded to the std430 layout of a mat3.
+     */
+    glm::vec4 normalMatrix[3];
+    glm::vec4 albedoRoughness;
+    glm::vec4 metallic;
+
+    /**
+     * Decoding of compact vertex positions, see {Model::positionOffset}.
+     */
+    glm::vec4 positionOffset;
+    glm::vec4 positionScale;
+};
+
+/**
+ * First-fit allocator of ranges of elements within a buffer.
+ */
+struct BufferRangeAllocator {
+    uint32_t capacity = 0;
+
+    /**
+     * Unallocated ranges as (first element, element count), sorted and never adjacent.
+     */
+    std::vector<std::pair<uint32_t, uint32_t>> freeRanges;
+
+    /**
+     * Returns false if there is no free range of {count} elements.
+     */
+    bool allocate(uint32_t count, uint32_t *first);
+
+    void free(uint32_t first, uint32_t count);
+
+    /**
+     * Adds the elements [{capacity}, {newCapacity}) to the free ranges.
+     */
+    void grow(uint32_t newCapacity);
+};
+
+/**
+ * Vertex and index buffers shared by all models. Every model occupies a range of both buffers, with indices relative
+ * to its first vertex (the base vertex). As all models use the same vertex arrays, an entire scene can be drawn
+ * with a few {glMultiDrawElementsIndirect} calls.
+ */
+struct GeometryPool {
+    /**
+     * Format of all vertices in the pool, which determines the vertex layout of the vertex arrays.
+     */
+    VertexFormat vertexFormat;
+    uint32_t vertexSize;
+
+    GLuint vertexBuffer;
     GLuint indexBuffer;
+
+    BufferRangeAllocator vertexAllocator;
+    BufferRangeAllocator indexAllocator;
+
+    /**
+     * Vertex arrays with the vertex layout and the index buffer bound, so drawing only requires binding one of them.
+     * The instanced ones read a transform per instance, in the {InstanceFormat} they are indexed by, from the buffer
+     * attached with {glBindVertexBuffer(INSTANCE_BINDING, ...)}.
+     */
+    GLuint vertexArray;
+    GLuint instancedVertexArrays[INSTANCE_FORMAT_COUNT];
+
+    /**
+     * Holds 0, 1, 2, ..., read by the draw ID attribute at the base instance of a draw. Indirect draws set their
+     * base instance to their index in the multi-draw, which makes it available to the vertex shader.
+     */
+    GLuint drawIdBuffer;
+    uint32_t drawIdCapacity;
+
+    static GeometryPool create(VertexFormat vertexFormat, uint32_t vertexCapacity, uint32_t indexCapacity);
+
+    void destroy();
+
+    /**
+     * Allocate a range of {count} elements, growing the buffer if no free range is large enough.
+     * Returns the first element of the range.
+     */
+    uint32_t allocateVertices(uint32_t count);
+
+    uint32_t allocateIndices(uint32_t count);
+
+    void freeVertices(uint32_t first, uint32_t count);
+
+    void freeIndices(uint32_t first, uint32_t count);
+
+    /**
+     * Make sure draw IDs up to {count} are available.
+     */
+    void reserveDrawIds(uint32_t count);
+
+    /**
+     * Attach the current buffers to the vertex arrays.
+     */
+    void attachBuffers();
 };
 
+/**
+ * Range of elements [first, first + count) of a buffer.
+ */
+struct InstanceRange {
+    uint32_t first;
+    uint32_t count;
+};
+
+/**
+ * Instance transforms of an instanced draw, streamed to the GPU. With OpenGL 4.4 the transforms are stored in
+ * {REGION_COUNT} persistently mapped buffers that are written in turn, each guarded by a fence so the CPU never
+ * writes a buffer the GPU is still reading. Otherwise a single buffer is updated with glBufferSubData, orphaning it
+ * when all transforms change.
+ */
 struct InstanceTransformBuffer {
+    static const uint32_t REGION_COUNT = 3;
+
+    /**
+     * The buffer to draw from, one of the {regions}.
+     */
     GLuint buffer;
     uint32_t elementCount;
 
-    static InstanceTransformBuffer create(std::vector<glm::mat4> *transforms);
+    /**
+     * Layout of the transforms in {buffer}, they are converted on upload.
+     */
+    InstanceFormat format;
+
+    /**
+     * Bounds of the instance origins and the largest scale of the transforms, for level of detail selection.
+     */
+    glm::vec3 originMin;
+    glm::vec3 originMax;
+    float maxScale;
+
+    /**
+     * Copy of the transforms in {buffer}, which per-instance culling reads.
+     */
+    std::vector<glm::mat4> transforms;
+
+    /**
+     * Whether all transforms are a rotation times a uniform scale, so the vertex shader can transform normals with
+     * the transform itself. Otherwise a {PackedNormalMatrix} per instance is stored after the transforms, at
+     * {getNormalOffset}. Always set for {QUANTIZED_INSTANCE_FORMAT}.
+     */
+    bool uniformScale;
+
+    bool persistent;
+    uint32_t capacity;
+    GLuint regions[REGION_COUNT];
+    uint8_t *mappedRegions[REGION_COUNT];
+    GLsync fences[REGION_COUNT];
+    uint32_t currentRegion;
+
+    /**
+     * Ranges of {transforms} which changed since each region was last written.
+     */
+    std::vector<InstanceRange> dirtyRanges[REGION_COUNT];
+    bool pendingUpdate;
+
+    /**
+     * Converted transforms and normal matrices, staged for glBufferSubData when the buffers are not mapped.
+     */
+    std::vector<uint8_t> encodedTransforms;
+    std::vector<PackedNormalMatrix> encodedNormals;
+
+    /**
+     * Bytes written to instance buffers since the last {takeUploadedBytes}, of all instance buffers.
+     */
+    static uint64_t uploadedBytes;
+
+    static InstanceTransformBuffer create(std::vector<glm::mat4> *transforms,
+                                          InstanceFormat format = MAT4_INSTANCE_FORMAT);
 
     void destroy();
 
+    /**
+     * Grows the buffers to hold at least {count} transforms, by at least half their capacity.
+     */
+    void reserve(uint32_t count);
+
+    /**
+     * Replaces all transforms, the number of transforms may change. Commits immediately.
+     */
     void updateData(std::vector<glm::mat4> *transforms);
+
+    /**
+     * Replaces transforms [first, first + count). Only the changed ranges are written by the next {commit}, and
+     * draws use the new transforms after it. The instance bounds only grow, until the next {updateData}.
+     */
+    void updateRange(uint32_t first, const glm::mat4 *newTransforms, uint32_t count);
+
+    /**
+     * Writes the changed ranges to the next region and draws from it, at most once per frame for the fences to
+     * rarely wait. Does nothing if nothing changed since the last commit.
+     */
+    void commit();
+
+    uint32_t getRegionCount() const;
+
+    /**
+     * Size in bytes of each region for {capacity} transforms and their normal matrices.
+     */
+    GLsizeiptr getBufferSize() const;
+
+    /**
+     * Offset in bytes of the normal matrices in {buffer}, 0 if {uniformScale} is set.
+     */
+    GLintptr getNormalOffset() const;
+
+    static uint64_t takeUploadedBytes();
 };
 
 struct GPUMaterial {
@@ -52,15 +361,90 @@ struct GPUMaterial {
  * Holds a vertex array object on the gpu.
  */
 struct VertexArrayObject {
+    /**
+     * The vertex arrays of the {GeometryPool} the model is stored in, which has the format of the model.
+     */
+    GLuint vertexArray;
+    GLuint instancedVertexArrays[INSTANCE_FORMAT_COUNT];
+
+    VertexFormat vertexFormat;
+    glm::vec3 positionOffset;
+    glm::vec3 positionScale;
+
+    /**
+     * See {Model::bounds}.
+     */
+    Bounds bounds;
+
+    /**
+     * Range of the vertex buffer of the geometry pool.
+     */
     uint32_t numVertices;
-    GLuint vertexBuffer;
+    int32_t baseVertex;
+
+    /**
+     * Range of the index buffer of the geometry pool, holding the indices of all submeshes.
+     */
+    uint32_t numIndices;
+    uint32_t firstIndex;
 
     std::vector<IndexBuffer> materialIndexBuffers;
     std::vector<GPUMaterial> materials;
 
-    void unload();
+    void unload(GeometryPool *pool);
+
+    static VertexArrayObject create(Model *model, GeometryPool *pool);
+};
+
+/**
+ * Locations of the uniforms set by {Renderer}, -1 for those the program does not use. Attribute locations are fixed,
+ * see {VertexAttribute}.
+ */
+struct ShaderLocations {
+    /**
+     * Whether the program reads its model matrix and material constants by draw ID (see {GPUDrawData}), so that
+     * it can be used for multi-draws.
+     */
+    bool indirect;
+
+    GLint model;
+    GLint view;
+    GLint projection;
+    GLint cameraPosition;
+
+    /**
+     * Vertex decoding, see {CompactVertex}.
+     */
+    GLint compactVertices;
+    GLint positionOffset;
+    GLint positionScale;
+
+    /**
+     * Instance decoding, see {InstanceFormat}.
+     */
+    GLint instanceFormat;
+    GLint instanceUniformScale;
+
+    /**
+     * Normal matrix of {model}, see {PackedNormalMatrix}.
+     */
+    GLint normalMatrix;
+
+    GLint albedoConstant;
+    GLint roughnessConstant;
+    GLint metallicConstant;
+
+    GLint useAlbedoTexture;
+    GLint useRoughnessTexture;
+    GLint useMetallicTexture;
+    GLint useNormalTexture;
 
-    static VertexArrayObject create(Model *model);
+    GLint albedoTexture;
+    GLint roughnessTexture;
+    GLint metallicTexture;
+    GLint normalTexture;
+
+    static ShaderLocations resolve(const ShaderReflection &reflection);
 };
 
 /**
@@ -71,6 +455,12 @@ struct ShaderProgram {
     GLuint fragmentShader;
     GLuint program;
 
+    /**
+     * Reflected when the program is linked, so drawing does not need to look up locations by name.
+     */
+    ShaderReflection reflection;
+    ShaderLocations locations;
+
     static bool checkShaderCompilation(GLuint shader);
 
     static bool checkProgramLinking(GLuint program);
@@ -78,6 +468,26 @@ struct ShaderProgram {
     static ShaderProgram createShaderProgram(const char *vertexText, const char *fragmentText);
 };
 
+/**
+ * GPU memory counters of {GraphicsManager}.
+ */
+struct GraphicsMemoryStats {
+    /**
+     * Bytes uploaded by the last {GraphicsManager::uploadLoadedAssets}, see {LoadedAsset::uploadSize}.
+     */
+    uint64_t uploadedBytes;
+
+    /**
+     * Bytes of all assets uploaded by {GraphicsManager::uploadLoadedAssets}, geometry and textures.
+     */
+    uint64_t assetBytes;
+
+    /**
+     * Allocated size of the vertex and index buffers of the geometry pools, including their free ranges.
+     */
+    uint64_t geometryPoolBytes;
+};
+
 /**
  * Top level manager for graphics. Keeps track of loaded assets etc...
  */
@@ -86,14 +496,211 @@ private:
     std::unordered_map<uint64_t, VertexArrayObject> loadedModels;
     std::unordered_map<uint64_t, ShaderProgram> loadedShaders;
 
+    /**
+     * One per vertex format, created when the first model with that format is loaded.
+     */
+    GeometryPool geometryPools[VERTEX_FORMAT_COUNT] = {};
+
+    /**
+     * Per-frame budget of {uploadLoadedAssets}.
+     */
+    double uploadBudgetMs = 2.0;
+    uint64_t uploadBudgetBytes = 32 * 1024 * 1024;
+
+    uint64_t lastUploadedBytes = 0;
+    uint64_t uploadedAssetBytes = 0;
+
 public:
+    /**
+     * Returns nullptr if the model has not been uploaded (yet).
+     */
     VertexArrayObject *getVAO(AssetID assetId);
 
+    /**
+     * Returns nullptr if the shader has not been compiled (yet).
+     */
     ShaderProgram *getShaderProgram(AssetID assetId);
 
+    GeometryPool *getGeometryPool(VertexFormat format);
+
+    /**
+     * Make sure draw IDs up to {count} are available in all geometry pools.
+     */
+    void reserveDrawIds(uint32_t count);
+
     void loadModel(Model *model);
 
     void loadShader(Shader *shader);
+
+    /**
+     * Limits the time and the number of bytes {uploadLoadedAssets} spends per call.
+     */
+    void setUploadBudget(double milliseconds, uint64_t bytes);
+
+    /**
+     * Uploads assets that were loaded in the background by {AssetManager::loadObjAsync} and
+     * {AssetManager::loadShaderAsync}, until the upload budget is used up. Call once per frame on the GL thread.
+     * At least one asset is uploaded per call, so assets larger than the budget still get uploaded.
+     * Returns the number of uploaded assets.
+     */
+    uint32_t uploadLoadedAssets(AssetManager *assetManager);
+
+    GraphicsMemoryStats getMemoryStats() const;
+};
+
+/**
+ * Render pass of a draw, the most significant part of its draw key. Passes are executed in order.
+ */
+enum RenderPass {
+    /** Sorted by shader, then texture set, then front-to-back. */
+    OPAQUE_PASS = 0,
+    /** Sorted back-to-front, then by shader and texture set. */
+    TRANSPARENT_PASS = 1
+};
+
+/**
+ * A single submesh draw in a {RenderQueue}.
+ */
+struct DrawPacket {
+    /**
+     * Packed sort key, see {RenderQueue::makeKey}.
+     */
+    uint64_t key;
+
+    ShaderProgram *shader;
+    const VertexArrayObject *vao;
+
+    /**
+     * Index into {VertexArrayObject::materialIndexBuffers}.
+     */
+    uint32_t subMesh;
+
+    /**
+     * Index into {RenderQueue::transforms}, unused for instanced draws.
+     */
+    uint32_t transformIndex;
+
+    /**
+     * Level of detail of the submesh, selected at submission.
+     */
+    uint32_t lod;
+
+    /**
+     * Buffer with one transform per instance, 0 for non-instanced draws.
+     */
+    GLuint instanceBuffer;
+    uint32_t instanceCount;
+    InstanceFormat instanceFormat;
+
+    /**
+     * Offset of the per-instance normal matrices in {instanceBuffer}, 0 if the instances have a uniform scale.
+     */
+    GLintptr instanceNormalOffset;
+};
+
+/**
+ * Per-frame counters of {Renderer::flush}. A bind or upload is 'avoided' if the state it would set is already set.
+ */
+struct RenderQueueStats {
+    uint32_t draws;
+
+    /**
+     * Triangles drawn, of the selected levels of detail.
+     */
+    uint32_t triangles;
+
+    /**
+     * Number of {glMultiDrawElementsIndirect} calls, which together issued some of the {draws}.
+     */
+    uint32_t multiDraws;
+
+    uint32_t shaderBinds;
+    uint32_t shaderBindsAvoided;
+
+    uint32_t vertexArrayBinds;
+    uint32_t vertexArrayBindsAvoided;
+
+    uint32_t textureBinds;
+    uint32_t textureBindsAvoided;
+
+    uint32_t materialUploads;
+    uint32_t materialUploadsAvoided;
+};
+
+/**
+ * Per-frame counters of view frustum culling. Submeshes of instanced draws count once, not per instance.
+ */
+struct CullingStats {
+    uint32_t visible;
+    uint32_t culled;
+
+    uint32_t instancesVisible;
+    uint32_t instancesCulled;
+
+    /**
+     * Objects of the bounding volume hierarchies culled with {Renderer::cullScene}.
+     */
+    uint32_t objectsVisible;
+    uint32_t objectsCulled;
+
+    /**
+     * Draws inside the frustum but hidden behind occluders, see {Renderer::setOcclusionCuller}. Their submeshes are
+     * also counted as culled.
+     */
+    uint32_t occluded;
+};
+
+/**
+ * Bounding spheres in structure of arrays layout, tested against a frustum in a single batch.
+ */
+struct SphereBatch {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> radius;
+
+    /**
+     * Result of the last {test}, one entry per sphere.
+     */
+    std::vector<uint8_t> visible;
+
+    void clear();
+
+    void add(glm::vec3 center, float sphereRadius);
+
+    /**
+     * Tests all spheres with {Frustum::test_spheres}. Returns the number of visible spheres.
+     */
+    uint32_t test(const Frustum &frustum);
+};
+
+/**
+ * Draws collected during a frame, which are sorted by their keys before execution so that draws sharing state are
+ * executed consecutively.
+ */
+struct RenderQueue {
+    std::vector<DrawPacket> packets;
+    std::vector<glm::mat4> transforms;
+    std::vector<PackedNormalMatrix> normalMatrices;
+
+    /**
+     * Scratch buffer of {sort}.
+     */
+    std::vector<DrawPacket> sortBuffer;
+
+    /**
+     * Builds a draw key. Opaque keys are laid out as pass (2 bits), shader (10), texture set (20), view depth (32);
+     * transparent keys as pass (2), inverted view depth (32), shader (10), texture set (20). The shader and texture
+     * set fields are hashes, a collision only makes the sort group less state together.
+     */
+    static uint64_t makeKey(RenderPass pass, GLuint program, const GPUMaterial &material, float depth);
+
+    /**
+     * Sorts {packets} by key with an LSD radix sort, skipping the digits which are equal for all keys.
+     */
+    void sort();
+
+    void clear();
 };
 
 /**
@@ -103,12 +710,134 @@ struct Renderer {
 private:
     GraphicsManager *graphicsManager = nullptr;
 
-    ShaderProgram activeShader;
+    /**
+     * Optional, see {setOcclusionCuller}.
+     */
+    const OcclusionCuller *occlusionCuller = nullptr;
+
+    /**
+     * Optional, see {setGpuProfiler}.
+     */
+    GpuProfiler *gpuProfiler = nullptr;
+
+    /**
+     * Points into the shaders of {graphicsManager}, nullptr until a shader is used.
+     */
+    ShaderProgram *activeShader = nullptr;
 
     glm::vec3 cameraPosition;
     glm::mat4 activeViewMatrix;
     glm::mat4 activePerspectiveMatrix;
 
+    uint32_t viewportHeight = 1;
+
+    /**
+     * Of the active view and perspective matrices, in world space.
+     */
+    Frustum frustum;
+
+    /**
+     * Visibility of the submeshes of the model being drawn, see {cullSubMeshes}.
+     */
+    SphereBatch subMeshSpheres;
+    CullingStats cullingStats = {};
+
+    /**
+     * Bytes written to instance buffers during the previous frame.
+     */
+    uint64_t instanceUploadBytes = 0;
+
+    /**
+     * Level of detail selection, see {setLodSelection}.
+     */
+    float lodErrorThreshold = 1.0f;
+    float lodHysteresis = 0.25f;
+
+    /**
+     * See {setRespecifyVertexLayout}, the vertex array is created when it is first set.
+     */
+    bool respecifyVertexLayout = false;
+    GLuint respecifiedVertexArray = 0;
+
+    /**
+     * Draws submitted since the last {flush}.
+     */
+    RenderQueue queue;
+    RenderQueueStats queueStats = {};
+
+    /**
+     * Commands and per-draw data of the packets drawn with multi-draws, uploaded once per {flush}.
+     */
+    std::vector<DrawElementsIndirectCommand> indirectCommands;
+    std::vector<GPUDrawData> drawData;
+    GLuint indirectCommandBuffer = 0;
+    GLuint drawDataBuffer = 0;
+
+    /**
+     * Visible transforms of the last instanced draw, written by {compactVisibleInstances}. The buffer is orphaned on
+     * every write, so it can be reused while the previous draw is still executing.
+     */
+    GLuint culledInstanceBuffer = 0;
+    GLsizeiptr culledInstanceBufferSize = 0;
+
+    /**
+     * Per-instance culling of {compactVisibleInstances}, which keeps its scratch buffers between draws.
+     */
+    InstanceCuller instanceCuller;
+
+    /**
+     * Adds a packet to {queue} for every submesh of {vao} that {cullSubMeshes} or {cullInstances} found visible.
+     * {pixelsPerUnit} and {lodState} are passed on to {selectLod}.
+     */
+    void submitPackets(AssetID shader, VertexArrayObject *vao, float depth, float pixelsPerUnit,
+                       LodState *lodState, uint32_t transformIndex, GLuint instanceBuffer, uint32_t instanceCount,
+                       InstanceFormat instanceFormat, GLintptr instanceNormalOffset, RenderPass pass);
+
+    /**
+     * Tests the submeshes of {vao} drawn with {transform} against the view frustum. The model sphere is tested
+     * first, then the model box against the occlusion culler if set, and the submesh spheres are only tested as a
+     * batch if both pass. Leaves the result in
+     * {subMeshSpheres.visible}, updates {cullingStats} and returns the number of visible submeshes.
+     */
+    uint32_t cullSubMeshes(const VertexArrayObject *vao, const glm::mat4 &transform);
+
+    /**
+     * Like {cullSubMeshes}, but tests a sphere around all instances of {transforms} for all submeshes at once. If
+     * that sphere is only partially visible and {compact} is set, the instances are culled one by one with
+     * {compactVisibleInstances}. Returns the number of visible instances and sets {instanceBuffer} to the buffer to
+     * draw them from, with the normal matrices at {normalOffset} (see {InstanceTransformBuffer::getNormalOffset}).
+     */
+    uint32_t cullInstances(const VertexArrayObject *vao, const InstanceTransformBuffer &transforms, bool compact,
+                           GLuint *instanceBuffer, GLintptr *normalOffset);
+
+    /**
+     * Tests every instance of {transforms} against the view frustum, in parallel chunks on the thread pool, and
+     * writes the visible transforms consecutively to {culledInstanceBuffer}, followed by their normal matrices at
+     * {normalOffset} unless the transforms have a uniform scale. Returns the number of visible instances.
+     */
+    uint32_t compactVisibleInstances(const VertexArrayObject *vao, const InstanceTransformBuffer &transforms,
+                                     GLintptr *normalOffset);
+
+    /**
+     * Size in pixels of an object space unit of a model at view depth {depth} with scale {scale}, using the active
+     * perspective matrix.
+     */
+    float lodPixelsPerUnit(float depth, float scale) const;
+
+    /**
+     * The coarsest level of detail of {indexBuffer} whose error, projected with {pixelsPerUnit}, is within the
+     * error threshold. A level coarser than the previously selected one must be within the threshold reduced by
+     * the hysteresis, while the previous level is kept until it exceeds the threshold increased by it. The previous
+     * level of submesh {subMesh} is read from and the selected one written to {lodState}, if set.
+     */
+    uint32_t selectLod(const IndexBuffer &indexBuffer, uint32_t subMesh, float pixelsPerUnit,
+                       LodState *lodState) const;
+
+    /**
+     * {gpuProfiler} if it times every draw call, nullptr otherwise.
+     */
+    GpuProfiler *getDrawProfiler() const;
+
 public:
     Renderer();
 
@@ -120,13 +849,100 @@ public:
 
     void setPerspective(glm::mat4 perspectiveMatrix);
 
-    void useShader(AssetID id);
+    /**
+     * Height of the framebuffer drawn to, which the screen space error of level of detail selection is measured in.
+     */
+    void setViewportHeight(uint32_t height);
 
-    void renderModel(AssetID id, glm::mat4 transform);
+    /**
+     * Draw the coarsest level of detail of which the projected error is at most {errorThreshold} pixels, with
+     * {hysteresis} as a fraction of the threshold to avoid switching levels back and forth.
+     */
+    void setLodSelection(float errorThreshold, float hysteresis);
 
-    void renderModelInstanced(AssetID id, InstanceTransformBuffer transforms);
+    /**
+     * Makes {renderModel} specify the vertex attributes and buffers for every draw on a single vertex array, as draws
+     * did before the layouts were baked into the vertex arrays of the geometry pools. Only to measure the difference,
+     * see --benchmark in main.cpp.
+     */
+    void setRespecifyVertexLayout(bool respecify);
+
+    void useShader(AssetID id);
+
+    /**
+     * Binds {shaderProgram}, which need not be loaded by the graphics manager, like the shader of {Hud}. Drawing
+     * code outside the renderer binds its programs through here, so the renderer knows which program is bound.
+     */
+    void useShaderProgram(ShaderProgram *shaderProgram);
+
+    /**
+     * Draws model {id}. The levels of detail of the previous frame are kept in {lodState}, without it every level is
+     * selected without hysteresis.
+     */
+    void renderModel(AssetID id, glm::mat4 transform, LodState *lodState = nullptr);
+
+    /**
+     * Draws an instance of model {id} for every transform in {transforms} that is in the view frustum, see
+     * {renderModel}.
+     */
+    void renderModelInstanced(AssetID id, const InstanceTransformBuffer &transforms, LodState *lodState = nullptr);
+
+    /**
+     * Queues drawing model {id} with {shader}. Queued draws are executed by {flush}, not in submission order.
+     * The view matrix must be set before submitting, it is used to sort by depth.
+     */
+    void submit(AssetID shader, AssetID id, glm::mat4 transform, LodState *lodState = nullptr,
+                RenderPass pass = OPAQUE_PASS);
+
+    /**
+     * Queues drawing an instance of model {id} for every transform in {transforms}, see {submit}. The instances
+     * span a range of depths, so instanced draws are sorted as if they were at the camera.
+     */
+    void submitInstanced(AssetID shader, AssetID id, const InstanceTransformBuffer &transforms,
+                         LodState *lodState = nullptr, RenderPass pass = OPAQUE_PASS);
+
+    /**
+     * Replaces {visible} with the user data of the objects of {bvh} in the view frustum, to submit only those. The
+     * hierarchy is culled top-down, so the cost scales with the visible part of the scene rather than its size.
+     */
+    uint32_t cullScene(const DynamicBVH &bvh, std::vector<uint32_t> *visible);
+
+    /**
+     * Sorts and executes all queued draws, skipping binds and uniform uploads of state that is already set.
+     * Consecutive non-instanced draws with the same indirect shader and textures are issued as a single
+     * multi-draw.
+     */
+    void flush();
+
+    /**
+     * Counters of the last {flush}.
+     */
+    RenderQueueStats getQueueStats() const;
+
+    /**
+     * Counters of the current frame, which are reset by {clearScreen}.
+     */
+    CullingStats getCullingStats() const;
+
+    /**
+     * Bytes written to instance buffers, including the culled instance buffer, between the last two calls to
+     * {clearScreen}.
+     */
+    uint64_t getInstanceUploadBytes() const;
 
     void setGraphicsManager(GraphicsManager *graphicsManager);
+
+    /**
+     * Skips non-instanced draws of which the model box is hidden behind the occluders of {occlusionCuller}, or none
+     * if nullptr. The culler must be rasterized with the view and perspective matrices of the frame first.
+     */
+    void setOcclusionCuller(const OcclusionCuller *occlusionCuller);
+
+    /**
+     * Times the clear and every pass of {flush} with {gpuProfiler}, and every draw call if it has draw zones
+     * enabled, or nothing if nullptr.
+     */
+    void setGpuProfiler(GpuProfiler *gpuProfiler);
 };
 
 #endif //GAME_GRAPHICS_HPP
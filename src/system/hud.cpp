@@ -0,0 +1,440 @@
+//
+// Created by agent on 17-10-2026.
+//
+
+#include "hud.hpp"
+
+#include <cstdio>
+#include <cstdarg>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+#include "../util/ls_log.hpp"
+#include "../util/profiler.hpp"
+
+static const char *const HUD_TITLE = "Performance (F1)";
+
+static const float FONT_SIZE = 13.f;
+static const float ROW_HEIGHT = 14.f;
+static const float CHART_HEIGHT = 60.f;
+static const float HUD_WIDTH = 300.f;
+
+/**
+ * Weight of the last frame in the smoothed zone times.
+ */
+static const double TIMING_SMOOTHING = .1;
+
+/**
+ * Zones deeper than this are not shown, so the draw zones of a capture do not flood the overlay.
+ */
+static const uint32_t MAX_ZONE_DEPTH = 1;
+
+static const char *const HUD_VERTEX_SHADER = R"(#version 430 core
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 uv;
+layout(location = 2) in vec4 color;
+
+uniform mat4 projection;
+
+out vec2 fragmentUv;
+out vec4 fragmentColor;
+
+void main()
+{
+    fragmentUv = uv;
+    fragmentColor = color;
+    gl_Position = projection * vec4(position, 0, 1);
+}
+)";
+
+static const char *const HUD_FRAGMENT_SHADER = R"(#version 430 core
+in vec2 fragmentUv;
+in vec4 fragmentColor;
+
+uniform sampler2D fontTexture;
+
+out vec4 outColor;
+
+void main()
+{
+    outColor = fragmentColor * texture(fontTexture, fragmentUv);
+}
+)";
+
+/**
+ * Vertex layout Nuklear converts the overlay to.
+ */
+struct HudVertex {
+    float position[2];
+    float uv[2];
+    nk_byte color[4];
+};
+
+Hud::Hud(GpuProfiler *gpuProfiler) : gpuProfiler(gpuProfiler)
+{
+    // the default font is baked into a texture, which is also used for untextured shapes through {nullTexture}
+    nk_font_atlas_init_default(&atlas);
+    nk_font_atlas_begin(&atlas);
+    struct nk_font *font = nk_font_atlas_add_default(&atlas, FONT_SIZE, nullptr);
+
+    int atlasWidth;
+    int atlasHeight;
+    const void *image = nk_font_atlas_bake(&atlas, &atlasWidth, &atlasHeight, NK_FONT_ATLAS_RGBA32);
+
+    glGenTextures(1, &fontTexture);
+    glBindTexture(GL_TEXTURE_2D, fontTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasWidth, atlasHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+    nk_font_atlas_end(&atlas, nk_handle_id((int) fontTexture), &nullTexture);
+
+    nk_init_default(&context, &font->handle);
+    nk_buffer_init_default(&commands);
+    context.style.window.fixed_background = nk_style_item_color(nk_rgba(30, 30, 30, 200));
+
+    static const struct nk_draw_vertex_layout_element VERTEX_LAYOUT[] = {
+            {NK_VERTEX_POSITION, NK_FORMAT_FLOAT, offsetof(HudVertex, position)},
+            {NK_VERTEX_TEXCOORD, NK_FORMAT_FLOAT, offsetof(HudVertex, uv)},
+            {NK_VERTEX_COLOR, NK_FORMAT_R8G8B8A8, offsetof(HudVertex, color)},
+            {NK_VERTEX_LAYOUT_END}
+    };
+
+    memset(&convertConfig, 0, sizeof(convertConfig));
+    convertConfig.vertex_layout = VERTEX_LAYOUT;
+    convertConfig.vertex_size = sizeof(HudVertex);
+    convertConfig.vertex_alignment = alignof(HudVertex);
+    convertConfig.tex_null = nullTexture;
+    convertConfig.circle_segment_count = 12;
+    convertConfig.curve_segment_count = 12;
+    convertConfig.arc_segment_count = 12;
+    convertConfig.global_alpha = 1.f;
+    // NB: anti-aliased shapes cost more vertices than everything else, the overlay only has rectangles
+    convertConfig.shape_AA = NK_ANTI_ALIASING_OFF;
+    convertConfig.line_AA = NK_ANTI_ALIASING_ON;
+
+    shader = ShaderProgram::createShaderProgram(HUD_VERTEX_SHADER, HUD_FRAGMENT_SHADER);
+    if (!shader.program) {
+        ls_log::log(LOG_ERROR, "could not create the shader of the performance overlay\n");
+        return;
+    }
+    projectionLocation = glGetUniformLocation(shader.program, "projection");
+
+    glGenVertexArrays(1, &vertexArray);
+    glGenBuffers(1, &vertexBuffer);
+    glGenBuffers(1, &indexBuffer);
+
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, MAX_VERTEX_BYTES, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, MAX_INDEX_BYTES, nullptr, GL_STREAM_DRAW);
+
+    // same separate attribute format and buffer binding as the vertex arrays of GeometryPool
+    glBindVertexBuffer(VERTEX_BINDING, vertexBuffer, 0, sizeof(HudVertex));
+    glEnableVertexAttribArray(0);
+    glVertexAttribFormat(0, 2, GL_FLOAT, GL_FALSE, offsetof(HudVertex, position));
+    glVertexAttribBinding(0, VERTEX_BINDING);
+    glEnableVertexAttribArray(1);
+    glVertexAttribFormat(1, 2, GL_FLOAT, GL_FALSE, offsetof(HudVertex, uv));
+    glVertexAttribBinding(1, VERTEX_BINDING);
+    glEnableVertexAttribArray(2);
+    glVertexAttribFormat(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(HudVertex, color));
+    glVertexAttribBinding(2, VERTEX_BINDING);
+    glBindVertexArray(0);
+
+    sortedFrameTimes.reserve(FRAME_HISTORY);
+    lastFrameStart = std::chrono::steady_clock::now();
+}
+
+Hud::~Hud()
+{
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteTextures(1, &fontTexture);
+    if (shader.program) {
+        glDeleteProgram(shader.program);
+        glDeleteShader(shader.vertexShader);
+        glDeleteShader(shader.fragmentShader);
+    }
+
+    nk_buffer_free(&commands);
+    nk_free(&context);
+    nk_font_atlas_clear(&atlas);
+}
+
+void Hud::setVisible(bool visible)
+{
+    this->visible = visible;
+
+    // the profilers stay enabled while capturing, see {Profiler::start_capture}
+    bool profiling = visible || Profiler::get_instance()->is_capturing();
+    Profiler::get_instance()->set_enabled(profiling);
+    if (gpuProfiler) {
+        gpuProfiler->setEnabled(profiling);
+    }
+
+    cpuTimings.clear();
+    gpuTimings.clear();
+}
+
+bool Hud::isVisible() const
+{
+    return visible;
+}
+
+void Hud::beginFrame()
+{
+    auto now = std::chrono::steady_clock::now();
+    frameTimes[nextFrameTime] = std::chrono::duration<float, std::milli>(now - lastFrameStart).count();
+    nextFrameTime = (nextFrameTime + 1) % FRAME_HISTORY;
+    frameTimeCount = std::min(frameTimeCount + 1, FRAME_HISTORY);
+    lastFrameStart = now;
+}
+
+void Hud::addTiming(std::vector<HudTiming> *timings, const char *name, uint32_t depth, double milliseconds,
+                    uint64_t start)
+{
+    for (auto &timing : *timings) {
+        if (timing.depth == depth && strcmp(timing.name, name) == 0) {
+            // zones may be recorded several times per frame
+            timing.frameMilliseconds = timing.recorded ? timing.frameMilliseconds + milliseconds : milliseconds;
+            timing.frameStart = timing.recorded ? std::min(timing.frameStart, start) : start;
+            timing.recorded = true;
+            return;
+        }
+    }
+
+    timings->push_back({name, depth, milliseconds, milliseconds, start, true});
+}
+
+void Hud::smoothTimings(std::vector<HudTiming> *timings)
+{
+    timings->erase(std::remove_if(timings->begin(), timings->end(), [](const HudTiming &timing) {
+        return !timing.recorded;
+    }), timings->end());
+
+    for (auto &timing : *timings) {
+        timing.milliseconds += (timing.frameMilliseconds - timing.milliseconds) * TIMING_SMOOTHING;
+        timing.recorded = false;
+    }
+
+    // NB: a parent starts before its children, so this lists every zone above the zones it contains
+    std::stable_sort(timings->begin(), timings->end(), [](const HudTiming &a, const HudTiming &b) {
+        return a.frameStart < b.frameStart;
+    });
+}
+
+void Hud::updateTimings()
+{
+    Profiler *profiler = Profiler::get_instance();
+    uint32_t mainTrack = profiler->get_thread_track()->id;
+    for (const auto &event : profiler->get_frame_events()) {
+        if (event.track == mainTrack && event.depth <= MAX_ZONE_DEPTH) {
+            addTiming(&cpuTimings, event.name, event.depth, (double) (event.end - event.start) / 1e6, event.start);
+        }
+    }
+    smoothTimings(&cpuTimings);
+
+    if (gpuProfiler) {
+        const std::vector<GpuZoneResult> &zones = gpuProfiler->getFrameZones();
+        for (uint32_t i = 0; i < zones.size(); i++) {
+            if (zones[i].depth <= MAX_ZONE_DEPTH) {
+                addTiming(&gpuTimings, zones[i].name, zones[i].depth, zones[i].milliseconds, i);
+            }
+        }
+        smoothTimings(&gpuTimings);
+    }
+}
+
+/**
+ * Adds a row of {name} and the value formatted from {format}, aligned to the right.
+ */
+static void valueRow(struct nk_context *context, const char *name, const char *format, ...)
+{
+    char value[64];
+    va_list arguments;
+    va_start(arguments, format);
+    vsnprintf(value, sizeof(value), format, arguments);
+    va_end(arguments);
+
+    nk_layout_row_dynamic(context, ROW_HEIGHT, 2);
+    nk_label(context, name, NK_TEXT_LEFT);
+    nk_label(context, value, NK_TEXT_RIGHT);
+}
+
+/**
+ * Adds a row for every timing, indented by depth.
+ */
+static void timingRows(struct nk_context *context, const std::vector<HudTiming> &timings)
+{
+    char name[64];
+    for (const auto &timing : timings) {
+        snprintf(name, sizeof(name), "%*s%s", (int) timing.depth * 2, "", timing.name);
+        valueRow(context, name, "%.2f ms", timing.milliseconds);
+    }
+}
+
+void Hud::layout(const Renderer &renderer, const GraphicsManager &graphicsManager)
+{
+    // the window fits its rows, which change as zones come and go
+    uint32_t rowCount = 13 + (uint32_t) (cpuTimings.size() + gpuTimings.size());
+    float height = 40.f + CHART_HEIGHT + (float) rowCount * (ROW_HEIGHT + context.style.window.spacing.y);
+    struct nk_rect bounds = nk_rect(10.f, 10.f, HUD_WIDTH, height);
+    nk_window_set_bounds(&context, HUD_TITLE, bounds);
+
+    if (nk_begin(&context, HUD_TITLE, bounds, NK_WINDOW_BORDER | NK_WINDOW_TITLE | NK_WINDOW_NO_SCROLLBAR |
+                                              NK_WINDOW_NO_INPUT)) {
+        sortedFrameTimes.assign(frameTimes, frameTimes + frameTimeCount);
+        std::sort(sortedFrameTimes.begin(), sortedFrameTimes.end());
+        auto percentile = [this](float fraction) {
+            auto index = (size_t) (fraction * (float) sortedFrameTimes.size());
+            return sortedFrameTimes[std::min(index, sortedFrameTimes.size() - 1)];
+        };
+
+        if (!sortedFrameTimes.empty()) {
+            float average = 0;
+            for (float frameTime : sortedFrameTimes) {
+                average += frameTime;
+            }
+            average /= (float) sortedFrameTimes.size();
+
+            valueRow(&context, "frame", "%.2f ms, %.0f fps", average, 1000.f / std::max(average, .001f));
+            valueRow(&context, "p50 / p95 / p99", "%.2f / %.2f / %.2f ms", percentile(.5f), percentile(.95f),
+                     percentile(.99f));
+
+            // oldest frame first
+            nk_layout_row_dynamic(&context, CHART_HEIGHT, 1);
+            if (nk_chart_begin(&context, NK_CHART_COLUMN, (int) frameTimeCount, 0.f,
+                               std::max(sortedFrameTimes.back(), 1.f))) {
+                uint32_t first = (frameTimeCount == FRAME_HISTORY) ? nextFrameTime : 0;
+                for (uint32_t i = 0; i < frameTimeCount; i++) {
+                    nk_chart_push(&context, frameTimes[(first + i) % FRAME_HISTORY]);
+                }
+                nk_chart_end(&context);
+            }
+        }
+
+        valueRow(&context, "CPU", "");
+        timingRows(&context, cpuTimings);
+        if (gpuProfiler) {
+            valueRow(&context, "GPU", "");
+            timingRows(&context, gpuTimings);
+        }
+
+        RenderQueueStats queueStats = renderer.getQueueStats();
+        CullingStats cullingStats = renderer.getCullingStats();
+        GraphicsMemoryStats memoryStats = graphicsManager.getMemoryStats();
+        uint32_t stateChanges = queueStats.shaderBinds + queueStats.vertexArrayBinds + queueStats.textureBinds +
+                                queueStats.materialUploads;
+        uint64_t uploadedBytes = memoryStats.uploadedBytes + renderer.getInstanceUploadBytes();
+
+        valueRow(&context, "draws", "%u (%u multi-draws)", queueStats.draws, queueStats.multiDraws);
+        valueRow(&context, "triangles", "%u", queueStats.triangles);
+        valueRow(&context, "state changes", "%u", stateChanges);
+        valueRow(&context, "objects", "%u visible, %u culled", cullingStats.objectsVisible,
+                 cullingStats.objectsCulled);
+        valueRow(&context, "uploaded", "%.1f KB", (double) uploadedBytes / 1024.0);
+        valueRow(&context, "asset memory", "%.1f MB (pools %.1f MB)", (double) memoryStats.assetBytes / 1048576.0,
+                 (double) memoryStats.geometryPoolBytes / 1048576.0);
+        valueRow(&context, "overlay", "%.3f ms", renderMs);
+    }
+    nk_end(&context);
+}
+
+void Hud::draw(Renderer *renderer, uint32_t width, uint32_t height)
+{
+    glEnable(GL_BLEND);
+    glBlendEquation(GL_FUNC_ADD);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_SCISSOR_TEST);
+
+    // maps pixels, with y down, to clip space
+    const GLfloat projection[16] = {
+            2.f / (float) width, 0, 0, 0,
+            0, -2.f / (float) height, 0, 0,
+            0, 0, -1, 0,
+            -1, 1, 0, 1
+    };
+    renderer->useShaderProgram(&shader);
+    glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, projection);
+    glActiveTexture(GL_TEXTURE0);
+
+    // the whole overlay is converted straight into the buffers, of which the previous contents are discarded
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    void *vertices = glMapBufferRange(GL_ARRAY_BUFFER, 0, MAX_VERTEX_BYTES,
+                                      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    void *indices = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, MAX_INDEX_BYTES,
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+    nk_flags converted = NK_CONVERT_INVALID_PARAM;
+    if (vertices && indices) {
+        struct nk_buffer vertexData;
+        struct nk_buffer indexData;
+        nk_buffer_init_fixed(&vertexData, vertices, MAX_VERTEX_BYTES);
+        nk_buffer_init_fixed(&indexData, indices, MAX_INDEX_BYTES);
+        converted = nk_convert(&context, &commands, &vertexData, &indexData, &convertConfig);
+    }
+
+    if (vertices) {
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    if (indices) {
+        glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+    }
+
+    if (converted == NK_CONVERT_SUCCESS) {
+        const nk_draw_index *offset = nullptr;
+        const struct nk_draw_command *command;
+        nk_draw_foreach(command, &context, &commands) {
+            if (!command->elem_count) {
+                continue;
+            }
+
+            // NB: clip rectangles have y down, the scissor box has y up
+            glBindTexture(GL_TEXTURE_2D, (GLuint) command->texture.id);
+            glScissor((GLint) command->clip_rect.x,
+                      (GLint) ((float) height - (command->clip_rect.y + command->clip_rect.h)),
+                      (GLint) command->clip_rect.w, (GLint) command->clip_rect.h);
+            glDrawElements(GL_TRIANGLES, (GLsizei) command->elem_count, GL_UNSIGNED_SHORT, offset);
+            offset += command->elem_count;
+        }
+    } else {
+        ls_log::log(LOG_WARN, "the performance overlay does not fit in its buffers\n");
+    }
+    nk_buffer_clear(&commands);
+
+    // the state the renderer expects, see {Window::Window}
+    glBindVertexArray(0);
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+}
+
+void Hud::render(Renderer *renderer, const GraphicsManager &graphicsManager, uint32_t width, uint32_t height)
+{
+    if (!visible || !shader.program) {
+        return;
+    }
+
+    PROFILE_ZONE("Hud::render");
+    PROFILE_GPU_ZONE(gpuProfiler, "HUD");
+    auto startTime = std::chrono::steady_clock::now();
+
+    updateTimings();
+
+    // the overlay takes no input, but Nuklear expects a (possibly empty) input pass every frame
+    nk_input_begin(&context);
+    nk_input_end(&context);
+
+    layout(*renderer, graphicsManager);
+    draw(renderer, width, height);
+    nk_clear(&context);
+
+    renderMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
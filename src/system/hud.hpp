@@ -0,0 +1,153 @@
+//
+// Created by agent on 17-10-2026.
+//
+
+#ifndef GAME_HUD_HPP
+#define GAME_HUD_HPP
+
+#include <chrono>
+#include <vector>
+#include <cstdint>
+
+// NB: all files including nuklear.h must use the same configuration, main.cpp compiles the implementation
+#define NK_INCLUDE_FIXED_TYPES // additionally required for mingw-w64 https://github.com/vurtun/nuklear/issues/770
+#define NK_INCLUDE_DEFAULT_ALLOCATOR
+#define NK_INCLUDE_VERTEX_BUFFER_OUTPUT
+#define NK_INCLUDE_FONT_BAKING
+#define NK_INCLUDE_DEFAULT_FONT
+
+#include "nuklear.h"
+
+#include <glad/glad.h>
+
+#include "graphics.hpp"
+#include "gpu_profiler.hpp"
+
+/**
+ * Smoothed time of a zone shown by {Hud}.
+ */
+struct HudTiming {
+    const char *name;
+    uint32_t depth;
+    double milliseconds;
+
+    /**
+     * Total time and first start of the zone in the last frame, the start orders the zones.
+     */
+    double frameMilliseconds;
+    uint64_t frameStart;
+    bool recorded;
+};
+
+/**
+ * Performance overlay drawn with Nuklear: a graph of the frame times with percentiles, the CPU zones of the main
+ * thread and the GPU zones down to the passes, and the counters of {Renderer} and {GraphicsManager}.
+ *
+ * The overlay is converted to a single vertex and index buffer per frame, which is written through a mapped
+ * buffer and drawn with one draw call per clip rectangle. It enables {Profiler} and the {GpuProfiler} while it is
+ * visible, as it shows their zones, and shows its own CPU time.
+ */
+struct Hud {
+    /**
+     * Number of frame times in the graph and the percentiles.
+     */
+    static const uint32_t FRAME_HISTORY = 120;
+
+    /**
+     * Capacity of the vertex and index buffers, Nuklear stops converting commands that do not fit.
+     */
+    static const uint32_t MAX_VERTEX_BYTES = 256 * 1024;
+    static const uint32_t MAX_INDEX_BYTES = 64 * 1024;
+
+private:
+    GpuProfiler *gpuProfiler;
+
+    struct nk_context context;
+    struct nk_font_atlas atlas;
+    struct nk_draw_null_texture nullTexture;
+    struct nk_convert_config convertConfig;
+
+    /**
+     * Draw commands of the current frame, kept between frames to reuse the memory.
+     */
+    struct nk_buffer commands;
+
+    ShaderProgram shader = {};
+    GLint projectionLocation = -1;
+    GLuint fontTexture = 0;
+    GLuint vertexArray = 0;
+    GLuint vertexBuffer = 0;
+    GLuint indexBuffer = 0;
+
+    bool visible = false;
+
+    /**
+     * Frame times in milliseconds, a ring buffer of which {frameTimeCount} entries are valid.
+     */
+    float frameTimes[FRAME_HISTORY] = {};
+    uint32_t frameTimeCount = 0;
+    uint32_t nextFrameTime = 0;
+    std::chrono::steady_clock::time_point lastFrameStart;
+
+    /**
+     * Scratch buffer to compute the percentiles in.
+     */
+    std::vector<float> sortedFrameTimes;
+
+    std::vector<HudTiming> cpuTimings;
+    std::vector<HudTiming> gpuTimings;
+
+    /**
+     * CPU time of the previous {render}.
+     */
+    double renderMs = 0;
+
+    /**
+     * Adds a zone of the last frame to {timings}.
+     */
+    static void addTiming(std::vector<HudTiming> *timings, const char *name, uint32_t depth, double milliseconds,
+                          uint64_t start);
+
+    /**
+     * Moves the smoothed times towards the times of the last frame, and removes the zones it did not record.
+     */
+    static void smoothTimings(std::vector<HudTiming> *timings);
+
+    /**
+     * Adds the zones of the last frame of {Profiler} and {gpuProfiler}.
+     */
+    void updateTimings();
+
+    void layout(const Renderer &renderer, const GraphicsManager &graphicsManager);
+
+    void draw(Renderer *renderer, uint32_t width, uint32_t height);
+
+public:
+    /**
+     * Requires a current GL context. {gpuProfiler} may be nullptr, the GPU zones are not shown then.
+     */
+    explicit Hud(GpuProfiler *gpuProfiler);
+
+    ~Hud();
+
+    Hud(const Hud &) = delete;
+
+    Hud &operator=(const Hud &) = delete;
+
+    void setVisible(bool visible);
+
+    bool isVisible() const;
+
+    /**
+     * Records the time since the previous call as a frame time. Call once per frame, also while hidden.
+     */
+    void beginFrame();
+
+    /**
+     * Draws the overlay on top of the frame in a framebuffer of {width} by {height}, if it is visible. Call after
+     * the scene is drawn.
+     */
+    void render(Renderer *renderer, const GraphicsManager &graphicsManager, uint32_t width, uint32_t height);
+};
+
+#endif //GAME_HUD_HPP
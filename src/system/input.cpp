@@ -5,9 +5,9 @@
 
 #include "../util/ls_log.hpp"
 
-InputHandler::InputHandler(uint32_t p_size_x, uint32_t p_size_y
+InputHandler::InputHandler(uint32_t p_size_x, uint32_t p_size_y, bool p_poll_events
 ) :
-        framebuffer_size_x(p_size_x), framebuffer_size_y(p_size_y)
+        framebuffer_size_x(p_size_x), framebuffer_size_y(p_size_y), poll_events(p_poll_events)
 {
     // initialize the bit vectors with the correct amount of memory
     pressed = (uint32_t *) calloc(VECTOR_COUNT, sizeof(uint32_t));
@@ -42,7 +42,9 @@ void InputHandler::pull_input()
     framebuffer_resized = false;
 
     /** populate with new inputs */
-    glfwPollEvents();
+    if (poll_events) {
+        glfwPollEvents();
+    }
 }
 
 /**
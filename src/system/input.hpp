@@ -8,8 +8,11 @@
 class InputHandler {
 public:
     // todo should maybe extend this to pass along all initial state (cursor pos etc.)
-    /** Supply initial with framebuffer sizes. */
-    InputHandler(uint32_t p_size_x, uint32_t p_size_y);
+    /**
+     * Supply initial with framebuffer sizes. If {p_poll_events} is not set, {pull_input} only clears the input,
+     * for headless windows which have no events and may run without GLFW.
+     */
+    InputHandler(uint32_t p_size_x, uint32_t p_size_y, bool p_poll_events = true);
 
     virtual ~InputHandler();
 
@@ -173,6 +176,13 @@ public:
     bool is_iconified() const;
 
     void set_iconified(bool iconified);
+
+    /**
+     * Event polling.
+     */
+private:
+    // whether GLFW events are polled by {pull_input}
+    bool poll_events;
 };
 
 #endif //INPUT_HPP
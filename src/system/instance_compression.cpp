@@ -0,0 +1,142 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#include "instance_compression.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+static int16_t encodeSnorm16(float value)
+{
+    return (int16_t) std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+}
+
+static float decodeSnorm16(int16_t value)
+{
+    return std::max((float) value / 32767.0f, -1.0f);
+}
+
+/**
+ * Unit quaternion (x, y, z, w) of rotation matrix {m}, computed from the largest of the diagonal combinations so
+ * the division is well conditioned.
+ */
+static glm::vec4 rotationToQuaternion(const glm::mat3 &m)
+{
+    float trace = m[0][0] + m[1][1] + m[2][2];
+    glm::vec4 q;
+    if (trace > 0.0f) {
+        float s = std::sqrt(trace + 1.0f) * 2.0f;
+        q = glm::vec4((m[1][2] - m[2][1]) / s, (m[2][0] - m[0][2]) / s, (m[0][1] - m[1][0]) / s, 0.25f * s);
+    } else if (m[0][0] > m[1][1] && m[0][0] > m[2][2]) {
+        float s = std::sqrt(1.0f + m[0][0] - m[1][1] - m[2][2]) * 2.0f;
+        q = glm::vec4(0.25f * s, (m[1][0] + m[0][1]) / s, (m[2][0] + m[0][2]) / s, (m[1][2] - m[2][1]) / s);
+    } else if (m[1][1] > m[2][2]) {
+        float s = std::sqrt(1.0f + m[1][1] - m[0][0] - m[2][2]) * 2.0f;
+        q = glm::vec4((m[1][0] + m[0][1]) / s, 0.25f * s, (m[2][1] + m[1][2]) / s, (m[2][0] - m[0][2]) / s);
+    } else {
+        float s = std::sqrt(1.0f + m[2][2] - m[0][0] - m[1][1]) * 2.0f;
+        q = glm::vec4((m[2][0] + m[0][2]) / s, (m[2][1] + m[1][2]) / s, 0.25f * s, (m[0][1] - m[1][0]) / s);
+    }
+
+    // q and -q are the same rotation, fixing the sign of w keeps the encoding unique
+    q = glm::normalize(q);
+    return (q.w < 0.0f) ? -q : q;
+}
+
+/**
+ * Same as {quaternionToRotation} in the instanced vertex shader.
+ */
+static glm::mat3 quaternionToRotation(glm::vec4 q)
+{
+    float x2 = q.x + q.x;
+    float y2 = q.y + q.y;
+    float z2 = q.z + q.z;
+    return glm::mat3(
+            glm::vec3(1.0f - q.y * y2 - q.z * z2, q.x * y2 + q.w * z2, q.x * z2 - q.w * y2),
+            glm::vec3(q.x * y2 - q.w * z2, 1.0f - q.x * x2 - q.z * z2, q.y * z2 + q.w * x2),
+            glm::vec3(q.x * z2 + q.w * y2, q.y * z2 - q.w * x2, 1.0f - q.x * x2 - q.y * y2));
+}
+
+static void encodeQuantized(const glm::mat4 &transform, QuantizedInstance *result)
+{
+    glm::vec3 axes[3] = {glm::vec3(transform[0]), glm::vec3(transform[1]), glm::vec3(transform[2])};
+    float scale = std::max(glm::length(axes[0]), std::max(glm::length(axes[1]), glm::length(axes[2])));
+
+    glm::vec4 rotation(0.0f, 0.0f, 0.0f, 1.0f);
+    if (scale > 0.0f) {
+        // orthonormalize, so shear and non-uniform scale do not leak into the quaternion
+        glm::vec3 x = glm::normalize(axes[0]);
+        glm::vec3 y = glm::normalize(axes[1] - x * glm::dot(x, axes[1]));
+        // NB: mirrored transforms can not be represented by a rotation, they lose the mirroring of the z axis
+        glm::vec3 z = glm::cross(x, y);
+        rotation = rotationToQuaternion(glm::mat3(x, y, z));
+    }
+
+    result->translation[0] = transform[3].x;
+    result->translation[1] = transform[3].y;
+    result->translation[2] = transform[3].z;
+    result->scale = scale;
+    for (int i = 0; i < 4; i++) {
+        result->rotation[i] = encodeSnorm16(rotation[i]);
+    }
+}
+
+uint32_t InstanceCompression::getSize(InstanceFormat format)
+{
+    switch (format) {
+        case AFFINE_INSTANCE_FORMAT:
+            return sizeof(AffineInstance);
+        case QUANTIZED_INSTANCE_FORMAT:
+            return sizeof(QuantizedInstance);
+        default:
+            return sizeof(glm::mat4);
+    }
+}
+
+void InstanceCompression::encode(InstanceFormat format, const glm::mat4 *transforms, uint32_t count,
+                                 void *destination)
+{
+    if (format == AFFINE_INSTANCE_FORMAT) {
+        auto *affine = (AffineInstance *) destination;
+        for (uint32_t i = 0; i < count; i++) {
+            const glm::mat4 &m = transforms[i];
+            for (int row = 0; row < 3; row++) {
+                affine[i].rows[row] = glm::vec4(m[0][row], m[1][row], m[2][row], m[3][row]);
+            }
+        }
+    } else if (format == QUANTIZED_INSTANCE_FORMAT) {
+        auto *quantized = (QuantizedInstance *) destination;
+        for (uint32_t i = 0; i < count; i++) {
+            encodeQuantized(transforms[i], &quantized[i]);
+        }
+    } else {
+        std::memcpy(destination, transforms, count * sizeof(glm::mat4));
+    }
+}
+
+glm::mat4 InstanceCompression::decode(InstanceFormat format, const void *encoded)
+{
+    glm::mat4 result(1.0f);
+    if (format == AFFINE_INSTANCE_FORMAT) {
+        const auto *affine = (const AffineInstance *) encoded;
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 3; row++) {
+                result[column][row] = affine->rows[row][column];
+            }
+        }
+    } else if (format == QUANTIZED_INSTANCE_FORMAT) {
+        const auto *quantized = (const QuantizedInstance *) encoded;
+        glm::vec4 q(decodeSnorm16(quantized->rotation[0]), decodeSnorm16(quantized->rotation[1]),
+                    decodeSnorm16(quantized->rotation[2]), decodeSnorm16(quantized->rotation[3]));
+        result = glm::mat4(quaternionToRotation(glm::normalize(q)) * quantized->scale);
+        result[3] = glm::vec4(quantized->translation[0], quantized->translation[1], quantized->translation[2], 1.0f);
+    } else {
+        std::memcpy(&result, encoded, sizeof(glm::mat4));
+    }
+
+    return result;
+}
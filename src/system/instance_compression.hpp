@@ -0,0 +1,68 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#ifndef GAME_INSTANCE_COMPRESSION_HPP
+#define GAME_INSTANCE_COMPRESSION_HPP
+
+#include <cstdint>
+
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+/**
+ * Layout of the per-instance transforms of an {InstanceTransformBuffer}, decoded by the instanced vertex shader.
+ */
+enum InstanceFormat {
+    /** glm::mat4, 64 bytes. */
+    MAT4_INSTANCE_FORMAT,
+    /** {AffineInstance}, 48 bytes, exact for affine transforms. */
+    AFFINE_INSTANCE_FORMAT,
+    /** {QuantizedInstance}, 24 bytes, only translation, rotation and uniform scale. */
+    QUANTIZED_INSTANCE_FORMAT,
+    INSTANCE_FORMAT_COUNT
+};
+
+/**
+ * The first three rows of an affine transform, of which the last row is always (0, 0, 0, 1).
+ */
+struct AffineInstance {
+    glm::vec4 rows[3];
+};
+
+/**
+ * Translation, rotation and uniform scale of a transform.
+ */
+struct QuantizedInstance {
+    float translation[3];
+    float scale;
+
+    /**
+     * Unit quaternion (x, y, z, w) as signed normalized 16 bit integers, with w >= 0.
+     */
+    int16_t rotation[4];
+};
+
+/**
+ * Conversion of instance transforms to an {InstanceFormat}. The decoding counterpart is in the instanced vertex
+ * shader.
+ */
+struct InstanceCompression {
+    /**
+     * Size in bytes of a transform in {format}.
+     */
+    static uint32_t getSize(InstanceFormat format);
+
+    /**
+     * Writes {count} {transforms} in {format} to {destination}, which must hold {count} * {getSize(format)} bytes.
+     * {QUANTIZED_INSTANCE_FORMAT} keeps the largest axis scale and drops non-uniform scale and shear.
+     */
+    static void encode(InstanceFormat format, const glm::mat4 *transforms, uint32_t count, void *destination);
+
+    /**
+     * The transform {encoded} in {format} decodes to, like the vertex shader decodes it.
+     */
+    static glm::mat4 decode(InstanceFormat format, const void *encoded);
+};
+
+#endif //GAME_INSTANCE_COMPRESSION_HPP
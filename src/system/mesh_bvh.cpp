@@ -0,0 +1,453 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#include "mesh_bvh.hpp"
+
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+#include "asset_manager.hpp"
+#include "../util/aabb.hpp"
+#include "../util/ls_log.hpp"
+
+/**
+ * Number of bins per axis of the SAH build.
+ */
+static const uint32_t SAH_BIN_COUNT = 16;
+
+/**
+ * Cost of visiting a node relative to testing a triangle packet, in the SAH of the build.
+ */
+static const float TRAVERSAL_COST = 1.0f;
+
+/**
+ * Below this depth the build splits at the object median, which bounds the depth of the tree so that the traversal
+ * stack of {MeshBVH::intersect} cannot overflow.
+ */
+static const uint32_t MAX_SAH_DEPTH = 32;
+
+/**
+ * Triangle during the build.
+ */
+struct BuildTriangle {
+    AABB box;
+    glm::vec3 centroid;
+    uint32_t triangle;
+};
+
+static uint32_t packetsFor(uint32_t triangleCount)
+{
+    return (triangleCount + 3) / 4;
+}
+
+static void setBox(MeshBVHNode *node, const AABB &box)
+{
+    for (int axis = 0; axis < 3; axis++) {
+        node->min[axis] = box.min[axis];
+        node->max[axis] = box.max[axis];
+    }
+}
+
+/**
+ * Distance along the ray to the box of {node}, INFINITY if the ray misses it within {maxDistance}.
+ */
+static float intersectNode(const MeshBVHNode &node, glm::vec3 origin, glm::vec3 inverseDirection, float maxDistance)
+{
+    float tMin = 0.0f;
+    float tMax = maxDistance;
+    for (int axis = 0; axis < 3; axis++) {
+        float t0 = (node.min[axis] - origin[axis]) * inverseDirection[axis];
+        float t1 = (node.max[axis] - origin[axis]) * inverseDirection[axis];
+        tMin = std::max(tMin, std::min(t0, t1));
+        tMax = std::min(tMax, std::max(t0, t1));
+    }
+
+    return tMin <= tMax ? tMin : INFINITY;
+}
+
+/**
+ * Möller-Trumbore test of the ray against the four triangles of {packet}. Updates {hit} and returns true if one of
+ * them is hit nearer than {hit->distance}; {hit->triangle} is set to the triangle number of the packet.
+ */
+static bool intersectPacket(const MeshTrianglePacket &packet, glm::vec3 origin, glm::vec3 direction, MeshHit *hit)
+{
+#if defined(__SSE__) || defined(_M_X64)
+    __m128 e1[3];
+    __m128 e2[3];
+    __m128 toOrigin[3];
+    for (int axis = 0; axis < 3; axis++) {
+        e1[axis] = _mm_loadu_ps(packet.e1[axis]);
+        e2[axis] = _mm_loadu_ps(packet.e2[axis]);
+        toOrigin[axis] = _mm_sub_ps(_mm_set1_ps(origin[axis]), _mm_loadu_ps(packet.v0[axis]));
+    }
+    __m128 dx = _mm_set1_ps(direction.x);
+    __m128 dy = _mm_set1_ps(direction.y);
+    __m128 dz = _mm_set1_ps(direction.z);
+
+    // p = direction x e2, det = e1 . p
+    __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2[2]), _mm_mul_ps(dz, e2[1]));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2[0]), _mm_mul_ps(dx, e2[2]));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2[1]), _mm_mul_ps(dy, e2[0]));
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1[0], px), _mm_mul_ps(e1[1], py)), _mm_mul_ps(e1[2], pz));
+    __m128 inverseDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+    __m128 u = _mm_add_ps(_mm_mul_ps(toOrigin[0], px), _mm_mul_ps(toOrigin[1], py));
+    u = _mm_mul_ps(_mm_add_ps(u, _mm_mul_ps(toOrigin[2], pz)), inverseDet);
+
+    // q = (origin - v0) x e1
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(toOrigin[1], e1[2]), _mm_mul_ps(toOrigin[2], e1[1]));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(toOrigin[2], e1[0]), _mm_mul_ps(toOrigin[0], e1[2]));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(toOrigin[0], e1[1]), _mm_mul_ps(toOrigin[1], e1[0]));
+
+    __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz));
+    v = _mm_mul_ps(v, inverseDet);
+    __m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2[0], qx), _mm_mul_ps(e2[1], qy)), _mm_mul_ps(e2[2], qz));
+    t = _mm_mul_ps(t, inverseDet);
+
+    // NB: comparisons with NaN, from degenerate triangles, are false
+    __m128 zero = _mm_setzero_ps();
+    __m128 mask = _mm_cmpneq_ps(det, zero);
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(t, zero));
+    mask = _mm_and_ps(mask, _mm_cmplt_ps(t, _mm_set1_ps(hit->distance)));
+
+    int lanes = _mm_movemask_ps(mask);
+    if (lanes == 0) {
+        return false;
+    }
+
+    float ts[4];
+    float us[4];
+    float vs[4];
+    _mm_storeu_ps(ts, t);
+    _mm_storeu_ps(us, u);
+    _mm_storeu_ps(vs, v);
+
+    for (int lane = 0; lane < 4; lane++) {
+        if (((lanes >> lane) & 1) && ts[lane] < hit->distance) {
+            hit->distance = ts[lane];
+            hit->u = us[lane];
+            hit->v = vs[lane];
+            hit->triangle = packet.triangles[lane];
+        }
+    }
+
+    return true;
+#else
+    bool found = false;
+    for (int lane = 0; lane < 4; lane++) {
+        glm::vec3 e1(packet.e1[0][lane], packet.e1[1][lane], packet.e1[2][lane]);
+        glm::vec3 e2(packet.e2[0][lane], packet.e2[1][lane], packet.e2[2][lane]);
+        glm::vec3 toOrigin = origin - glm::vec3(packet.v0[0][lane], packet.v0[1][lane], packet.v0[2][lane]);
+
+        glm::vec3 p = glm::cross(direction, e2);
+        float det = glm::dot(e1, p);
+        if (det == 0.0f) {
+            continue;
+        }
+
+        glm::vec3 q = glm::cross(toOrigin, e1);
+        float u = glm::dot(toOrigin, p) / det;
+        float v = glm::dot(direction, q) / det;
+        float t = glm::dot(e2, q) / det;
+        if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 0.0f && t < hit->distance) {
+            hit->distance = t;
+            hit->u = u;
+            hit->v = v;
+            hit->triangle = packet.triangles[lane];
+            found = true;
+        }
+    }
+
+    return found;
+#endif
+}
+
+void MeshBVH::setSubMeshes(const Model &model)
+{
+    subMeshFirstTriangles.clear();
+    uint32_t triangleCount = 0;
+    for (const auto &subMesh : model.mesh.materialSubMeshes) {
+        subMeshFirstTriangles.emplace_back(triangleCount);
+        triangleCount += subMesh.getIndexCount() / 3;
+    }
+}
+
+void MeshBVH::build(const Model &model)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    setSubMeshes(model);
+    nodes.clear();
+    packets.clear();
+    mappedNodes = nullptr;
+    mappedNodeCount = 0;
+    mappedPackets = nullptr;
+    mappedPacketCount = 0;
+
+    const Vertex *vertices = model.getVertexData();
+    std::vector<BuildTriangle> triangles;
+    for (const auto &subMesh : model.mesh.materialSubMeshes) {
+        const uint32_t *indices = subMesh.getIndexData();
+        for (uint32_t i = 0; i + 2 < subMesh.getIndexCount(); i += 3) {
+            BuildTriangle triangle;
+            triangle.box.grow(vertices[indices[i]].position);
+            triangle.box.grow(vertices[indices[i + 1]].position);
+            triangle.box.grow(vertices[indices[i + 2]].position);
+            triangle.centroid = triangle.box.center();
+            triangle.triangle = (uint32_t) triangles.size();
+            triangles.emplace_back(triangle);
+        }
+    }
+
+    if (triangles.empty()) {
+        return;
+    }
+
+    // vertex positions by triangle number, for filling the packets
+    std::vector<glm::vec3> corners;
+    corners.reserve(triangles.size() * 3);
+    for (const auto &subMesh : model.mesh.materialSubMeshes) {
+        const uint32_t *indices = subMesh.getIndexData();
+        for (uint32_t i = 0; i + 2 < subMesh.getIndexCount(); i += 3) {
+            for (uint32_t c = 0; c < 3; c++) {
+                corners.emplace_back(vertices[indices[i + c]].position);
+            }
+        }
+    }
+
+    struct BuildTask {
+        uint32_t node;
+        uint32_t begin;
+        uint32_t end;
+        uint32_t depth;
+    };
+
+    nodes.reserve(2 * packetsFor((uint32_t) triangles.size()));
+    nodes.emplace_back();
+    std::vector<BuildTask> tasks = {{0, 0, (uint32_t) triangles.size(), 0}};
+    uint32_t maxDepth = 0;
+
+    while (!tasks.empty()) {
+        BuildTask task = tasks.back();
+        tasks.pop_back();
+        maxDepth = std::max(maxDepth, task.depth);
+
+        BuildTriangle *items = triangles.data() + task.begin;
+        uint32_t count = task.end - task.begin;
+
+        AABB box;
+        AABB centroidBox;
+        for (uint32_t i = 0; i < count; i++) {
+            box.grow(items[i].box);
+            centroidBox.grow(items[i].centroid);
+        }
+        setBox(&nodes[task.node], box);
+
+        // split with the lowest SAH cost, in units of packet tests
+        int bestAxis = -1;
+        uint32_t bestSplit = 0;
+        float bestCost = INFINITY;
+        glm::vec3 extent = centroidBox.extent();
+
+        for (int axis = 0; axis < 3 && count > 4 && task.depth < MAX_SAH_DEPTH; axis++) {
+            if (extent[axis] <= 0.0f) {
+                continue;
+            }
+
+            AABB binBoxes[SAH_BIN_COUNT];
+            uint32_t binCounts[SAH_BIN_COUNT] = {};
+            float scale = (float) SAH_BIN_COUNT / extent[axis];
+            for (uint32_t i = 0; i < count; i++) {
+                auto bin = std::min((uint32_t) ((items[i].centroid[axis] - centroidBox.min[axis]) * scale),
+                                    SAH_BIN_COUNT - 1);
+                binBoxes[bin].grow(items[i].box);
+                binCounts[bin]++;
+            }
+
+            float rightCosts[SAH_BIN_COUNT];
+            AABB rightBox;
+            uint32_t rightCount = 0;
+            for (uint32_t b = SAH_BIN_COUNT - 1; b > 0; b--) {
+                rightBox.grow(binBoxes[b]);
+                rightCount += binCounts[b];
+                rightCosts[b - 1] = rightBox.surface_area() * (float) packetsFor(rightCount);
+            }
+
+            AABB leftBox;
+            uint32_t leftCount = 0;
+            for (uint32_t b = 0; b + 1 < SAH_BIN_COUNT; b++) {
+                leftBox.grow(binBoxes[b]);
+                leftCount += binCounts[b];
+                float cost = leftBox.surface_area() * (float) packetsFor(leftCount) + rightCosts[b];
+                if (leftCount > 0 && leftCount < count && cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = b;
+                }
+            }
+        }
+
+        float area = box.surface_area();
+        bool fitsLeaf = packetsFor(count) <= MAX_LEAF_PACKETS;
+        if (fitsLeaf && (bestAxis < 0 || area * (float) packetsFor(count) <= area * TRAVERSAL_COST + bestCost)) {
+            MeshBVHNode &leaf = nodes[task.node];
+            leaf.leftOrFirst = (uint32_t) packets.size();
+            leaf.packetCount = packetsFor(count);
+
+            for (uint32_t first = 0; first < count; first += 4) {
+                MeshTrianglePacket packet = {};
+                for (uint32_t lane = 0; lane < 4; lane++) {
+                    if (first + lane >= count) {
+                        packet.triangles[lane] = UINT32_MAX;
+                        continue;
+                    }
+
+                    uint32_t triangle = items[first + lane].triangle;
+                    glm::vec3 v0 = corners[triangle * 3];
+                    glm::vec3 e1 = corners[triangle * 3 + 1] - v0;
+                    glm::vec3 e2 = corners[triangle * 3 + 2] - v0;
+                    for (int axis = 0; axis < 3; axis++) {
+                        packet.v0[axis][lane] = v0[axis];
+                        packet.e1[axis][lane] = e1[axis];
+                        packet.e2[axis][lane] = e2[axis];
+                    }
+                    packet.triangles[lane] = triangle;
+                }
+                packets.emplace_back(packet);
+            }
+            continue;
+        }
+
+        BuildTriangle *middle = items + count / 2;
+        if (bestAxis >= 0) {
+            float scale = (float) SAH_BIN_COUNT / extent[bestAxis];
+            float origin = centroidBox.min[bestAxis];
+            middle = std::partition(items, items + count, [&](const BuildTriangle &item) {
+                return std::min((uint32_t) ((item.centroid[bestAxis] - origin) * scale), SAH_BIN_COUNT - 1) <=
+                       bestSplit;
+            });
+        } else {
+            // no usable split plane, e.g. all centroids coincide: split at the median of the longest axis
+            int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+            std::nth_element(items, middle, items + count, [axis](const BuildTriangle &a, const BuildTriangle &b) {
+                return a.centroid[axis] < b.centroid[axis];
+            });
+        }
+        if (middle == items || middle == items + count) {
+            middle = items + count / 2;
+        }
+
+        auto left = (uint32_t) nodes.size();
+        nodes[task.node].leftOrFirst = left;
+        nodes[task.node].packetCount = 0;
+        nodes.emplace_back();
+        nodes.emplace_back();
+
+        auto split = task.begin + (uint32_t) (middle - items);
+        tasks.push_back({left, task.begin, split, task.depth + 1});
+        tasks.push_back({left + 1, split, task.end, task.depth + 1});
+    }
+
+    double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    ls_log::log(LOG_INFO, "built triangle BVH of %s in %.1f ms: %u triangles, %u nodes, %u packets, depth %u\n",
+                model.mesh.name.c_str(), buildMs, (uint32_t) triangles.size(), (uint32_t) nodes.size(),
+                (uint32_t) packets.size(), maxDepth);
+}
+
+bool MeshBVH::intersect(glm::vec3 origin, glm::vec3 direction, float maxDistance, MeshHit *hit) const
+{
+    const MeshBVHNode *nodeData = getNodeData();
+    const MeshTrianglePacket *packetData = getPacketData();
+    if (getNodeCount() == 0) {
+        return false;
+    }
+
+    glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+    MeshHit nearest = {};
+    nearest.triangle = UINT32_MAX;
+    nearest.distance = maxDistance;
+
+    // entries are nodes of which the box is hit, with the distance to it
+    uint32_t stackNodes[MAX_DEPTH];
+    float stackDistances[MAX_DEPTH];
+    uint32_t stackSize = 0;
+
+    uint32_t node = 0;
+    float distance = intersectNode(nodeData[0], origin, inverseDirection, nearest.distance);
+    while (distance != INFINITY) {
+        const MeshBVHNode &current = nodeData[node];
+        distance = INFINITY;
+
+        if (current.packetCount > 0) {
+            for (uint32_t p = 0; p < current.packetCount; p++) {
+                intersectPacket(packetData[current.leftOrFirst + p], origin, direction, &nearest);
+            }
+        } else {
+            // continue with the nearer child, and come back for the farther one
+            uint32_t children[2] = {current.leftOrFirst, current.leftOrFirst + 1};
+            float distances[2];
+            for (int c = 0; c < 2; c++) {
+                distances[c] = intersectNode(nodeData[children[c]], origin, inverseDirection, nearest.distance);
+            }
+
+            int nearer = distances[0] <= distances[1] ? 0 : 1;
+            if (distances[1 - nearer] != INFINITY) {
+                stackNodes[stackSize] = children[1 - nearer];
+                stackDistances[stackSize] = distances[1 - nearer];
+                stackSize++;
+            }
+            node = children[nearer];
+            distance = distances[nearer];
+        }
+
+        // pop the next node that may still hold a nearer hit
+        while (distance == INFINITY && stackSize > 0) {
+            stackSize--;
+            if (stackDistances[stackSize] < nearest.distance) {
+                node = stackNodes[stackSize];
+                distance = stackDistances[stackSize];
+            }
+        }
+    }
+
+    if (nearest.triangle == UINT32_MAX) {
+        return false;
+    }
+
+    auto subMesh = std::upper_bound(subMeshFirstTriangles.begin(), subMeshFirstTriangles.end(), nearest.triangle);
+    nearest.subMesh = (uint32_t) (subMesh - subMeshFirstTriangles.begin()) - 1;
+    nearest.triangle -= subMeshFirstTriangles[nearest.subMesh];
+
+    *hit = nearest;
+    return true;
+}
+
+const MeshBVHNode *MeshBVH::getNodeData() const
+{
+    return mappedNodes ? mappedNodes : nodes.data();
+}
+
+uint32_t MeshBVH::getNodeCount() const
+{
+    return mappedNodes ? mappedNodeCount : (uint32_t) nodes.size();
+}
+
+const MeshTrianglePacket *MeshBVH::getPacketData() const
+{
+    return mappedPackets ? mappedPackets : packets.data();
+}
+
+uint32_t MeshBVH::getPacketCount() const
+{
+    return mappedPackets ? mappedPacketCount : (uint32_t) packets.size();
+}
@@ -0,0 +1,127 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#ifndef GAME_MESH_BVH_HPP
+#define GAME_MESH_BVH_HPP
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/vec3.hpp>
+
+struct Model;
+
+/**
+ * Node of a {MeshBVH}, 32 bytes so two siblings share a cache line.
+ */
+struct MeshBVHNode {
+    float min[3];
+
+    /**
+     * Internal nodes: index of the left child, the right child follows it. Leaves: first triangle packet.
+     */
+    uint32_t leftOrFirst;
+
+    float max[3];
+
+    /**
+     * Number of triangle packets of a leaf, 0 for internal nodes.
+     */
+    uint32_t packetCount;
+};
+
+/**
+ * Four triangles in structure of arrays layout, as the vertex {v0} and the edges {e1} = v1 - v0 and {e2} = v2 - v0,
+ * indexed [axis][lane]. Unused lanes are degenerate triangles, which are never hit.
+ */
+struct MeshTrianglePacket {
+    float v0[3][4];
+    float e1[3][4];
+    float e2[3][4];
+
+    /**
+     * Triangle of each lane, numbered through all submeshes in order.
+     */
+    uint32_t triangles[4];
+};
+
+/**
+ * Triangle of a model hit by a ray.
+ */
+struct MeshHit {
+    uint32_t subMesh;
+
+    /**
+     * Index of the triangle within the submesh: its vertices are indices 3 * triangle to 3 * triangle + 2.
+     */
+    uint32_t triangle;
+
+    /**
+     * Barycentric coordinates of the hit relative to the second and third vertex of the triangle.
+     */
+    float u;
+    float v;
+
+    /**
+     * Along the ray, in units of the length of the ray direction.
+     */
+    float distance;
+};
+
+/**
+ * Bounding volume hierarchy over the full detail triangles of a model, for exact ray queries on the CPU. Built at
+ * import with the binned surface area heuristic and stored in the mesh cache, so cooked models map it without
+ * rebuilding. Leaves hold up to {MAX_LEAF_PACKETS} packets of four triangles, which are tested with SSE.
+ */
+struct MeshBVH {
+    static const uint32_t MAX_LEAF_PACKETS = 2;
+
+    /**
+     * Maximum depth of the tree, the size of the traversal stack of {intersect}. {build} stays within it, cooked
+     * trees are checked against it by {MeshCache::load}.
+     */
+    static const uint32_t MAX_DEPTH = 64;
+
+    std::vector<MeshBVHNode> nodes;
+    std::vector<MeshTrianglePacket> packets;
+
+    /**
+     * Inside the memory-mapped cooked mesh of the parent Model, used instead of {nodes} and {packets} if set.
+     */
+    const MeshBVHNode *mappedNodes = nullptr;
+    uint32_t mappedNodeCount = 0;
+    const MeshTrianglePacket *mappedPackets = nullptr;
+    uint32_t mappedPacketCount = 0;
+
+    /**
+     * First triangle of each submesh, to map the triangle numbers of the packets back to submeshes.
+     */
+    std::vector<uint32_t> subMeshFirstTriangles;
+
+    /**
+     * Builds the hierarchy over the submesh triangles of {model}.
+     */
+    void build(const Model &model);
+
+    /**
+     * Fills {subMeshFirstTriangles} from the index counts of the submeshes of {model}.
+     */
+    void setSubMeshes(const Model &model);
+
+    /**
+     * Finds the nearest triangle hit by the ray from {origin} in {direction}, in object space, within {maxDistance}.
+     * Triangles are hit from both sides. Returns false if no triangle is hit.
+     */
+    bool intersect(glm::vec3 origin, glm::vec3 direction, float maxDistance, MeshHit *hit) const;
+
+    const MeshBVHNode *getNodeData() const;
+
+    uint32_t getNodeCount() const;
+
+    const MeshTrianglePacket *getPacketData() const;
+
+    uint32_t getPacketCount() const;
+};
+
+#endif //GAME_MESH_BVH_HPP
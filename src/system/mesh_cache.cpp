@@ -0,0 +1,522 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#include "mesh_cache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "../util/util.hpp"
+#include "../util/ls_log.hpp"
+#include "../util/mapped_file.hpp"
+
+static const char MESH_CACHE_MAGIC[8] = {'L', 'S', 'M', 'E', 'S', 'H', 0, 0};
+
+enum MeshCacheSectionType {
+    /** Serialized list of source files, see {writeSourceFile}. */
+    SECTION_SOURCE_FILES,
+    /** Serialized material table, see {writeMaterial}. */
+    SECTION_MATERIALS,
+    /** Array of {MeshCacheSubMesh}. */
+    SECTION_SUBMESHES,
+    /** Array of {Vertex}. */
+    SECTION_VERTICES,
+    /** Array of uint32_t indices of all submeshes, followed by those of all levels of detail, concatenated. */
+    SECTION_INDICES,
+    /** Array of {MeshCacheLod}, grouped by submesh in order of coarseness. */
+    SECTION_LODS,
+    /** Array of {MeshBVHNode}. */
+    SECTION_BVH_NODES,
+    /** Array of {MeshTrianglePacket}. */
+    SECTION_BVH_PACKETS
+};
+
+struct MeshCacheHeader {
+    char magic[8];
+    uint32_t version;
+
+    /** Guards against changes to the vertex layout without a version bump. */
+    uint32_t vertexSize;
+
+    uint32_t sectionCount;
+    uint32_t reserved;
+};
+
+struct MeshCacheSection {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct MeshCacheSubMesh {
+    int32_t materialIndex;
+    uint32_t indexCount;
+    uint64_t firstIndex;
+};
+
+struct MeshCacheLod {
+    uint32_t subMesh;
+    uint32_t indexCount;
+    uint64_t firstIndex;
+    float error;
+    uint32_t reserved;
+};
+
+/** Appends plain data to a byte buffer. */
+struct CacheWriter {
+    std::vector<char> bytes;
+
+    void write(const void *data, size_t size)
+    {
+        bytes.insert(bytes.end(), (const char *) data, (const char *) data + size);
+    }
+
+    template<typename T>
+    void write(const T &value)
+    {
+        write(&value, sizeof(T));
+    }
+
+    void writeString(const std::string &string)
+    {
+        write((uint32_t) string.size());
+        write(string.data(), string.size());
+    }
+};
+
+/** Reads plain data from a byte range, failing (rather than reading out of bounds) on truncated input. */
+struct CacheReader {
+    const char *cursor;
+    const char *end;
+    bool failed = false;
+
+    CacheReader(const char *data, size_t size) : cursor(data), end(data + size)
+    {}
+
+    void read(void *data, size_t size)
+    {
+        if (failed || (size_t) (end - cursor) < size) {
+            failed = true;
+            memset(data, 0, size);
+            return;
+        }
+
+        memcpy(data, cursor, size);
+        cursor += size;
+    }
+
+    template<typename T>
+    T read()
+    {
+        T value;
+        read(&value, sizeof(T));
+        return value;
+    }
+
+    std::string readString()
+    {
+        uint32_t size = read<uint32_t>();
+        if (failed || (size_t) (end - cursor) < size) {
+            failed = true;
+            return std::string();
+        }
+
+        std::string result(cursor, size);
+        cursor += size;
+        return result;
+    }
+};
+
+static void writeMaterial(CacheWriter *writer, const Material &material)
+{
+    writer->writeString(material.name);
+    writer->write(material.albedo);
+    writer->write(material.roughness);
+    writer->write(material.metallic);
+    writer->writeString(material.albedoTexture.file);
+    writer->writeString(material.roughnessTexture.file);
+    writer->writeString(material.metallicTexture.file);
+    writer->writeString(material.normalMap.file);
+}
+
+static Material readMaterial(CacheReader *reader)
+{
+    Material material = {};
+    material.name = reader->readString();
+    material.albedo = reader->read<glm::vec3>();
+    material.roughness = reader->read<float>();
+    material.metallic = reader->read<float>();
+    material.albedoTexture.file = reader->readString();
+    material.roughnessTexture.file = reader->readString();
+    material.metallicTexture.file = reader->readString();
+    material.normalMap.file = reader->readString();
+
+    return material;
+}
+
+/**
+ * Records the hash, modification time and size of {file}. Returns false if the file cannot be read.
+ */
+static bool writeSourceFile(CacheWriter *writer, const std::string &file)
+{
+    int64_t mtime;
+    uint64_t size;
+    if (Util::get_file_info(file.c_str(), &mtime, &size) == EXIT_FAILURE) {
+        return false;
+    }
+
+    std::shared_ptr<MappedFile> mapping = MappedFile::open(file.c_str());
+    if (!mapping) {
+        return false;
+    }
+
+    writer->writeString(file);
+    writer->write(mtime);
+    writer->write(size);
+    writer->write(Util::hash_bytes(mapping->get_data(), mapping->get_size()));
+
+    return true;
+}
+
+/**
+ * Checks a source file recorded by {writeSourceFile} against the file on disk. The modification time and size are
+ * compared first, the contents are only hashed if those match.
+ */
+static bool checkSourceFile(CacheReader *reader)
+{
+    std::string file = reader->readString();
+    int64_t cachedMtime = reader->read<int64_t>();
+    uint64_t cachedSize = reader->read<uint64_t>();
+    uint64_t cachedHash = reader->read<uint64_t>();
+
+    if (reader->failed) {
+        return false;
+    }
+
+    int64_t mtime;
+    uint64_t size;
+    if (Util::get_file_info(file.c_str(), &mtime, &size) == EXIT_FAILURE) {
+        return false;
+    }
+
+    if (mtime != cachedMtime || size != cachedSize) {
+        return false;
+    }
+
+    std::shared_ptr<MappedFile> mapping = MappedFile::open(file.c_str());
+    if (!mapping) {
+        return false;
+    }
+
+    return Util::hash_bytes(mapping->get_data(), mapping->get_size()) == cachedHash;
+}
+
+bool MeshCache::load(const std::string &cacheFile, Model *model)
+{
+    std::shared_ptr<MappedFile> mapping = MappedFile::open(cacheFile.c_str());
+    if (!mapping) {
+        return false;
+    }
+
+    const char *data = mapping->get_data();
+    size_t size = mapping->get_size();
+
+    if (size < sizeof(MeshCacheHeader)) {
+        return false;
+    }
+
+    MeshCacheHeader header;
+    memcpy(&header, data, sizeof(header));
+
+    if (memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0 ||
+        header.version != VERSION || header.vertexSize != sizeof(Vertex)) {
+        ls_log::log(LOG_INFO, "mesh cache %s is outdated\n", cacheFile.c_str());
+        return false;
+    }
+
+    if ((size - sizeof(MeshCacheHeader)) / sizeof(MeshCacheSection) < header.sectionCount) {
+        return false;
+    }
+
+    // locate the sections, and validate that they lie within the file
+    const char *sectionData[SECTION_BVH_PACKETS + 1] = {};
+    size_t sectionSize[SECTION_BVH_PACKETS + 1] = {};
+
+    for (uint32_t i = 0; i < header.sectionCount; i++) {
+        MeshCacheSection section;
+        memcpy(&section, data + sizeof(MeshCacheHeader) + i * sizeof(MeshCacheSection), sizeof(section));
+
+        if (section.offset > size || section.size > size - section.offset) {
+            return false;
+        }
+
+        if (section.type <= SECTION_BVH_PACKETS) {
+            sectionData[section.type] = data + section.offset;
+            sectionSize[section.type] = section.size;
+        }
+    }
+
+    // all source files must be unchanged
+    CacheReader sourceReader(sectionData[SECTION_SOURCE_FILES], sectionSize[SECTION_SOURCE_FILES]);
+    uint32_t sourceFileCount = sourceReader.read<uint32_t>();
+    if (sourceReader.failed || sourceFileCount == 0) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < sourceFileCount; i++) {
+        if (!checkSourceFile(&sourceReader)) {
+            ls_log::log(LOG_INFO, "mesh cache %s is stale\n", cacheFile.c_str());
+            return false;
+        }
+    }
+
+    CacheReader materialReader(sectionData[SECTION_MATERIALS], sectionSize[SECTION_MATERIALS]);
+    uint32_t materialCount = materialReader.read<uint32_t>();
+    std::vector<Material> materials;
+    for (uint32_t i = 0; i < materialCount && !materialReader.failed; i++) {
+        materials.emplace_back(readMaterial(&materialReader));
+    }
+    if (materialReader.failed) {
+        return false;
+    }
+
+    const Vertex *vertices = (const Vertex *) sectionData[SECTION_VERTICES];
+    const uint32_t *indices = (const uint32_t *) sectionData[SECTION_INDICES];
+    uint64_t vertexCount = sectionSize[SECTION_VERTICES] / sizeof(Vertex);
+    uint64_t indexCount = sectionSize[SECTION_INDICES] / sizeof(uint32_t);
+
+    // the submeshes and LODs are uploaded and traversed without checking their indices
+    for (uint64_t i = 0; i < indexCount; i++) {
+        if (indices[i] >= vertexCount) {
+            ls_log::log(LOG_WARN, "mesh cache %s indexes vertex %u of %u\n", cacheFile.c_str(), indices[i],
+                        (uint32_t) vertexCount);
+            return false;
+        }
+    }
+
+    const MeshCacheSubMesh *subMeshes = (const MeshCacheSubMesh *) sectionData[SECTION_SUBMESHES];
+    uint64_t subMeshCount = sectionSize[SECTION_SUBMESHES] / sizeof(MeshCacheSubMesh);
+
+    // NB: built aside, so {model} is unchanged if the cache is rejected and the OBJ file is imported instead
+    std::vector<MaterialSubMesh> materialSubMeshes;
+    for (uint64_t i = 0; i < subMeshCount; i++) {
+        if (subMeshes[i].firstIndex > indexCount || subMeshes[i].indexCount > indexCount - subMeshes[i].firstIndex) {
+            return false;
+        }
+
+        // -1 is drawn with the default material, see VertexArrayObject::create
+        if (subMeshes[i].materialIndex < -1 || subMeshes[i].materialIndex >= (int64_t) materialCount) {
+            ls_log::log(LOG_WARN, "mesh cache %s uses material %d of %u\n", cacheFile.c_str(),
+                        subMeshes[i].materialIndex, materialCount);
+            return false;
+        }
+
+        MaterialSubMesh subMesh = {};
+        subMesh.materialIndex = subMeshes[i].materialIndex;
+        subMesh.mappedIndices = indices + subMeshes[i].firstIndex;
+        subMesh.mappedIndexCount = subMeshes[i].indexCount;
+        materialSubMeshes.emplace_back(subMesh);
+    }
+
+    const MeshCacheLod *lods = (const MeshCacheLod *) sectionData[SECTION_LODS];
+    uint64_t lodCount = sectionSize[SECTION_LODS] / sizeof(MeshCacheLod);
+
+    for (uint64_t i = 0; i < lodCount; i++) {
+        if (lods[i].subMesh >= subMeshCount || lods[i].firstIndex > indexCount ||
+            lods[i].indexCount > indexCount - lods[i].firstIndex) {
+            return false;
+        }
+
+        MeshLod lod = {};
+        lod.error = lods[i].error;
+        lod.mappedIndices = indices + lods[i].firstIndex;
+        lod.mappedIndexCount = lods[i].indexCount;
+        materialSubMeshes[lods[i].subMesh].lods.emplace_back(lod);
+    }
+
+    const MeshBVHNode *bvhNodes = (const MeshBVHNode *) sectionData[SECTION_BVH_NODES];
+    const MeshTrianglePacket *bvhPackets = (const MeshTrianglePacket *) sectionData[SECTION_BVH_PACKETS];
+    uint64_t bvhNodeCount = sectionSize[SECTION_BVH_NODES] / sizeof(MeshBVHNode);
+    uint64_t bvhPacketCount = sectionSize[SECTION_BVH_PACKETS] / sizeof(MeshTrianglePacket);
+
+    // the traversal follows the child and packet references without checking them, and keeps a stack entry per
+    // level. Children follow their parent, so the depths are known once the nodes before them are checked
+    std::vector<uint32_t> nodeDepths(bvhNodeCount, 0);
+    for (uint64_t i = 0; i < bvhNodeCount; i++) {
+        const MeshBVHNode &node = bvhNodes[i];
+        bool valid = node.packetCount == 0 ? node.leftOrFirst > i && (uint64_t) node.leftOrFirst + 1 < bvhNodeCount
+                                           : node.leftOrFirst <= bvhPacketCount &&
+                                             node.packetCount <= bvhPacketCount - node.leftOrFirst;
+        if (!valid) {
+            return false;
+        }
+
+        if (node.packetCount == 0) {
+            uint32_t childDepth = nodeDepths[i] + 1;
+            if (childDepth >= MeshBVH::MAX_DEPTH) {
+                ls_log::log(LOG_WARN, "mesh cache %s has a triangle BVH deeper than %u\n", cacheFile.c_str(),
+                            MeshBVH::MAX_DEPTH);
+                return false;
+            }
+            nodeDepths[node.leftOrFirst] = std::max(nodeDepths[node.leftOrFirst], childDepth);
+            nodeDepths[node.leftOrFirst + 1] = std::max(nodeDepths[node.leftOrFirst + 1], childDepth);
+        }
+    }
+
+    // the packets number the full detail triangles, the levels of detail follow them in the index section
+    uint64_t triangleCount = 0;
+    for (uint64_t i = 0; i < subMeshCount; i++) {
+        triangleCount += subMeshes[i].indexCount / 3;
+    }
+    for (uint64_t i = 0; i < bvhPacketCount; i++) {
+        for (uint32_t triangle : bvhPackets[i].triangles) {
+            if (triangle != UINT32_MAX && triangle >= triangleCount) {
+                return false;
+            }
+        }
+    }
+
+    model->mesh.materialSubMeshes = std::move(materialSubMeshes);
+    model->bvh.nodes.clear();
+    model->bvh.packets.clear();
+    model->bvh.mappedNodes = bvhNodes;
+    model->bvh.mappedNodeCount = (uint32_t) bvhNodeCount;
+    model->bvh.mappedPackets = bvhPackets;
+    model->bvh.mappedPacketCount = (uint32_t) bvhPacketCount;
+    model->bvh.setSubMeshes(*model);
+
+    model->vertices.clear();
+    model->mappedVertices = vertices;
+    model->mappedVertexCount = (uint32_t) vertexCount;
+    model->materials = materials;
+    model->cookedData = mapping;
+
+    return true;
+}
+
+bool MeshCache::write(const std::string &cacheFile, const std::vector<std::string> &sourceFiles, const Model &model)
+{
+    CacheWriter sources;
+    sources.write((uint32_t) sourceFiles.size());
+    for (const auto &file : sourceFiles) {
+        if (!writeSourceFile(&sources, file)) {
+            ls_log::log(LOG_WARN, "cannot record source file %s of mesh cache\n", file.c_str());
+            return false;
+        }
+    }
+
+    CacheWriter materials;
+    materials.write((uint32_t) model.materials.size());
+    for (const auto &material : model.materials) {
+        writeMaterial(&materials, material);
+    }
+
+    CacheWriter subMeshes;
+    CacheWriter indices;
+    uint64_t firstIndex = 0;
+    for (const auto &subMesh : model.mesh.materialSubMeshes) {
+        MeshCacheSubMesh entry = {};
+        entry.materialIndex = subMesh.materialIndex;
+        entry.indexCount = subMesh.getIndexCount();
+        entry.firstIndex = firstIndex;
+        subMeshes.write(entry);
+
+        indices.write(subMesh.getIndexData(), subMesh.getIndexCount() * sizeof(uint32_t));
+        firstIndex += subMesh.getIndexCount();
+    }
+
+    CacheWriter lods;
+    for (uint32_t i = 0; i < model.mesh.materialSubMeshes.size(); i++) {
+        for (const auto &lod : model.mesh.materialSubMeshes[i].lods) {
+            MeshCacheLod entry = {};
+            entry.subMesh = i;
+            entry.indexCount = lod.getIndexCount();
+            entry.firstIndex = firstIndex;
+            entry.error = lod.error;
+            lods.write(entry);
+
+            indices.write(lod.getIndexData(), lod.getIndexCount() * sizeof(uint32_t));
+            firstIndex += lod.getIndexCount();
+        }
+    }
+
+    struct SectionContents {
+        const void *data;
+        uint64_t size;
+    };
+
+    // NB: in the order of {MeshCacheSectionType}
+    const SectionContents contents[] = {
+            {sources.bytes.data(),   sources.bytes.size()},
+            {materials.bytes.data(), materials.bytes.size()},
+            {subMeshes.bytes.data(), subMeshes.bytes.size()},
+            {model.getVertexData(),  model.getVertexCount() * sizeof(Vertex)},
+            {indices.bytes.data(),   indices.bytes.size()},
+            {lods.bytes.data(),      lods.bytes.size()},
+            {model.bvh.getNodeData(),   model.bvh.getNodeCount() * sizeof(MeshBVHNode)},
+            {model.bvh.getPacketData(), model.bvh.getPacketCount() * sizeof(MeshTrianglePacket)}
+    };
+    const uint32_t SECTION_COUNT = SECTION_BVH_PACKETS + 1;
+
+    MeshCacheHeader header = {};
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+    header.version = VERSION;
+    header.vertexSize = sizeof(Vertex);
+    header.sectionCount = SECTION_COUNT;
+
+    // 16 byte alignment of the section data keeps the mapped arrays aligned
+    uint64_t headerSize = sizeof(MeshCacheHeader) + SECTION_COUNT * sizeof(MeshCacheSection);
+    uint64_t offset = headerSize;
+    std::vector<MeshCacheSection> sections(SECTION_COUNT);
+    for (uint32_t i = 0; i < SECTION_COUNT; i++) {
+        offset = (offset + 15) & ~(uint64_t) 15;
+
+        sections[i].type = i;
+        sections[i].offset = offset;
+        sections[i].size = contents[i].size;
+        offset += contents[i].size;
+    }
+
+    // write to a temporary file first, so a crash never leaves a truncated cache behind. The name is unique per
+    // writer, as the same model may be imported by several loads, or several instances of the application, at once
+    static const uint32_t PROCESS_TAG = std::random_device()();
+    static std::atomic<uint32_t> nextTempFile(0);
+    char tempSuffix[32];
+    snprintf(tempSuffix, sizeof(tempSuffix), ".%08x.%u.tmp", PROCESS_TAG, nextTempFile++);
+    std::string tempFile = cacheFile + tempSuffix;
+    FILE *file = fopen(tempFile.c_str(), "wb");
+    if (!file) {
+        ls_log::log(LOG_WARN, "cannot write mesh cache %s\n", cacheFile.c_str());
+        return false;
+    }
+
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+    success &= fwrite(sections.data(), sizeof(MeshCacheSection), SECTION_COUNT, file) == SECTION_COUNT;
+
+    const char padding[16] = {};
+    uint64_t written = headerSize;
+    for (uint32_t i = 0; i < SECTION_COUNT && success; i++) {
+        success &= fwrite(padding, 1, sections[i].offset - written, file) == sections[i].offset - written;
+        if (contents[i].size > 0) {
+            success &= fwrite(contents[i].data, 1, contents[i].size, file) == contents[i].size;
+        }
+        written = sections[i].offset + sections[i].size;
+    }
+
+    success &= fclose(file) == 0;
+
+    // NB: rename does not replace an existing file on all platforms
+    remove(cacheFile.c_str());
+    if (!success || rename(tempFile.c_str(), cacheFile.c_str()) != 0) {
+        ls_log::log(LOG_WARN, "cannot write mesh cache %s\n", cacheFile.c_str());
+        remove(tempFile.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,41 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#ifndef GAME_MESH_CACHE_HPP
+#define GAME_MESH_CACHE_HPP
+
+#include <string>
+#include <vector>
+
+#include "asset_manager.hpp"
+
+/**
+ * Cooked mesh cache (.lsmesh files). A cache file holds the final vertices, the per-material index buffers and the
+ * material table of a {Model}, together with the hash, modification time and size of every source file it was
+ * cooked from. Levels of detail are stored as additional index ranges, the triangle hierarchy ({MeshBVH}) as its
+ * nodes and triangle packets. Loading maps the file into memory and points the model at the mapped arrays, without
+ * copying.
+ *
+ * Layout: a {MeshCacheHeader}, followed by {MeshCacheHeader::sectionCount} {MeshCacheSection} entries, followed by
+ * the 16-byte aligned section data.
+ */
+struct MeshCache {
+    /**
+     * Bump whenever the layout of the file or the output of the importer changes, to invalidate existing caches.
+     */
+    static const uint32_t VERSION = 4;
+
+    /**
+     * Maps {cacheFile} into {model} if it exists, has the current version and all of its source files are unchanged.
+     * Texture images are not part of the cache, only their paths are restored.
+     */
+    static bool load(const std::string &cacheFile, Model *model);
+
+    /**
+     * Writes {model} to {cacheFile}, recording {sourceFiles} as the files the model was imported from.
+     */
+    static bool write(const std::string &cacheFile, const std::vector<std::string> &sourceFiles, const Model &model);
+};
+
+#endif //GAME_MESH_CACHE_HPP
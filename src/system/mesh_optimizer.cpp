@@ -0,0 +1,287 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#include "mesh_optimizer.hpp"
+
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+#include "../util/ls_log.hpp"
+#include "../util/thread_pool.hpp"
+
+/**
+ * Parameters of the vertex scoring function, the values recommended by Forsyth.
+ */
+static const uint32_t SCORING_CACHE_SIZE = 32;
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+/**
+ * Score of a vertex at position {cachePosition} of the LRU cache (-1 if not cached) with {remainingTriangles} triangles
+ * still to be emitted. Vertices of the last triangle get a fixed score so the next triangle is not biased towards
+ * one of its edges.
+ */
+static float vertexScore(int32_t cachePosition, uint32_t remainingTriangles)
+{
+    if (remainingTriangles == 0) {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            score = LAST_TRIANGLE_SCORE;
+        } else {
+            float scale = 1.0f / (SCORING_CACHE_SIZE - 3);
+            score = std::pow(1.0f - (float) (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+        }
+    }
+
+    // boost vertices with few triangles left, so lone triangles are not left behind
+    score += VALENCE_BOOST_SCALE * std::pow((float) remainingTriangles, -VALENCE_BOOST_POWER);
+    return score;
+}
+
+float VertexCacheStatistics::acmr() const
+{
+    return triangles ? (float) transformedVertices / (float) triangles : 0.0f;
+}
+
+float VertexCacheStatistics::atvr() const
+{
+    return uniqueVertices ? (float) transformedVertices / (float) uniqueVertices : 0.0f;
+}
+
+void VertexCacheStatistics::add(const VertexCacheStatistics &other)
+{
+    transformedVertices += other.transformedVertices;
+    triangles += other.triangles;
+    uniqueVertices += other.uniqueVertices;
+}
+
+VertexCacheStatistics MeshOptimizer::analyzeVertexCache(const uint32_t *indices, uint32_t indexCount,
+                                                        uint32_t vertexCount)
+{
+    VertexCacheStatistics result;
+    result.triangles = indexCount / 3;
+
+    // a vertex is in the FIFO cache if fewer than ANALYSIS_CACHE_SIZE vertices were transformed since its own
+    // transform, 0 means never transformed
+    std::vector<uint32_t> transformTimes(vertexCount, 0);
+    uint32_t time = ANALYSIS_CACHE_SIZE + 1;
+
+    for (uint32_t i = 0; i < indexCount; i++) {
+        uint32_t &transformTime = transformTimes[indices[i]];
+        if (transformTime == 0) {
+            result.uniqueVertices++;
+        }
+
+        if (time - transformTime > ANALYSIS_CACHE_SIZE) {
+            transformTime = time++;
+            result.transformedVertices++;
+        }
+    }
+
+    return result;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t> *indices, uint32_t vertexCount)
+{
+    auto triangleCount = (uint32_t) (indices->size() / 3);
+    if (triangleCount < 2) {
+        return;
+    }
+
+    // work with submesh-local vertex numbers, so the arrays below scale with the submesh and not with the model
+    std::vector<uint32_t> localVertices(vertexCount, UINT32_MAX);
+    std::vector<uint32_t> globalVertices;
+    std::vector<uint32_t> triangles(triangleCount * 3);
+    for (uint32_t i = 0; i < triangleCount * 3; i++) {
+        uint32_t &local = localVertices[(*indices)[i]];
+        if (local == UINT32_MAX) {
+            local = (uint32_t) globalVertices.size();
+            globalVertices.emplace_back((*indices)[i]);
+        }
+        triangles[i] = local;
+    }
+
+    auto uniqueCount = (uint32_t) globalVertices.size();
+
+    // triangles of each vertex, the first {remaining} of which are not yet emitted
+    std::vector<uint32_t> remaining(uniqueCount, 0);
+    for (uint32_t vertex : triangles) {
+        remaining[vertex]++;
+    }
+
+    std::vector<uint32_t> adjacencyOffsets(uniqueCount + 1, 0);
+    for (uint32_t v = 0; v < uniqueCount; v++) {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+    }
+
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (uint32_t i = 0; i < triangleCount * 3; i++) {
+        adjacency[adjacencyFill[triangles[i]]++] = i / 3;
+    }
+
+    std::vector<int32_t> cachePositions(uniqueCount, -1);
+    std::vector<float> vertexScores(uniqueCount);
+    for (uint32_t v = 0; v < uniqueCount; v++) {
+        vertexScores[v] = vertexScore(-1, remaining[v]);
+    }
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    uint32_t bestTriangle = 0;
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        triangleScores[t] = vertexScores[triangles[t * 3]] + vertexScores[triangles[t * 3 + 1]] +
+                            vertexScores[triangles[t * 3 + 2]];
+        if (triangleScores[t] > triangleScores[bestTriangle]) {
+            bestTriangle = t;
+        }
+    }
+
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> newCache;
+    cache.reserve(SCORING_CACHE_SIZE + 3);
+    newCache.reserve(SCORING_CACHE_SIZE + 3);
+
+    uint32_t scanPosition = 0;
+    std::vector<uint32_t> &result = *indices;
+
+    for (uint32_t i = 0; i < triangleCount; i++) {
+        if (bestTriangle == UINT32_MAX) {
+            // no cached vertex has triangles left, continue with the next triangle in the original order
+            while (emitted[scanPosition]) {
+                scanPosition++;
+            }
+            bestTriangle = scanPosition;
+        }
+
+        const uint32_t *triangle = &triangles[bestTriangle * 3];
+        emitted[bestTriangle] = true;
+        newCache.clear();
+
+        for (uint32_t c = 0; c < 3; c++) {
+            uint32_t vertex = triangle[c];
+            result[i * 3 + c] = globalVertices[vertex];
+
+            // remove the triangle from the remaining triangles of the vertex
+            uint32_t *begin = &adjacency[adjacencyOffsets[vertex]];
+            uint32_t *end = begin + remaining[vertex];
+            *std::find(begin, end, bestTriangle) = *(end - 1);
+            remaining[vertex]--;
+
+            newCache.emplace_back(vertex);
+        }
+
+        for (uint32_t vertex : cache) {
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]) {
+                newCache.emplace_back(vertex);
+            }
+        }
+
+        // rescore all vertices that were or are in the cache, which includes the ones falling out of it
+        bestTriangle = UINT32_MAX;
+        float bestScore = -1.0f;
+        for (uint32_t c = 0; c < newCache.size(); c++) {
+            uint32_t vertex = newCache[c];
+            int32_t position = (c < SCORING_CACHE_SIZE) ? (int32_t) c : -1;
+            cachePositions[vertex] = position;
+
+            float score = vertexScore(position, remaining[vertex]);
+            float delta = score - vertexScores[vertex];
+            vertexScores[vertex] = score;
+
+            for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex] + remaining[vertex]; a++) {
+                uint32_t t = adjacency[a];
+                triangleScores[t] += delta;
+                if (position >= 0 && triangleScores[t] > bestScore) {
+                    bestScore = triangleScores[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        if (newCache.size() > SCORING_CACHE_SIZE) {
+            newCache.resize(SCORING_CACHE_SIZE);
+        }
+        std::swap(cache, newCache);
+    }
+}
+
+void MeshOptimizer::optimizeVertexFetch(Model *model)
+{
+    auto vertexCount = (uint32_t) model->vertices.size();
+    std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+    uint32_t nextVertex = 0;
+
+    for (auto &subMesh : model->mesh.materialSubMeshes) {
+        for (uint32_t &index : subMesh.indices) {
+            if (remap[index] == UINT32_MAX) {
+                remap[index] = nextVertex++;
+            }
+            index = remap[index];
+        }
+    }
+
+    // levels of detail use a subset of the vertices of their submesh
+    for (auto &subMesh : model->mesh.materialSubMeshes) {
+        for (auto &lod : subMesh.lods) {
+            for (uint32_t &index : lod.indices) {
+                index = remap[index];
+            }
+        }
+    }
+
+    for (uint32_t &newIndex : remap) {
+        if (newIndex == UINT32_MAX) {
+            newIndex = nextVertex++;
+        }
+    }
+
+    std::vector<Vertex> vertices(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        vertices[remap[v]] = model->vertices[v];
+    }
+    model->vertices.swap(vertices);
+}
+
+void MeshOptimizer::optimize(Model *model)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    auto vertexCount = (uint32_t) model->vertices.size();
+    std::vector<MaterialSubMesh> &subMeshes = model->mesh.materialSubMeshes;
+    std::vector<VertexCacheStatistics> before(subMeshes.size());
+
+    ThreadPool::get_instance()->parallel_for(subMeshes.size(), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            std::vector<uint32_t> &indices = subMeshes[i].indices;
+            before[i] = analyzeVertexCache(indices.data(), (uint32_t) indices.size(), vertexCount);
+            optimizeVertexCache(&indices, vertexCount);
+            for (auto &lod : subMeshes[i].lods) {
+                optimizeVertexCache(&lod.indices, vertexCount);
+            }
+        }
+    });
+
+    optimizeVertexFetch(model);
+
+    VertexCacheStatistics totalBefore;
+    VertexCacheStatistics totalAfter;
+    for (uint32_t i = 0; i < subMeshes.size(); i++) {
+        const std::vector<uint32_t> &indices = subMeshes[i].indices;
+        totalBefore.add(before[i]);
+        totalAfter.add(analyzeVertexCache(indices.data(), (uint32_t) indices.size(), vertexCount));
+    }
+
+    double optimizeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    ls_log::log(LOG_INFO, "optimized %s in %.1f ms: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (FIFO cache of %u)\n",
+                model->mesh.name.c_str(), optimizeMs, totalBefore.acmr(), totalAfter.acmr(), totalBefore.atvr(),
+                totalAfter.atvr(), ANALYSIS_CACHE_SIZE);
+}
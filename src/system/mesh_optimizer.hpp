@@ -0,0 +1,69 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#ifndef GAME_MESH_OPTIMIZER_HPP
+#define GAME_MESH_OPTIMIZER_HPP
+
+#include <vector>
+
+#include "asset_manager.hpp"
+
+/**
+ * Vertex cache efficiency of an index buffer, measured with a FIFO cache of {MeshOptimizer::ANALYSIS_CACHE_SIZE}.
+ */
+struct VertexCacheStatistics {
+    /**
+     * Number of vertices the vertex shader runs for.
+     */
+    uint32_t transformedVertices = 0;
+    uint32_t triangles = 0;
+    uint32_t uniqueVertices = 0;
+
+    /**
+     * Average cache miss ratio: transformed vertices per triangle, between 0.5 (ideal grid) and 3 (no reuse).
+     */
+    float acmr() const;
+
+    /**
+     * Average transform to vertex ratio: transformed vertices per unique vertex, 1 is ideal.
+     */
+    float atvr() const;
+
+    void add(const VertexCacheStatistics &other);
+};
+
+/**
+ * Import-stage reordering of model geometry for the GPU. Reordering leaves the rendered image unchanged.
+ */
+struct MeshOptimizer {
+    /**
+     * Size of the simulated post-transform cache used for the statistics, a conservative estimate for current GPUs.
+     */
+    static const uint32_t ANALYSIS_CACHE_SIZE = 16;
+
+    /**
+     * Optimizes all submeshes of {model}, and their levels of detail, with {optimizeVertexCache} and then
+     * {optimizeVertexFetch}, and logs the vertex cache statistics of the submeshes before and after. The model must
+     * not be memory-mapped.
+     */
+    static void optimize(Model *model);
+
+    /**
+     * Reorders the triangles of {indices} for post-transform cache reuse, with the algorithm of Tom Forsyth's
+     * "Linear-Speed Vertex Cache Optimisation": triangles are greedily emitted by the score of their vertices, which
+     * favours vertices recently used and vertices with few remaining triangles. Indices must be below {vertexCount}.
+     */
+    static void optimizeVertexCache(std::vector<uint32_t> *indices, uint32_t vertexCount);
+
+    /**
+     * Renumbers the vertices of {model} in the order in which the submeshes first use them, so vertex fetch walks
+     * through the vertex buffer mostly sequentially. Unreferenced vertices are moved to the end.
+     */
+    static void optimizeVertexFetch(Model *model);
+
+    static VertexCacheStatistics analyzeVertexCache(const uint32_t *indices, uint32_t indexCount,
+                                                    uint32_t vertexCount);
+};
+
+#endif //GAME_MESH_OPTIMIZER_HPP
@@ -0,0 +1,553 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#include "mesh_simplifier.hpp"
+
+#include <cmath>
+#include <chrono>
+#include <tuple>
+#include <algorithm>
+#include <unordered_set>
+
+#include <glm/glm.hpp>
+
+#include "../util/ls_log.hpp"
+#include "../util/thread_pool.hpp"
+
+/**
+ * Weight of the constraint planes of border and seam edges, relative to the area weight of the triangle planes.
+ */
+static const double EDGE_CONSTRAINT_WEIGHT = 10.0;
+
+static const uint32_t NO_VERTEX = UINT32_MAX;
+
+/**
+ * Symmetric 4x4 matrix of which x^T Q x is the weighted sum of squared distances of point x to a set of planes.
+ */
+struct Quadric {
+    double a00, a01, a02, a03;
+    double a11, a12, a13;
+    double a22, a23;
+    double a33;
+
+    /**
+     * Sum of the plane weights, to turn the error into a mean squared distance.
+     */
+    double weight;
+};
+
+/**
+ * Adds the plane with unit {normal} through {point}.
+ */
+static void addPlane(Quadric *q, glm::vec3 normal, glm::vec3 point, double weight)
+{
+    double x = normal.x;
+    double y = normal.y;
+    double z = normal.z;
+    double d = -(x * point.x + y * point.y + z * point.z);
+
+    q->a00 += weight * x * x;
+    q->a01 += weight * x * y;
+    q->a02 += weight * x * z;
+    q->a03 += weight * x * d;
+    q->a11 += weight * y * y;
+    q->a12 += weight * y * z;
+    q->a13 += weight * y * d;
+    q->a22 += weight * z * z;
+    q->a23 += weight * z * d;
+    q->a33 += weight * d * d;
+    q->weight += weight;
+}
+
+static void addQuadric(Quadric *q, const Quadric &other)
+{
+    q->a00 += other.a00;
+    q->a01 += other.a01;
+    q->a02 += other.a02;
+    q->a03 += other.a03;
+    q->a11 += other.a11;
+    q->a12 += other.a12;
+    q->a13 += other.a13;
+    q->a22 += other.a22;
+    q->a23 += other.a23;
+    q->a33 += other.a33;
+    q->weight += other.weight;
+}
+
+/**
+ * Weighted mean squared distance of {point} to the planes of {q}.
+ */
+static double quadricError(const Quadric &q, glm::vec3 point)
+{
+    if (q.weight <= 0) {
+        return 0;
+    }
+
+    double x = point.x;
+    double y = point.y;
+    double z = point.z;
+    double error = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z +
+                   2 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z) +
+                   2 * (q.a03 * x + q.a13 * y + q.a23 * z) + q.a33;
+
+    return std::max(error, 0.0) / q.weight;
+}
+
+static uint64_t edgeKey(uint32_t from, uint32_t to)
+{
+    return ((uint64_t) from << 32) | to;
+}
+
+/**
+ * Collapse of position {from} onto position {to}.
+ */
+struct EdgeCollapse {
+    uint32_t from;
+    uint32_t to;
+    double error;
+};
+
+/**
+ * State of a single {MeshSimplifier::simplify} call. Vertices are numbered locally, in order of first use, and a
+ * position is identified by the first of the vertices at that position.
+ */
+struct SimplifyContext {
+    std::vector<uint32_t> globalVertices;
+    std::vector<glm::vec3> positions;
+
+    /**
+     * Position of each vertex, and the next vertex at the same position (a circular list of the 'wedges').
+     */
+    std::vector<uint32_t> positionOf;
+    std::vector<uint32_t> nextWedge;
+
+    std::vector<uint32_t> triangles;
+    std::vector<Quadric> quadrics;
+
+    /**
+     * Final vertex of each collapsed vertex.
+     */
+    std::vector<uint32_t> remap;
+
+    /**
+     * Directed edges of the current triangles, by vertex and by position.
+     */
+    std::unordered_set<uint64_t> vertexEdges;
+    std::unordered_set<uint64_t> positionEdges;
+
+    std::vector<bool> onBorder;
+    std::vector<bool> used;
+
+    /**
+     * Triangles around each position, {adjacency[adjacencyOffsets[p]]} up to {adjacency[adjacencyOffsets[p + 1]]}.
+     */
+    std::vector<uint32_t> adjacencyOffsets;
+    std::vector<uint32_t> adjacency;
+
+    std::vector<bool> locked;
+
+    /**
+     * Wedge pairs of the collapse checked last by {canCollapse}.
+     */
+    std::vector<std::pair<uint32_t, uint32_t>> wedgeCollapses;
+
+    void init(const std::vector<uint32_t> &indices, const Vertex *vertices, uint32_t vertexCount)
+    {
+        std::vector<uint32_t> localVertices(vertexCount, NO_VERTEX);
+        triangles.resize(indices.size());
+        for (size_t i = 0; i < indices.size(); i++) {
+            uint32_t &local = localVertices[indices[i]];
+            if (local == NO_VERTEX) {
+                local = (uint32_t) globalVertices.size();
+                globalVertices.emplace_back(indices[i]);
+                positions.emplace_back(vertices[indices[i]].position);
+            }
+            triangles[i] = local;
+        }
+
+        auto count = (uint32_t) globalVertices.size();
+
+        // group vertices with bitwise equal positions by sorting them
+        std::vector<uint32_t> order(count);
+        for (uint32_t v = 0; v < count; v++) {
+            order[v] = v;
+        }
+        std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+            const glm::vec3 &pa = positions[a];
+            const glm::vec3 &pb = positions[b];
+            return std::tie(pa.x, pa.y, pa.z, a) < std::tie(pb.x, pb.y, pb.z, b);
+        });
+
+        positionOf.resize(count);
+        nextWedge.resize(count);
+        for (uint32_t i = 0; i < count;) {
+            uint32_t end = i + 1;
+            while (end < count && positions[order[end]] == positions[order[i]]) {
+                end++;
+            }
+
+            for (uint32_t j = i; j < end; j++) {
+                positionOf[order[j]] = order[i];
+                nextWedge[order[j]] = order[(j + 1 < end) ? j + 1 : i];
+            }
+            i = end;
+        }
+
+        remap.resize(count);
+        for (uint32_t v = 0; v < count; v++) {
+            remap[v] = v;
+        }
+
+        onBorder.resize(count);
+        used.resize(count);
+        locked.resize(count);
+
+        buildTopology();
+        initQuadrics();
+    }
+
+    bool isBorderEdge(uint32_t a, uint32_t b) const
+    {
+        return positionEdges.count(edgeKey(a, b)) != positionEdges.count(edgeKey(b, a));
+    }
+
+    /**
+     * Rebuilds the edges, borders and adjacency of the current triangles.
+     */
+    void buildTopology()
+    {
+        auto count = (uint32_t) positionOf.size();
+
+        vertexEdges.clear();
+        positionEdges.clear();
+        std::fill(used.begin(), used.end(), false);
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            for (uint32_t c = 0; c < 3; c++) {
+                uint32_t a = triangles[t + c];
+                uint32_t b = triangles[t + (c + 1) % 3];
+                vertexEdges.insert(edgeKey(a, b));
+                positionEdges.insert(edgeKey(positionOf[a], positionOf[b]));
+                used[a] = true;
+            }
+        }
+
+        std::fill(onBorder.begin(), onBorder.end(), false);
+        for (uint64_t edge : positionEdges) {
+            auto a = (uint32_t) (edge >> 32);
+            auto b = (uint32_t) edge;
+            if (!positionEdges.count(edgeKey(b, a))) {
+                onBorder[a] = true;
+                onBorder[b] = true;
+            }
+        }
+
+        adjacencyOffsets.assign(count + 1, 0);
+        for (uint32_t vertex : triangles) {
+            adjacencyOffsets[positionOf[vertex] + 1]++;
+        }
+        for (uint32_t p = 0; p < count; p++) {
+            adjacencyOffsets[p + 1] += adjacencyOffsets[p];
+        }
+
+        adjacency.resize(triangles.size());
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < triangles.size(); i++) {
+            adjacency[fill[positionOf[triangles[i]]]++] = (uint32_t) (i / 3);
+        }
+    }
+
+    void initQuadrics()
+    {
+        quadrics.assign(positionOf.size(), Quadric());
+
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            const uint32_t *triangle = &triangles[t];
+            glm::vec3 p0 = positions[triangle[0]];
+            glm::vec3 normal = glm::cross(positions[triangle[1]] - p0, positions[triangle[2]] - p0);
+            float doubleArea = glm::length(normal);
+            if (doubleArea == 0) {
+                continue;
+            }
+            normal /= doubleArea;
+
+            for (uint32_t c = 0; c < 3; c++) {
+                addPlane(&quadrics[positionOf[triangle[c]]], normal, p0, doubleArea * 0.5);
+            }
+
+            // borders and seams are kept in place by a plane through the edge, perpendicular to the triangle
+            for (uint32_t c = 0; c < 3; c++) {
+                uint32_t a = triangle[c];
+                uint32_t b = triangle[(c + 1) % 3];
+                bool border = !positionEdges.count(edgeKey(positionOf[b], positionOf[a]));
+                bool seam = !border && !vertexEdges.count(edgeKey(b, a));
+                if (!border && !seam) {
+                    continue;
+                }
+
+                glm::vec3 edge = positions[b] - positions[a];
+                glm::vec3 edgeNormal = glm::cross(edge, normal);
+                float length = glm::length(edgeNormal);
+                if (length == 0) {
+                    continue;
+                }
+
+                double weight = (double) length * length * EDGE_CONSTRAINT_WEIGHT;
+                addPlane(&quadrics[positionOf[a]], edgeNormal / length, positions[a], weight);
+                addPlane(&quadrics[positionOf[b]], edgeNormal / length, positions[a], weight);
+            }
+        }
+    }
+
+    /**
+     * Whether position {from} can be collapsed onto position {to}, filling {wedgeCollapses} if so. Every vertex at
+     * {from} must share a triangle with exactly one vertex at {to}, which it is then replaced by; this keeps the
+     * attributes on both sides of a seam apart. Border positions may only move along the border.
+     */
+    bool canCollapse(uint32_t from, uint32_t to)
+    {
+        if (onBorder[from] && !isBorderEdge(from, to)) {
+            return false;
+        }
+
+        wedgeCollapses.clear();
+        uint32_t wedge = from;
+        do {
+            if (used[wedge]) {
+                uint32_t target = NO_VERTEX;
+                for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; a++) {
+                    const uint32_t *triangle = &triangles[adjacency[a] * 3];
+                    if (triangle[0] != wedge && triangle[1] != wedge && triangle[2] != wedge) {
+                        continue;
+                    }
+
+                    for (uint32_t c = 0; c < 3; c++) {
+                        if (positionOf[triangle[c]] == to) {
+                            if (target != NO_VERTEX && target != triangle[c]) {
+                                return false;
+                            }
+                            target = triangle[c];
+                        }
+                    }
+                }
+
+                if (target == NO_VERTEX) {
+                    return false;
+                }
+                wedgeCollapses.emplace_back(wedge, target);
+            }
+
+            wedge = nextWedge[wedge];
+        } while (wedge != from);
+
+        return true;
+    }
+
+    /**
+     * Whether collapsing {from} onto {to} turns any of the remaining triangles around {from} over.
+     */
+    bool flipsTriangles(uint32_t from, uint32_t to) const
+    {
+        for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; a++) {
+            const uint32_t *triangle = &triangles[adjacency[a] * 3];
+            glm::vec3 before[3];
+            glm::vec3 after[3];
+            bool removed = false;
+            for (uint32_t c = 0; c < 3; c++) {
+                uint32_t position = positionOf[triangle[c]];
+                removed |= position == to;
+                before[c] = positions[position];
+                after[c] = (position == from) ? positions[to] : before[c];
+            }
+
+            if (removed) {
+                continue;
+            }
+
+            glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+            glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+            if (glm::dot(normalBefore, normalAfter) <= 0) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * Performs a pass of non-overlapping collapses, cheapest first, and removes the resulting degenerate triangles.
+     * Returns the number of collapses.
+     */
+    uint32_t collapsePass(uint32_t targetIndexCount, double *maxError)
+    {
+        std::vector<EdgeCollapse> candidates;
+        candidates.reserve(triangles.size() * 2);
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            for (uint32_t c = 0; c < 3; c++) {
+                uint32_t a = positionOf[triangles[t + c]];
+                uint32_t b = positionOf[triangles[t + (c + 1) % 3]];
+                candidates.push_back({a, b, 0});
+                candidates.push_back({b, a, 0});
+            }
+        }
+
+        std::sort(candidates.begin(), candidates.end(), [](const EdgeCollapse &a, const EdgeCollapse &b) {
+            return std::tie(a.from, a.to) < std::tie(b.from, b.to);
+        });
+        candidates.erase(std::unique(candidates.begin(), candidates.end(),
+                                     [](const EdgeCollapse &a, const EdgeCollapse &b) {
+                                         return a.from == b.from && a.to == b.to;
+                                     }), candidates.end());
+
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [this](const EdgeCollapse &collapse) {
+            return !canCollapse(collapse.from, collapse.to);
+        }), candidates.end());
+
+        for (auto &collapse : candidates) {
+            Quadric quadric = quadrics[collapse.from];
+            addQuadric(&quadric, quadrics[collapse.to]);
+            collapse.error = quadricError(quadric, positions[collapse.to]);
+        }
+
+        std::sort(candidates.begin(), candidates.end(), [](const EdgeCollapse &a, const EdgeCollapse &b) {
+            return a.error < b.error;
+        });
+
+        // a collapse in a closed manifold region removes two triangles
+        auto triangleCount = (uint32_t) (triangles.size() / 3);
+        uint32_t collapseLimit = std::max((triangleCount - targetIndexCount / 3) / 2, 1u);
+        uint32_t collapses = 0;
+
+        std::fill(locked.begin(), locked.end(), false);
+        for (const auto &collapse : candidates) {
+            if (collapses >= collapseLimit) {
+                break;
+            }
+
+            if (locked[collapse.from] || locked[collapse.to] || flipsTriangles(collapse.from, collapse.to)) {
+                continue;
+            }
+
+            // the wedges were found valid before this pass, and the neighbourhood is unchanged since it is unlocked
+            canCollapse(collapse.from, collapse.to);
+            for (const auto &wedgeCollapse : wedgeCollapses) {
+                remap[wedgeCollapse.first] = wedgeCollapse.second;
+            }
+            addQuadric(&quadrics[collapse.to], quadrics[collapse.from]);
+
+            // the triangles around the collapsed position changed, so its neighbours wait for the next pass
+            for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; a++) {
+                for (uint32_t c = 0; c < 3; c++) {
+                    locked[positionOf[triangles[adjacency[a] * 3 + c]]] = true;
+                }
+            }
+
+            *maxError = std::max(*maxError, collapse.error);
+            collapses++;
+        }
+
+        size_t kept = 0;
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            uint32_t a = remap[triangles[t]];
+            uint32_t b = remap[triangles[t + 1]];
+            uint32_t c = remap[triangles[t + 2]];
+            if (positionOf[a] == positionOf[b] || positionOf[b] == positionOf[c] || positionOf[a] == positionOf[c]) {
+                continue;
+            }
+
+            triangles[kept++] = a;
+            triangles[kept++] = b;
+            triangles[kept++] = c;
+        }
+        triangles.resize(kept);
+
+        return collapses;
+    }
+};
+
+float MeshSimplifier::simplify(std::vector<uint32_t> *indices, const Vertex *vertices, uint32_t vertexCount,
+                               uint32_t targetIndexCount)
+{
+    if (indices->size() <= targetIndexCount) {
+        return 0;
+    }
+
+    SimplifyContext context;
+    context.init(*indices, vertices, vertexCount);
+
+    double maxError = 0;
+    while (context.triangles.size() > targetIndexCount) {
+        if (context.collapsePass(targetIndexCount, &maxError) == 0) {
+            break;
+        }
+        context.buildTopology();
+    }
+
+    indices->resize(context.triangles.size());
+    for (size_t i = 0; i < context.triangles.size(); i++) {
+        (*indices)[i] = context.globalVertices[context.triangles[i]];
+    }
+
+    return (float) std::sqrt(maxError);
+}
+
+void MeshSimplifier::generateLods(Model *model)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    const Vertex *vertices = model->vertices.data();
+    auto vertexCount = (uint32_t) model->vertices.size();
+    std::vector<MaterialSubMesh> &subMeshes = model->mesh.materialSubMeshes;
+
+    ThreadPool::get_instance()->parallel_for(subMeshes.size(), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            MaterialSubMesh &subMesh = subMeshes[i];
+            subMesh.lods.clear();
+
+            const std::vector<uint32_t> *previous = &subMesh.indices;
+            float error = 0;
+            while (subMesh.lods.size() < MAX_LOD_COUNT && previous->size() / 3 >= MIN_LOD_TRIANGLES) {
+                auto targetIndexCount = (uint32_t) (previous->size() / 6 * 3);
+
+                MeshLod lod;
+                lod.indices = *previous;
+                float levelError = simplify(&lod.indices, vertices, vertexCount, targetIndexCount);
+                if (lod.indices.size() > previous->size() * 85 / 100) {
+                    break;
+                }
+
+                // each level is simplified from the previous one, so their errors add up
+                error += levelError;
+                lod.error = error;
+                subMesh.lods.emplace_back(std::move(lod));
+                previous = &subMesh.lods.back().indices;
+            }
+        }
+    });
+
+    double generateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    for (uint32_t level = 1; level <= MAX_LOD_COUNT; level++) {
+        uint32_t triangleCount = 0;
+        float maxError = 0;
+        bool present = false;
+        for (const auto &subMesh : subMeshes) {
+            // submeshes with fewer levels are drawn with their coarsest level
+            size_t available = std::min<size_t>(level, subMesh.lods.size());
+            if (available == 0) {
+                triangleCount += subMesh.getIndexCount() / 3;
+            } else {
+                triangleCount += subMesh.lods[available - 1].getIndexCount() / 3;
+                maxError = std::max(maxError, subMesh.lods[available - 1].error);
+            }
+            present |= level <= subMesh.lods.size();
+        }
+
+        if (!present) {
+            break;
+        }
+
+        ls_log::log(LOG_INFO, "LOD %u of %s: %u triangles, error %g\n", level, model->mesh.name.c_str(),
+                    triangleCount, maxError);
+    }
+    ls_log::log(LOG_INFO, "generated LODs of %s in %.1f ms\n", model->mesh.name.c_str(), generateMs);
+}
@@ -0,0 +1,45 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#ifndef GAME_MESH_SIMPLIFIER_HPP
+#define GAME_MESH_SIMPLIFIER_HPP
+
+#include <vector>
+
+#include "asset_manager.hpp"
+
+/**
+ * Quadric error metric simplification (Garland and Heckbert) of index buffers. Edges are collapsed onto one of their
+ * end points, so a simplified index buffer references a subset of the original vertices and no vertices are added.
+ *
+ * Open borders and attribute seams (positions shared by vertices with different normals or texture coordinates) are
+ * only collapsed along themselves and are weighted by additional constraint planes, so they keep their shape.
+ */
+struct MeshSimplifier {
+    /**
+     * Maximum number of levels generated below full detail.
+     */
+    static const uint32_t MAX_LOD_COUNT = 4;
+
+    /**
+     * Submeshes, or levels, with fewer triangles than this are not simplified further.
+     */
+    static const uint32_t MIN_LOD_TRIANGLES = 64;
+
+    /**
+     * Fills {MaterialSubMesh::lods} of every submesh of {model}. Each level targets half the triangles of the level
+     * above and is simplified from it. The chain stops early when a level reduces the triangle count by less than
+     * 15%, as a level that is barely cheaper to draw is not worth its memory. The model must not be memory-mapped.
+     */
+    static void generateLods(Model *model);
+
+    /**
+     * Simplifies the triangles of {indices} towards {targetIndexCount} indices. Stops early if no valid collapse is
+     * left. Returns the largest error of the collapses, in object space units.
+     */
+    static float simplify(std::vector<uint32_t> *indices, const Vertex *vertices, uint32_t vertexCount,
+                          uint32_t targetIndexCount);
+};
+
+#endif //GAME_MESH_SIMPLIFIER_HPP
@@ -0,0 +1,574 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#include "obj_parser.hpp"
+
+#include <map>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <algorithm>
+
+#include "../util/util.hpp"
+#include "../util/mapped_file.hpp"
+#include "../util/thread_pool.hpp"
+
+/**
+ * Index triple of a face corner. Negative OBJ indices refer back from the current end of the attribute arrays,
+ * and are stored relative to the first attribute of the chunk until the chunk offsets are known.
+ */
+struct ObjCorner {
+    int32_t v;
+    int32_t vt;
+    int32_t vn;
+
+    /** Bit 0, 1 and 2 are set when respectively {v}, {vt} and {vn} are relative to the chunk. */
+    uint8_t relative;
+};
+
+/**
+ * A 'usemtl', 'g' or 'o' statement, which applies from the {triangle}-th triangle of the chunk onward.
+ */
+struct ObjNamedEvent {
+    uint32_t triangle;
+    std::string name;
+};
+
+/**
+ * A line-aligned range of the OBJ file, and everything that was parsed from it.
+ */
+struct ObjChunk {
+    const char *begin;
+    const char *end;
+
+    std::vector<float> vertices;
+    std::vector<float> normals;
+    std::vector<float> texcoords;
+
+    /** Three corners per triangle. */
+    std::vector<ObjCorner> corners;
+
+    std::vector<ObjNamedEvent> materialEvents;
+    std::vector<ObjNamedEvent> groupEvents;
+    std::vector<std::string> materialLibraries;
+
+    /** Offsets of this chunk into the merged arrays, and the material active at the start of the chunk. */
+    uint32_t vertexBase = 0;
+    uint32_t normalBase = 0;
+    uint32_t texcoordBase = 0;
+    uint32_t triangleBase = 0;
+    int32_t materialCarry = -1;
+};
+
+struct ObjShapeRange {
+    std::string name;
+    uint32_t firstTriangle;
+    uint32_t triangleCount;
+};
+
+static const double POWERS_OF_TEN[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+static inline bool isLineEnd(char c)
+{
+    return c == '\n' || c == '\r' || c == '\0';
+}
+
+static inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static inline const char *skipSpace(const char *p)
+{
+    while (isSpace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static inline const char *skipToken(const char *p)
+{
+    while (!isSpace(*p) && !isLineEnd(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static std::string parseName(const char *&p)
+{
+    p = skipSpace(p);
+    const char *end = skipToken(p);
+    std::string result(p, end);
+    p = end;
+
+    return result;
+}
+
+/**
+ * Parses a decimal number at {p} and advances {p} past it. Returns false and leaves {out} untouched when there is
+ * no number. Numbers with up to 15 significant digits and a small exponent are converted exactly (the common case
+ * for OBJ files), others are handed to strtod. Both give the correctly rounded double, which is then cast to float.
+ */
+static bool parseFloat(const char *&p, float *out)
+{
+    p = skipSpace(p);
+    const char *start = p;
+
+    bool negative = false;
+    if (*p == '-' || *p == '+') {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int32_t significantDigits = 0;
+    int32_t exponent = 0;
+    bool anyDigits = false;
+
+    while (isDigit(*p)) {
+        if (significantDigits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            significantDigits += (mantissa != 0);
+        } else {
+            exponent++;
+        }
+        anyDigits = true;
+        p++;
+    }
+
+    if (*p == '.') {
+        p++;
+        while (isDigit(*p)) {
+            if (significantDigits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                significantDigits += (mantissa != 0);
+                exponent--;
+            }
+            anyDigits = true;
+            p++;
+        }
+    }
+
+    if (!anyDigits) {
+        // could still be 'inf' or 'nan'
+        char *end;
+        double value = strtod(start, &end);
+        if (end == start) {
+            p = start;
+            return false;
+        }
+        p = end;
+        *out = (float) value;
+        return true;
+    }
+
+    if (*p == 'e' || *p == 'E') {
+        const char *exponentStart = p;
+        p++;
+
+        bool negativeExponent = false;
+        if (*p == '-' || *p == '+') {
+            negativeExponent = *p == '-';
+            p++;
+        }
+
+        if (isDigit(*p)) {
+            int32_t explicitExponent = 0;
+            while (isDigit(*p)) {
+                explicitExponent = std::min(explicitExponent * 10 + (*p - '0'), 100000);
+                p++;
+            }
+            exponent += negativeExponent ? -explicitExponent : explicitExponent;
+        } else {
+            p = exponentStart;
+        }
+    }
+
+    if (significantDigits <= 15 && exponent >= -22 && exponent <= 22) {
+        double value = (double) mantissa;
+        value = (exponent < 0) ? value / POWERS_OF_TEN[-exponent] : value * POWERS_OF_TEN[exponent];
+        *out = (float) (negative ? -value : value);
+    } else {
+        char *end;
+        *out = (float) strtod(start, &end);
+        p = end;
+    }
+
+    return true;
+}
+
+static int32_t parseInt(const char *&p)
+{
+    bool negative = false;
+    if (*p == '-' || *p == '+') {
+        negative = *p == '-';
+        p++;
+    }
+
+    int32_t value = 0;
+    while (isDigit(*p)) {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+
+    return negative ? -value : value;
+}
+
+/**
+ * Converts a 1-based (or negative, relative) OBJ index the way tinyobj does: positive indices become 0-based,
+ * zero stays zero and negative indices count back from {localCount}, the number of elements parsed so far.
+ */
+static inline void fixIndex(int32_t raw, uint32_t localCount, int32_t *index, uint8_t relativeBit, uint8_t *relative)
+{
+    if (raw > 0) {
+        *index = raw - 1;
+    } else if (raw == 0) {
+        *index = 0;
+    } else {
+        *index = (int32_t) localCount + raw;
+        *relative |= relativeBit;
+    }
+}
+
+/** Parses a 'v', 'v/t', 'v//n' or 'v/t/n' face corner. Returns false at the end of the line. */
+static bool parseCorner(const char *&p, const ObjChunk &chunk, ObjCorner *corner)
+{
+    p = skipSpace(p);
+    if (isLineEnd(*p)) {
+        return false;
+    }
+
+    corner->v = -1;
+    corner->vt = -1;
+    corner->vn = -1;
+    corner->relative = 0;
+
+    fixIndex(parseInt(p), chunk.vertices.size() / 3, &corner->v, 1u, &corner->relative);
+
+    if (*p == '/') {
+        p++;
+        if (*p != '/') {
+            fixIndex(parseInt(p), chunk.texcoords.size() / 2, &corner->vt, 2u, &corner->relative);
+        }
+        if (*p == '/') {
+            p++;
+            fixIndex(parseInt(p), chunk.normals.size() / 3, &corner->vn, 4u, &corner->relative);
+        }
+    }
+
+    p = skipToken(p);
+
+    return true;
+}
+
+static void parseChunk(ObjChunk *chunk)
+{
+    std::vector<ObjCorner> face;
+
+    const char *p = chunk->begin;
+    while (p < chunk->end) {
+        const char *line = skipSpace(p);
+
+        if (line[0] == 'v' && isSpace(line[1])) {
+            const char *q = line + 2;
+            float xyz[3] = {0, 0, 0};
+            for (float &value : xyz) {
+                parseFloat(q, &value);
+            }
+            chunk->vertices.insert(chunk->vertices.end(), xyz, xyz + 3);
+        } else if (line[0] == 'v' && line[1] == 'n' && isSpace(line[2])) {
+            const char *q = line + 3;
+            float xyz[3] = {0, 0, 0};
+            for (float &value : xyz) {
+                parseFloat(q, &value);
+            }
+            chunk->normals.insert(chunk->normals.end(), xyz, xyz + 3);
+        } else if (line[0] == 'v' && line[1] == 't' && isSpace(line[2])) {
+            const char *q = line + 3;
+            float uv[2] = {0, 0};
+            for (float &value : uv) {
+                parseFloat(q, &value);
+            }
+            chunk->texcoords.insert(chunk->texcoords.end(), uv, uv + 2);
+        } else if (line[0] == 'f' && isSpace(line[1])) {
+            const char *q = line + 2;
+
+            face.clear();
+            ObjCorner corner = {};
+            while (parseCorner(q, *chunk, &corner)) {
+                face.emplace_back(corner);
+            }
+
+            // fan triangulation, identical to tinyobj
+            for (size_t k = 2; k < face.size(); k++) {
+                chunk->corners.emplace_back(face[0]);
+                chunk->corners.emplace_back(face[k - 1]);
+                chunk->corners.emplace_back(face[k]);
+            }
+        } else if (strncmp(line, "usemtl", 6) == 0 && isSpace(line[6])) {
+            const char *q = line + 7;
+            chunk->materialEvents.push_back({(uint32_t) (chunk->corners.size() / 3), parseName(q)});
+        } else if (strncmp(line, "mtllib", 6) == 0 && isSpace(line[6])) {
+            const char *end = line;
+            while (!isLineEnd(*end)) {
+                end++;
+            }
+            chunk->materialLibraries.emplace_back(line, end);
+        } else if ((line[0] == 'g' || line[0] == 'o') && (isSpace(line[1]) || isLineEnd(line[1]))) {
+            const char *q = line + 1;
+            chunk->groupEvents.push_back({(uint32_t) (chunk->corners.size() / 3), parseName(q)});
+        }
+
+        // advance to the next line
+        p = line;
+        while (*p != '\n' && *p != '\0') {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        p++;
+    }
+}
+
+/** Copies the attributes of {chunk} into the merged arrays and writes its triangles into their shapes. */
+static void resolveChunk(const ObjChunk &chunk, const std::map<std::string, int> &materialMap,
+                         const std::vector<ObjShapeRange> &shapeRanges,
+                         tinyobj::attrib_t *attrib, std::vector<tinyobj::shape_t> *shapes)
+{
+    std::copy(chunk.vertices.begin(), chunk.vertices.end(), attrib->vertices.begin() + chunk.vertexBase * 3);
+    std::copy(chunk.normals.begin(), chunk.normals.end(), attrib->normals.begin() + chunk.normalBase * 3);
+    std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), attrib->texcoords.begin() + chunk.texcoordBase * 2);
+
+    uint32_t triangleCount = chunk.corners.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // shape containing the first triangle of this chunk
+    auto shapeIt = std::upper_bound(
+            shapeRanges.begin(), shapeRanges.end(), chunk.triangleBase,
+            [](uint32_t triangle, const ObjShapeRange &range) { return triangle < range.firstTriangle; });
+    size_t shapeIndex = (shapeIt - shapeRanges.begin()) - 1;
+
+    int32_t material = chunk.materialCarry;
+    size_t materialEvent = 0;
+
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        uint32_t triangle = chunk.triangleBase + t;
+
+        while (triangle >= shapeRanges[shapeIndex].firstTriangle + shapeRanges[shapeIndex].triangleCount) {
+            shapeIndex++;
+        }
+
+        while (materialEvent < chunk.materialEvents.size() && chunk.materialEvents[materialEvent].triangle <= t) {
+            auto found = materialMap.find(chunk.materialEvents[materialEvent].name);
+            material = (found != materialMap.end()) ? found->second : -1;
+            materialEvent++;
+        }
+
+        const ObjShapeRange &range = shapeRanges[shapeIndex];
+        tinyobj::mesh_t &mesh = (*shapes)[shapeIndex].mesh;
+        uint32_t localTriangle = triangle - range.firstTriangle;
+
+        mesh.material_ids[localTriangle] = material;
+
+        for (uint32_t k = 0; k < 3; k++) {
+            const ObjCorner &corner = chunk.corners[t * 3 + k];
+
+            tinyobj::index_t index = {};
+            index.vertex_index = (corner.relative & 1u) ? (int32_t) chunk.vertexBase + corner.v : corner.v;
+            index.texcoord_index = (corner.relative & 2u) ? (int32_t) chunk.texcoordBase + corner.vt : corner.vt;
+            index.normal_index = (corner.relative & 4u) ? (int32_t) chunk.normalBase + corner.vn : corner.vn;
+
+            mesh.indices[localTriangle * 3 + k] = index;
+        }
+    }
+}
+
+bool ObjParser::loadObj(tinyobj::attrib_t *attrib, std::vector<tinyobj::shape_t> *shapes,
+                        std::vector<tinyobj::material_t> *materials, std::string *err,
+                        const std::string &file, const std::string &mtlBaseDir, size_t minChunkSize)
+{
+    char *buffer = nullptr;
+    size_t size = 0;
+    if (Util::read_file(&buffer, &size, file.c_str()) == EXIT_FAILURE) {
+        *err = "Cannot open file [" + file + "]\n";
+        delete[] buffer;
+        return false;
+    }
+
+    ThreadPool *pool = ThreadPool::get_instance();
+
+    // split the file into line-aligned chunks, a few per thread but not so small that the merging dominates
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(pool->get_thread_count() * 4,
+                                                             size / std::max<size_t>(1, minChunkSize)));
+
+    std::vector<ObjChunk> chunks(chunkCount);
+
+    const char *fileEnd = buffer + size;
+    const char *cursor = buffer;
+    for (size_t c = 0; c < chunkCount; c++) {
+        const char *end = (c + 1 == chunkCount) ? fileEnd : std::max<const char *>(cursor, buffer + size * (c + 1) / chunkCount);
+        while (end < fileEnd && (end == buffer || end[-1] != '\n')) {
+            end++;
+        }
+
+        chunks[c].begin = cursor;
+        chunks[c].end = end;
+        cursor = end;
+    }
+
+    pool->parallel_for(chunkCount, [&chunks](uint32_t begin, uint32_t end) {
+        for (uint32_t c = begin; c < end; c++) {
+            parseChunk(&chunks[c]);
+        }
+    });
+
+    // materials are read with tinyobj, by feeding it just the 'mtllib' statements
+    std::string materialLibraries;
+    for (const auto &chunk : chunks) {
+        for (const auto &library : chunk.materialLibraries) {
+            materialLibraries += library + "\n";
+        }
+    }
+
+    materials->clear();
+    if (!materialLibraries.empty()) {
+        tinyobj::attrib_t unusedAttrib;
+        std::vector<tinyobj::shape_t> unusedShapes;
+        std::istringstream stream(materialLibraries);
+        tinyobj::MaterialFileReader materialReader(mtlBaseDir);
+
+        tinyobj::LoadObj(&unusedAttrib, &unusedShapes, materials, err, &stream, &materialReader);
+    }
+
+    std::map<std::string, int> materialMap;
+    for (size_t i = 0; i < materials->size(); i++) {
+        materialMap.emplace((*materials)[i].name, (int) i);
+    }
+
+    // compute the offset of each chunk in the merged arrays, and the material active at its start
+    uint32_t vertexCount = 0;
+    uint32_t normalCount = 0;
+    uint32_t texcoordCount = 0;
+    uint32_t triangleCount = 0;
+    int32_t material = -1;
+
+    std::vector<ObjShapeRange> shapeRanges;
+    std::string shapeName;
+    uint32_t shapeStart = 0;
+
+    for (auto &chunk : chunks) {
+        chunk.vertexBase = vertexCount;
+        chunk.normalBase = normalCount;
+        chunk.texcoordBase = texcoordCount;
+        chunk.triangleBase = triangleCount;
+        chunk.materialCarry = material;
+
+        vertexCount += chunk.vertices.size() / 3;
+        normalCount += chunk.normals.size() / 3;
+        texcoordCount += chunk.texcoords.size() / 2;
+        triangleCount += chunk.corners.size() / 3;
+
+        if (!chunk.materialEvents.empty()) {
+            auto found = materialMap.find(chunk.materialEvents.back().name);
+            material = (found != materialMap.end()) ? found->second : -1;
+        }
+
+        // a group statement starts a new shape, as long as the previous one received any faces
+        for (const auto &event : chunk.groupEvents) {
+            uint32_t triangle = chunk.triangleBase + event.triangle;
+            if (triangle > shapeStart) {
+                shapeRanges.push_back({shapeName, shapeStart, triangle - shapeStart});
+            }
+            shapeName = event.name;
+            shapeStart = triangle;
+        }
+    }
+
+    if (triangleCount > shapeStart) {
+        shapeRanges.push_back({shapeName, shapeStart, triangleCount - shapeStart});
+    }
+
+    attrib->vertices.resize(vertexCount * 3);
+    attrib->normals.resize(normalCount * 3);
+    attrib->texcoords.resize(texcoordCount * 2);
+
+    shapes->clear();
+    shapes->resize(shapeRanges.size());
+    for (size_t s = 0; s < shapeRanges.size(); s++) {
+        tinyobj::shape_t &shape = (*shapes)[s];
+        shape.name = shapeRanges[s].name;
+        shape.mesh.indices.resize(shapeRanges[s].triangleCount * 3);
+        shape.mesh.num_face_vertices.assign(shapeRanges[s].triangleCount, 3);
+        shape.mesh.material_ids.resize(shapeRanges[s].triangleCount);
+    }
+
+    pool->parallel_for(chunkCount, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t c = begin; c < end; c++) {
+            resolveChunk(chunks[c], materialMap, shapeRanges, attrib, shapes);
+        }
+    });
+
+    delete[] buffer;
+
+    return true;
+}
+
+std::vector<std::string> ObjParser::findMaterialLibraries(const std::string &file)
+{
+    std::vector<std::string> libraries;
+
+    std::shared_ptr<MappedFile> mapping = MappedFile::open(file.c_str());
+    if (!mapping) {
+        return libraries;
+    }
+
+    // NB: the mapping is not null terminated, so all scanning is bounded by {end}
+    const char *p = mapping->get_data();
+    const char *end = p + mapping->get_size();
+    while (p < end) {
+        const char *lineEnd = (const char *) memchr(p, '\n', end - p);
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+
+        const char *q = p;
+        while (q < lineEnd && isSpace(*q)) {
+            q++;
+        }
+
+        if (lineEnd - q > 7 && strncmp(q, "mtllib", 6) == 0 && isSpace(q[6])) {
+            q += 7;
+            while (q < lineEnd) {
+                while (q < lineEnd && (isSpace(*q) || *q == '\r')) {
+                    q++;
+                }
+
+                const char *name = q;
+                while (q < lineEnd && !isSpace(*q) && *q != '\r') {
+                    q++;
+                }
+
+                if (q > name) {
+                    libraries.emplace_back(name, q);
+                }
+            }
+        }
+
+        p = lineEnd + 1;
+    }
+
+    return libraries;
+}
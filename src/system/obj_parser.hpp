@@ -0,0 +1,41 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#ifndef GAME_OBJ_PARSER_HPP
+#define GAME_OBJ_PARSER_HPP
+
+#include <string>
+#include <vector>
+
+#include "tiny_obj_loader.h"
+
+/**
+ * Multithreaded OBJ front-end. The file is split into line-aligned chunks which are parsed in parallel on the
+ * thread pool, after which the chunks are merged into the same structures {tinyobj::LoadObj} produces: positions,
+ * normals and texcoords in file order, fan-triangulated faces, per-face material ids and one shape per group.
+ */
+struct ObjParser {
+    /**
+     * Smallest chunk the file is split into, so that merging does not dominate on small files.
+     */
+    static const size_t MIN_CHUNK_SIZE = 256 * 1024;
+
+    /**
+     * @param file: path of the .obj file.
+     * @param mtlBaseDir: directory (including trailing separator) relative to which 'mtllib' files are resolved.
+     * @param minChunkSize: smallest chunk in bytes, lowered by the tests to split small files across many chunks.
+     * Returns false and sets {err} if the file could not be read.
+     */
+    static bool loadObj(tinyobj::attrib_t *attrib, std::vector<tinyobj::shape_t> *shapes,
+                        std::vector<tinyobj::material_t> *materials, std::string *err,
+                        const std::string &file, const std::string &mtlBaseDir,
+                        size_t minChunkSize = MIN_CHUNK_SIZE);
+
+    /**
+     * Lists the file names named by the 'mtllib' statements of {file}, without parsing anything else.
+     */
+    static std::vector<std::string> findMaterialLibraries(const std::string &file);
+};
+
+#endif //GAME_OBJ_PARSER_HPP
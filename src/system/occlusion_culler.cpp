@@ -0,0 +1,394 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#include "occlusion_culler.hpp"
+
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+#include "../util/profiler.hpp"
+#include "../util/thread_pool.hpp"
+
+/**
+ * Vertices closer to the eye than this clip space w are treated as crossing the near plane.
+ */
+static const float MIN_CLIP_W = 1e-5f;
+
+/**
+ * Minimum number of occluder vertices per job of the vertex transform.
+ */
+static const uint32_t TRANSFORM_BATCH_SIZE = 4096;
+
+static glm::vec4 transformPoint(const glm::mat4 &m, glm::vec3 p)
+{
+#if defined(__SSE__) || defined(_M_X64)
+    __m128 result = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&m[0][0]), _mm_set1_ps(p.x)), _mm_loadu_ps(&m[3][0]));
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(&m[1][0]), _mm_set1_ps(p.y)));
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(&m[2][0]), _mm_set1_ps(p.z)));
+
+    glm::vec4 out;
+    _mm_storeu_ps(&out[0], result);
+    return out;
+#else
+    return m * glm::vec4(p, 1.0f);
+#endif
+}
+
+OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height)
+{
+    tilesX = std::max((width + TILE_WIDTH - 1) / TILE_WIDTH, 1u);
+    tilesY = std::max((height + TILE_HEIGHT - 1) / TILE_HEIGHT, 1u);
+    this->width = tilesX * TILE_WIDTH;
+    this->height = tilesY * TILE_HEIGHT;
+    bins.resize(tilesX * tilesY);
+
+    uint32_t levelWidth = this->width;
+    uint32_t levelHeight = this->height;
+    while (true) {
+        levelWidths.emplace_back(levelWidth);
+        levelHeights.emplace_back(levelHeight);
+        pyramid.emplace_back(levelWidth * levelHeight, 1.0f);
+        if (levelWidth == 1 && levelHeight == 1) {
+            break;
+        }
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+    }
+}
+
+uint32_t OcclusionCuller::addOccluder(const Model &model, const glm::mat4 &transform)
+{
+    Occluder occluder;
+    occluder.transform = transform;
+
+    const Vertex *vertices = model.getVertexData();
+    for (uint32_t i = 0; i < model.getVertexCount(); i++) {
+        occluder.positions.emplace_back(vertices[i].position);
+    }
+    for (const auto &subMesh : model.mesh.materialSubMeshes) {
+        occluder.indices.insert(occluder.indices.end(), subMesh.getIndexData(),
+                                subMesh.getIndexData() + subMesh.getIndexCount());
+    }
+
+    occluders.emplace_back(std::move(occluder));
+    return (uint32_t) occluders.size() - 1;
+}
+
+void OcclusionCuller::setOccluderTransform(uint32_t occluder, const glm::mat4 &transform)
+{
+    occluders[occluder].transform = transform;
+}
+
+void OcclusionCuller::clearOccluders()
+{
+    occluders.clear();
+}
+
+void OcclusionCuller::setupTriangles(const Occluder &occluder, uint32_t firstVertex)
+{
+    for (uint32_t i = 0; i + 2 < occluder.indices.size(); i += 3) {
+        float x[3];
+        float y[3];
+        float z[3];
+        bool clipped = false;
+        for (uint32_t k = 0; k < 3; k++) {
+            const glm::vec4 &clip = clipVertices[firstVertex + occluder.indices[i + k]];
+            if (clip.w < MIN_CLIP_W || clip.z < -clip.w) {
+                clipped = true;
+                break;
+            }
+
+            float inverseW = 1.0f / clip.w;
+            x[k] = (clip.x * inverseW * 0.5f + 0.5f) * (float) width;
+            y[k] = (clip.y * inverseW * 0.5f + 0.5f) * (float) height;
+            z[k] = clip.z * inverseW;
+        }
+        if (clipped) {
+            continue;
+        }
+
+        // counter-clockwise winding, so the edge functions are positive inside
+        float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+        if (area == 0.0f) {
+            continue;
+        }
+        if (area < 0.0f) {
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+            std::swap(z[1], z[2]);
+            area = -area;
+        }
+
+        // pixels of which the center may be inside
+        OccluderTriangle triangle;
+        triangle.minX = std::max((int32_t) std::ceil(std::min({x[0], x[1], x[2]}) - 0.5f), 0);
+        triangle.minY = std::max((int32_t) std::ceil(std::min({y[0], y[1], y[2]}) - 0.5f), 0);
+        triangle.maxX = std::min((int32_t) std::floor(std::max({x[0], x[1], x[2]}) - 0.5f), (int32_t) width - 1);
+        triangle.maxY = std::min((int32_t) std::floor(std::max({y[0], y[1], y[2]}) - 0.5f), (int32_t) height - 1);
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+            continue;
+        }
+
+        for (uint32_t k = 0; k < 3; k++) {
+            uint32_t from = (k + 1) % 3;
+            uint32_t to = (k + 2) % 3;
+            triangle.edgeA[k] = y[from] - y[to];
+            triangle.edgeB[k] = x[to] - x[from];
+            triangle.edgeC[k] = (y[to] - y[from]) * x[from] - (x[to] - x[from]) * y[from];
+        }
+
+        triangle.zA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+        triangle.zB = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+        triangle.zC = z[0] - triangle.zA * x[0] - triangle.zB * y[0];
+
+        // a pixel only counts as occluding up to the farthest depth of the plane within it
+        triangle.zC += 0.5f * (std::abs(triangle.zA) + std::abs(triangle.zB));
+
+        auto index = (uint32_t) triangles.size();
+        triangles.emplace_back(triangle);
+
+        for (uint32_t ty = triangle.minY / TILE_HEIGHT; ty <= triangle.maxY / TILE_HEIGHT; ty++) {
+            for (uint32_t tx = triangle.minX / TILE_WIDTH; tx <= triangle.maxX / TILE_WIDTH; tx++) {
+                bins[ty * tilesX + tx].emplace_back(index);
+            }
+        }
+    }
+}
+
+void OcclusionCuller::rasterizeTile(uint32_t tile)
+{
+    auto tileX = (int32_t) ((tile % tilesX) * TILE_WIDTH);
+    auto tileY = (int32_t) ((tile / tilesX) * TILE_HEIGHT);
+    float *depth = pyramid[0].data();
+
+    for (int32_t y = tileY; y < tileY + (int32_t) TILE_HEIGHT; y++) {
+        std::fill(depth + y * width + tileX, depth + y * width + tileX + TILE_WIDTH, 1.0f);
+    }
+
+    for (uint32_t index : bins[tile]) {
+        const OccluderTriangle &triangle = triangles[index];
+
+        // NB: starting at a multiple of 4 keeps the 4 pixel steps within the tile
+        int32_t minX = std::max(triangle.minX, tileX) & ~3;
+        int32_t maxX = std::min(triangle.maxX, tileX + (int32_t) TILE_WIDTH - 1);
+        int32_t minY = std::max(triangle.minY, tileY);
+        int32_t maxY = std::min(triangle.maxY, tileY + (int32_t) TILE_HEIGHT - 1);
+
+#if defined(__SSE__) || defined(_M_X64)
+        __m128 startX = _mm_add_ps(_mm_set1_ps((float) minX), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+        __m128 zero = _mm_setzero_ps();
+        __m128 edgeA[3];
+        for (int k = 0; k < 3; k++) {
+            edgeA[k] = _mm_set1_ps(triangle.edgeA[k]);
+        }
+        __m128 zA = _mm_set1_ps(triangle.zA);
+
+        for (int32_t y = minY; y <= maxY; y++) {
+            float centerY = (float) y + 0.5f;
+            __m128 rowEdges[3];
+            for (int k = 0; k < 3; k++) {
+                rowEdges[k] = _mm_set1_ps(triangle.edgeB[k] * centerY + triangle.edgeC[k]);
+            }
+            __m128 rowZ = _mm_set1_ps(triangle.zB * centerY + triangle.zC);
+
+            __m128 centerX = startX;
+            for (int32_t x = minX; x <= maxX; x += 4) {
+                __m128 inside = _mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], centerX), rowEdges[0]), zero);
+                inside = _mm_and_ps(inside, _mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], centerX), rowEdges[1]), zero));
+                inside = _mm_and_ps(inside, _mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], centerX), rowEdges[2]), zero));
+
+                if (_mm_movemask_ps(inside)) {
+                    float *pixels = depth + y * width + x;
+                    __m128 current = _mm_loadu_ps(pixels);
+                    __m128 z = _mm_min_ps(current, _mm_add_ps(_mm_mul_ps(zA, centerX), rowZ));
+                    _mm_storeu_ps(pixels, _mm_or_ps(_mm_and_ps(inside, z), _mm_andnot_ps(inside, current)));
+                }
+
+                centerX = _mm_add_ps(centerX, _mm_set1_ps(4.0f));
+            }
+        }
+#else
+        for (int32_t y = minY; y <= maxY; y++) {
+            float centerY = (float) y + 0.5f;
+            for (int32_t x = minX; x <= maxX; x++) {
+                float centerX = (float) x + 0.5f;
+                bool inside = true;
+                for (int k = 0; k < 3; k++) {
+                    inside &= triangle.edgeA[k] * centerX + triangle.edgeB[k] * centerY + triangle.edgeC[k] > 0.0f;
+                }
+
+                if (inside) {
+                    float &pixel = depth[y * width + x];
+                    pixel = std::min(pixel, triangle.zA * centerX + triangle.zB * centerY + triangle.zC);
+                }
+            }
+        }
+#endif
+    }
+}
+
+void OcclusionCuller::buildPyramid()
+{
+    for (uint32_t level = 1; level < pyramid.size(); level++) {
+        const std::vector<float> &source = pyramid[level - 1];
+        std::vector<float> &target = pyramid[level];
+        uint32_t sourceWidth = levelWidths[level - 1];
+        uint32_t sourceHeight = levelHeights[level - 1];
+        uint32_t targetWidth = levelWidths[level];
+
+        // only the first level is large enough to be worth splitting
+        uint32_t minBatch = level == 1 ? 16 : levelHeights[level];
+        ThreadPool::get_instance()->parallel_for(levelHeights[level], [&](uint32_t begin, uint32_t end) {
+            for (uint32_t y = begin; y < end; y++) {
+                uint32_t y0 = 2 * y;
+                uint32_t y1 = std::min(2 * y + 1, sourceHeight - 1);
+                for (uint32_t x = 0; x < targetWidth; x++) {
+                    uint32_t x0 = 2 * x;
+                    uint32_t x1 = std::min(2 * x + 1, sourceWidth - 1);
+                    target[y * targetWidth + x] = std::max(
+                            std::max(source[y0 * sourceWidth + x0], source[y0 * sourceWidth + x1]),
+                            std::max(source[y1 * sourceWidth + x0], source[y1 * sourceWidth + x1]));
+                }
+            }
+        }, minBatch);
+    }
+}
+
+void OcclusionCuller::rasterize(const glm::mat4 &viewProjection)
+{
+    PROFILE_ZONE("OcclusionCuller::rasterize");
+    auto startTime = std::chrono::steady_clock::now();
+    this->viewProjection = viewProjection;
+
+    std::vector<uint32_t> firstVertices;
+    uint32_t vertexCount = 0;
+    for (const auto &occluder : occluders) {
+        firstVertices.emplace_back(vertexCount);
+        vertexCount += (uint32_t) occluder.positions.size();
+    }
+    clipVertices.resize(vertexCount);
+
+    for (uint32_t o = 0; o < occluders.size(); o++) {
+        const Occluder &occluder = occluders[o];
+        glm::mat4 modelViewProjection = viewProjection * occluder.transform;
+        glm::vec4 *clip = clipVertices.data() + firstVertices[o];
+
+        ThreadPool::get_instance()->parallel_for((uint32_t) occluder.positions.size(), [&](uint32_t begin,
+                                                                                              uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                clip[i] = transformPoint(modelViewProjection, occluder.positions[i]);
+            }
+        }, TRANSFORM_BATCH_SIZE);
+    }
+
+    triangles.clear();
+    for (auto &bin : bins) {
+        bin.clear();
+    }
+    for (uint32_t o = 0; o < occluders.size(); o++) {
+        setupTriangles(occluders[o], firstVertices[o]);
+    }
+
+    ThreadPool::get_instance()->parallel_for((uint32_t) bins.size(), [this](uint32_t begin, uint32_t end) {
+        for (uint32_t tile = begin; tile < end; tile++) {
+            rasterizeTile(tile);
+        }
+    });
+
+    buildPyramid();
+
+    lastRasterizeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+bool OcclusionCuller::isOccluded(const Bounds &bounds, const glm::mat4 &transform) const
+{
+    glm::mat4 modelViewProjection = viewProjection * transform;
+
+    float minX = INFINITY;
+    float minY = INFINITY;
+    float minZ = INFINITY;
+    float maxX = -INFINITY;
+    float maxY = -INFINITY;
+    for (uint32_t corner = 0; corner < 8; corner++) {
+        glm::vec3 point((corner & 1) ? bounds.max.x : bounds.min.x, (corner & 2) ? bounds.max.y : bounds.min.y,
+                        (corner & 4) ? bounds.max.z : bounds.min.z);
+        glm::vec4 clip = transformPoint(modelViewProjection, point);
+
+        // boxes crossing the near plane cover the view, or are too close to be hidden
+        if (clip.w < MIN_CLIP_W || clip.z < -clip.w) {
+            return false;
+        }
+
+        float inverseW = 1.0f / clip.w;
+        minX = std::min(minX, clip.x * inverseW);
+        minY = std::min(minY, clip.y * inverseW);
+        maxX = std::max(maxX, clip.x * inverseW);
+        maxY = std::max(maxY, clip.y * inverseW);
+        minZ = std::min(minZ, clip.z * inverseW);
+    }
+
+    // boxes outside of the view are left to frustum culling
+    if (maxX < -1.0f || maxY < -1.0f || minX > 1.0f || minY > 1.0f) {
+        return false;
+    }
+
+    // NB: occluders are sampled at pixel centers, so an edge pixel may be partly uncovered. The rectangle is widened
+    //     by half a pixel, to all pixels of which the center is nearest to a point of it. A point between covered
+    //     centers is covered itself, as long as the occluders are convex at the scale of a pixel.
+    auto toPixel = [](float ndc, float offset, uint32_t size) {
+        auto pixel = (int32_t) std::floor((ndc * 0.5f + 0.5f) * (float) size + offset);
+        return std::min(std::max(pixel, 0), (int32_t) size - 1);
+    };
+    int32_t x0 = toPixel(minX, -0.5f, width);
+    int32_t x1 = toPixel(maxX, 0.5f, width);
+    int32_t y0 = toPixel(minY, -0.5f, height);
+    int32_t y1 = toPixel(maxY, 0.5f, height);
+
+    // the level at which the rectangle spans at most 2x2 texels
+    uint32_t level = 0;
+    while (level + 1 < pyramid.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) {
+        level++;
+    }
+
+    const std::vector<float> &depths = pyramid[level];
+    uint32_t levelWidth = levelWidths[level];
+    float maxDepth = 0.0f;
+    for (int32_t y = y0 >> level; y <= y1 >> level; y++) {
+        for (int32_t x = x0 >> level; x <= x1 >> level; x++) {
+            maxDepth = std::max(maxDepth, depths[y * levelWidth + x]);
+        }
+    }
+
+    return minZ > maxDepth;
+}
+
+uint32_t OcclusionCuller::getWidth() const
+{
+    return width;
+}
+
+uint32_t OcclusionCuller::getHeight() const
+{
+    return height;
+}
+
+const float *OcclusionCuller::getDepthData() const
+{
+    return pyramid[0].data();
+}
+
+uint32_t OcclusionCuller::getTriangleCount() const
+{
+    return (uint32_t) triangles.size();
+}
+
+double OcclusionCuller::getRasterizeMs() const
+{
+    return lastRasterizeMs;
+}
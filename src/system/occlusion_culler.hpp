@@ -0,0 +1,144 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#ifndef GAME_OCCLUSION_CULLER_HPP
+#define GAME_OCCLUSION_CULLER_HPP
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "asset_manager.hpp"
+
+/**
+ * Occluder triangle in screen space, set up for rasterization.
+ */
+struct OccluderTriangle {
+    /**
+     * Edge functions a * x + b * y + c, positive inside, in the order of the opposite vertex.
+     */
+    float edgeA[3];
+    float edgeB[3];
+    float edgeC[3];
+
+    /**
+     * Depth as a plane z = zA * x + zB * y + zC, with zC offset to the farthest depth within a pixel.
+     */
+    float zA;
+    float zB;
+    float zC;
+
+    /**
+     * Pixel bounds, inclusive.
+     */
+    int32_t minX;
+    int32_t minY;
+    int32_t maxX;
+    int32_t maxY;
+};
+
+/**
+ * Software occlusion culling. A small set of occluder meshes is rasterized into a low resolution depth buffer on the
+ * CPU every frame, from which a hierarchical depth (Hi-Z) pyramid is built. Objects of which the screen space bounds
+ * lie behind the occluders in that pyramid are not drawn.
+ *
+ * Triangles are binned to tiles, which are rasterized in parallel on the thread pool, four pixels at a time with SSE.
+ * Depths are the normalized device z of OpenGL, 1 being the far plane. The buffer stores the nearest occluder depth,
+ * and the pyramid the farthest depth of each region, so a test against it is conservative.
+ */
+struct OcclusionCuller {
+    static const uint32_t TILE_WIDTH = 32;
+    static const uint32_t TILE_HEIGHT = 16;
+
+private:
+    struct Occluder {
+        std::vector<glm::vec3> positions;
+        std::vector<uint32_t> indices;
+        glm::mat4 transform;
+    };
+
+    uint32_t width;
+    uint32_t height;
+    uint32_t tilesX;
+    uint32_t tilesY;
+
+    std::vector<Occluder> occluders;
+
+    glm::mat4 viewProjection;
+
+    /**
+     * Level 0 is the rasterized depth buffer, every next level holds the maximum of 2x2 texels of the previous one.
+     */
+    std::vector<std::vector<float>> pyramid;
+    std::vector<uint32_t> levelWidths;
+    std::vector<uint32_t> levelHeights;
+
+    /**
+     * Per frame: clip space vertices of the occluders, set up triangles, and the triangles overlapping each tile.
+     */
+    std::vector<glm::vec4> clipVertices;
+    std::vector<OccluderTriangle> triangles;
+    std::vector<std::vector<uint32_t>> bins;
+
+    double lastRasterizeMs = 0;
+
+    /**
+     * Sets up the triangles of {occluder}, of which the clip space vertices start at {clipVertices[firstVertex]}, and
+     * bins them. Triangles crossing the near plane are skipped, which only makes culling less effective.
+     */
+    void setupTriangles(const Occluder &occluder, uint32_t firstVertex);
+
+    void rasterizeTile(uint32_t tile);
+
+    void buildPyramid();
+
+public:
+    /**
+     * Depth buffer of {width} by {height} pixels, rounded up to whole tiles.
+     */
+    explicit OcclusionCuller(uint32_t width = 320, uint32_t height = 192);
+
+    /**
+     * Adds the full detail triangles of {model}, placed with {transform}, as an occluder. The geometry is copied, so
+     * an occluder must be a closed or opaque surface and is best kept low-poly. Returns the occluder index.
+     */
+    uint32_t addOccluder(const Model &model, const glm::mat4 &transform);
+
+    void setOccluderTransform(uint32_t occluder, const glm::mat4 &transform);
+
+    void clearOccluders();
+
+    /**
+     * Rasterizes all occluders as seen with {viewProjection} and builds the pyramid. Must be called every frame
+     * before testing, with the matrices the frame is drawn with.
+     */
+    void rasterize(const glm::mat4 &viewProjection);
+
+    /**
+     * Whether the box ({bounds.min}, {bounds.max}) transformed by {transform} is entirely behind the occluders. The
+     * screen rectangle of the box is tested at the pyramid level where it covers at most a few texels.
+     */
+    bool isOccluded(const Bounds &bounds, const glm::mat4 &transform) const;
+
+    uint32_t getWidth() const;
+
+    uint32_t getHeight() const;
+
+    /**
+     * Rasterized depths, {getWidth} by {getHeight} with the bottom row first.
+     */
+    const float *getDepthData() const;
+
+    /**
+     * Triangles rasterized by the last {rasterize}.
+     */
+    uint32_t getTriangleCount() const;
+
+    double getRasterizeMs() const;
+};
+
+#endif //GAME_OCCLUSION_CULLER_HPP
@@ -0,0 +1,269 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#include "scene_graph.hpp"
+
+#include <atomic>
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+#include "../util/profiler.hpp"
+#include "../util/thread_pool.hpp"
+
+/**
+ * Minimum number of nodes per job of {SceneGraph::update}.
+ */
+static const uint32_t UPDATE_BATCH_SIZE = 1024;
+
+/**
+ * {result} = {a} * {local}, where the last row of {local} is (0, 0, 0, 1).
+ */
+static void multiplyAffine(const glm::mat4 &a, const glm::mat4 &local, glm::mat4 *result)
+{
+#if defined(__SSE__) || defined(_M_X64)
+    __m128 a0 = _mm_loadu_ps(&a[0][0]);
+    __m128 a1 = _mm_loadu_ps(&a[1][0]);
+    __m128 a2 = _mm_loadu_ps(&a[2][0]);
+    __m128 a3 = _mm_loadu_ps(&a[3][0]);
+
+    for (int column = 0; column < 3; column++) {
+        __m128 r = _mm_mul_ps(a0, _mm_set1_ps(local[column][0]));
+        r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(local[column][1])));
+        r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(local[column][2])));
+        _mm_storeu_ps(&(*result)[column][0], r);
+    }
+
+    __m128 r = _mm_add_ps(a3, _mm_mul_ps(a0, _mm_set1_ps(local[3][0])));
+    r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(local[3][1])));
+    r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(local[3][2])));
+    _mm_storeu_ps(&(*result)[3][0], r);
+#else
+    *result = a * local;
+#endif
+}
+
+/**
+ * Translation * rotation * scale.
+ */
+static glm::mat4 composeTransform(glm::vec3 translation, glm::quat rotation, glm::vec3 scale)
+{
+    glm::mat3 axes = glm::mat3_cast(rotation);
+
+    glm::mat4 result(1.0f);
+    for (int axis = 0; axis < 3; axis++) {
+        result[axis] = glm::vec4(axes[axis] * scale[axis], 0.0f);
+    }
+    result[3] = glm::vec4(translation, 1.0f);
+
+    return result;
+}
+
+NodeID SceneGraph::createNode(NodeID parent)
+{
+    uint32_t parentIndex = (parent == INVALID_NODE) ? UINT32_MAX : indices[parent];
+    uint32_t depth = (parentIndex == UINT32_MAX) ? 0 : depths[parentIndex] + 1;
+
+    auto node = (NodeID) indices.size();
+    auto index = (uint32_t) handles.size();
+    indices.emplace_back(index);
+    handles.emplace_back(node);
+
+    translations.emplace_back(0.0f);
+    rotations.emplace_back(1.0f, 0.0f, 0.0f, 0.0f);
+    scales.emplace_back(1.0f);
+    parents.emplace_back(parentIndex);
+    depths.emplace_back(depth);
+    worldMatrices.emplace_back(1.0f);
+    dirty.emplace_back(0);
+    changed.emplace_back(0);
+
+    if (levelDirtyCounts.size() <= depth) {
+        levelDirtyCounts.resize(depth + 1, 0);
+    }
+    markDirty(index);
+
+    // appending keeps the order if the node is at the deepest level
+    if (index > 0 && depths[index - 1] > depth) {
+        unsorted = true;
+    }
+    if (levelOffsets.size() < depth + 2) {
+        levelOffsets.resize(depth + 2, index);
+    }
+    levelOffsets[depth + 1] = index + 1;
+
+    return node;
+}
+
+void SceneGraph::markDirty(uint32_t index)
+{
+    if (!dirty[index]) {
+        dirty[index] = 1;
+        levelDirtyCounts[depths[index]]++;
+    }
+}
+
+void SceneGraph::setTranslation(NodeID node, glm::vec3 translation)
+{
+    uint32_t index = indices[node];
+    translations[index] = translation;
+    markDirty(index);
+}
+
+void SceneGraph::setRotation(NodeID node, glm::quat rotation)
+{
+    uint32_t index = indices[node];
+    rotations[index] = rotation;
+    markDirty(index);
+}
+
+void SceneGraph::setScale(NodeID node, glm::vec3 scale)
+{
+    uint32_t index = indices[node];
+    scales[index] = scale;
+    markDirty(index);
+}
+
+void SceneGraph::setLocalTransform(NodeID node, glm::vec3 translation, glm::quat rotation, glm::vec3 scale)
+{
+    uint32_t index = indices[node];
+    translations[index] = translation;
+    rotations[index] = rotation;
+    scales[index] = scale;
+    markDirty(index);
+}
+
+void SceneGraph::sortByDepth()
+{
+    auto nodeCount = (uint32_t) handles.size();
+    auto levelCount = (uint32_t) levelDirtyCounts.size();
+
+    // counting sort, which keeps the order of the nodes within a level
+    levelOffsets.assign(levelCount + 1, 0);
+    for (uint32_t depth : depths) {
+        levelOffsets[depth + 1]++;
+    }
+    for (uint32_t level = 0; level < levelCount; level++) {
+        levelOffsets[level + 1] += levelOffsets[level];
+    }
+
+    std::vector<uint32_t> newIndices(nodeCount);
+    std::vector<uint32_t> fill(levelOffsets.begin(), levelOffsets.end() - 1);
+    for (uint32_t i = 0; i < nodeCount; i++) {
+        newIndices[i] = fill[depths[i]]++;
+    }
+
+    auto permute = [&](auto &values) {
+        typename std::remove_reference<decltype(values)>::type sorted(values.size());
+        for (uint32_t i = 0; i < nodeCount; i++) {
+            sorted[newIndices[i]] = values[i];
+        }
+        values.swap(sorted);
+    };
+    permute(translations);
+    permute(rotations);
+    permute(scales);
+    permute(parents);
+    permute(depths);
+    permute(worldMatrices);
+    permute(dirty);
+    permute(changed);
+    permute(handles);
+
+    for (uint32_t &parent : parents) {
+        if (parent != UINT32_MAX) {
+            parent = newIndices[parent];
+        }
+    }
+    for (uint32_t i = 0; i < nodeCount; i++) {
+        indices[handles[i]] = i;
+    }
+
+    unsorted = false;
+}
+
+void SceneGraph::update()
+{
+    PROFILE_ZONE("SceneGraph::update");
+    if (unsorted) {
+        sortByDepth();
+    }
+
+    lastUpdatedCount = 0;
+    bool parentLevelChanged = false;
+    bool updateChanged = false;
+
+    for (uint32_t level = 0; level + 1 < levelOffsets.size(); level++) {
+        uint32_t begin = levelOffsets[level];
+        uint32_t end = levelOffsets[level + 1];
+
+        // nothing to recompute if no node of the level is dirty and no parent changed
+        if (levelDirtyCounts[level] == 0 && !parentLevelChanged) {
+            if (anyChanged) {
+                std::fill(changed.begin() + begin, changed.begin() + end, 0);
+            }
+            continue;
+        }
+
+        std::atomic<uint32_t> updatedCount(0);
+        ThreadPool::get_instance()->parallel_for(end - begin, [&](uint32_t batchBegin, uint32_t batchEnd) {
+            uint32_t batchUpdated = 0;
+            for (uint32_t i = begin + batchBegin; i < begin + batchEnd; i++) {
+                uint32_t parent = parents[i];
+                bool nodeChanged = dirty[i] || (parent != UINT32_MAX && changed[parent]);
+                changed[i] = nodeChanged;
+                if (!nodeChanged) {
+                    continue;
+                }
+
+                glm::mat4 local = composeTransform(translations[i], rotations[i], scales[i]);
+                if (parent == UINT32_MAX) {
+                    worldMatrices[i] = local;
+                } else {
+                    multiplyAffine(worldMatrices[parent], local, &worldMatrices[i]);
+                }
+                dirty[i] = 0;
+                batchUpdated++;
+            }
+            updatedCount += batchUpdated;
+        }, UPDATE_BATCH_SIZE);
+
+        levelDirtyCounts[level] = 0;
+        parentLevelChanged = updatedCount > 0;
+        updateChanged |= parentLevelChanged;
+        lastUpdatedCount += updatedCount;
+    }
+
+    anyChanged = updateChanged;
+}
+
+const glm::mat4 &SceneGraph::getWorldMatrix(NodeID node) const
+{
+    return worldMatrices[indices[node]];
+}
+
+bool SceneGraph::hasChanged(NodeID node) const
+{
+    return changed[indices[node]] != 0;
+}
+
+void SceneGraph::getWorldMatrices(const std::vector<NodeID> &nodes, std::vector<glm::mat4> *result) const
+{
+    result->reserve(result->size() + nodes.size());
+    for (NodeID node : nodes) {
+        result->emplace_back(worldMatrices[indices[node]]);
+    }
+}
+
+uint32_t SceneGraph::getNodeCount() const
+{
+    return (uint32_t) handles.size();
+}
+
+uint32_t SceneGraph::getUpdatedCount() const
+{
+    return lastUpdatedCount;
+}
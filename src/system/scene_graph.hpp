@@ -0,0 +1,140 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#ifndef GAME_SCENE_GRAPH_HPP
+#define GAME_SCENE_GRAPH_HPP
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+struct InstanceTransformBuffer;
+
+/**
+ * Handle of a node of a {SceneGraph}.
+ */
+typedef uint32_t NodeID;
+
+const NodeID INVALID_NODE = UINT32_MAX;
+
+/**
+ * Hierarchy of transforms. Nodes hold a local translation, rotation and scale relative to their parent, from which
+ * {update} computes world matrices.
+ *
+ * Nodes are stored in structure of arrays layout sorted by depth, so the nodes of a level only depend on the level
+ * above and are updated in parallel. Handles stay valid when nodes are reordered.
+ */
+struct SceneGraph {
+private:
+    /**
+     * Per node, in depth order. Parents are indices into these arrays, {UINT32_MAX} for roots.
+     */
+    std::vector<glm::vec3> translations;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> depths;
+    std::vector<glm::mat4> worldMatrices;
+
+    /**
+     * Set for nodes of which the local transform changed since the last {update}.
+     */
+    std::vector<uint8_t> dirty;
+
+    /**
+     * Set for nodes of which the world matrix changed in the last {update}: dirty nodes and their descendants.
+     */
+    std::vector<uint8_t> changed;
+
+    /**
+     * Maps from node index to handle and back.
+     */
+    std::vector<NodeID> handles;
+    std::vector<uint32_t> indices;
+
+    /**
+     * Nodes of depth d are [levelOffsets[d], levelOffsets[d + 1]). Only valid if not {unsorted}.
+     */
+    std::vector<uint32_t> levelOffsets;
+
+    /**
+     * Number of dirty nodes per depth, so unchanged levels are skipped.
+     */
+    std::vector<uint32_t> levelDirtyCounts;
+
+    /**
+     * Set when nodes were created since the last sort, which are appended at the end.
+     */
+    bool unsorted = false;
+
+    /**
+     * Whether {changed} has any flag set.
+     */
+    bool anyChanged = false;
+
+    uint32_t lastUpdatedCount = 0;
+
+    /**
+     * Scratch buffer of {updateInstances}.
+     */
+    std::vector<glm::mat4> gathered;
+
+    void sortByDepth();
+
+    void markDirty(uint32_t index);
+
+public:
+    /**
+     * Adds a node with the identity transform as a child of {parent}, or as a root if {parent} is {INVALID_NODE}.
+     */
+    NodeID createNode(NodeID parent = INVALID_NODE);
+
+    void setTranslation(NodeID node, glm::vec3 translation);
+
+    void setRotation(NodeID node, glm::quat rotation);
+
+    void setScale(NodeID node, glm::vec3 scale);
+
+    void setLocalTransform(NodeID node, glm::vec3 translation, glm::quat rotation, glm::vec3 scale);
+
+    /**
+     * Recomputes the world matrices of the dirty nodes and their descendants, level by level, with the nodes of a
+     * level divided over the thread pool.
+     */
+    void update();
+
+    /**
+     * World matrix of {node} as of the last {update}.
+     */
+    const glm::mat4 &getWorldMatrix(NodeID node) const;
+
+    /**
+     * Whether the world matrix of {node} changed in the last {update}.
+     */
+    bool hasChanged(NodeID node) const;
+
+    /**
+     * Appends the world matrices of {nodes} to {result}, e.g. to create an {InstanceTransformBuffer}.
+     */
+    void getWorldMatrices(const std::vector<NodeID> &nodes, std::vector<glm::mat4> *result) const;
+
+    /**
+     * Writes the world matrices of {nodes} that changed in the last {update} to {buffer}, in which instance i is
+     * node {nodes[i]}, and commits it. Consecutive changed instances are written as a single range. Returns the
+     * number of changed instances.
+     */
+    uint32_t updateInstances(const std::vector<NodeID> &nodes, InstanceTransformBuffer *buffer);
+
+    uint32_t getNodeCount() const;
+
+    /**
+     * Number of world matrices recomputed by the last {update}.
+     */
+    uint32_t getUpdatedCount() const;
+};
+
+#endif //GAME_SCENE_GRAPH_HPP
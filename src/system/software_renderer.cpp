@@ -0,0 +1,658 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#include "software_renderer.hpp"
+
+#include <cmath>
+#include <atomic>
+#include <algorithm>
+
+#include <glm/geometric.hpp>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+#include "../util/util.hpp"
+#include "../util/normal_matrix.hpp"
+#include "../util/profiler.hpp"
+#include "../util/thread_pool.hpp"
+
+/**
+ * Minimum number of vertices per job of the vertex stage.
+ */
+static const uint32_t VERTEX_BATCH_SIZE = 1024;
+
+static const float PI = 3.14159265359f;
+
+/**
+ * Used for submeshes without a material, with the defaults of {Material}.
+ */
+static const Material DEFAULT_MATERIAL = Material();
+
+static float transformScale(const glm::mat4 &transform)
+{
+    return std::max(glm::length(glm::vec3(transform[0])),
+                    std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+}
+
+static ShadedVertex interpolateVertex(const ShadedVertex &a, const ShadedVertex &b, float t)
+{
+    ShadedVertex result;
+    result.clipPosition = a.clipPosition + (b.clipPosition - a.clipPosition) * t;
+    result.worldPosition = a.worldPosition + (b.worldPosition - a.worldPosition) * t;
+    result.worldNormal = a.worldNormal + (b.worldNormal - a.worldNormal) * t;
+    result.worldTangent = a.worldTangent + (b.worldTangent - a.worldTangent) * t;
+    result.worldBiTangent = a.worldBiTangent + (b.worldBiTangent - a.worldBiTangent) * t;
+    result.uv = a.uv + (b.uv - a.uv) * t;
+    return result;
+}
+
+/**
+ * Texel ({x}, {y}) of {texture} as normalized values, with grayscale replicated to RGB like GL_LUMINANCE.
+ */
+static glm::vec4 fetchTexel(const Texture &texture, uint32_t x, uint32_t y)
+{
+    size_t texel = (size_t) y * texture.width + x;
+    const auto *data8 = (const uint8_t *) texture.data;
+    const auto *data16 = (const uint16_t *) texture.data;
+
+    switch (texture.format) {
+        case GRAYSCALE_8: {
+            float value = (float) data8[texel] / 255.f;
+            return glm::vec4(value, value, value, 1.f);
+        }
+        case GRAYSCALE_16: {
+            float value = (float) data16[texel] / 65535.f;
+            return glm::vec4(value, value, value, 1.f);
+        }
+        case RGB_8:
+            return glm::vec4((float) data8[texel * 3] / 255.f, (float) data8[texel * 3 + 1] / 255.f,
+                             (float) data8[texel * 3 + 2] / 255.f, 1.f);
+        case RGBA_8:
+            return glm::vec4((float) data8[texel * 4] / 255.f, (float) data8[texel * 4 + 1] / 255.f,
+                             (float) data8[texel * 4 + 2] / 255.f, (float) data8[texel * 4 + 3] / 255.f);
+        case RGB_16:
+            return glm::vec4((float) data16[texel * 3] / 65535.f, (float) data16[texel * 3 + 1] / 65535.f,
+                             (float) data16[texel * 3 + 2] / 65535.f, 1.f);
+        case RGBA_16:
+            return glm::vec4((float) data16[texel * 4] / 65535.f, (float) data16[texel * 4 + 1] / 65535.f,
+                             (float) data16[texel * 4 + 2] / 65535.f, (float) data16[texel * 4 + 3] / 65535.f);
+    }
+
+    return glm::vec4(0.f, 0.f, 0.f, 1.f);
+}
+
+/**
+ * Bilinear sample of {texture} at {uv} with GL_REPEAT wrapping. Rows are stored bottom row first, like OpenGL.
+ */
+static glm::vec4 sampleTexture(const Texture &texture, glm::vec2 uv)
+{
+    float x = uv.x * (float) texture.width - 0.5f;
+    float y = uv.y * (float) texture.height - 0.5f;
+    float floorX = std::floor(x);
+    float floorY = std::floor(y);
+    float fractionX = x - floorX;
+    float fractionY = y - floorY;
+
+    auto wrap = [](float coordinate, uint32_t size) {
+        auto wrapped = (int64_t) coordinate % (int64_t) size;
+        return (uint32_t) (wrapped < 0 ? wrapped + size : wrapped);
+    };
+    uint32_t x0 = wrap(floorX, texture.width);
+    uint32_t x1 = wrap(floorX + 1.f, texture.width);
+    uint32_t y0 = wrap(floorY, texture.height);
+    uint32_t y1 = wrap(floorY + 1.f, texture.height);
+
+    glm::vec4 bottom = fetchTexel(texture, x0, y0) * (1.f - fractionX) + fetchTexel(texture, x1, y0) * fractionX;
+    glm::vec4 top = fetchTexel(texture, x0, y1) * (1.f - fractionX) + fetchTexel(texture, x1, y1) * fractionX;
+    return bottom * (1.f - fractionY) + top * fractionY;
+}
+
+/*
+ * Ported from pbr.frag, see there.
+ */
+
+static float distributionGGX(glm::vec3 N, glm::vec3 H, float roughness)
+{
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float NdotH = std::max(glm::dot(N, H), 0.f);
+
+    float denominator = NdotH * NdotH * (a2 - 1.f) + 1.f;
+    return a2 / (PI * denominator * denominator);
+}
+
+static float geometrySchlickGGX(float NdotV, float roughness)
+{
+    float r = roughness + 1.f;
+    float k = (r * r) / 8.f;
+
+    return NdotV / (NdotV * (1.f - k) + k);
+}
+
+static float geometrySmith(float NdotV, float NdotL, float roughness)
+{
+    return geometrySchlickGGX(NdotL, roughness) * geometrySchlickGGX(NdotV, roughness);
+}
+
+static glm::vec3 fresnelSchlick(float cosTheta, glm::vec3 F0)
+{
+    return F0 + (glm::vec3(1.f) - F0) * std::pow(1.f - cosTheta, 5.f);
+}
+
+SoftwareRenderer::SoftwareRenderer(uint32_t width, uint32_t height)
+{
+    setViewportSize(width, height);
+}
+
+void SoftwareRenderer::setViewportSize(uint32_t width, uint32_t height)
+{
+    this->width = std::max(width, 1u);
+    this->height = std::max(height, 1u);
+    tilesX = (this->width + TILE_SIZE - 1) / TILE_SIZE;
+    tilesY = (this->height + TILE_SIZE - 1) / TILE_SIZE;
+    stride = tilesX * TILE_SIZE;
+
+    colors.resize((size_t) stride * tilesY * TILE_SIZE * 3);
+    depths.resize((size_t) stride * tilesY * TILE_SIZE);
+    bins.resize(tilesX * tilesY);
+    clearScreen();
+}
+
+void SoftwareRenderer::clearScreen()
+{
+    auto red = (uint8_t) (clearColor.x * 255.f + .5f);
+    auto green = (uint8_t) (clearColor.y * 255.f + .5f);
+    auto blue = (uint8_t) (clearColor.z * 255.f + .5f);
+    for (size_t i = 0; i < colors.size(); i += 3) {
+        colors[i] = red;
+        colors[i + 1] = green;
+        colors[i + 2] = blue;
+    }
+
+    std::fill(depths.begin(), depths.end(), 1.f);
+    stats = {};
+}
+
+void SoftwareRenderer::setCameraPosition(glm::vec3 pos)
+{
+    this->cameraPosition = pos;
+}
+
+void SoftwareRenderer::setView(glm::mat4 viewMatrix)
+{
+    this->activeViewMatrix = viewMatrix;
+    this->frustum = Frustum::from_matrix(activePerspectiveMatrix * activeViewMatrix);
+}
+
+void SoftwareRenderer::setPerspective(glm::mat4 perspectiveMatrix)
+{
+    this->activePerspectiveMatrix = perspectiveMatrix;
+    this->frustum = Frustum::from_matrix(activePerspectiveMatrix * activeViewMatrix);
+}
+
+void SoftwareRenderer::setClearColor(glm::vec3 color)
+{
+    this->clearColor = color;
+}
+
+void SoftwareRenderer::renderModel(AssetID id, glm::mat4 transform)
+{
+    assert(assetManager);
+
+    // skip models that are still loading
+    const Model *model = assetManager->getModel(id);
+    if (!model) {
+        return;
+    }
+
+    drawModel(*model, transform);
+}
+
+void SoftwareRenderer::renderModelInstanced(AssetID id, const InstanceTransformBuffer &transforms)
+{
+    assert(assetManager);
+
+    const Model *model = assetManager->getModel(id);
+    if (!model) {
+        return;
+    }
+
+    for (const auto &transform : transforms.transforms) {
+        drawModel(*model, transform);
+    }
+}
+
+uint32_t SoftwareRenderer::cullScene(const DynamicBVH &bvh, std::vector<uint32_t> *visible) const
+{
+    visible->clear();
+    return bvh.cull(frustum, visible);
+}
+
+void SoftwareRenderer::drawModel(const Model &model, const glm::mat4 &transform)
+{
+    PROFILE_ZONE("SoftwareRenderer::drawModel");
+    float scale = transformScale(transform);
+    glm::vec3 modelCenter(transform * glm::vec4(model.bounds.center, 1.f));
+    if (!frustum.intersects_sphere(modelCenter, model.bounds.radius * scale)) {
+        stats.drawsCulled++;
+        return;
+    }
+    stats.draws++;
+
+    // vertex stage, see pbr.vert
+    glm::mat4 modelViewProjection = activePerspectiveMatrix * activeViewMatrix * transform;
+    PackedNormalMatrix normalMatrix = PackedNormalMatrix::from_transform(transform);
+    auto transformNormal = [&normalMatrix](glm::vec3 normal) {
+        return glm::normalize(normalMatrix.columns[0] * normal.x + normalMatrix.columns[1] * normal.y +
+                              normalMatrix.columns[2] * normal.z);
+    };
+
+    const Vertex *modelVertices = model.getVertexData();
+    vertices.resize(model.getVertexCount());
+    ThreadPool::get_instance()->parallel_for(model.getVertexCount(), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            const Vertex &vertex = modelVertices[i];
+            ShadedVertex &result = vertices[i];
+            result.clipPosition = modelViewProjection * glm::vec4(vertex.position, 1.f);
+            result.worldPosition = glm::vec3(transform * glm::vec4(vertex.position, 1.f));
+            result.worldNormal = transformNormal(vertex.normal);
+            result.worldTangent = transformNormal(vertex.tangent);
+            result.worldBiTangent = transformNormal(vertex.biTangent);
+            result.uv = vertex.uv;
+        }
+    }, VERTEX_BATCH_SIZE);
+
+    triangles.clear();
+    for (auto &bin : bins) {
+        bin.clear();
+    }
+
+    for (const auto &subMesh : model.mesh.materialSubMeshes) {
+        glm::vec3 center(transform * glm::vec4(subMesh.bounds.center, 1.f));
+        if (!frustum.intersects_sphere(center, subMesh.bounds.radius * scale)) {
+            continue;
+        }
+
+        const Material *material = &DEFAULT_MATERIAL;
+        if (subMesh.materialIndex >= 0 && (size_t) subMesh.materialIndex < model.materials.size()) {
+            material = &model.materials[subMesh.materialIndex];
+        }
+
+        const uint32_t *indices = subMesh.getIndexData();
+        for (uint32_t i = 0; i + 2 < subMesh.getIndexCount(); i += 3) {
+            clipTriangle(indices[i], indices[i + 1], indices[i + 2], material);
+        }
+    }
+
+    if (triangles.empty()) {
+        return;
+    }
+    stats.triangles += (uint32_t) triangles.size();
+
+    std::atomic<uint64_t> pixelsShaded{0};
+    ThreadPool::get_instance()->parallel_for((uint32_t) bins.size(), [this, &pixelsShaded](uint32_t begin,
+                                                                                           uint32_t end) {
+        PROFILE_ZONE("SoftwareRenderer::rasterizeTiles");
+        uint64_t shaded = 0;
+        for (uint32_t tile = begin; tile < end; tile++) {
+            shaded += rasterizeTile(tile);
+        }
+        pixelsShaded += shaded;
+    });
+    stats.pixelsShaded += pixelsShaded;
+}
+
+void SoftwareRenderer::clipTriangle(uint32_t v0, uint32_t v1, uint32_t v2, const Material *material)
+{
+    uint32_t corners[3] = {v0, v1, v2};
+
+    // signed distance to the near plane z = -w, in clip space
+    float distances[3];
+    uint32_t insideCount = 0;
+    for (uint32_t k = 0; k < 3; k++) {
+        const glm::vec4 &clip = vertices[corners[k]].clipPosition;
+        distances[k] = clip.z + clip.w;
+        insideCount += distances[k] >= 0.f;
+    }
+
+    if (insideCount == 3) {
+        setupTriangle(v0, v1, v2, material);
+        return;
+    }
+    if (insideCount == 0) {
+        return;
+    }
+
+    // Sutherland-Hodgman against the near plane gives a triangle or a quad
+    uint32_t polygon[4];
+    uint32_t polygonSize = 0;
+    for (uint32_t k = 0; k < 3; k++) {
+        uint32_t next = (k + 1) % 3;
+        if (distances[k] >= 0.f) {
+            polygon[polygonSize++] = corners[k];
+        }
+        if ((distances[k] >= 0.f) != (distances[next] >= 0.f)) {
+            float t = distances[k] / (distances[k] - distances[next]);
+            ShadedVertex vertex = interpolateVertex(vertices[corners[k]], vertices[corners[next]], t);
+            polygon[polygonSize++] = (uint32_t) vertices.size();
+            vertices.emplace_back(vertex);
+        }
+    }
+
+    for (uint32_t k = 1; k + 1 < polygonSize; k++) {
+        setupTriangle(polygon[0], polygon[k], polygon[k + 1], material);
+    }
+}
+
+void SoftwareRenderer::setupTriangle(uint32_t v0, uint32_t v1, uint32_t v2, const Material *material)
+{
+    SoftwareTriangle triangle;
+    triangle.vertices[0] = v0;
+    triangle.vertices[1] = v1;
+    triangle.vertices[2] = v2;
+    triangle.material = material;
+
+    float x[3];
+    float y[3];
+    float z[3];
+    for (uint32_t k = 0; k < 3; k++) {
+        const glm::vec4 &clip = vertices[triangle.vertices[k]].clipPosition;
+        triangle.inverseW[k] = 1.f / clip.w;
+        x[k] = (clip.x * triangle.inverseW[k] * .5f + .5f) * (float) width;
+        y[k] = (clip.y * triangle.inverseW[k] * .5f + .5f) * (float) height;
+        z[k] = clip.z * triangle.inverseW[k] * .5f + .5f;
+    }
+
+    // back faces, clockwise in window space, are culled like with GL_CULL_FACE, degenerate ones have no pixels
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    if (!(area > 0.f)) {
+        return;
+    }
+
+    // pixels of which the center may be inside
+    triangle.minX = std::max((int32_t) std::ceil(std::min({x[0], x[1], x[2]}) - .5f), 0);
+    triangle.minY = std::max((int32_t) std::ceil(std::min({y[0], y[1], y[2]}) - .5f), 0);
+    triangle.maxX = std::min((int32_t) std::floor(std::max({x[0], x[1], x[2]}) - .5f), (int32_t) width - 1);
+    triangle.maxY = std::min((int32_t) std::floor(std::max({y[0], y[1], y[2]}) - .5f), (int32_t) height - 1);
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+        return;
+    }
+
+    float inverseArea = 1.f / area;
+    for (uint32_t k = 0; k < 3; k++) {
+        uint32_t from = (k + 1) % 3;
+        uint32_t to = (k + 2) % 3;
+        float dx = x[to] - x[from];
+        float dy = y[to] - y[from];
+        triangle.edgeA[k] = -dy * inverseArea;
+        triangle.edgeB[k] = dx * inverseArea;
+        triangle.edgeC[k] = (dy * x[from] - dx * y[from]) * inverseArea;
+
+        // counter-clockwise with y up: the interior is right of edges going down, and below edges going left
+        triangle.topLeft[k] = dy < 0.f || (dy == 0.f && dx < 0.f);
+    }
+
+    triangle.zA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) * inverseArea;
+    triangle.zB = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) * inverseArea;
+    triangle.zC = z[0] - triangle.zA * x[0] - triangle.zB * y[0];
+
+    auto index = (uint32_t) triangles.size();
+    triangles.emplace_back(triangle);
+
+    for (uint32_t ty = triangle.minY / TILE_SIZE; ty <= triangle.maxY / TILE_SIZE; ty++) {
+        for (uint32_t tx = triangle.minX / TILE_SIZE; tx <= triangle.maxX / TILE_SIZE; tx++) {
+            bins[ty * tilesX + tx].emplace_back(index);
+        }
+    }
+}
+
+uint64_t SoftwareRenderer::rasterizeTile(uint32_t tile)
+{
+    auto tileX = (int32_t) ((tile % tilesX) * TILE_SIZE);
+    auto tileY = (int32_t) ((tile / tilesX) * TILE_SIZE);
+    uint64_t pixelsShaded = 0;
+
+    // NB: triangles are in submission order, so overlapping pixels resolve as they would on the GPU
+    for (uint32_t index : bins[tile]) {
+        const SoftwareTriangle &triangle = triangles[index];
+
+        // NB: starting at a multiple of 4 keeps the 4 pixel steps within the tile
+        int32_t minX = std::max(triangle.minX, tileX) & ~3;
+        int32_t maxX = std::min(triangle.maxX, tileX + (int32_t) TILE_SIZE - 1);
+        int32_t minY = std::max(triangle.minY, tileY);
+        int32_t maxY = std::min(triangle.maxY, tileY + (int32_t) TILE_SIZE - 1);
+
+#if defined(__SSE__) || defined(_M_X64)
+        __m128 zero = _mm_setzero_ps();
+        __m128 edgeA[3];
+        __m128 topLeft[3];
+        for (int k = 0; k < 3; k++) {
+            edgeA[k] = _mm_set1_ps(triangle.edgeA[k]);
+            topLeft[k] = _mm_cmpneq_ps(_mm_set1_ps(triangle.topLeft[k] ? 1.f : 0.f), zero);
+        }
+        __m128 zA = _mm_set1_ps(triangle.zA);
+        __m128 startX = _mm_add_ps(_mm_set1_ps((float) minX), _mm_set_ps(3.5f, 2.5f, 1.5f, .5f));
+
+        for (int32_t y = minY; y <= maxY; y++) {
+            float centerY = (float) y + .5f;
+            __m128 rowEdges[3];
+            for (int k = 0; k < 3; k++) {
+                rowEdges[k] = _mm_set1_ps(triangle.edgeB[k] * centerY + triangle.edgeC[k]);
+            }
+            __m128 rowZ = _mm_set1_ps(triangle.zB * centerY + triangle.zC);
+
+            __m128 centerX = startX;
+            for (int32_t x = minX; x <= maxX; x += 4, centerX = _mm_add_ps(centerX, _mm_set1_ps(4.f))) {
+                __m128 barycentrics[3];
+                __m128 inside = _mm_cmpeq_ps(zero, zero);
+                for (int k = 0; k < 3; k++) {
+                    barycentrics[k] = _mm_add_ps(_mm_mul_ps(edgeA[k], centerX), rowEdges[k]);
+                    __m128 onEdge = _mm_and_ps(_mm_cmpeq_ps(barycentrics[k], zero), topLeft[k]);
+                    inside = _mm_and_ps(inside, _mm_or_ps(_mm_cmpgt_ps(barycentrics[k], zero), onEdge));
+                }
+                if (!_mm_movemask_ps(inside)) {
+                    continue;
+                }
+
+                float *depth = depths.data() + (size_t) y * stride + x;
+                __m128 current = _mm_loadu_ps(depth);
+                __m128 z = _mm_add_ps(_mm_mul_ps(zA, centerX), rowZ);
+                __m128 passed = _mm_and_ps(inside, _mm_cmplt_ps(z, current));
+                int mask = _mm_movemask_ps(passed);
+                if (!mask) {
+                    continue;
+                }
+                _mm_storeu_ps(depth, _mm_or_ps(_mm_and_ps(passed, z), _mm_andnot_ps(passed, current)));
+
+                float lanes[3][4];
+                for (int k = 0; k < 3; k++) {
+                    _mm_storeu_ps(lanes[k], barycentrics[k]);
+                }
+                for (int lane = 0; lane < 4; lane++) {
+                    if (!(mask & (1 << lane))) {
+                        continue;
+                    }
+
+                    float perspective[3];
+                    for (int k = 0; k < 3; k++) {
+                        perspective[k] = lanes[k][lane] * triangle.inverseW[k];
+                    }
+                    float normalization = 1.f / (perspective[0] + perspective[1] + perspective[2]);
+                    glm::vec3 color = shade(triangle, perspective[1] * normalization,
+                                            perspective[2] * normalization);
+
+                    uint8_t *pixel = colors.data() + ((size_t) y * stride + x + lane) * 3;
+                    pixel[0] = (uint8_t) (color.x * 255.f + .5f);
+                    pixel[1] = (uint8_t) (color.y * 255.f + .5f);
+                    pixel[2] = (uint8_t) (color.z * 255.f + .5f);
+                    pixelsShaded++;
+                }
+            }
+        }
+#else
+        for (int32_t y = minY; y <= maxY; y++) {
+            float centerY = (float) y + .5f;
+            for (int32_t x = minX; x <= maxX; x++) {
+                float centerX = (float) x + .5f;
+                float barycentrics[3];
+                bool inside = true;
+                for (int k = 0; k < 3; k++) {
+                    barycentrics[k] = triangle.edgeA[k] * centerX + triangle.edgeB[k] * centerY + triangle.edgeC[k];
+                    inside &= barycentrics[k] > 0.f || (barycentrics[k] == 0.f && triangle.topLeft[k]);
+                }
+
+                float &depth = depths[(size_t) y * stride + x];
+                float z = triangle.zA * centerX + triangle.zB * centerY + triangle.zC;
+                if (!inside || !(z < depth)) {
+                    continue;
+                }
+                depth = z;
+
+                float perspective[3];
+                for (int k = 0; k < 3; k++) {
+                    perspective[k] = barycentrics[k] * triangle.inverseW[k];
+                }
+                float normalization = 1.f / (perspective[0] + perspective[1] + perspective[2]);
+                glm::vec3 color = shade(triangle, perspective[1] * normalization, perspective[2] * normalization);
+
+                uint8_t *pixel = colors.data() + ((size_t) y * stride + x) * 3;
+                pixel[0] = (uint8_t) (color.x * 255.f + .5f);
+                pixel[1] = (uint8_t) (color.y * 255.f + .5f);
+                pixel[2] = (uint8_t) (color.z * 255.f + .5f);
+                pixelsShaded++;
+            }
+        }
+#endif
+    }
+
+    return pixelsShaded;
+}
+
+glm::vec3 SoftwareRenderer::shade(const SoftwareTriangle &triangle, float b1, float b2) const
+{
+    const ShadedVertex &v0 = vertices[triangle.vertices[0]];
+    const ShadedVertex &v1 = vertices[triangle.vertices[1]];
+    const ShadedVertex &v2 = vertices[triangle.vertices[2]];
+    float b0 = 1.f - b1 - b2;
+
+    glm::vec3 worldPos = v0.worldPosition * b0 + v1.worldPosition * b1 + v2.worldPosition * b2;
+    glm::vec3 worldNorm = v0.worldNormal * b0 + v1.worldNormal * b1 + v2.worldNormal * b2;
+    glm::vec2 uvCoord = v0.uv * b0 + v1.uv * b1 + v2.uv * b2;
+
+    const Material &material = *triangle.material;
+    glm::vec3 albedo = material.albedo;
+    float roughness = material.roughness;
+    float metallic = material.metallic;
+    float ao = 1.f;
+
+    if (material.albedoTexture.data) {
+        albedo = glm::vec3(sampleTexture(material.albedoTexture, uvCoord));
+    }
+    if (material.roughnessTexture.data) {
+        roughness = sampleTexture(material.roughnessTexture, uvCoord).x;
+    }
+    if (material.metallicTexture.data) {
+        metallic = sampleTexture(material.metallicTexture, uvCoord).x;
+    }
+
+    glm::vec3 N;
+    if (material.normalMap.data) {
+        // the TBN matrix is interpolated without normalizing its columns, like the varying of pbr.vert
+        glm::vec3 tangent = v0.worldTangent * b0 + v1.worldTangent * b1 + v2.worldTangent * b2;
+        glm::vec3 biTangent = v0.worldBiTangent * b0 + v1.worldBiTangent * b1 + v2.worldBiTangent * b2;
+        glm::vec3 mapped = glm::vec3(sampleTexture(material.normalMap, uvCoord)) * 2.f - glm::vec3(1.f);
+        N = glm::normalize(tangent * mapped.x + biTangent * mapped.y + worldNorm * mapped.z);
+    } else {
+        N = glm::normalize(worldNorm);
+    }
+    glm::vec3 V = glm::normalize(cameraPosition - worldPos);
+
+    glm::vec3 F0 = glm::vec3(.04f) * (1.f - metallic) + albedo * metallic;
+
+    // a single directional light of color (1, 1, 1) from direction (-1, -1, -1)
+    glm::vec3 L = glm::normalize(glm::vec3(1.f, 1.f, 1.f));
+    glm::vec3 H = glm::normalize(V + L);
+    glm::vec3 radiance(1.f);
+
+    float NdotV = std::max(glm::dot(N, V), 0.f);
+    float NdotL = std::max(glm::dot(N, L), 0.f);
+
+    // cook-torrance brdf
+    float NDF = distributionGGX(N, H, roughness);
+    float G = geometrySmith(NdotV, NdotL, roughness);
+    glm::vec3 F = fresnelSchlick(std::max(glm::dot(H, V), 0.f), F0);
+
+    glm::vec3 kS = F;
+    glm::vec3 kD = (glm::vec3(1.f) - kS) * (1.f - metallic);
+
+    glm::vec3 specular = NDF * G * F / std::max(4.f * NdotV * NdotL, .001f);
+    glm::vec3 Lo = (kD * albedo / PI + specular) * radiance * NdotL;
+
+    glm::vec3 ambient = glm::vec3(.03f) * albedo * ao;
+    glm::vec3 color = ambient + Lo;
+
+    return glm::vec3(std::pow(std::min(std::max(color.x, 0.f), 1.f), 1.f / 2.2f),
+                     std::pow(std::min(std::max(color.y, 0.f), 1.f), 1.f / 2.2f),
+                     std::pow(std::min(std::max(color.z, 0.f), 1.f), 1.f / 2.2f));
+}
+
+void SoftwareRenderer::readPixels(std::vector<uint8_t> *pixels, uint32_t *width, uint32_t *height) const
+{
+    *width = this->width;
+    *height = this->height;
+
+    size_t rowSize = (size_t) this->width * 3;
+    pixels->resize(rowSize * this->height);
+    for (uint32_t y = 0; y < this->height; y++) {
+        const uint8_t *row = colors.data() + (size_t) (this->height - 1 - y) * stride * 3;
+        std::copy(row, row + rowSize, pixels->data() + y * rowSize);
+    }
+}
+
+bool SoftwareRenderer::saveFrame(const std::string &file) const
+{
+    std::vector<uint8_t> pixels;
+    uint32_t frameWidth;
+    uint32_t frameHeight;
+    readPixels(&pixels, &frameWidth, &frameHeight);
+
+    if (Util::write_ppm(file.c_str(), pixels.data(), frameWidth, frameHeight) != EXIT_SUCCESS) {
+        ls_log::log(LOG_ERROR, "cannot write %s\n", file.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+const float *SoftwareRenderer::getDepthData() const
+{
+    return depths.data();
+}
+
+uint32_t SoftwareRenderer::getWidth() const
+{
+    return width;
+}
+
+uint32_t SoftwareRenderer::getHeight() const
+{
+    return height;
+}
+
+uint32_t SoftwareRenderer::getStride() const
+{
+    return stride;
+}
+
+SoftwareRenderStats SoftwareRenderer::getStats() const
+{
+    return stats;
+}
+
+void SoftwareRenderer::setAssetManager(AssetManager *assetManager)
+{
+    this->assetManager = assetManager;
+}
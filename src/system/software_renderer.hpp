@@ -0,0 +1,234 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#ifndef GAME_SOFTWARE_RENDERER_HPP
+#define GAME_SOFTWARE_RENDERER_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "asset_manager.hpp"
+#include "graphics.hpp"
+#include "../util/frustum.hpp"
+
+/**
+ * Output of the vertex stage of {SoftwareRenderer}, the attributes pbr.vert passes on to pbr.frag.
+ */
+struct ShadedVertex {
+    glm::vec4 clipPosition;
+    glm::vec3 worldPosition;
+    glm::vec3 worldNormal;
+    glm::vec3 worldTangent;
+    glm::vec3 worldBiTangent;
+    glm::vec2 uv;
+};
+
+/**
+ * Triangle in screen space, set up for rasterization.
+ */
+struct SoftwareTriangle {
+    /**
+     * Edge functions a * x + b * y + c, scaled so that they are the screen space barycentric coordinates of the
+     * vertex opposite to the edge.
+     */
+    float edgeA[3];
+    float edgeB[3];
+    float edgeC[3];
+
+    /**
+     * Whether an edge is a top or left edge, which own the pixel centers exactly on them.
+     */
+    bool topLeft[3];
+
+    /**
+     * Window space depth as a plane z = zA * x + zB * y + zC.
+     */
+    float zA;
+    float zB;
+    float zC;
+
+    /**
+     * Reciprocal clip space w of the vertices, for perspective correct interpolation.
+     */
+    float inverseW[3];
+
+    /**
+     * Indices of the vertices in {SoftwareRenderer::vertices}.
+     */
+    uint32_t vertices[3];
+
+    const Material *material;
+
+    /**
+     * Pixel bounds, inclusive.
+     */
+    int32_t minX;
+    int32_t minY;
+    int32_t maxX;
+    int32_t maxY;
+};
+
+/**
+ * Per-frame counters of {SoftwareRenderer}, reset by {SoftwareRenderer::clearScreen}.
+ */
+struct SoftwareRenderStats {
+    uint32_t draws;
+    uint32_t drawsCulled;
+
+    /**
+     * Triangles left after frustum, near plane and back face culling, including the ones split by near plane
+     * clipping.
+     */
+    uint32_t triangles;
+
+    uint64_t pixelsShaded;
+};
+
+/**
+ * Renderer that draws on the CPU, for machines without a GPU. It draws the models of an {AssetManager} with the
+ * same calls as {Renderer}, with a port of pbr.vert and the Cook-Torrance shading of pbr.frag, so its frames can be
+ * compared with those of OpenGL.
+ *
+ * Every draw transforms the vertices of the model in parallel, sets up and clips the triangles, and bins them to
+ * tiles of {TILE_SIZE} pixels. The tiles are then rasterized in parallel on the thread pool, four pixels at a time
+ * with SSE edge functions and depth test, in submission order within each tile. Pixels passing the depth test are
+ * shaded right away.
+ *
+ * Differences with the OpenGL path: a single sample per pixel instead of multisampling, textures are sampled
+ * bilinearly from the full resolution image instead of with mipmaps, and models are always drawn at full detail.
+ */
+struct SoftwareRenderer {
+    static const uint32_t TILE_SIZE = 32;
+
+private:
+    AssetManager *assetManager = nullptr;
+
+    glm::vec3 cameraPosition;
+    glm::mat4 activeViewMatrix;
+    glm::mat4 activePerspectiveMatrix;
+    Frustum frustum;
+
+    /**
+     * Size of the frame, and of the buffers, which are padded to whole tiles.
+     */
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t tilesX = 0;
+    uint32_t tilesY = 0;
+    uint32_t stride = 0;
+
+    /**
+     * The clear color of {Window}.
+     */
+    glm::vec3 clearColor = {241.f / 255.f, 250.f / 255.f, 238.f / 255.f};
+
+    /**
+     * Final 8 bit RGB colors and window space depths, bottom row first.
+     */
+    std::vector<uint8_t> colors;
+    std::vector<float> depths;
+
+    /**
+     * Per draw: shaded vertices, followed by the vertices created by clipping, and the triangles overlapping each
+     * tile.
+     */
+    std::vector<ShadedVertex> vertices;
+    std::vector<SoftwareTriangle> triangles;
+    std::vector<std::vector<uint32_t>> bins;
+
+    SoftwareRenderStats stats = {};
+
+    /**
+     * Draws {model} with {transform}, after testing it against the view frustum.
+     */
+    void drawModel(const Model &model, const glm::mat4 &transform);
+
+    /**
+     * Sets up and bins the triangle of vertices {v0}, {v1} and {v2}, which lie in front of the near plane.
+     */
+    void setupTriangle(uint32_t v0, uint32_t v1, uint32_t v2, const Material *material);
+
+    /**
+     * Clips the triangle against the near plane, then sets up the remaining one or two triangles.
+     */
+    void clipTriangle(uint32_t v0, uint32_t v1, uint32_t v2, const Material *material);
+
+    /**
+     * Rasterizes the triangles binned to {tile}, returns the number of pixels shaded.
+     */
+    uint64_t rasterizeTile(uint32_t tile);
+
+    /**
+     * Port of pbr.frag: the color of a pixel of {triangle} at perspective correct barycentric coordinates {b1} and
+     * {b2}, with gamma applied.
+     */
+    glm::vec3 shade(const SoftwareTriangle &triangle, float b1, float b2) const;
+
+public:
+    explicit SoftwareRenderer(uint32_t width = 800, uint32_t height = 600);
+
+    void clearScreen();
+
+    void setCameraPosition(glm::vec3 pos);
+
+    void setView(glm::mat4 viewMatrix);
+
+    void setPerspective(glm::mat4 perspectiveMatrix);
+
+    /**
+     * Resizes the frame, which discards its contents.
+     */
+    void setViewportSize(uint32_t width, uint32_t height);
+
+    void setClearColor(glm::vec3 color);
+
+    /**
+     * Draws model {id} of the asset manager, if it is loaded.
+     */
+    void renderModel(AssetID id, glm::mat4 transform);
+
+    /**
+     * Draws an instance of model {id} for every transform in {transforms}. Only the CPU copy of the transforms is
+     * read, so the buffer does not need to be created on a GPU.
+     */
+    void renderModelInstanced(AssetID id, const InstanceTransformBuffer &transforms);
+
+    /**
+     * See {Renderer::cullScene}.
+     */
+    uint32_t cullScene(const DynamicBVH &bvh, std::vector<uint32_t> *visible) const;
+
+    /**
+     * Reads the frame as 8 bit RGB, top row first, like {Window::readPixels}.
+     */
+    void readPixels(std::vector<uint8_t> *pixels, uint32_t *width, uint32_t *height) const;
+
+    /**
+     * Writes the frame to {file} as a binary PPM image. Returns false on failure.
+     */
+    bool saveFrame(const std::string &file) const;
+
+    /**
+     * Window space depths, {getWidth} by {getHeight} with a row stride of {getStride} and the bottom row first.
+     */
+    const float *getDepthData() const;
+
+    uint32_t getWidth() const;
+
+    uint32_t getHeight() const;
+
+    uint32_t getStride() const;
+
+    SoftwareRenderStats getStats() const;
+
+    void setAssetManager(AssetManager *assetManager);
+};
+
+#endif //GAME_SOFTWARE_RENDERER_HPP
@@ -0,0 +1,155 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#include "vertex_compression.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "../util/ls_log.hpp"
+#include "../util/util.hpp"
+
+static int16_t encodeSnorm16(float value)
+{
+    return (int16_t) std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+}
+
+static float decodeSnorm16(int16_t value)
+{
+    return std::max((float) value / 32767.0f, -1.0f);
+}
+
+static float signNotZero(float value)
+{
+    return (value >= 0.0f) ? 1.0f : -1.0f;
+}
+
+/**
+ * Octahedral encoding: the unit sphere is projected onto the octahedron |x| + |y| + |z| = 1, of which the lower half
+ * is folded over the upper half, which is then projected onto the xy plane.
+ */
+static void encodeOctahedral(glm::vec3 n, int16_t *result)
+{
+    float sum = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    float x = n.x / sum;
+    float y = n.y / sum;
+    if (n.z < 0.0f) {
+        float foldedX = (1.0f - std::fabs(y)) * signNotZero(x);
+        float foldedY = (1.0f - std::fabs(x)) * signNotZero(y);
+        x = foldedX;
+        y = foldedY;
+    }
+
+    result[0] = encodeSnorm16(x);
+    result[1] = encodeSnorm16(y);
+}
+
+/**
+ * Same as {octDecode} in the vertex shaders.
+ */
+static glm::vec3 decodeOctahedral(const int16_t *encoded)
+{
+    glm::vec3 n(decodeSnorm16(encoded[0]), decodeSnorm16(encoded[1]), 0.0f);
+    n.z = 1.0f - std::fabs(n.x) - std::fabs(n.y);
+    float t = std::max(-n.z, 0.0f);
+    n.x += (n.x >= 0.0f) ? -t : t;
+    n.y += (n.y >= 0.0f) ? -t : t;
+    return glm::normalize(n);
+}
+
+static bool isFinite(glm::vec3 v)
+{
+    return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+}
+
+/**
+ * Unit vector perpendicular to unit vector {n}.
+ */
+static glm::vec3 anyPerpendicular(glm::vec3 n)
+{
+    glm::vec3 axis = (std::fabs(n.x) < 0.9f) ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+    return glm::normalize(glm::cross(n, axis));
+}
+
+void VertexCompression::compress(Model *model)
+{
+    const Vertex *vertices = model->getVertexData();
+    uint32_t vertexCount = model->getVertexCount();
+    if (vertexCount == 0) {
+        return;
+    }
+
+    glm::vec3 min = vertices[0].position;
+    glm::vec3 max = vertices[0].position;
+    for (uint32_t i = 1; i < vertexCount; i++) {
+        min = glm::min(min, vertices[i].position);
+        max = glm::max(max, vertices[i].position);
+    }
+
+    model->positionOffset = min;
+    model->positionScale = max - min;
+    model->compactVertices.resize(vertexCount);
+
+    float maxPositionError = 0;
+    float maxNormalError = 0;
+    float maxUVError = 0;
+
+    for (uint32_t i = 0; i < vertexCount; i++) {
+        const Vertex &vertex = vertices[i];
+        CompactVertex &compact = model->compactVertices[i];
+
+        for (int axis = 0; axis < 3; axis++) {
+            float extent = model->positionScale[axis];
+            float t = (extent > 0.0f) ? (vertex.position[axis] - min[axis]) / extent : 0.0f;
+            compact.position[axis] = (uint16_t) std::lround(std::min(std::max(t, 0.0f), 1.0f) * 65535.0f);
+
+            float decoded = min[axis] + (float) compact.position[axis] / 65535.0f * extent;
+            maxPositionError = std::max(maxPositionError, std::fabs(decoded - vertex.position[axis]));
+        }
+
+        glm::vec3 normal = vertex.normal;
+        if (!isFinite(normal) || glm::length(normal) == 0.0f) {
+            normal = glm::vec3(0, 0, 1);
+        }
+        normal = glm::normalize(normal);
+
+        // the tangent frame is stored orthonormal, the bitangent is reconstructed as cross(normal, tangent) * sign
+        glm::vec3 tangent = vertex.tangent - normal * glm::dot(normal, vertex.tangent);
+        if (!isFinite(tangent) || glm::length(tangent) < 1e-6f) {
+            tangent = anyPerpendicular(normal);
+        }
+        tangent = glm::normalize(tangent);
+
+        float handedness = glm::dot(glm::cross(normal, tangent), vertex.biTangent);
+        compact.position[3] = (std::isfinite(handedness) && handedness < 0.0f) ? 0 : 65535;
+
+        encodeOctahedral(normal, &compact.normalTangent[0]);
+        encodeOctahedral(tangent, &compact.normalTangent[2]);
+
+        // NB: the arc cosine of the dot product is off by up to 0.02 degrees near 0 in single precision
+        glm::vec3 decodedNormal = decodeOctahedral(&compact.normalTangent[0]);
+        float angle = std::atan2(glm::length(glm::cross(decodedNormal, normal)), glm::dot(decodedNormal, normal));
+        maxNormalError = std::max(maxNormalError, angle);
+
+        for (int axis = 0; axis < 2; axis++) {
+            compact.uv[axis] = Util::float_to_half(vertex.uv[axis]);
+            float error = std::fabs(Util::half_to_float(compact.uv[axis]) - vertex.uv[axis]);
+            if (std::isfinite(error)) {
+                maxUVError = std::max(maxUVError, error);
+            }
+        }
+    }
+
+    model->vertexFormat = COMPACT_VERTEX_FORMAT;
+
+    float extent = std::max(std::max(model->positionScale.x, model->positionScale.y), model->positionScale.z);
+    ls_log::log(LOG_INFO, "compressed vertices of %s: %u -> %u bytes, max errors: position %g (%.4f%% of extent), "
+                          "normal %.4f degrees, uv %g\n",
+                model->mesh.name.c_str(), vertexCount * (uint32_t) sizeof(Vertex),
+                vertexCount * (uint32_t) sizeof(CompactVertex), maxPositionError,
+                (extent > 0.0f) ? maxPositionError / extent * 100.0f : 0.0f,
+                maxNormalError * 180.0f / 3.14159265f, maxUVError);
+}
@@ -0,0 +1,21 @@
+//
+// Created by agent on 16-10-2026.
+//
+
+#ifndef GAME_VERTEX_COMPRESSION_HPP
+#define GAME_VERTEX_COMPRESSION_HPP
+
+#include "asset_manager.hpp"
+
+/**
+ * Conversion of {Vertex} to {CompactVertex}. The decoding counterpart is in the vertex shaders.
+ */
+struct VertexCompression {
+    /**
+     * Fills {Model::compactVertices} and the position decoding of {model} from its full precision vertices, and
+     * switches it to {COMPACT_VERTEX_FORMAT}. Logs the size reduction and the largest decoding errors.
+     */
+    static void compress(Model *model);
+};
+
+#endif //GAME_VERTEX_COMPRESSION_HPP
@@ -1,5 +1,14 @@
 #include "window.hpp"
 
+#include <cstring>
+
+#ifdef LIGHT_SHOW_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include "../util/util.hpp"
+
 /** Begin global static GLFW callbacks (in source file since static functions). */
 
 static void global_error_callback(int error, const char *description)
@@ -41,27 +50,55 @@ static void global_window_iconify_callback(GLFWwindow *window, int iconified)
 
 /** End global static GLFW callbacks. */
 
-Window::Window(uint32_t width, uint32_t height, const char *title)
+Window::Window(uint32_t width, uint32_t height, const char *title, bool headless)
 {
-    //TODO: find a place to initialize/load GL.
-    WindowManager::getInstance()->registerWindow(this);
+    this->handle = nullptr;
+    this->initial_width = width;
+    this->initial_height = height;
+    this->title = title;
+    this->headless = headless;
 
-    //TODO: temp AA
-    glfwWindowHint(GLFW_SAMPLES, 8);
-    GLFWwindow *window = glfwCreateWindow(width, height, title, NULL, NULL);
+    if (headless) {
+        if (!createHeadlessContext()) {
+            ls_log::log(LOG_ERROR, "Could not create a headless GL context.\n");
+            assert(false);
+        }
 
-    if (!window) {
-        printf("Could not open glfw window.\n");
-        glfwTerminate();
-        assert(false);
-    }
+        // same number of samples as the window below
+        if (!createFramebuffers(8)) {
+            ls_log::log(LOG_ERROR, "Could not create the offscreen framebuffer.\n");
+            assert(false);
+        }
+    } else {
+        //TODO: find a place to initialize/load GL.
+        WindowManager::getInstance()->registerWindow(this);
+
+        //TODO: temp AA
+        glfwWindowHint(GLFW_SAMPLES, 8);
+        GLFWwindow *window = glfwCreateWindow(width, height, title, NULL, NULL);
+
+        if (!window) {
+            printf("Could not open glfw window.\n");
+            glfwTerminate();
+            assert(false);
+        }
 
-    glfwMakeContextCurrent(window);
+        glfwMakeContextCurrent(window);
 
-    if (!gladLoadGL()) {
-        printf("Glad could not load GL.\n");
-        glfwTerminate();
-        assert(false);
+        if (!gladLoadGL()) {
+            printf("Glad could not load GL.\n");
+            glfwTerminate();
+            assert(false);
+        }
+
+        glfwSetKeyCallback(window, global_key_callback);
+        glfwSetScrollCallback(window, global_scroll_callback);
+        glfwSetMouseButtonCallback(window, global_mouse_button_callback);
+        glfwSetCursorPosCallback(window, global_cursor_position_callback);
+        glfwSetFramebufferSizeCallback(window, global_framebuffer_size_callback);
+        glfwSetWindowIconifyCallback(window, global_window_iconify_callback);
+
+        this->handle = window;
     }
 
     glEnable(GL_MULTISAMPLE);
@@ -72,32 +109,234 @@ Window::Window(uint32_t width, uint32_t height, const char *title)
 
     glClearColor(241.f / 255.f, 250.f / 255.f, 238.f / 255.f, 1);
 
-    glfwSetKeyCallback(window, global_key_callback);
-    glfwSetScrollCallback(window, global_scroll_callback);
-    glfwSetMouseButtonCallback(window, global_mouse_button_callback);
-    glfwSetCursorPosCallback(window, global_cursor_position_callback);
-    glfwSetFramebufferSizeCallback(window, global_framebuffer_size_callback);
-    glfwSetWindowIconifyCallback(window, global_window_iconify_callback);
+    this->renderer = new Renderer();
+    // NB: GLFW is not initialized for headless windows in builds with LIGHT_SHOW_EGL
+    this->input_handler = new InputHandler(width, height, !headless);
+}
+
+bool Window::createHeadlessContext()
+{
+#ifdef LIGHT_SHOW_EGL
+    EGLDisplay display = EGL_NO_DISPLAY;
+
+    // Mesa's surfaceless platform needs neither an X11 nor a Wayland server
+    auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display) {
+        display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    EGLint major;
+    EGLint minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        ls_log::log(LOG_ERROR, "Could not initialize EGL, error 0x%x.\n", eglGetError());
+        return false;
+    }
+    egl_display = display;
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        ls_log::log(LOG_ERROR, "EGL %d.%d does not support desktop OpenGL.\n", major, minor);
+        return false;
+    }
+
+    const EGLint config_attributes[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE
+    };
+    EGLConfig config;
+    EGLint config_count = 0;
+    if (!eglChooseConfig(display, config_attributes, &config, 1, &config_count) || config_count == 0) {
+        ls_log::log(LOG_ERROR, "No EGL config for desktop OpenGL, error 0x%x.\n", eglGetError());
+        return false;
+    }
+
+    // the renderer needs multi-draw indirect and shader storage buffers
+    const EGLint context_attributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 4,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+    if (context == EGL_NO_CONTEXT) {
+        ls_log::log(LOG_ERROR, "Could not create an OpenGL 4.3 context, error 0x%x.\n", eglGetError());
+        return false;
+    }
+    egl_context = context;
+
+    // no surface, all drawing goes to the offscreen framebuffer (EGL_KHR_surfaceless_context)
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        ls_log::log(LOG_ERROR, "Could not make the EGL context current, error 0x%x.\n", eglGetError());
+        return false;
+    }
+
+    if (!gladLoadGLLoader((GLADloadproc) eglGetProcAddress)) {
+        ls_log::log(LOG_ERROR, "Glad could not load GL.\n");
+        return false;
+    }
+#else
+    // initializes GLFW, the window is not registered since it receives no events
+    WindowManager::getInstance();
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(initial_width, initial_height, title, NULL, NULL);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    if (!window) {
+        return false;
+    }
+
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGL()) {
+        ls_log::log(LOG_ERROR, "Glad could not load GL.\n");
+        return false;
+    }
 
     this->handle = window;
-    this->initial_width = width;
-    this->initial_height = height;
-    this->title = title;
+#endif
 
-    this->renderer = new Renderer();
-    this->input_handler = new InputHandler(width, height);
+    return true;
+}
+
+bool Window::createFramebuffers(GLsizei samples)
+{
+    GLint max_samples = 0;
+    glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+    samples = std::min(samples, (GLsizei) max_samples);
+
+    auto width = (GLsizei) initial_width;
+    auto height = (GLsizei) initial_height;
+
+    glGenRenderbuffers(1, &color_renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, color_renderbuffer);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &depth_renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH24_STENCIL8, width, height);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_renderbuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_renderbuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        return false;
+    }
+
+    // multisampled renderbuffers cannot be read directly
+    glGenRenderbuffers(1, &resolve_renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, resolve_renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenFramebuffers(1, &resolve_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, resolve_framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, resolve_renderbuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        return false;
+    }
+
+    // the offscreen framebuffer stays bound for all drawing
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+
+    ls_log::log(LOG_INFO, "rendering headless to %ux%u with %d samples on %s\n", initial_width, initial_height,
+                samples, (const char *) glGetString(GL_RENDERER));
+
+    return true;
 }
 
 Window::~Window()
 {
     delete this->input_handler;
     delete this->renderer;
-    WindowManager::getInstance()->deregisterWindow(this);
+
+    if (headless) {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteFramebuffers(1, &resolve_framebuffer);
+        glDeleteRenderbuffers(1, &color_renderbuffer);
+        glDeleteRenderbuffers(1, &depth_renderbuffer);
+        glDeleteRenderbuffers(1, &resolve_renderbuffer);
+    }
+
+#ifdef LIGHT_SHOW_EGL
+    if (egl_display) {
+        eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (egl_context) {
+            eglDestroyContext(egl_display, egl_context);
+        }
+        eglTerminate(egl_display);
+    }
+#endif
+
+    // headless windows are not registered, and getInstance would initialize GLFW
+    if (!headless) {
+        WindowManager::getInstance()->deregisterWindow(this);
+    }
 }
 
 void Window::swapBuffers()
 {
-    glfwSwapBuffers(this->handle);
+    if (!headless) {
+        glfwSwapBuffers(this->handle);
+    }
+}
+
+bool Window::isHeadless() const
+{
+    return headless;
+}
+
+void Window::readPixels(std::vector<uint8_t> *pixels, uint32_t *width, uint32_t *height)
+{
+    if (headless) {
+        *width = initial_width;
+        *height = initial_height;
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolve_framebuffer);
+        glBlitFramebuffer(0, 0, (GLint) *width, (GLint) *height, 0, 0, (GLint) *width, (GLint) *height,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, resolve_framebuffer);
+    } else {
+        *width = input_handler->get_size_x();
+        *height = input_handler->get_size_y();
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glReadBuffer(GL_BACK);
+    }
+
+    // rows are tightly packed, and read bottom row first
+    std::vector<uint8_t> rows((size_t) *width * *height * 3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, (GLsizei) *width, (GLsizei) *height, GL_RGB, GL_UNSIGNED_BYTE, rows.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    size_t row_size = (size_t) *width * 3;
+    pixels->resize(rows.size());
+    for (uint32_t y = 0; y < *height; y++) {
+        memcpy(pixels->data() + y * row_size, rows.data() + (*height - 1 - y) * row_size, row_size);
+    }
+
+    if (headless) {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    }
+}
+
+bool Window::saveFrame(const std::string &file)
+{
+    std::vector<uint8_t> pixels;
+    uint32_t width;
+    uint32_t height;
+    readPixels(&pixels, &width, &height);
+
+    if (Util::write_ppm(file.c_str(), pixels.data(), width, height) != EXIT_SUCCESS) {
+        ls_log::log(LOG_ERROR, "cannot write %s\n", file.c_str());
+        return false;
+    }
+
+    return true;
 }
 
 Renderer *Window::getRenderer()
@@ -112,11 +351,20 @@ InputHandler *Window::get_input_handler()
 
 bool Window::shouldClose()
 {
+    if (headless) {
+        return close_requested;
+    }
+
     return glfwWindowShouldClose(this->handle);
 }
 
 void Window::close()
 {
+    if (headless) {
+        close_requested = true;
+        return;
+    }
+
     glfwSetWindowShouldClose(this->handle, GLFW_TRUE);
 }
 
@@ -1,13 +1,17 @@
 #ifndef LIGHT_SHOW_WINDOW_HPP
 #define LIGHT_SHOW_WINDOW_HPP
 
+#include <string>
+#include <vector>
+
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "input.hpp"
 #include "graphics.hpp"
 
 /**
- * Represents a physical window in which graphics are displayed.
+ * Represents a physical window in which graphics are displayed, or, if headless, an offscreen render target without
+ * a window.
  */
 struct Window {
 private:
@@ -17,14 +21,60 @@ private:
     const char *title;
     Renderer *renderer;
     InputHandler *input_handler;
+
+    /**
+     * Headless windows render to {framebuffer}, a multisampled offscreen framebuffer, which is resolved into
+     * {resolve_framebuffer} for reading.
+     */
+    bool headless = false;
+    bool close_requested = false;
+    GLuint framebuffer = 0;
+    GLuint color_renderbuffer = 0;
+    GLuint depth_renderbuffer = 0;
+    GLuint resolve_framebuffer = 0;
+    GLuint resolve_renderbuffer = 0;
+
+    /**
+     * EGL display and context of a headless window in builds with LIGHT_SHOW_EGL, as void pointers to keep the EGL
+     * headers out of this header. Without EGL, headless windows use a hidden GLFW window for their context.
+     */
+    void *egl_display = nullptr;
+    void *egl_context = nullptr;
+
+    /** Creates the GL context of a headless window, returns false on failure. */
+    bool createHeadlessContext();
+
+    /** Creates the offscreen framebuffers of a headless window, with up to {samples} samples per pixel. */
+    bool createFramebuffers(GLsizei samples);
+
 public:
-    Window(uint32_t width, uint32_t height, const char *title);
+    /**
+     * If {headless} is set, no window is shown and nothing is presented: the renderer draws into an offscreen
+     * framebuffer of {width} by {height}, which can be read back with {readPixels}. In builds with LIGHT_SHOW_EGL
+     * (Linux) the context is created with EGL on a surfaceless display, so it runs without a display server, for
+     * example on Mesa's llvmpipe.
+     */
+    Window(uint32_t width, uint32_t height, const char *title, bool headless = false);
 
     virtual ~Window();
 
+    /** Presents the frame, does nothing if headless. */
     void swapBuffers();
 
-    /** Poll the GLFW flag indicating whether the window should close. */
+    bool isHeadless() const;
+
+    /**
+     * Reads back the frame drawn so far as 8 bit RGB, top row first, into {pixels}. Must be called before
+     * {swapBuffers}. Writes the size of the frame to {width} and {height}.
+     */
+    void readPixels(std::vector<uint8_t> *pixels, uint32_t *width, uint32_t *height);
+
+    /**
+     * Writes the frame drawn so far to {file} as a binary PPM image, see {readPixels}. Returns false on failure.
+     */
+    bool saveFrame(const std::string &file);
+
+    /** Poll the GLFW flag indicating whether the window should close, or whether {close} was called if headless. */
     bool shouldClose();
 
     /** Set GLFW flag to indicate that the window should close. */
@@ -0,0 +1,110 @@
+#include "aabb.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+AABB::AABB(glm::vec3 p_min, glm::vec3 p_max) : min(p_min), max(p_max)
+{}
+
+AABB AABB::transformed(const AABB &box, const glm::mat4 &transform)
+{
+    if (box.is_empty()) {
+        return box;
+    }
+
+    // every axis of the result is the translation plus the extremes of the rotated and scaled box along that axis
+    glm::vec3 translation(transform[3]);
+    AABB result(translation, translation);
+    for (int column = 0; column < 3; column++) {
+        for (int row = 0; row < 3; row++) {
+            float a = transform[column][row] * box.min[column];
+            float b = transform[column][row] * box.max[column];
+            result.min[row] += std::min(a, b);
+            result.max[row] += std::max(a, b);
+        }
+    }
+
+    return result;
+}
+
+AABB AABB::merged(const AABB &a, const AABB &b)
+{
+    return AABB(glm::vec3(std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y), std::min(a.min.z, b.min.z)),
+                glm::vec3(std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y), std::max(a.max.z, b.max.z)));
+}
+
+void AABB::grow(const AABB &box)
+{
+    *this = merged(*this, box);
+}
+
+void AABB::grow(glm::vec3 point)
+{
+    *this = merged(*this, AABB(point, point));
+}
+
+bool AABB::is_empty() const
+{
+    return min.x > max.x || min.y > max.y || min.z > max.z;
+}
+
+bool AABB::contains(const AABB &box) const
+{
+    return min.x <= box.min.x && min.y <= box.min.y && min.z <= box.min.z &&
+           max.x >= box.max.x && max.y >= box.max.y && max.z >= box.max.z;
+}
+
+bool AABB::overlaps(const AABB &box) const
+{
+    return min.x <= box.max.x && min.y <= box.max.y && min.z <= box.max.z &&
+           max.x >= box.min.x && max.y >= box.min.y && max.z >= box.min.z;
+}
+
+glm::vec3 AABB::center() const
+{
+    return (min + max) * 0.5f;
+}
+
+glm::vec3 AABB::extent() const
+{
+    return max - min;
+}
+
+float AABB::surface_area() const
+{
+    if (is_empty()) {
+        return 0.0f;
+    }
+
+    glm::vec3 e = extent();
+    return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+}
+
+float AABB::intersect_ray(glm::vec3 origin, glm::vec3 inverse_direction, float max_distance) const
+{
+    // slab test, NaN from 0 * INFINITY is ignored by the min/max order
+    float t_min = 0.0f;
+    float t_max = max_distance;
+    for (int axis = 0; axis < 3; axis++) {
+        float t0 = (min[axis] - origin[axis]) * inverse_direction[axis];
+        float t1 = (max[axis] - origin[axis]) * inverse_direction[axis];
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        t_min = t0 > t_min ? t0 : t_min;
+        t_max = t1 < t_max ? t1 : t_max;
+    }
+
+    return t_min <= t_max ? t_min : INFINITY;
+}
+
+float AABB::distance_squared(glm::vec3 point) const
+{
+    float result = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        float d = std::max(std::max(min[axis] - point[axis], 0.0f), point[axis] - max[axis]);
+        result += d * d;
+    }
+
+    return result;
+}
@@ -0,0 +1,50 @@
+#ifndef UTIL_AABB_HPP
+#define UTIL_AABB_HPP
+
+#include <cmath>
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+/**
+ * Axis-aligned bounding box. The default box is empty (min > max), so growing it by any box or point yields that
+ * box or point.
+ */
+struct AABB {
+    glm::vec3 min = glm::vec3(INFINITY);
+    glm::vec3 max = glm::vec3(-INFINITY);
+
+    AABB() = default;
+
+    AABB(glm::vec3 p_min, glm::vec3 p_max);
+
+    /** Box around {box} transformed by the affine {transform} (Arvo's method). */
+    static AABB transformed(const AABB &box, const glm::mat4 &transform);
+
+    static AABB merged(const AABB &a, const AABB &b);
+
+    void grow(const AABB &box);
+
+    void grow(glm::vec3 point);
+
+    bool is_empty() const;
+
+    bool contains(const AABB &box) const;
+
+    bool overlaps(const AABB &box) const;
+
+    glm::vec3 center() const;
+
+    glm::vec3 extent() const;
+
+    /** Surface area, 0 for an empty box. */
+    float surface_area() const;
+
+    /** Distance along the ray to the entry point of the box, INFINITY if the ray misses it within {max_distance}. */
+    float intersect_ray(glm::vec3 origin, glm::vec3 inverse_direction, float max_distance) const;
+
+    /** Squared distance from {point} to the box, 0 if inside. */
+    float distance_squared(glm::vec3 point) const;
+};
+
+#endif //UTIL_AABB_HPP
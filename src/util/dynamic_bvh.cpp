@@ -0,0 +1,558 @@
+#include "dynamic_bvh.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+#include "thread_pool.hpp"
+
+/**
+ * Number of bins per axis of the SAH build.
+ */
+static const uint32_t SAH_BIN_COUNT = 16;
+
+/**
+ * Subtrees of the SAH build with at least this many objects build their children in parallel.
+ */
+static const uint32_t PARALLEL_BUILD_SIZE = 16384;
+
+/**
+ * Initial capacity of the traversal stacks, enough for most trees without reallocating.
+ */
+static const uint32_t TRAVERSAL_STACK_SIZE = 64;
+
+struct BVHBuildItem {
+    AABB box;
+    glm::vec3 centroid;
+    uint32_t leaf;
+};
+
+DynamicBVH::DynamicBVH(float p_margin) : margin(p_margin)
+{}
+
+uint32_t DynamicBVH::allocate_node()
+{
+    uint32_t node;
+    if (free_list != BVH_NULL) {
+        node = free_list;
+        free_list = nodes[node].parent;
+    } else {
+        node = (uint32_t) nodes.size();
+        nodes.emplace_back();
+    }
+
+    BVHNode &result = nodes[node];
+    result.box = AABB();
+    result.parent = BVH_NULL;
+    result.children[0] = BVH_NULL;
+    result.children[1] = BVH_NULL;
+    result.user_data = 0;
+    result.height = 0;
+
+    return node;
+}
+
+void DynamicBVH::free_node(uint32_t node)
+{
+    nodes[node].parent = free_list;
+    nodes[node].height = UINT32_MAX;
+    free_list = node;
+}
+
+AABB DynamicBVH::fatten(const AABB &box) const
+{
+    glm::vec3 padding = box.extent() * margin;
+    return AABB(box.min - padding, box.max + padding);
+}
+
+bool DynamicBVH::is_leaf(uint32_t node) const
+{
+    return nodes[node].children[0] == BVH_NULL;
+}
+
+void DynamicBVH::insert_leaf(uint32_t leaf)
+{
+    if (root == BVH_NULL) {
+        root = leaf;
+        nodes[leaf].parent = BVH_NULL;
+        return;
+    }
+
+    // descend towards the sibling for which the increase of the surface area of the tree is smallest (Catto's
+    // greedy variant of the branch and bound search of Bittner et al.)
+    AABB leaf_box = nodes[leaf].box;
+    uint32_t index = root;
+    while (!is_leaf(index)) {
+        const BVHNode &node = nodes[index];
+        float area = node.box.surface_area();
+        float combined_area = AABB::merged(node.box, leaf_box).surface_area();
+
+        // cost of making the leaf a sibling of this node, and the cost the ancestors of a lower sibling inherit
+        float cost = 2.0f * combined_area;
+        float inherited_cost = 2.0f * (combined_area - area);
+
+        float child_costs[2];
+        for (int c = 0; c < 2; c++) {
+            const BVHNode &child = nodes[node.children[c]];
+            float merged_area = AABB::merged(child.box, leaf_box).surface_area();
+            child_costs[c] = inherited_cost + (is_leaf(node.children[c]) ? merged_area
+                                                                         : merged_area - child.box.surface_area());
+        }
+
+        if (cost < child_costs[0] && cost < child_costs[1]) {
+            break;
+        }
+        index = node.children[child_costs[0] <= child_costs[1] ? 0 : 1];
+    }
+
+    uint32_t sibling = index;
+    uint32_t old_parent = nodes[sibling].parent;
+    uint32_t new_parent = allocate_node();
+
+    BVHNode &parent = nodes[new_parent];
+    parent.parent = old_parent;
+    parent.children[0] = sibling;
+    parent.children[1] = leaf;
+    nodes[sibling].parent = new_parent;
+    nodes[leaf].parent = new_parent;
+
+    if (old_parent == BVH_NULL) {
+        root = new_parent;
+    } else {
+        BVHNode &grand_parent = nodes[old_parent];
+        grand_parent.children[grand_parent.children[0] == sibling ? 0 : 1] = new_parent;
+    }
+
+    refit(new_parent);
+}
+
+void DynamicBVH::remove_leaf(uint32_t leaf)
+{
+    if (leaf == root) {
+        root = BVH_NULL;
+        return;
+    }
+
+    uint32_t parent = nodes[leaf].parent;
+    uint32_t grand_parent = nodes[parent].parent;
+    uint32_t sibling = nodes[parent].children[nodes[parent].children[0] == leaf ? 1 : 0];
+
+    // the sibling takes the place of the parent
+    nodes[sibling].parent = grand_parent;
+    free_node(parent);
+
+    if (grand_parent == BVH_NULL) {
+        root = sibling;
+    } else {
+        BVHNode &node = nodes[grand_parent];
+        node.children[node.children[0] == parent ? 0 : 1] = sibling;
+        refit(grand_parent);
+    }
+}
+
+void DynamicBVH::refit(uint32_t node)
+{
+    while (node != BVH_NULL) {
+        BVHNode &current = nodes[node];
+        current.box = AABB::merged(nodes[current.children[0]].box, nodes[current.children[1]].box);
+
+        rotate(node);
+        current.height = 1 + std::max(nodes[current.children[0]].height, nodes[current.children[1]].height);
+
+        node = current.parent;
+    }
+}
+
+void DynamicBVH::rotate(uint32_t node)
+{
+    // a rotation swaps a child with a grandchild on the other side, which changes the box of the other child only
+    BVHNode &current = nodes[node];
+    float best_gain = 0.0f;
+    int best_child = -1;
+    int best_grand_child = -1;
+
+    for (int c = 0; c < 2; c++) {
+        uint32_t child = current.children[c];
+        uint32_t other = current.children[1 - c];
+        if (is_leaf(other)) {
+            continue;
+        }
+
+        const BVHNode &other_node = nodes[other];
+        float area = other_node.box.surface_area();
+        for (int g = 0; g < 2; g++) {
+            // {child} takes the place of grandchild g, next to grandchild 1 - g
+            AABB rotated = AABB::merged(nodes[child].box, nodes[other_node.children[1 - g]].box);
+            float gain = area - rotated.surface_area();
+            if (gain > best_gain) {
+                best_gain = gain;
+                best_child = c;
+                best_grand_child = g;
+            }
+        }
+    }
+
+    if (best_child < 0) {
+        return;
+    }
+
+    uint32_t child = current.children[best_child];
+    uint32_t other = current.children[1 - best_child];
+    BVHNode &other_node = nodes[other];
+    uint32_t grand_child = other_node.children[best_grand_child];
+
+    current.children[best_child] = grand_child;
+    nodes[grand_child].parent = node;
+    other_node.children[best_grand_child] = child;
+    nodes[child].parent = other;
+
+    other_node.box = AABB::merged(nodes[other_node.children[0]].box, nodes[other_node.children[1]].box);
+    other_node.height = 1 + std::max(nodes[other_node.children[0]].height, nodes[other_node.children[1]].height);
+}
+
+uint32_t DynamicBVH::insert(const AABB &box, uint32_t user_data)
+{
+    uint32_t leaf = allocate_node();
+    nodes[leaf].box = fatten(box);
+    nodes[leaf].user_data = user_data;
+    proxy_count++;
+
+    insert_leaf(leaf);
+    return leaf;
+}
+
+void DynamicBVH::remove(uint32_t proxy)
+{
+    remove_leaf(proxy);
+    free_node(proxy);
+    proxy_count--;
+}
+
+bool DynamicBVH::move(uint32_t proxy, const AABB &box)
+{
+    AABB &leaf_box = nodes[proxy].box;
+    if (leaf_box.contains(box)) {
+        return false;
+    }
+
+    if (leaf_box.overlaps(box)) {
+        // small motion, the object likely still belongs in this part of the tree
+        leaf_box = fatten(box);
+        refit(nodes[proxy].parent);
+    } else {
+        remove_leaf(proxy);
+        nodes[proxy].box = fatten(box);
+        insert_leaf(proxy);
+    }
+
+    return true;
+}
+
+uint32_t DynamicBVH::build_range(BVHBuildItem *items, uint32_t count, uint32_t first_node)
+{
+    if (count == 1) {
+        return items[0].leaf;
+    }
+
+    AABB centroid_box;
+    for (uint32_t i = 0; i < count; i++) {
+        centroid_box.grow(items[i].centroid);
+    }
+
+    // evaluate the split planes between the bins of all axes, with cost = area(left) * n(left) + area(right) * n(right)
+    int best_axis = -1;
+    uint32_t best_split = 0;
+    float best_cost = INFINITY;
+    glm::vec3 extent = centroid_box.extent();
+
+    for (int axis = 0; axis < 3 && count > 2; axis++) {
+        if (extent[axis] <= 0.0f) {
+            continue;
+        }
+
+        // grown component-wise here rather than with {AABB::grow}, this loop dominates the build
+        AABB bin_boxes[SAH_BIN_COUNT];
+        uint32_t bin_counts[SAH_BIN_COUNT] = {};
+        float scale = (float) SAH_BIN_COUNT / extent[axis];
+        for (uint32_t i = 0; i < count; i++) {
+            auto bin = (uint32_t) ((items[i].centroid[axis] - centroid_box.min[axis]) * scale);
+            bin = std::min(bin, SAH_BIN_COUNT - 1);
+
+            AABB &bin_box = bin_boxes[bin];
+            const AABB &box = items[i].box;
+            for (int a = 0; a < 3; a++) {
+                bin_box.min[a] = std::min(bin_box.min[a], box.min[a]);
+                bin_box.max[a] = std::max(bin_box.max[a], box.max[a]);
+            }
+            bin_counts[bin]++;
+        }
+
+        // right_costs[b] is the cost of the bins from b + 1 on
+        float right_costs[SAH_BIN_COUNT];
+        AABB right_box;
+        uint32_t right_count = 0;
+        for (uint32_t b = SAH_BIN_COUNT - 1; b > 0; b--) {
+            right_box.grow(bin_boxes[b]);
+            right_count += bin_counts[b];
+            right_costs[b - 1] = right_box.surface_area() * (float) right_count;
+        }
+
+        AABB left_box;
+        uint32_t left_count = 0;
+        for (uint32_t b = 0; b + 1 < SAH_BIN_COUNT; b++) {
+            left_box.grow(bin_boxes[b]);
+            left_count += bin_counts[b];
+            float cost = left_box.surface_area() * (float) left_count + right_costs[b];
+            if (left_count > 0 && left_count < count && cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = b;
+            }
+        }
+    }
+
+    BVHBuildItem *middle = items + count / 2;
+    if (best_axis >= 0) {
+        float scale = (float) SAH_BIN_COUNT / extent[best_axis];
+        float origin = centroid_box.min[best_axis];
+        middle = std::partition(items, items + count, [&](const BVHBuildItem &item) {
+            auto bin = (uint32_t) ((item.centroid[best_axis] - origin) * scale);
+            return std::min(bin, SAH_BIN_COUNT - 1) <= best_split;
+        });
+    }
+    if (middle == items || middle == items + count) {
+        middle = items + count / 2;
+    }
+
+    // the left subtree takes the first left_count - 1 nodes, followed by this node and the right subtree
+    auto left_count = (uint32_t) (middle - items);
+    uint32_t node = first_node + left_count - 1;
+    uint32_t left;
+    uint32_t right;
+    if (count >= PARALLEL_BUILD_SIZE) {
+        ThreadPool::get_instance()->parallel_for(2, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t side = begin; side < end; side++) {
+                if (side == 0) {
+                    left = build_range(items, left_count, first_node);
+                } else {
+                    right = build_range(middle, count - left_count, node + 1);
+                }
+            }
+        });
+    } else {
+        left = build_range(items, left_count, first_node);
+        right = build_range(middle, count - left_count, node + 1);
+    }
+
+    BVHNode &result = nodes[node];
+    result.parent = BVH_NULL;
+    result.children[0] = left;
+    result.children[1] = right;
+    result.box = AABB::merged(nodes[left].box, nodes[right].box);
+    result.height = 1 + std::max(nodes[left].height, nodes[right].height);
+    nodes[left].parent = node;
+    nodes[right].parent = node;
+
+    return node;
+}
+
+void DynamicBVH::build(const AABB *boxes, const uint32_t *user_data, uint32_t count, uint32_t *proxies)
+{
+    clear();
+    if (count == 0) {
+        return;
+    }
+
+    // leaves first, then the internal nodes, which subtrees are assigned contiguous ranges of so they can be built
+    // in parallel
+    nodes.resize(2 * count - 1);
+
+    // the items are partitioned in place, so each level of the build reads them sequentially
+    std::vector<BVHBuildItem> items(count);
+    for (uint32_t leaf = 0; leaf < count; leaf++) {
+        BVHNode &node = nodes[leaf];
+        node.box = fatten(boxes[leaf]);
+        node.parent = BVH_NULL;
+        node.children[0] = BVH_NULL;
+        node.children[1] = BVH_NULL;
+        node.user_data = user_data[leaf];
+        node.height = 0;
+        proxies[leaf] = leaf;
+
+        items[leaf].box = node.box;
+        items[leaf].centroid = boxes[leaf].center();
+        items[leaf].leaf = leaf;
+    }
+    proxy_count = count;
+
+    root = build_range(items.data(), count, count);
+}
+
+void DynamicBVH::clear()
+{
+    nodes.clear();
+    root = BVH_NULL;
+    free_list = BVH_NULL;
+    proxy_count = 0;
+}
+
+uint32_t DynamicBVH::cull(const Frustum &frustum, std::vector<uint32_t> *visible) const
+{
+    if (root == BVH_NULL) {
+        return 0;
+    }
+
+    // entries are (node, mask of the planes the node is not known to be inside of)
+    std::vector<std::pair<uint32_t, uint32_t>> stack;
+    stack.reserve(TRAVERSAL_STACK_SIZE);
+    stack.emplace_back(root, ALL_FRUSTUM_PLANES);
+
+    size_t first = visible->size();
+    while (!stack.empty()) {
+        uint32_t node = stack.back().first;
+        uint32_t plane_mask = stack.back().second;
+        stack.pop_back();
+
+        const BVHNode &current = nodes[node];
+        if (plane_mask && frustum.test_box(current.box.min, current.box.max, &plane_mask) == OUTSIDE_FRUSTUM) {
+            continue;
+        }
+
+        if (is_leaf(node)) {
+            visible->emplace_back(current.user_data);
+        } else {
+            stack.emplace_back(current.children[1], plane_mask);
+            stack.emplace_back(current.children[0], plane_mask);
+        }
+    }
+
+    return (uint32_t) (visible->size() - first);
+}
+
+uint32_t DynamicBVH::query_sphere(glm::vec3 center, float radius, std::vector<uint32_t> *result) const
+{
+    if (root == BVH_NULL) {
+        return 0;
+    }
+
+    std::vector<uint32_t> stack;
+    stack.reserve(TRAVERSAL_STACK_SIZE);
+    stack.emplace_back(root);
+
+    size_t first = result->size();
+    float radius_squared = radius * radius;
+    while (!stack.empty()) {
+        uint32_t node = stack.back();
+        stack.pop_back();
+
+        const BVHNode &current = nodes[node];
+        if (current.box.distance_squared(center) > radius_squared) {
+            continue;
+        }
+
+        if (is_leaf(node)) {
+            result->emplace_back(current.user_data);
+        } else {
+            stack.emplace_back(current.children[1]);
+            stack.emplace_back(current.children[0]);
+        }
+    }
+
+    return (uint32_t) (result->size() - first);
+}
+
+bool DynamicBVH::ray_cast(glm::vec3 origin, glm::vec3 direction, float max_distance,
+                          const std::function<float(uint32_t user_data, float distance)> &intersect,
+                          BVHRayHit *hit) const
+{
+    if (root == BVH_NULL) {
+        return false;
+    }
+
+    glm::vec3 inverse_direction(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    float nearest = max_distance;
+    bool found = false;
+
+    // entries are (node, distance to its box)
+    std::vector<std::pair<uint32_t, float>> stack;
+    stack.reserve(TRAVERSAL_STACK_SIZE);
+
+    float root_distance = nodes[root].box.intersect_ray(origin, inverse_direction, nearest);
+    if (root_distance != INFINITY) {
+        stack.emplace_back(root, root_distance);
+    }
+
+    while (!stack.empty()) {
+        uint32_t node = stack.back().first;
+        float distance = stack.back().second;
+        stack.pop_back();
+
+        // a hit found since the node was pushed may be nearer than its box
+        if (distance > nearest) {
+            continue;
+        }
+
+        const BVHNode &current = nodes[node];
+        if (is_leaf(node)) {
+            float object_distance = intersect(current.user_data, nearest);
+            if (object_distance < nearest) {
+                nearest = object_distance;
+                hit->user_data = current.user_data;
+                hit->distance = object_distance;
+                found = true;
+            }
+            continue;
+        }
+
+        float distances[2];
+        for (int c = 0; c < 2; c++) {
+            distances[c] = nodes[current.children[c]].box.intersect_ray(origin, inverse_direction, nearest);
+        }
+
+        // push the farther child first, so the nearer one is visited first
+        int nearer = distances[0] <= distances[1] ? 0 : 1;
+        if (distances[1 - nearer] != INFINITY) {
+            stack.emplace_back(current.children[1 - nearer], distances[1 - nearer]);
+        }
+        if (distances[nearer] != INFINITY) {
+            stack.emplace_back(current.children[nearer], distances[nearer]);
+        }
+    }
+
+    return found;
+}
+
+const AABB &DynamicBVH::get_box(uint32_t proxy) const
+{
+    return nodes[proxy].box;
+}
+
+uint32_t DynamicBVH::get_user_data(uint32_t proxy) const
+{
+    return nodes[proxy].user_data;
+}
+
+uint32_t DynamicBVH::get_proxy_count() const
+{
+    return proxy_count;
+}
+
+uint32_t DynamicBVH::get_height() const
+{
+    return root == BVH_NULL ? 0 : nodes[root].height;
+}
+
+float DynamicBVH::get_sah_cost() const
+{
+    if (root == BVH_NULL || is_leaf(root)) {
+        return 0.0f;
+    }
+
+    float internal_area = 0.0f;
+    for (uint32_t node = 0; node < nodes.size(); node++) {
+        if (nodes[node].height != UINT32_MAX && !is_leaf(node)) {
+            internal_area += nodes[node].box.surface_area();
+        }
+    }
+
+    return internal_area / nodes[root].box.surface_area();
+}
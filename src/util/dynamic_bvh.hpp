@@ -0,0 +1,137 @@
+#ifndef UTIL_DYNAMIC_BVH_HPP
+#define UTIL_DYNAMIC_BVH_HPP
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+#include <glm/vec3.hpp>
+
+#include "aabb.hpp"
+#include "frustum.hpp"
+
+const uint32_t BVH_NULL = UINT32_MAX;
+
+struct BVHNode {
+    /** For leaves the fattened box of the object, for internal nodes the union of the children. */
+    AABB box;
+
+    /** {BVH_NULL} for the root. For free nodes, the next free node. */
+    uint32_t parent;
+
+    /** {BVH_NULL} for leaves. */
+    uint32_t children[2];
+
+    /** Of leaves, passed back by the queries. */
+    uint32_t user_data;
+
+    /** 0 for leaves. */
+    uint32_t height;
+};
+
+/**
+ * Object of {DynamicBVH::build}.
+ */
+struct BVHBuildItem;
+
+struct BVHRayHit {
+    uint32_t user_data;
+    float distance;
+};
+
+/**
+ * Bounding volume hierarchy over objects that move, with one object per leaf. Objects are identified by the proxy
+ * returned by {insert} or {build}, which stays valid until the object is removed.
+ *
+ * {build} creates the tree top-down with the binned surface area heuristic (SAH). Afterwards, objects are inserted
+ * next to the sibling that increases the total surface area the least, and moved objects refit their ancestors.
+ * Every refit tries the tree rotations of Kopta et al. ("Fast, Effective BVH Updates for Animated Scenes") to keep
+ * the SAH cost close to that of a rebuild. Leaf boxes are enlarged by a margin, so objects moving within it do not
+ * touch the tree at all.
+ */
+struct DynamicBVH {
+private:
+    std::vector<BVHNode> nodes;
+    uint32_t root = BVH_NULL;
+    uint32_t free_list = BVH_NULL;
+    uint32_t proxy_count = 0;
+
+    /** Fraction of the extent of an object added to each side of its leaf box. */
+    float margin;
+
+    uint32_t allocate_node();
+
+    void free_node(uint32_t node);
+
+    AABB fatten(const AABB &box) const;
+
+    bool is_leaf(uint32_t node) const;
+
+    void insert_leaf(uint32_t leaf);
+
+    void remove_leaf(uint32_t leaf);
+
+    /** Recomputes the boxes and heights of {node} and its ancestors, rotating each of them. */
+    void refit(uint32_t node);
+
+    /** Applies the rotation below {node} that reduces the surface area of its children the most, if any. */
+    void rotate(uint32_t node);
+
+    /**
+     * Builds the subtree over {items[0, count)}, which are reordered, and returns its root. The internal nodes of
+     * the subtree are stored at [{first_node}, {first_node} + {count} - 1).
+     */
+    uint32_t build_range(BVHBuildItem *items, uint32_t count, uint32_t first_node);
+
+public:
+    explicit DynamicBVH(float p_margin = 0.1f);
+
+    /** Adds an object with bounding box {box}. Returns its proxy. */
+    uint32_t insert(const AABB &box, uint32_t user_data);
+
+    void remove(uint32_t proxy);
+
+    /**
+     * Updates the bounding box of {proxy}. Nothing changes if {box} is within the leaf box. A box overlapping the
+     * leaf box is refitted in place, otherwise the object is reinserted. Returns whether the tree changed.
+     */
+    bool move(uint32_t proxy, const AABB &box);
+
+    /**
+     * Replaces the contents of the tree with the {count} objects with bounding boxes {boxes}, built with the binned
+     * SAH. Writes the proxy of object i to {proxies[i]}.
+     */
+    void build(const AABB *boxes, const uint32_t *user_data, uint32_t count, uint32_t *proxies);
+
+    void clear();
+
+    /**
+     * Appends the user data of the objects of which the leaf box intersects {frustum} to {visible}, and returns their
+     * number. Subtrees inside the frustum are added without testing them, subtrees outside it are skipped.
+     */
+    uint32_t cull(const Frustum &frustum, std::vector<uint32_t> *visible) const;
+
+    /** Appends the user data of the objects of which the leaf box overlaps the sphere to {result}. */
+    uint32_t query_sphere(glm::vec3 center, float radius, std::vector<uint32_t> *result) const;
+
+    /**
+     * Finds the nearest object along the ray. Leaves are visited front to back, and {intersect(user_data, distance)}
+     * is called for the objects of which the leaf box is hit before the nearest hit so far at {distance}. It returns
+     * the distance at which the ray hits the object, or INFINITY. Returns whether an object was hit.
+     */
+    bool ray_cast(glm::vec3 origin, glm::vec3 direction, float max_distance,
+                  const std::function<float(uint32_t user_data, float distance)> &intersect, BVHRayHit *hit) const;
+
+    const AABB &get_box(uint32_t proxy) const;
+
+    uint32_t get_user_data(uint32_t proxy) const;
+
+    uint32_t get_proxy_count() const;
+
+    uint32_t get_height() const;
+
+    /** Surface area of the internal nodes relative to the root, which measures the expected cost of queries. */
+    float get_sah_cost() const;
+};
+
+#endif //UTIL_DYNAMIC_BVH_HPP
@@ -0,0 +1,264 @@
+#include "frustum.hpp"
+#include "thread_pool.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+#include <glm/geometric.hpp>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+Frustum Frustum::from_matrix(const glm::mat4 &view_projection)
+{
+    // NB: glm matrices are column major, so row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+    const glm::mat4 &m = view_projection;
+    glm::vec4 row_x(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row_y(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row_z(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row_w(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum result = {};
+    result.planes[LEFT_PLANE] = row_w + row_x;
+    result.planes[RIGHT_PLANE] = row_w - row_x;
+    result.planes[BOTTOM_PLANE] = row_w + row_y;
+    result.planes[TOP_PLANE] = row_w - row_y;
+    result.planes[NEAR_PLANE] = row_w + row_z;
+    result.planes[FAR_PLANE] = row_w - row_z;
+
+    for (auto &plane : result.planes) {
+        float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        if (length > 0) {
+            plane /= length;
+        }
+    }
+
+    return result;
+}
+
+bool Frustum::intersects_sphere(glm::vec3 center, float radius) const
+{
+    for (const auto &plane : planes) {
+        // NB: written as a negated comparison so NaN is culled, like in the SIMD paths of {test_spheres}
+        if (!(plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w >= -radius)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Frustum::contains_sphere(glm::vec3 center, float radius) const
+{
+    for (const auto &plane : planes) {
+        if (!(plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w >= radius)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+FrustumOverlap Frustum::test_box(glm::vec3 min, glm::vec3 max, uint32_t *plane_mask) const
+{
+    for (uint32_t p = 0; p < FRUSTUM_PLANE_COUNT; p++) {
+        if (!(*plane_mask & (1u << p))) {
+            continue;
+        }
+
+        // the corners of the box furthest along and against the plane normal
+        const glm::vec4 &plane = planes[p];
+        glm::vec3 positive(plane.x >= 0 ? max.x : min.x, plane.y >= 0 ? max.y : min.y, plane.z >= 0 ? max.z : min.z);
+        glm::vec3 negative(plane.x >= 0 ? min.x : max.x, plane.y >= 0 ? min.y : max.y, plane.z >= 0 ? min.z : max.z);
+
+        if (!(plane.x * positive.x + plane.y * positive.y + plane.z * positive.z + plane.w >= 0)) {
+            return OUTSIDE_FRUSTUM;
+        }
+        if (plane.x * negative.x + plane.y * negative.y + plane.z * negative.z + plane.w >= 0) {
+            *plane_mask &= ~(1u << p);
+        }
+    }
+
+    return *plane_mask ? INTERSECTS_FRUSTUM : INSIDE_FRUSTUM;
+}
+
+#if defined(__SSE__) || defined(_M_X64)
+/**
+ * Bit i of the result is set if sphere i of the four spheres ({x}, {y}, {z}, {radius}) intersects all {planes}.
+ */
+static int intersects_spheres_sse(const glm::vec4 *planes, __m128 x, __m128 y, __m128 z, __m128 radius)
+{
+    __m128 negative_radius = _mm_sub_ps(_mm_setzero_ps(), radius);
+
+    // a lane stays set while its sphere is not entirely outside any plane
+    __m128 inside = _mm_cmpeq_ps(x, x);
+    for (uint32_t p = 0; p < FRUSTUM_PLANE_COUNT; p++) {
+        const glm::vec4 &plane = planes[p];
+        __m128 distance = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_set1_ps(plane.w));
+        distance = _mm_add_ps(distance, _mm_mul_ps(y, _mm_set1_ps(plane.y)));
+        distance = _mm_add_ps(distance, _mm_mul_ps(z, _mm_set1_ps(plane.z)));
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negative_radius));
+    }
+
+    return _mm_movemask_ps(inside);
+}
+#endif
+
+uint32_t Frustum::test_spheres(const float *x, const float *y, const float *z, const float *radius, uint32_t count,
+                               uint8_t *visible) const
+{
+    uint32_t visible_count = 0;
+    uint32_t i = 0;
+
+#if defined(__AVX__)
+    for (; i + 8 <= count; i += 8) {
+        __m256 cx = _mm256_loadu_ps(x + i);
+        __m256 cy = _mm256_loadu_ps(y + i);
+        __m256 cz = _mm256_loadu_ps(z + i);
+        __m256 negative_radius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+
+        // a lane stays set while its sphere is not entirely outside any plane
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const auto &plane : planes) {
+            __m256 distance = _mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(plane.x)), _mm256_set1_ps(plane.w));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(cy, _mm256_set1_ps(plane.y)));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(cz, _mm256_set1_ps(plane.z)));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negative_radius, _CMP_GE_OQ));
+        }
+
+        int mask = _mm256_movemask_ps(inside);
+        for (uint32_t lane = 0; lane < 8; lane++) {
+            visible[i + lane] = (uint8_t) ((mask >> lane) & 1);
+        }
+        visible_count += (uint32_t) __builtin_popcount((unsigned) mask);
+    }
+#elif defined(__SSE__) || defined(_M_X64)
+    for (; i + 4 <= count; i += 4) {
+        int mask = intersects_spheres_sse(planes, _mm_loadu_ps(x + i), _mm_loadu_ps(y + i), _mm_loadu_ps(z + i),
+                                          _mm_loadu_ps(radius + i));
+        for (uint32_t lane = 0; lane < 4; lane++) {
+            visible[i + lane] = (uint8_t) ((mask >> lane) & 1);
+            visible_count += (mask >> lane) & 1;
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        visible[i] = intersects_sphere(glm::vec3(x[i], y[i], z[i]), radius[i]) ? 1 : 0;
+        visible_count += visible[i];
+    }
+
+    return visible_count;
+}
+
+uint32_t Frustum::cull_transformed_spheres(const glm::mat4 *transforms, uint32_t count, glm::vec3 center,
+                                           float radius, uint32_t *visible_indices) const
+{
+    uint32_t visible_count = 0;
+    uint32_t i = 0;
+
+#if defined(__SSE__) || defined(_M_X64)
+    __m128 local_x = _mm_set1_ps(center.x);
+    __m128 local_y = _mm_set1_ps(center.y);
+    __m128 local_z = _mm_set1_ps(center.z);
+    __m128 local_radius = _mm_set1_ps(radius);
+
+    for (; i + 4 <= count; i += 4) {
+        // columns[c][r] holds row r of column c of the four matrices, one matrix per lane
+        __m128 columns[4][4];
+        for (uint32_t c = 0; c < 4; c++) {
+            for (uint32_t lane = 0; lane < 4; lane++) {
+                columns[c][lane] = _mm_loadu_ps(&transforms[i + lane][c][0]);
+            }
+            _MM_TRANSPOSE4_PS(columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+        }
+
+        __m128 world[3];
+        for (uint32_t r = 0; r < 3; r++) {
+            world[r] = _mm_add_ps(_mm_mul_ps(columns[0][r], local_x), columns[3][r]);
+            world[r] = _mm_add_ps(world[r], _mm_mul_ps(columns[1][r], local_y));
+            world[r] = _mm_add_ps(world[r], _mm_mul_ps(columns[2][r], local_z));
+        }
+
+        // largest squared length of the axes
+        __m128 scale = _mm_setzero_ps();
+        for (uint32_t c = 0; c < 3; c++) {
+            __m128 length = _mm_mul_ps(columns[c][0], columns[c][0]);
+            length = _mm_add_ps(length, _mm_mul_ps(columns[c][1], columns[c][1]));
+            length = _mm_add_ps(length, _mm_mul_ps(columns[c][2], columns[c][2]));
+            scale = _mm_max_ps(scale, length);
+        }
+
+        __m128 world_radius = _mm_mul_ps(local_radius, _mm_sqrt_ps(scale));
+        int mask = intersects_spheres_sse(planes, world[0], world[1], world[2], world_radius);
+        for (uint32_t lane = 0; lane < 4; lane++) {
+            visible_indices[visible_count] = i + lane;
+            visible_count += (mask >> lane) & 1;
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        const glm::mat4 &m = transforms[i];
+        glm::vec3 world(m * glm::vec4(center, 1.0f));
+        float scale = std::max(glm::dot(glm::vec3(m[0]), glm::vec3(m[0])),
+                               std::max(glm::dot(glm::vec3(m[1]), glm::vec3(m[1])),
+                                        glm::dot(glm::vec3(m[2]), glm::vec3(m[2]))));
+        if (intersects_sphere(world, radius * std::sqrt(scale))) {
+            visible_indices[visible_count++] = i;
+        }
+    }
+
+    return visible_count;
+}
+
+uint32_t InstanceCuller::cull(const Frustum &frustum, const glm::mat4 *transforms, uint32_t count, glm::vec3 center,
+                              float radius)
+{
+    uint32_t chunk_count = (count + INSTANCE_CULLING_CHUNK - 1) / INSTANCE_CULLING_CHUNK;
+    visible_indices.resize(count);
+    chunk_offsets.resize(chunk_count + 1);
+    chunk_offsets[0] = 0;
+
+    ThreadPool::get_instance()->parallel_for(chunk_count, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t chunk = begin; chunk < end; chunk++) {
+            uint32_t first = chunk * INSTANCE_CULLING_CHUNK;
+            uint32_t *visible = &visible_indices[first];
+            uint32_t visible_count = frustum.cull_transformed_spheres(
+                    &transforms[first], std::min(INSTANCE_CULLING_CHUNK, count - first), center, radius, visible);
+
+            // NB: the indices are relative to the chunk, {compact} hands out indices into {transforms}
+            for (uint32_t i = 0; i < visible_count; i++) {
+                visible[i] += first;
+            }
+            chunk_offsets[chunk + 1] = visible_count;
+        }
+    });
+
+    for (uint32_t chunk = 0; chunk < chunk_count; chunk++) {
+        chunk_offsets[chunk + 1] += chunk_offsets[chunk];
+    }
+
+    return chunk_offsets[chunk_count];
+}
+
+void InstanceCuller::compact(
+        const std::function<void(uint32_t destination, const uint32_t *sources, uint32_t count)> &copy) const
+{
+    if (chunk_offsets.empty()) {
+        return;
+    }
+
+    auto chunk_count = (uint32_t) chunk_offsets.size() - 1;
+    ThreadPool::get_instance()->parallel_for(chunk_count, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t chunk = begin; chunk < end; chunk++) {
+            uint32_t count = chunk_offsets[chunk + 1] - chunk_offsets[chunk];
+            if (count > 0) {
+                copy(chunk_offsets[chunk], &visible_indices[chunk * INSTANCE_CULLING_CHUNK], count);
+            }
+        }
+    });
+}
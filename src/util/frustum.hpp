@@ -0,0 +1,92 @@
+#ifndef UTIL_FRUSTUM_HPP
+#define UTIL_FRUSTUM_HPP
+
+#include <cstdint>
+#include <vector>
+#include <functional>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+enum FrustumPlane {
+    LEFT_PLANE, RIGHT_PLANE, BOTTOM_PLANE, TOP_PLANE, NEAR_PLANE, FAR_PLANE, FRUSTUM_PLANE_COUNT
+};
+
+enum FrustumOverlap {
+    OUTSIDE_FRUSTUM, INTERSECTS_FRUSTUM, INSIDE_FRUSTUM
+};
+
+/** Bit i set for plane i, see {Frustum::test_box}. */
+const uint32_t ALL_FRUSTUM_PLANES = (1u << FRUSTUM_PLANE_COUNT) - 1;
+
+/**
+ * View frustum as six planes (a, b, c, d) with unit normals pointing inward: point p lies inside the frustum if
+ * a * p.x + b * p.y + c * p.z + d >= 0 for every plane.
+ */
+struct Frustum {
+    glm::vec4 planes[FRUSTUM_PLANE_COUNT];
+
+    /** Extracts the planes of the clip volume of {view_projection} (Gribb and Hartmann), in the space it maps from. */
+    static Frustum from_matrix(const glm::mat4 &view_projection);
+
+    /** Conservative test: false only if the sphere lies entirely outside one of the planes. */
+    bool intersects_sphere(glm::vec3 center, float radius) const;
+
+    /** True if the sphere lies entirely inside all planes. */
+    bool contains_sphere(glm::vec3 center, float radius) const;
+
+    /**
+     * Tests the box ({min}, {max}) against the planes of which the bit is set in {plane_mask}, and clears the bits
+     * of the planes the box lies entirely inside of. Passing the mask of a parent box on to its children skips the
+     * planes the parent is already inside of. Like {intersects_sphere}, the test is conservative.
+     */
+    FrustumOverlap test_box(glm::vec3 min, glm::vec3 max, uint32_t *plane_mask) const;
+
+    /**
+     * Batched {intersects_sphere} of {count} spheres in structure of arrays layout, 8 (AVX) or 4 (SSE) at a time.
+     * Sets {visible[i]} to 1 if sphere i intersects the frustum and to 0 otherwise. Returns the number of visible
+     * spheres.
+     */
+    uint32_t test_spheres(const float *x, const float *y, const float *z, const float *radius, uint32_t count,
+                          uint8_t *visible) const;
+
+    /**
+     * Tests the sphere ({center}, {radius}) transformed by each of the {count} matrices of {transforms}, with the
+     * radius scaled by the largest axis scale of the matrix. Writes the indices of the visible transforms to
+     * {visible_indices} in increasing order and returns their number. Four transforms are transposed and tested at
+     * a time with SSE.
+     */
+    uint32_t cull_transformed_spheres(const glm::mat4 *transforms, uint32_t count, glm::vec3 center, float radius,
+                                      uint32_t *visible_indices) const;
+};
+
+/** Number of instances culled per job by {InstanceCuller}. */
+const uint32_t INSTANCE_CULLING_CHUNK = 4096;
+
+/**
+ * Frustum culling of many instances of one model, in chunks of {INSTANCE_CULLING_CHUNK} on the thread pool, and
+ * compaction of the visible ones into consecutive slots. Keeps its scratch buffers between calls.
+ */
+struct InstanceCuller {
+    /** Indices of the visible instances of each chunk, stored at the start of the chunk. */
+    std::vector<uint32_t> visible_indices;
+
+    /** Prefix sums of the visible counts of the chunks: the first slot of each chunk in the compacted instances. */
+    std::vector<uint32_t> chunk_offsets;
+
+    /**
+     * Tests the sphere ({center}, {radius}) transformed by each of the {count} {transforms} against {frustum}, with
+     * {Frustum::cull_transformed_spheres}. Returns the number of visible instances.
+     */
+    uint32_t cull(const Frustum &frustum, const glm::mat4 *transforms, uint32_t count, glm::vec3 center,
+                  float radius);
+
+    /**
+     * Calls {copy(destination, sources, count)} once per chunk of the last {cull}, in parallel on the thread pool: the
+     * {count} visible instances with indices {sources} go to slots {destination} to {destination} + {count}.
+     */
+    void compact(const std::function<void(uint32_t destination, const uint32_t *sources, uint32_t count)> &copy) const;
+};
+
+#endif //UTIL_FRUSTUM_HPP
@@ -0,0 +1,111 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+#else
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#endif
+
+#include "ls_log.hpp"
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (data) {
+        UnmapViewOfFile(data);
+    }
+    if (mapping_handle) {
+        CloseHandle(mapping_handle);
+    }
+    if (file_handle) {
+        CloseHandle(file_handle);
+    }
+#else
+    if (data) {
+        munmap((void *) data, size);
+    }
+    if (file_descriptor >= 0) {
+        close(file_descriptor);
+    }
+#endif
+}
+
+std::shared_ptr<MappedFile> MappedFile::open(const char *file_name)
+{
+    std::shared_ptr<MappedFile> result(new MappedFile());
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    result->file_handle = file;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        return nullptr;
+    }
+    result->size = (size_t) file_size.QuadPart;
+
+    // NB: empty files cannot be mapped, they are represented by a null pointer and a size of zero
+    if (result->size == 0) {
+        return result;
+    }
+
+    result->mapping_handle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!result->mapping_handle) {
+        ls_log::log(LOG_ERROR, "failed to create file mapping of \"%s\"\n", file_name);
+        return nullptr;
+    }
+
+    result->data = (const char *) MapViewOfFile(result->mapping_handle, FILE_MAP_READ, 0, 0, 0);
+    if (!result->data) {
+        ls_log::log(LOG_ERROR, "failed to map view of \"%s\"\n", file_name);
+        return nullptr;
+    }
+#else
+    int file = ::open(file_name, O_RDONLY);
+    if (file < 0) {
+        return nullptr;
+    }
+    result->file_descriptor = file;
+
+    struct stat file_stat = {};
+    if (fstat(file, &file_stat) != 0) {
+        return nullptr;
+    }
+    result->size = (size_t) file_stat.st_size;
+
+    // NB: empty files cannot be mapped, they are represented by a null pointer and a size of zero
+    if (result->size == 0) {
+        return result;
+    }
+
+    void *mapping = mmap(nullptr, result->size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (mapping == MAP_FAILED) {
+        ls_log::log(LOG_ERROR, "failed to map \"%s\"\n", file_name);
+        return nullptr;
+    }
+    result->data = (const char *) mapping;
+#endif
+
+    return result;
+}
+
+const char *MappedFile::get_data() const
+{
+    return data;
+}
+
+size_t MappedFile::get_size() const
+{
+    return size;
+}
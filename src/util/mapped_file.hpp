@@ -0,0 +1,40 @@
+#ifndef UTIL_MAPPED_FILE_HPP
+#define UTIL_MAPPED_FILE_HPP
+
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Read-only memory mapping of an entire file. The mapping is released when the last reference is dropped.
+ */
+class MappedFile {
+private:
+    const char *data = nullptr;
+    size_t size = 0;
+
+#ifdef _WIN32
+    void *file_handle = nullptr;
+    void *mapping_handle = nullptr;
+#else
+    int file_descriptor = -1;
+#endif
+
+    MappedFile() = default;
+
+public:
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    virtual ~MappedFile();
+
+    /** Maps {file_name} into memory. Returns {nullptr} if the file cannot be opened or mapped. */
+    static std::shared_ptr<MappedFile> open(const char *file_name);
+
+    const char *get_data() const;
+
+    size_t get_size() const;
+};
+
+#endif //UTIL_MAPPED_FILE_HPP
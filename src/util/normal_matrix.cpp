@@ -0,0 +1,105 @@
+#include "normal_matrix.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include <glm/geometric.hpp>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+PackedNormalMatrix PackedNormalMatrix::from_transform(const glm::mat4 &transform)
+{
+    glm::vec3 c0(transform[0]);
+    glm::vec3 c1(transform[1]);
+    glm::vec3 c2(transform[2]);
+
+    PackedNormalMatrix result;
+    result.columns[0] = glm::cross(c1, c2);
+    result.columns[1] = glm::cross(c2, c0);
+    result.columns[2] = glm::cross(c0, c1);
+
+    float determinant = glm::dot(c0, result.columns[0]);
+    if (determinant != 0.0f) {
+        for (auto &column : result.columns) {
+            column /= determinant;
+        }
+    }
+
+    return result;
+}
+
+void PackedNormalMatrix::from_transforms(const glm::mat4 *transforms, uint32_t count, PackedNormalMatrix *result)
+{
+    uint32_t i = 0;
+
+#if defined(__SSE__) || defined(_M_X64)
+    for (; i + 4 <= count; i += 4) {
+        // c[k][r] holds row r of column k of the four transforms, one transform per lane
+        __m128 c[3][4];
+        for (uint32_t k = 0; k < 3; k++) {
+            for (uint32_t lane = 0; lane < 4; lane++) {
+                c[k][lane] = _mm_loadu_ps(&transforms[i + lane][k][0]);
+            }
+            _MM_TRANSPOSE4_PS(c[k][0], c[k][1], c[k][2], c[k][3]);
+        }
+
+        // n[k] = cross(c[k + 1], c[k + 2])
+        __m128 n[3][4];
+        for (uint32_t k = 0; k < 3; k++) {
+            const __m128 *a = c[(k + 1) % 3];
+            const __m128 *b = c[(k + 2) % 3];
+            n[k][0] = _mm_sub_ps(_mm_mul_ps(a[1], b[2]), _mm_mul_ps(a[2], b[1]));
+            n[k][1] = _mm_sub_ps(_mm_mul_ps(a[2], b[0]), _mm_mul_ps(a[0], b[2]));
+            n[k][2] = _mm_sub_ps(_mm_mul_ps(a[0], b[1]), _mm_mul_ps(a[1], b[0]));
+            n[k][3] = _mm_setzero_ps();
+        }
+
+        __m128 determinant = _mm_mul_ps(c[0][0], n[0][0]);
+        determinant = _mm_add_ps(determinant, _mm_mul_ps(c[0][1], n[0][1]));
+        determinant = _mm_add_ps(determinant, _mm_mul_ps(c[0][2], n[0][2]));
+
+        // singular lanes keep the cofactors, like {from_transform}
+        __m128 singular = _mm_cmpeq_ps(determinant, _mm_setzero_ps());
+        __m128 scale = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+        scale = _mm_or_ps(_mm_andnot_ps(singular, scale), _mm_and_ps(singular, _mm_set1_ps(1.0f)));
+
+        for (uint32_t k = 0; k < 3; k++) {
+            for (uint32_t r = 0; r < 3; r++) {
+                n[k][r] = _mm_mul_ps(n[k][r], scale);
+            }
+            _MM_TRANSPOSE4_PS(n[k][0], n[k][1], n[k][2], n[k][3]);
+
+            // n[k][lane] now holds column k of the normal matrix of transform i + lane
+            for (uint32_t lane = 0; lane < 4; lane++) {
+                float column[4];
+                _mm_storeu_ps(column, n[k][lane]);
+                std::memcpy(&result[i + lane].columns[k], column, sizeof(glm::vec3));
+            }
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        result[i] = from_transform(transforms[i]);
+    }
+}
+
+bool PackedNormalMatrix::has_uniform_scale(const glm::mat4 &transform)
+{
+    glm::vec3 c0(transform[0]);
+    glm::vec3 c1(transform[1]);
+    glm::vec3 c2(transform[2]);
+
+    float l0 = glm::dot(c0, c0);
+    float l1 = glm::dot(c1, c1);
+    float l2 = glm::dot(c2, c2);
+
+    // relative to the squared scale, float precision of a composed transform is around 1e-6
+    float tolerance = 1e-4f * std::max(l0, std::max(l1, l2));
+    return std::fabs(l0 - l1) <= tolerance && std::fabs(l0 - l2) <= tolerance &&
+           std::fabs(glm::dot(c0, c1)) <= tolerance && std::fabs(glm::dot(c0, c2)) <= tolerance &&
+           std::fabs(glm::dot(c1, c2)) <= tolerance;
+}
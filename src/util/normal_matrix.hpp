@@ -0,0 +1,32 @@
+#ifndef UTIL_NORMAL_MATRIX_HPP
+#define UTIL_NORMAL_MATRIX_HPP
+
+#include <cstdint>
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+/**
+ * Inverse transpose of the upper 3x3 of a transform, which transforms normals, as three columns of three floats. This
+ * is the layout of a mat3 uniform and of the per-instance normal matrix attribute.
+ */
+struct PackedNormalMatrix {
+    glm::vec3 columns[3];
+
+    /**
+     * Computed from cofactors: the columns are the cross products of the columns of the transform, divided by its
+     * determinant. A singular transform gives the cofactor matrix.
+     */
+    static PackedNormalMatrix from_transform(const glm::mat4 &transform);
+
+    /** Batched {from_transform} of {count} transforms, four at a time with SSE. */
+    static void from_transforms(const glm::mat4 *transforms, uint32_t count, PackedNormalMatrix *result);
+
+    /**
+     * True if the upper 3x3 of {transform} is a rotation times a uniform scale, of which the normal matrix is the
+     * upper 3x3 itself up to scale.
+     */
+    static bool has_uniform_scale(const glm::mat4 &transform);
+};
+
+#endif //UTIL_NORMAL_MATRIX_HPP
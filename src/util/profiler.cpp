@@ -0,0 +1,228 @@
+#include "profiler.hpp"
+
+#include <cstdio>
+#include <algorithm>
+
+#include "ls_log.hpp"
+
+/**
+ * Track of the calling thread, see {Profiler::get_thread_track}.
+ */
+static thread_local ProfileTrack *thread_track = nullptr;
+
+void ProfileTrack::push(const ProfileEvent &event)
+{
+    uint32_t write = head.load(std::memory_order_relaxed);
+    if (write - tail.load(std::memory_order_acquire) >= CAPACITY) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    events[write % CAPACITY] = event;
+
+    // NB: publishes the event to the consumer
+    head.store(write + 1, std::memory_order_release);
+}
+
+Profiler::Profiler() : epoch(std::chrono::steady_clock::now())
+{
+}
+
+Profiler *Profiler::get_instance()
+{
+    // NB: initialization of a function-local static is thread safe
+    static Profiler instance;
+
+    return &instance;
+}
+
+void Profiler::set_enabled(bool enabled)
+{
+    this->enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool Profiler::is_enabled() const
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+uint64_t Profiler::now() const
+{
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - epoch).count();
+}
+
+ProfileTrack *Profiler::create_track(const char *name)
+{
+    std::lock_guard<std::mutex> lock(tracks_mutex);
+
+    std::unique_ptr<ProfileTrack> track(new ProfileTrack());
+    track->id = (uint32_t) tracks.size();
+    track->name = name;
+    tracks.emplace_back(std::move(track));
+
+    return tracks.back().get();
+}
+
+ProfileTrack *Profiler::get_thread_track()
+{
+    if (!thread_track) {
+        thread_track = create_track("thread");
+
+        std::lock_guard<std::mutex> lock(tracks_mutex);
+        thread_track->name += " " + std::to_string(thread_track->id);
+    }
+
+    return thread_track;
+}
+
+void Profiler::set_thread_name(const char *name)
+{
+    ProfileTrack *track = get_thread_track();
+
+    std::lock_guard<std::mutex> lock(tracks_mutex);
+    track->name = name;
+}
+
+void Profiler::record(ProfileTrack *track, const char *name, uint64_t start, uint64_t end, uint32_t depth)
+{
+    track->push({name, start, end, depth, track->id});
+}
+
+void Profiler::end_frame()
+{
+    frame_events.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(tracks_mutex);
+        for (auto &track : tracks) {
+            uint32_t read = track->tail.load(std::memory_order_relaxed);
+            uint32_t end = track->head.load(std::memory_order_acquire);
+            for (; read != end; read++) {
+                frame_events.emplace_back(track->events[read % ProfileTrack::CAPACITY]);
+            }
+
+            // NB: hands the slots back to the producer
+            track->tail.store(read, std::memory_order_release);
+        }
+    }
+
+    if (!capturing) {
+        return;
+    }
+
+    if (captured_events.size() + frame_events.size() > MAX_CAPTURED_EVENTS) {
+        ls_log::log(LOG_WARN, "profiler capture is full after %u events, stopping it\n",
+                    (uint32_t) captured_events.size());
+        capturing = false;
+        return;
+    }
+    captured_events.insert(captured_events.end(), frame_events.begin(), frame_events.end());
+}
+
+const std::vector<ProfileEvent> &Profiler::get_frame_events() const
+{
+    return frame_events;
+}
+
+void Profiler::start_capture()
+{
+    captured_events.clear();
+    capturing = true;
+}
+
+void Profiler::stop_capture()
+{
+    capturing = false;
+}
+
+bool Profiler::is_capturing() const
+{
+    return capturing;
+}
+
+/**
+ * Writes {text} as a JSON string.
+ */
+static void write_json_string(FILE *output, const char *text)
+{
+    fputc('"', output);
+    for (const char *c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', output);
+        }
+        if ((unsigned char) *c >= 0x20) {
+            fputc(*c, output);
+        }
+    }
+    fputc('"', output);
+}
+
+bool Profiler::write_chrome_trace(const char *file_name)
+{
+    FILE *output = fopen(file_name, "w");
+    if (!output) {
+        ls_log::log(LOG_ERROR, "cannot open %s for writing\n", file_name);
+        return false;
+    }
+
+    fprintf(output, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    // a "thread" for every track, in the order they were created
+    uint32_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(tracks_mutex);
+        for (const auto &track : tracks) {
+            fprintf(output, "{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":",
+                    track->id);
+            write_json_string(output, track->name.c_str());
+            fprintf(output, "}},\n{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_sort_index\","
+                            "\"args\":{\"sort_index\":%u}},\n", track->id, track->id);
+            dropped += track->dropped.load(std::memory_order_relaxed);
+        }
+    }
+
+    // complete events, in microseconds
+    for (const auto &event : captured_events) {
+        fprintf(output, "{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":", event.track,
+                (double) event.start / 1000.0, (double) (event.end - std::min(event.start, event.end)) / 1000.0);
+        write_json_string(output, event.name);
+        fprintf(output, "},\n");
+    }
+
+    fprintf(output, "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"light_show\"}}\n]}\n");
+
+    if (fclose(output) != 0) {
+        ls_log::log(LOG_ERROR, "cannot write %s\n", file_name);
+        return false;
+    }
+
+    if (dropped > 0) {
+        ls_log::log(LOG_WARN, "%u profiler events were dropped, the trace is incomplete\n", dropped);
+    }
+    ls_log::log(LOG_INFO, "wrote %u profiler events to %s\n", (uint32_t) captured_events.size(), file_name);
+
+    return true;
+}
+
+ProfileZone::ProfileZone(const char *name) : track(nullptr), name(name), start(0)
+{
+    Profiler *profiler = Profiler::get_instance();
+    if (!profiler->is_enabled()) {
+        return;
+    }
+
+    track = profiler->get_thread_track();
+    track->depth++;
+    start = profiler->now();
+}
+
+ProfileZone::~ProfileZone()
+{
+    if (!track) {
+        return;
+    }
+
+    track->depth--;
+    track->push({name, start, Profiler::get_instance()->now(), track->depth, track->id});
+}
@@ -0,0 +1,179 @@
+#ifndef UTIL_PROFILER_HPP
+#define UTIL_PROFILER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * A timed zone recorded by {Profiler}. Times are in nanoseconds since the profiler was created.
+ */
+struct ProfileEvent {
+    /**
+     * Must outlive the profiler, such as a string literal or {__func__}.
+     */
+    const char *name;
+
+    uint64_t start;
+    uint64_t end;
+
+    /**
+     * Nesting depth on the track, 0 for the outermost zones.
+     */
+    uint32_t depth;
+
+    /**
+     * Index of the {ProfileTrack} the zone was recorded on.
+     */
+    uint32_t track;
+};
+
+/**
+ * Events of a single thread, or of another timeline such as the GPU. The events are written by a single producer and
+ * read by {Profiler::end_frame} through a ring buffer without locks. Events are dropped while the ring is full.
+ */
+struct ProfileTrack {
+    static const uint32_t CAPACITY = 16384;
+
+    uint32_t id = 0;
+    std::string name;
+
+    std::unique_ptr<ProfileEvent[]> events{new ProfileEvent[CAPACITY]};
+
+    /**
+     * Number of events written and read since the track was created, the ring position is this modulo {CAPACITY}.
+     */
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+
+    std::atomic<uint32_t> dropped{0};
+
+    /**
+     * Number of open zones, only used by the producer.
+     */
+    uint32_t depth = 0;
+
+    /** Called by the producer only. */
+    void push(const ProfileEvent &event);
+};
+
+/**
+ * Collects the zones timed with {PROFILE_ZONE} on all threads, and the GPU zones of {GpuProfiler}. Nothing is
+ * recorded unless the profiler is enabled, a disabled zone costs a single atomic load.
+ *
+ * The main thread calls {end_frame} once per frame, which moves the events of all tracks to {get_frame_events} and,
+ * while capturing, to the capture that {write_chrome_trace} exports.
+ */
+class Profiler {
+private:
+    std::chrono::steady_clock::time_point epoch;
+
+    std::atomic<bool> enabled{false};
+
+    /**
+     * Guards adding tracks, the tracks themselves are read and written without it.
+     */
+    std::mutex tracks_mutex;
+    std::vector<std::unique_ptr<ProfileTrack>> tracks;
+
+    std::vector<ProfileEvent> frame_events;
+
+    bool capturing = false;
+    std::vector<ProfileEvent> captured_events;
+
+public:
+    /**
+     * Capture size at which capturing stops, about 100 MB.
+     */
+    static const uint32_t MAX_CAPTURED_EVENTS = 1u << 22;
+
+    Profiler();
+
+    static Profiler *get_instance();
+
+    void set_enabled(bool enabled);
+
+    bool is_enabled() const;
+
+    /**
+     * Nanoseconds since the profiler was created.
+     */
+    uint64_t now() const;
+
+    /**
+     * Adds a track for events that are not recorded by {PROFILE_ZONE}, see {record}.
+     */
+    ProfileTrack *create_track(const char *name);
+
+    /**
+     * Track of the calling thread, created on first use and named "thread {id}" until {set_thread_name} is called.
+     */
+    ProfileTrack *get_thread_track();
+
+    void set_thread_name(const char *name);
+
+    /**
+     * Records an event on {track}, which must only be written to from the calling thread.
+     */
+    void record(ProfileTrack *track, const char *name, uint64_t start, uint64_t end, uint32_t depth);
+
+    /**
+     * Moves the events recorded since the previous call out of all tracks. Called once per frame by the main thread.
+     */
+    void end_frame();
+
+    /**
+     * Events moved by the last {end_frame}, ordered by track, then by end time.
+     */
+    const std::vector<ProfileEvent> &get_frame_events() const;
+
+    /**
+     * Keeps the events of all following frames until {stop_capture}, discarding the previous capture.
+     */
+    void start_capture();
+
+    void stop_capture();
+
+    bool is_capturing() const;
+
+    /**
+     * Writes the captured events as Chrome trace JSON, which can be opened in chrome://tracing and Perfetto. Returns
+     * false on failure.
+     */
+    bool write_chrome_trace(const char *file_name);
+};
+
+/**
+ * Times its lifetime on the track of the calling thread, see {PROFILE_ZONE}.
+ */
+class ProfileZone {
+private:
+    ProfileTrack *track;
+    const char *name;
+    uint64_t start;
+
+public:
+    explicit ProfileZone(const char *name);
+
+    ~ProfileZone();
+
+    ProfileZone(const ProfileZone &) = delete;
+
+    ProfileZone &operator=(const ProfileZone &) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+/**
+ * Times the rest of the enclosing scope as zone {name}, which must be a string literal.
+ */
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+
+#endif //UTIL_PROFILER_HPP
@@ -0,0 +1,166 @@
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <algorithm>
+
+/**
+ * Shared state of the batches of a single {parallel_for} call. Batches are claimed in order through {next_batch}, by
+ * the calling thread and by the helper jobs it queued.
+ */
+struct BatchGroup {
+    const std::function<void(uint32_t, uint32_t)> *fn;
+    uint32_t count;
+    uint32_t batch_count;
+
+    std::atomic<uint32_t> next_batch{0};
+    std::atomic<uint32_t> remaining;
+    std::mutex mutex;
+    std::condition_variable done;
+
+    /** First exception thrown by a batch, rethrown by the calling thread. */
+    std::exception_ptr error;
+};
+
+/**
+ * Executes batches of {group} until all of them are claimed.
+ */
+static void run_batches(BatchGroup *group)
+{
+    uint32_t batch;
+    while ((batch = group->next_batch.fetch_add(1)) < group->batch_count) {
+        uint32_t begin = (uint32_t) (((uint64_t) group->count * batch) / group->batch_count);
+        uint32_t end = (uint32_t) (((uint64_t) group->count * (batch + 1)) / group->batch_count);
+
+        // NB: {fn} is only read after claiming a batch, while the calling thread is known to wait for it
+        try {
+            (*group->fn)(begin, end);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(group->mutex);
+            if (!group->error) {
+                group->error = std::current_exception();
+            }
+        }
+
+        if (--group->remaining == 0) {
+            std::lock_guard<std::mutex> lock(group->mutex);
+            group->done.notify_all();
+        }
+    }
+}
+
+ThreadPool::ThreadPool(uint32_t thread_count)
+{
+    if (thread_count == 0) {
+        uint32_t hardware_threads = std::thread::hardware_concurrency();
+        // leave one hardware thread for the calling (main) thread, but always have at least one worker
+        thread_count = (hardware_threads > 1) ? hardware_threads - 1 : 1;
+    }
+
+    for (uint32_t i = 0; i < thread_count; i++) {
+        workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        stopping = true;
+    }
+    jobs_available.notify_all();
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+ThreadPool *ThreadPool::get_instance()
+{
+    // NB: initialization of a function-local static is thread safe
+    static ThreadPool instance;
+
+    return &instance;
+}
+
+uint32_t ThreadPool::get_thread_count() const
+{
+    return (uint32_t) workers.size() + 1;
+}
+
+void ThreadPool::worker_loop()
+{
+    while (true) {
+        std::function<void()> job;
+
+        {
+            std::unique_lock<std::mutex> lock(jobs_mutex);
+            jobs_available.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+            if (stopping && jobs.empty()) {
+                return;
+            }
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        job();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        jobs.emplace_back(std::move(job));
+    }
+    jobs_available.notify_one();
+}
+
+void ThreadPool::parallel_for(uint32_t count, const std::function<void(uint32_t, uint32_t)> &fn, uint32_t min_batch)
+{
+    if (count == 0) {
+        return;
+    }
+
+    // a few batches per thread to even out the load
+    uint32_t batch_count = (count + std::max(min_batch, 1u) - 1) / std::max(min_batch, 1u);
+    batch_count = std::min(batch_count, get_thread_count() * 4);
+
+    if (batch_count <= 1) {
+        fn(0, count);
+        return;
+    }
+
+    std::shared_ptr<BatchGroup> group = std::make_shared<BatchGroup>();
+    group->fn = &fn;
+    group->count = count;
+    group->batch_count = batch_count;
+    group->remaining = batch_count;
+
+    // helpers claim batches of this call only, so a waiting thread never runs unrelated jobs such as asset loads
+    uint32_t helper_count = std::min(batch_count - 1, (uint32_t) workers.size());
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        for (uint32_t i = 0; i < helper_count; i++) {
+            jobs.emplace_back([group] {
+                run_batches(group.get());
+            });
+        }
+    }
+    jobs_available.notify_all();
+
+    // the calling thread claims batches too, and so finishes them alone if the workers are busy. The batches in
+    // flight on other threads are being executed, so waiting for them cannot deadlock, also not from within a job
+    run_batches(group.get());
+    {
+        std::unique_lock<std::mutex> lock(group->mutex);
+        group->done.wait(lock, [&group] { return group->remaining.load() == 0; });
+    }
+
+    if (group->error) {
+        std::rethrow_exception(group->error);
+    }
+}
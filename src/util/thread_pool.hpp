@@ -0,0 +1,52 @@
+#ifndef UTIL_THREAD_POOL_HPP
+#define UTIL_THREAD_POOL_HPP
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+/**
+ * Fixed-size pool of worker threads shared by the CPU-heavy parts of the program (asset import, culling, ...).
+ * A thread waiting on a {parallel_for} only executes batches of that call, never unrelated queued jobs, and nested
+ * use from within a job is safe.
+ */
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+
+    std::deque<std::function<void()>> jobs;
+    std::mutex jobs_mutex;
+    std::condition_variable jobs_available;
+
+    bool stopping = false;
+
+    void worker_loop();
+
+public:
+    /** If {thread_count} is 0, one worker is spawned for every hardware thread except the calling one. */
+    explicit ThreadPool(uint32_t thread_count = 0);
+
+    virtual ~ThreadPool();
+
+    static ThreadPool *get_instance();
+
+    /** Number of threads executing a {parallel_for}, including the calling thread. */
+    uint32_t get_thread_count() const;
+
+    /** Queue a job to be executed on a worker thread. */
+    void submit(std::function<void()> job);
+
+    /**
+     * Splits the range [0, {count}) into batches of at least {min_batch} elements and invokes {fn(begin, end)} for
+     * every batch. The calling thread participates and the call returns once all batches have finished. The first
+     * exception thrown by {fn} is rethrown then.
+     */
+    void parallel_for(uint32_t count, const std::function<void(uint32_t begin, uint32_t end)> &fn,
+                      uint32_t min_batch = 1);
+};
+
+#endif //UTIL_THREAD_POOL_HPP
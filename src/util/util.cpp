@@ -1,5 +1,10 @@
 #include "util.hpp"
 
+#include <cstring>
+#include <climits>
+#include <cmath>
+#include <sys/stat.h>
+
 int Util::read_file(char **buffer, size_t *size, const char *file_name)
 {
     FILE *file = fopen(file_name, "rb");
@@ -33,4 +38,223 @@ int Util::read_file(char **buffer, size_t *size, const char *file_name)
     (*buffer)[*size] = '\0';
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
+
+int Util::get_file_info(const char *file_name, int64_t *mtime, uint64_t *size)
+{
+    struct stat file_stat = {};
+    if (stat(file_name, &file_stat) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    *mtime = (int64_t) file_stat.st_mtime;
+    *size = (uint64_t) file_stat.st_size;
+
+    return EXIT_SUCCESS;
+}
+
+std::string Util::canonical_path(const std::string &path)
+{
+#ifdef _WIN32
+    char buffer[_MAX_PATH];
+    if (_fullpath(buffer, path.c_str(), _MAX_PATH)) {
+        return std::string(buffer);
+    }
+#else
+    char *resolved = realpath(path.c_str(), nullptr);
+    if (resolved) {
+        std::string result(resolved);
+        free(resolved);
+        return result;
+    }
+#endif
+
+    return path;
+}
+
+void Util::flip_image_vertically(void *pixels, uint32_t width, uint32_t height, uint32_t bytes_per_pixel)
+{
+    size_t row_size = (size_t) width * bytes_per_pixel;
+    std::vector<char> row(row_size);
+
+    char *top = (char *) pixels;
+    char *bottom = top + (size_t) (height - 1) * row_size;
+    for (uint32_t y = 0; y < height / 2; y++) {
+        memcpy(row.data(), top, row_size);
+        memcpy(top, bottom, row_size);
+        memcpy(bottom, row.data(), row_size);
+
+        top += row_size;
+        bottom -= row_size;
+    }
+}
+
+int Util::write_ppm(const char *file_name, const uint8_t *pixels, uint32_t width, uint32_t height)
+{
+    FILE *file = fopen(file_name, "wb");
+    if (!file) {
+        return EXIT_FAILURE;
+    }
+
+    size_t size = (size_t) width * height * 3;
+    fprintf(file, "P6\n%u %u\n255\n", width, height);
+    bool written = fwrite(pixels, 1, size, file) == size;
+    written &= fclose(file) == 0;
+
+    return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static const uint64_t XXH_PRIME_1 = 11400714785074694791ull;
+static const uint64_t XXH_PRIME_2 = 14029467366897019727ull;
+static const uint64_t XXH_PRIME_3 = 1609587929392839161ull;
+static const uint64_t XXH_PRIME_4 = 9650029242287828579ull;
+static const uint64_t XXH_PRIME_5 = 2870177450012600261ull;
+
+static inline uint64_t rotate_left(uint64_t x, uint32_t r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read_u64(const uint8_t *p)
+{
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t xxh_round(uint64_t accumulator, uint64_t input)
+{
+    accumulator += input * XXH_PRIME_2;
+    accumulator = rotate_left(accumulator, 31);
+    return accumulator * XXH_PRIME_1;
+}
+
+static inline uint64_t xxh_merge_round(uint64_t accumulator, uint64_t value)
+{
+    accumulator ^= xxh_round(0, value);
+    return accumulator * XXH_PRIME_1 + XXH_PRIME_4;
+}
+
+uint64_t Util::hash_bytes(const void *data, size_t size)
+{
+    const uint8_t *p = (const uint8_t *) data;
+    const uint8_t *end = p + size;
+
+    uint64_t hash;
+
+    if (size >= 32) {
+        // four independent lanes of 8 bytes each
+        uint64_t v1 = XXH_PRIME_1 + XXH_PRIME_2;
+        uint64_t v2 = XXH_PRIME_2;
+        uint64_t v3 = 0;
+        uint64_t v4 = 0 - XXH_PRIME_1;
+
+        do {
+            v1 = xxh_round(v1, read_u64(p));
+            v2 = xxh_round(v2, read_u64(p + 8));
+            v3 = xxh_round(v3, read_u64(p + 16));
+            v4 = xxh_round(v4, read_u64(p + 24));
+            p += 32;
+        } while (p + 32 <= end);
+
+        hash = rotate_left(v1, 1) + rotate_left(v2, 7) + rotate_left(v3, 12) + rotate_left(v4, 18);
+        hash = xxh_merge_round(hash, v1);
+        hash = xxh_merge_round(hash, v2);
+        hash = xxh_merge_round(hash, v3);
+        hash = xxh_merge_round(hash, v4);
+    } else {
+        hash = XXH_PRIME_5;
+    }
+
+    hash += (uint64_t) size;
+
+    while (p + 8 <= end) {
+        hash ^= xxh_round(0, read_u64(p));
+        hash = rotate_left(hash, 27) * XXH_PRIME_1 + XXH_PRIME_4;
+        p += 8;
+    }
+
+    if (p + 4 <= end) {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        hash ^= (uint64_t) value * XXH_PRIME_1;
+        hash = rotate_left(hash, 23) * XXH_PRIME_2 + XXH_PRIME_3;
+        p += 4;
+    }
+
+    while (p < end) {
+        hash ^= (*p) * XXH_PRIME_5;
+        hash = rotate_left(hash, 11) * XXH_PRIME_1;
+        p++;
+    }
+
+    // final avalanche
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME_2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME_3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+uint16_t Util::float_to_half(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16u) & 0x8000u;
+    uint32_t float_exponent = (bits >> 23u) & 0xFFu;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+
+    // infinity and NaN
+    if (float_exponent == 0xFF) {
+        return (uint16_t) (sign | 0x7C00u | (mantissa ? 0x200u : 0));
+    }
+
+    int32_t exponent = (int32_t) float_exponent - 127 + 15;
+    if (exponent >= 31) {
+        return (uint16_t) (sign | 0x7C00u);
+    }
+
+    uint32_t half;
+    uint32_t shift;
+    if (exponent <= 0) {
+        // subnormal half, the implicit leading one becomes explicit
+        if (exponent < -10) {
+            return (uint16_t) sign;
+        }
+        mantissa |= 0x800000u;
+        shift = 14 - exponent;
+        half = mantissa >> shift;
+    } else {
+        shift = 13;
+        half = ((uint32_t) exponent << 10u) | (mantissa >> shift);
+    }
+
+    // round to nearest even, a carry into the exponent is still correct
+    uint32_t remainder = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half & 1u))) {
+        half++;
+    }
+
+    return (uint16_t) (sign | half);
+}
+
+float Util::half_to_float(uint16_t value)
+{
+    uint32_t exponent = (value >> 10u) & 0x1Fu;
+    uint32_t mantissa = value & 0x3FFu;
+
+    float result;
+    if (exponent == 0) {
+        result = std::ldexp((float) mantissa, -24);
+    } else if (exponent == 31) {
+        result = mantissa ? NAN : INFINITY;
+    } else {
+        result = std::ldexp((float) (mantissa | 0x400u), (int) exponent - 25);
+    }
+
+    return (value & 0x8000u) ? -result : result;
+}
@@ -3,11 +3,36 @@
 
 #include <vector>
 #include <cstdlib>
+#include <cstdint>
+#include <string>
 
 #include "ls_log.hpp"
 
 namespace Util {
     int read_file(char **buffer, size_t *size, const char *file_name);
+
+    /** Obtains the modification time (in seconds since epoch) and size of a file. */
+    int get_file_info(const char *file_name, int64_t *mtime, uint64_t *size);
+
+    /** Absolute path with all '.', '..' and (where supported) symbolic links resolved. Returns {path} on failure. */
+    std::string canonical_path(const std::string &path);
+
+    /**
+     * Flips an image upside down in place. Used instead of {stbi_set_flip_vertically_on_load}, which sets global
+     * state and can therefore not be used while images are decoded on multiple threads.
+     */
+    void flip_image_vertically(void *pixels, uint32_t width, uint32_t height, uint32_t bytes_per_pixel);
+
+    /** Writes 8 bit RGB pixels, top row first, as a binary PPM image. */
+    int write_ppm(const char *file_name, const uint8_t *pixels, uint32_t width, uint32_t height);
+
+    /** 64 bit non-cryptographic hash (XXH64 with seed 0) of a block of memory. */
+    uint64_t hash_bytes(const void *data, size_t size);
+
+    /** IEEE 754 binary16 representation of {value}, rounded to nearest even. */
+    uint16_t float_to_half(float value);
+
+    float half_to_float(uint16_t value);
 }
 
 #endif //PBR_UTIL_HPP
@@ -0,0 +1,479 @@
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <stb_image.h>
+
+#include "system/asset_manager.hpp"
+#include "system/obj_parser.hpp"
+#include "util/ls_log.hpp"
+
+/**
+ * Models to compare, relative to LIGHT_SHOW_RES_DIR.
+ */
+const char *const TEST_MODELS[][2] = {
+        {"obj/Chandelier_03", "Chandelier_03.obj"},
+        {"obj/nol",           "nol.obj"}
+};
+
+/**
+ * Chunk sizes the synthetic files are parsed with; the smaller ones split them into as many chunks as the parser
+ * allows, so that faces, groups and 'usemtl' statements end up on either side of chunk boundaries.
+ */
+const size_t TEST_CHUNK_SIZES[] = {ObjParser::MIN_CHUNK_SIZE, 2048, 1};
+
+bool equal_vectors(glm::vec3 a, glm::vec3 b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+/**
+ * Equal up to a few ulps relative to the magnitude of the values. NaNs compare equal to each other, as tangents of
+ * faces with degenerate texture coordinates are NaN.
+ */
+bool nearly_equal(float a, float b)
+{
+    if (std::isnan(a) || std::isnan(b)) {
+        return std::isnan(a) && std::isnan(b);
+    }
+
+    return std::fabs(a - b) <= 1e-6f * std::max(1.0f, std::max(std::fabs(a), std::fabs(b)));
+}
+
+bool nearly_equal(glm::vec2 a, glm::vec2 b)
+{
+    return nearly_equal(a.x, b.x) && nearly_equal(a.y, b.y);
+}
+
+bool nearly_equal(glm::vec3 a, glm::vec3 b)
+{
+    return nearly_equal(a.x, b.x) && nearly_equal(a.y, b.y) && nearly_equal(a.z, b.z);
+}
+
+bool nearly_equal(const std::vector<float> &a, const std::vector<float> &b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.size(); i++) {
+        if (!nearly_equal(a[i], b[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool compare_textures(const char *model, const char *name, const Texture &expected, const Texture &actual)
+{
+    if (expected.file != actual.file) {
+        ls_log::log(LOG_ERROR, "%s: %s texture is %s instead of %s\n", model, name, actual.file.c_str(),
+                    expected.file.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Compares the models field by field, logging the first difference. {expected} is imported by tinyobj.
+ */
+bool compare_models(const char *model, const Model &expected, const Model &actual)
+{
+    if (expected.vertices.size() != actual.vertices.size()) {
+        ls_log::log(LOG_ERROR, "%s: %u vertices instead of %u\n", model, (uint32_t) actual.vertices.size(),
+                    (uint32_t) expected.vertices.size());
+        return false;
+    }
+
+    for (uint32_t i = 0; i < expected.vertices.size(); i++) {
+        const Vertex &a = expected.vertices[i];
+        const Vertex &b = actual.vertices[i];
+        if (!nearly_equal(a.position, b.position) || !nearly_equal(a.normal, b.normal) || !nearly_equal(a.uv, b.uv) ||
+            !nearly_equal(a.tangent, b.tangent) || !nearly_equal(a.biTangent, b.biTangent)) {
+            ls_log::log(LOG_ERROR, "%s: vertex %u differs\n", model, i);
+            return false;
+        }
+    }
+
+    const std::vector<MaterialSubMesh> &expectedSubMeshes = expected.mesh.materialSubMeshes;
+    const std::vector<MaterialSubMesh> &actualSubMeshes = actual.mesh.materialSubMeshes;
+    if (expectedSubMeshes.size() != actualSubMeshes.size()) {
+        ls_log::log(LOG_ERROR, "%s: %u submeshes instead of %u\n", model, (uint32_t) actualSubMeshes.size(),
+                    (uint32_t) expectedSubMeshes.size());
+        return false;
+    }
+
+    for (uint32_t i = 0; i < expectedSubMeshes.size(); i++) {
+        if (expectedSubMeshes[i].materialIndex != actualSubMeshes[i].materialIndex ||
+            expectedSubMeshes[i].indices != actualSubMeshes[i].indices) {
+            ls_log::log(LOG_ERROR, "%s: submesh %u differs (%u indices instead of %u)\n", model, i,
+                        (uint32_t) actualSubMeshes[i].indices.size(), (uint32_t) expectedSubMeshes[i].indices.size());
+            return false;
+        }
+    }
+
+    if (expected.materials.size() != actual.materials.size()) {
+        ls_log::log(LOG_ERROR, "%s: %u materials instead of %u\n", model, (uint32_t) actual.materials.size(),
+                    (uint32_t) expected.materials.size());
+        return false;
+    }
+
+    for (uint32_t i = 0; i < expected.materials.size(); i++) {
+        const Material &a = expected.materials[i];
+        const Material &b = actual.materials[i];
+        if (a.name != b.name || !equal_vectors(a.albedo, b.albedo) || a.roughness != b.roughness ||
+            a.metallic != b.metallic) {
+            ls_log::log(LOG_ERROR, "%s: material %u (%s) differs\n", model, i, a.name.c_str());
+            return false;
+        }
+
+        if (!compare_textures(model, "albedo", a.albedoTexture, b.albedoTexture) ||
+            !compare_textures(model, "roughness", a.roughnessTexture, b.roughnessTexture) ||
+            !compare_textures(model, "metallic", a.metallicTexture, b.metallicTexture) ||
+            !compare_textures(model, "normal", a.normalMap, b.normalMap)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * The raw output of {tinyobj::LoadObj} or {ObjParser::loadObj}.
+ */
+struct ParsedObj {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+};
+
+/**
+ * A small OBJ file written by the test, with what it should parse into independently of either parser: the vertex
+ * and normal index of every triangle corner and the material of every triangle, in file order, and the shape names.
+ */
+struct SyntheticObj {
+    const char *name;
+    std::string text;
+
+    std::vector<int> vertexIndices;
+    std::vector<int> normalIndices;
+    std::vector<int> materialIds;
+    std::vector<std::string> shapeNames;
+};
+
+const char *const SYNTHETIC_MTL_FILE = "obj_parser_test.mtl";
+const char *const SYNTHETIC_OBJ_FILE = "obj_parser_test.obj";
+
+/** Materials of the synthetic files, in the order tinyobj numbers them. */
+const char *const SYNTHETIC_MATERIALS[] = {"red", "blue"};
+
+void add_triangle(SyntheticObj *obj, int a, int b, int c, int normal, int material)
+{
+    obj->vertexIndices.insert(obj->vertexIndices.end(), {a, b, c});
+    obj->normalIndices.insert(obj->normalIndices.end(), {normal, normal, normal});
+    obj->materialIds.push_back(material);
+}
+
+/** A quad, a hexagon and a triangle, which are fan triangulated around their first corner. */
+SyntheticObj quads_and_ngons()
+{
+    SyntheticObj obj = {"quads and n-gons", "", {}, {}, {}, {""}};
+    obj.text = "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 0.5 1.5 0\nv -0.5 0.5 0\n"
+               "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+               "vn 0 0 1\n"
+               "f 1/1/1 2/2/1 3/3/1 4/4/1\n"
+               "f 1 2 3 5 4 6\n"
+               "f 1//1 3//1 4//1\n";
+
+    add_triangle(&obj, 0, 1, 2, 0, -1);
+    add_triangle(&obj, 0, 2, 3, 0, -1);
+
+    add_triangle(&obj, 0, 1, 2, -1, -1);
+    add_triangle(&obj, 0, 2, 4, -1, -1);
+    add_triangle(&obj, 0, 4, 3, -1, -1);
+    add_triangle(&obj, 0, 3, 5, -1, -1);
+
+    add_triangle(&obj, 0, 2, 3, 0, -1);
+
+    return obj;
+}
+
+/** Negative indices count back from the attributes parsed so far, and may be mixed with positive ones. */
+SyntheticObj negative_indices()
+{
+    SyntheticObj obj = {"negative indices", "", {}, {}, {}, {""}};
+    obj.text = "v 0 0 0\nv 1 0 0\nv 1 1 0\n"
+               "vt 0 0\nvt 1 0\nvt 1 1\n"
+               "vn 0 0 1\n"
+               "f -3/-3/-1 -2/-2/-1 -1/-1/-1\n"
+               "v 0 1 0\n"
+               "vn 0 0 -1\n"
+               "f 1//-1 -2//-1 -1//2\n"
+               "f -4/-3 2/-2 4/-1\n";
+
+    add_triangle(&obj, 0, 1, 2, 0, -1);
+    add_triangle(&obj, 0, 2, 3, 1, -1);
+    add_triangle(&obj, 0, 1, 3, -1, -1);
+
+    return obj;
+}
+
+/**
+ * Quads alternating between negative and positive indices, with groups and materials changing every few faces, so
+ * that they straddle chunk boundaries when split finely. It ends with a polygon whose face line is longer than the
+ * chunks the smallest chunk sizes produce, so that a chunk boundary falls inside it.
+ */
+SyntheticObj chunked_groups()
+{
+    const int QUAD_COUNT = 64;
+    const int POLYGON_SIZE = 300;
+
+    SyntheticObj obj = {"groups and materials across chunks", "", {}, {}, {}, {}};
+    obj.text = std::string("mtllib ") + SYNTHETIC_MTL_FILE + "\nvn 0 0 1\n";
+
+    int material = -1;
+    for (int i = 0; i < QUAD_COUNT; i++) {
+        if (i % 3 == 0) {
+            obj.shapeNames.push_back("part" + std::to_string(i / 3));
+            obj.text += "g " + obj.shapeNames.back() + "\n";
+        }
+        if (i % 2 == 0) {
+            material = (i / 2) % 2;
+            obj.text += std::string("usemtl ") + SYNTHETIC_MATERIALS[material] + "\n";
+        }
+
+        std::string x = std::to_string(i);
+        std::string x1 = std::to_string(i + 1);
+        obj.text += "v " + x + " 0 0\nv " + x1 + " 0 0\nv " + x1 + " 1 0\nv " + x + " 1 0\n";
+
+        int base = i * 4;
+        if (i % 2 == 1) {
+            obj.text += "f -4//-1 -3//-1 -2//-1 -1//-1\n";
+        } else {
+            obj.text += "f";
+            for (int k = 1; k <= 4; k++) {
+                obj.text += " " + std::to_string(base + k) + "//1";
+            }
+            obj.text += "\n";
+        }
+
+        add_triangle(&obj, base, base + 1, base + 2, 0, material);
+        add_triangle(&obj, base, base + 2, base + 3, 0, material);
+    }
+
+    obj.shapeNames.push_back("polygon");
+    obj.text += "g polygon\n";
+    for (int k = 0; k < POLYGON_SIZE; k++) {
+        obj.text += "v " + std::to_string(k) + " 2 0\n";
+    }
+
+    obj.text += "f";
+    for (int k = POLYGON_SIZE; k > 0; k--) {
+        obj.text += " -" + std::to_string(k);
+    }
+    obj.text += "\n";
+
+    int base = QUAD_COUNT * 4;
+    for (int k = 2; k < POLYGON_SIZE; k++) {
+        add_triangle(&obj, base, base + k - 1, base + k, -1, material);
+    }
+
+    return obj;
+}
+
+bool write_text_file(const char *file, const std::string &text)
+{
+    FILE *f = fopen(file, "wb");
+    if (!f) {
+        ls_log::log(LOG_ERROR, "cannot write %s\n", file);
+        return false;
+    }
+
+    bool written = fwrite(text.data(), 1, text.size(), f) == text.size();
+    fclose(f);
+
+    return written;
+}
+
+/**
+ * Compares {parsed} against what {obj} should parse into, logging the first difference.
+ */
+bool check_synthetic(const SyntheticObj &obj, const char *parser, const ParsedObj &parsed)
+{
+    std::vector<int> vertexIndices;
+    std::vector<int> normalIndices;
+    std::vector<int> materialIds;
+    std::vector<std::string> shapeNames;
+    for (const auto &shape : parsed.shapes) {
+        for (const auto &index : shape.mesh.indices) {
+            vertexIndices.push_back(index.vertex_index);
+            normalIndices.push_back(index.normal_index);
+        }
+        materialIds.insert(materialIds.end(), shape.mesh.material_ids.begin(), shape.mesh.material_ids.end());
+        shapeNames.push_back(shape.name);
+    }
+
+    if (vertexIndices != obj.vertexIndices || normalIndices != obj.normalIndices) {
+        ls_log::log(LOG_ERROR, "%s, %s: %u corners, or their indices, differ from the %u expected\n", obj.name, parser,
+                    (uint32_t) vertexIndices.size(), (uint32_t) obj.vertexIndices.size());
+        return false;
+    }
+
+    if (materialIds != obj.materialIds) {
+        ls_log::log(LOG_ERROR, "%s, %s: triangle materials differ\n", obj.name, parser);
+        return false;
+    }
+
+    if (shapeNames != obj.shapeNames) {
+        ls_log::log(LOG_ERROR, "%s, %s: %u shapes instead of %u, or differently named\n", obj.name, parser,
+                    (uint32_t) shapeNames.size(), (uint32_t) obj.shapeNames.size());
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Compares the raw parser outputs attribute by attribute and shape by shape, logging the first difference.
+ */
+bool compare_parsed(const char *name, const char *parser, const ParsedObj &expected, const ParsedObj &actual)
+{
+    if (!nearly_equal(expected.attrib.vertices, actual.attrib.vertices) ||
+        !nearly_equal(expected.attrib.normals, actual.attrib.normals) ||
+        !nearly_equal(expected.attrib.texcoords, actual.attrib.texcoords)) {
+        ls_log::log(LOG_ERROR, "%s, %s: attributes differ\n", name, parser);
+        return false;
+    }
+
+    if (expected.shapes.size() != actual.shapes.size()) {
+        ls_log::log(LOG_ERROR, "%s, %s: %u shapes instead of %u\n", name, parser, (uint32_t) actual.shapes.size(),
+                    (uint32_t) expected.shapes.size());
+        return false;
+    }
+
+    for (size_t s = 0; s < expected.shapes.size(); s++) {
+        const tinyobj::mesh_t &a = expected.shapes[s].mesh;
+        const tinyobj::mesh_t &b = actual.shapes[s].mesh;
+
+        bool equal = expected.shapes[s].name == actual.shapes[s].name && a.indices.size() == b.indices.size() &&
+                     a.material_ids == b.material_ids && a.num_face_vertices == b.num_face_vertices;
+        for (size_t i = 0; equal && i < a.indices.size(); i++) {
+            equal = a.indices[i].vertex_index == b.indices[i].vertex_index &&
+                    a.indices[i].normal_index == b.indices[i].normal_index &&
+                    a.indices[i].texcoord_index == b.indices[i].texcoord_index;
+        }
+
+        if (!equal) {
+            ls_log::log(LOG_ERROR, "%s, %s: shape %u differs\n", name, parser, (uint32_t) s);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Parses {obj} with tinyobj and with {ObjParser} at each of {TEST_CHUNK_SIZES}, and checks all of them against the
+ * expected triangles, and the parallel parser against tinyobj.
+ */
+bool test_synthetic(const SyntheticObj &obj)
+{
+    if (!write_text_file(SYNTHETIC_OBJ_FILE, obj.text)) {
+        return false;
+    }
+
+    ParsedObj expected;
+    std::string err;
+    if (!tinyobj::LoadObj(&expected.attrib, &expected.shapes, &expected.materials, &err, SYNTHETIC_OBJ_FILE, "./")) {
+        ls_log::log(LOG_ERROR, "%s: tinyobj could not parse the file: %s\n", obj.name, err.c_str());
+        return false;
+    }
+
+    bool passed = check_synthetic(obj, "tinyobj", expected);
+
+    for (size_t chunkSize : TEST_CHUNK_SIZES) {
+        std::string parser = "chunks of " + std::to_string(chunkSize) + " bytes";
+
+        ParsedObj actual;
+        if (!ObjParser::loadObj(&actual.attrib, &actual.shapes, &actual.materials, &err, SYNTHETIC_OBJ_FILE, "./",
+                                chunkSize)) {
+            ls_log::log(LOG_ERROR, "%s, %s: the parallel parser could not parse the file: %s\n", obj.name,
+                        parser.c_str(), err.c_str());
+            passed = false;
+            continue;
+        }
+
+        passed = check_synthetic(obj, parser.c_str(), actual) && passed;
+        passed = compare_parsed(obj.name, parser.c_str(), expected, actual) && passed;
+    }
+
+    if (passed) {
+        ls_log::log(LOG_INFO, "%s: %u triangles match\n", obj.name, (uint32_t) obj.materialIds.size());
+    }
+
+    return passed;
+}
+
+/**
+ * Checks that {ObjParser} and {tinyobj::LoadObj} import the bundled models into identical models: the same vertices,
+ * the same indices per submesh and the same materials. Then checks both parsers against small synthetic files, which
+ * the parallel parser splits into many chunks.
+ */
+int main()
+{
+    AssetManager asset_manager;
+    bool passed = true;
+
+    for (const auto &test_model : TEST_MODELS) {
+        std::string dir = std::string(LIGHT_SHOW_RES_DIR) + "/" + test_model[0];
+
+        Model expected(0);
+        asset_manager.setObjParserType(TINYOBJ_PARSER);
+        if (!asset_manager.importObj(dir, test_model[1], &expected)) {
+            ls_log::log(LOG_ERROR, "%s: tinyobj could not import the model\n", test_model[1]);
+            passed = false;
+            continue;
+        }
+
+        Model actual(1);
+        asset_manager.setObjParserType(PARALLEL_PARSER);
+        if (!asset_manager.importObj(dir, test_model[1], &actual)) {
+            ls_log::log(LOG_ERROR, "%s: the parallel parser could not import the model\n", test_model[1]);
+            passed = false;
+            continue;
+        }
+
+        if (compare_models(test_model[1], expected, actual)) {
+            ls_log::log(LOG_INFO, "%s: %u vertices, %u submeshes and %u materials match\n", test_model[1],
+                        (uint32_t) expected.vertices.size(), (uint32_t) expected.mesh.materialSubMeshes.size(),
+                        (uint32_t) expected.materials.size());
+        } else {
+            passed = false;
+        }
+    }
+
+    std::string mtl;
+    for (const char *material : SYNTHETIC_MATERIALS) {
+        mtl += std::string("newmtl ") + material + "\nKd 1 1 1\n";
+    }
+
+    if (write_text_file(SYNTHETIC_MTL_FILE, mtl)) {
+        for (const SyntheticObj &obj : {quads_and_ngons(), negative_indices(), chunked_groups()}) {
+            passed = test_synthetic(obj) && passed;
+        }
+    } else {
+        passed = false;
+    }
+
+    remove(SYNTHETIC_OBJ_FILE);
+    remove(SYNTHETIC_MTL_FILE);
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}